@@ -101,6 +101,7 @@ QtSpacescapeMainWindow::QtSpacescapeMainWindow(QWidget *parent) :
     connect(ui->actionAbout, SIGNAL(triggered()), this, SLOT(onAbout()));
 
     
+    mPropertyTitles["cpuNoise"] = QString("CPU Noise");
     mPropertyTitles["destBlendFactor"] = QString("Dest Blend Factor");
     mPropertyTitles["ditherAmount"] = QString("Dither Amount");
     mPropertyTitles["farColor"] = QString("Far Color");
@@ -113,6 +114,8 @@ QtSpacescapeMainWindow::QtSpacescapeMainWindow(QWidget *parent) :
     
     // option multiplier to use in HDR mode
     mPropertyTitles["hdrMultiplier"] = QString("HDR Multiplier");
+    mPropertyTitles["magnitudeLimit"] = QString("Magnitude Limit");
+    mPropertyTitles["maskCPUNoise"] = QString("Mask CPU Noise");
     mPropertyTitles["maskEnabled"] = QString("Mask Enabled");
     mPropertyTitles["maskGain"] = QString("Mask Gain");
     mPropertyTitles["maskInnerColor"] = QString("Mask Inner Color");
@@ -124,6 +127,7 @@ QtSpacescapeMainWindow::QtSpacescapeMainWindow(QWidget *parent) :
     mPropertyTitles["maskPower"] = QString("Mask Power");
     mPropertyTitles["maskScale"] = QString("Mask Noise Scale");
     mPropertyTitles["maskSeed"] = QString("Mask Random Seed");
+    mPropertyTitles["maskSize"] = QString("Mask Resolution");
     mPropertyTitles["maskThreshold"] = QString("Mask Threshold");
     mPropertyTitles["maxSize"] = QString("Near Billboard Size");
     mPropertyTitles["minSize"] = QString("Far Billboard Size");
@@ -138,6 +142,9 @@ QtSpacescapeMainWindow::QtSpacescapeMainWindow(QWidget *parent) :
     mPropertyTitles["outerColor"] = QString("Outer Color");
     mPropertyTitles["pointSize"] = QString("Point Size");
     mPropertyTitles["powerAmount"] = QString("Power");
+    mPropertyTitles["regionDec"] = QString("Region Declination");
+    mPropertyTitles["regionRA"] = QString("Region Right Ascension");
+    mPropertyTitles["regionRadius"] = QString("Region Radius");
     mPropertyTitles["previewTextureSize"] = QString("Preview Texture Size");
     mPropertyTitles["texture"] = QString("Billboard Texture");
     mPropertyTitles["type"] = QString("Layer Type");
@@ -392,7 +399,7 @@ QLatin1String QtSpacescapeMainWindow::getPropertyStatusTip(const Ogre::String& p
         return QLatin1String("Multiply the final by this value.");
     }
     else if(prop == "dataFile") {
-        return QLatin1String("A CSV file with x,y,z,distance (in parsecs), mag (magnitude), BV fields.");
+        return QLatin1String("A CSV file with x,y,z,distance (in parsecs), mag (magnitude), BV fields, or a binary .ssc star catalog converted from one.");
     }
     else if(prop == "octaves" || prop == "maskOctaves") {
         return QLatin1String("Number of noise functions in a series of noise functions that are added together.");
@@ -418,6 +425,24 @@ QLatin1String QtSpacescapeMainWindow::getPropertyStatusTip(const Ogre::String& p
     else if(prop == "maskSeed") {
         return QLatin1String("This number is used as the basis for the random number generator for the noise mask.");
     }
+    else if(prop == "maskSize") {
+        return QLatin1String("Width and height of each noise mask face, up to 4096. Higher resolutions follow the mask more closely.");
+    }
+    else if(prop == "cpuNoise") {
+        return QLatin1String("Generate the noise on the CPU instead of rendering it on the GPU.");
+    }
+    else if(prop == "maskCPUNoise") {
+        return QLatin1String("Generate the noise mask on the CPU instead of rendering it on the GPU and reading it back.");
+    }
+    else if(prop == "magnitudeLimit") {
+        return QLatin1String("Data file stars fainter than this apparent magnitude are skipped.");
+    }
+    else if(prop == "regionRA" || prop == "regionDec") {
+        return QLatin1String("Centre of the sky region data file stars are taken from, in degrees.");
+    }
+    else if(prop == "regionRadius") {
+        return QLatin1String("Radius of the sky region data file stars are taken from, in degrees. 180 uses the whole sky.");
+    }
     else if(prop == "sourceBlendFactor") {
         return QLatin1String("Source blend factor.");
     }
@@ -474,12 +499,15 @@ int QtSpacescapeMainWindow::getPropertyType(const Ogre::String& name)
         name == "octaves" ||
         name == "maskSeed" ||
         name == "maskOctaves" ||
+        name == "maskSize" ||
         name == "numBillboards" ||
         name == "numPoints" ||
         name == "pointSize" ) {
             return QVariant::Int;
     }
     else if(name == "visible" ||
+        name == "cpuNoise" ||
+        name == "maskCPUNoise" ||
         name == "maskEnabled"
         ) {
             return QVariant::Bool;
@@ -592,7 +620,7 @@ QtProperty* QtSpacescapeMainWindow::insertLayerProperties(Ogre::SpacescapeLayer*
             QtFilePathManager *mgr = new QtFilePathManager;
             QtProperty *pathProperty = mgr->addProperty("Data File");
 			mgr->setValue(pathProperty, QLatin1String(pl->second.c_str()));
-            mgr->setFilter(pathProperty, "Source files (*.csv)");
+            mgr->setFilter(pathProperty, "Star catalogs (*.csv *.ssc)");
             QtFileEditFactory *fact = new QtFileEditFactory;
             ui->layerProperties->setFactoryForManager(mgr, fact);
             layerProperties->addSubProperty(pathProperty);
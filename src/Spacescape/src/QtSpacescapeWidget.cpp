@@ -28,7 +28,9 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
 #include "QtSpacescapeWidget.h"
+#include <QDir>
 #include <QMouseEvent>
+#include <QStandardPaths>
 //#include "OGRE/Ogre.h"
 #include <Ogre.h>
 
@@ -430,6 +432,12 @@ void QtSpacescapeWidget::setupScene(void) {
 	
 	Ogre::ResourceGroupManager::getSingleton().initialiseAllResourceGroups();
 	createScene();
+
+    // keep baked noise between sessions so reopening scenes is quick
+    QString noiseCacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if(!noiseCacheDir.isEmpty() && QDir().mkpath(noiseCacheDir + "/noise")) {
+        getPlugin()->setNoiseCacheDirectory((noiseCacheDir + "/noise").toStdString());
+    }
 	
 	Ogre::MaterialManager::getSingleton().setDefaultTextureFiltering(Ogre::TFO_BILINEAR);
 	Ogre::MaterialManager::getSingleton().setDefaultAnisotropy(1);
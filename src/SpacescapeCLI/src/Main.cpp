@@ -0,0 +1,459 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include "SpacescapePlugin.h"
+#include "SpacescapeLayer.h"
+#include "SpacescapeProgressListener.h"
+#include "SpacescapeStarCatalog.h"
+#include "OgreRoot.h"
+#include "OgreConfigFile.h"
+#include "OgreLogManager.h"
+#include "OgreRenderWindow.h"
+#include "OgreResourceGroupManager.h"
+#include "OgreStringConverter.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+using namespace Ogre;
+
+typedef std::chrono::steady_clock Clock;
+
+/** Get the milliseconds elapsed since a time point
+@param start The time point
+@return the elapsed time in milliseconds
+*/
+static double elapsedMs(const Clock::time_point& start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+/** Progress listener that times each task the plugin reports
+*/
+class StageTimer : public SpacescapeProgressListener
+{
+public:
+    StageTimer() : mVerbose(false) {}
+
+    /** Close the current stage and print it if verbose
+    */
+    void finish(void)
+    {
+        if(!mStage.empty()) {
+            double ms = elapsedMs(mStart);
+            if(mVerbose) {
+                printf("    %-24s %10.1f ms\n", mStage.c_str(), ms);
+            }
+            mStage.clear();
+        }
+    }
+
+    /** Set whether every stage gets printed
+    @param verbose true to print stages
+    */
+    void setVerbose(bool verbose) { mVerbose = verbose; }
+
+    /** Called by the plugin whenever it starts a new task
+    @param percentComplete The percentage complete 0 - 100
+    @param msg The current task message
+    */
+    void updateProgressBar(unsigned int percentComplete, const String& msg)
+    {
+        if(msg == mStage) {
+            return;
+        }
+
+        finish();
+        mStage = msg;
+        mStart = Clock::now();
+    }
+
+private:
+    // current stage message
+    String mStage;
+
+    // when the current stage started
+    Clock::time_point mStart;
+
+    // print every stage
+    bool mVerbose;
+};
+
+/** Print usage information
+@param exe The executable name
+*/
+static void printUsage(const char* exe)
+{
+    printf(
+        "Usage: %s [options] scene.xml [scene.xml ...]\n"
+        "       %s --convert-catalog stars.csv stars.ssc\n"
+        "\n"
+        "Exports each Spacescape scene to a skybox without opening a window.\n"
+        "\n"
+        "Options:\n"
+        "  -o, --output DIR          directory to write to (default: .)\n"
+        "  -s, --size N              face size in pixels (default: 1024)\n"
+        "  -f, --format EXT          image format for the six faces (default: png)\n"
+        "  -c, --cube                write a single cube map .dds instead of six faces\n"
+        "  -r, --orientation MODE    default, unreal, unity or source\n"
+        "      --hdr                 enable HDR rendering\n"
+        "      --cpu-noise           generate noise layers on the CPU\n"
+        "      --software            render on the CPU, no render system or display needed\n"
+        "      --strip N             render and write N rows at a time to bound memory use\n"
+        "                            (.dds, .hdr, .pfm and .tga only)\n"
+        "      --compress FORMAT     block compress .dds output: bc1, bc3, bc7 or bc6h (HDR)\n"
+        "      --quality MODE        compression quality: fast, normal or high\n"
+        "      --mipmaps             write seamless mip maps (.dds embeds them, other\n"
+        "                            formats get a _mipN file per level)\n"
+        "      --noise-cache DIR     keep baked noise cubes in DIR and reuse them on\n"
+        "                            later runs with the same settings\n"
+        "      --media DIR           add a media directory (may be repeated)\n"
+        "      --plugins FILE        Ogre plugins file (default: plugins.cfg)\n"
+        "      --resources FILE      Ogre resources file (default: resources.cfg)\n"
+        "      --rendersystem NAME   render system to use\n"
+        "      --log FILE            Ogre log file (default: spacescape-cli.log)\n"
+        "      --convert-catalog CSV OUT\n"
+        "                            convert a CSV star catalog to the binary catalog\n"
+        "                            billboard layers map instead of parsing\n"
+        "  -v, --verbose             print the time of every export stage\n"
+        "  -h, --help                show this help\n",
+        exe, exe
+    );
+}
+
+/** Add the resource locations from an Ogre resources file
+@param filename The resources file
+*/
+static void setupResources(const String& filename)
+{
+    std::ifstream test(filename.c_str());
+    if(!test) {
+        return;
+    }
+    test.close();
+
+    ConfigFile config;
+    config.load(filename);
+
+    ConfigFile::SettingsBySection_::const_iterator sec;
+    for(sec = config.getSettingsBySection().begin(); sec != config.getSettingsBySection().end(); ++sec) {
+        ConfigFile::SettingsMultiMap::const_iterator i;
+        for(i = sec->second.begin(); i != sec->second.end(); ++i) {
+            ResourceGroupManager::getSingleton().addResourceLocation(i->second, i->first, sec->first);
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<String> scenes;
+    std::vector<String> mediaDirs;
+    String outputDir = ".";
+    String format = "png";
+    String pluginsFile = "plugins.cfg";
+    String resourcesFile = "resources.cfg";
+    String logFile = "spacescape-cli.log";
+    String renderSystemName;
+    String noiseCacheDir;
+    String catalogSource;
+    String catalogDest;
+    unsigned int size = 1024;
+    unsigned int stripHeight = 0;
+    bool cube = false;
+    bool hdr = false;
+    bool cpuNoise = false;
+    bool software = false;
+    bool mipmaps = false;
+    PixelFormat compression = PF_UNKNOWN;
+    SpacescapeBlockCompressor::Quality quality = SpacescapeBlockCompressor::BCQ_NORMAL;
+    bool verbose = false;
+    SpacescapePlugin::SpacescapeRTTOrientation orientation = SpacescapePlugin::SRO_DEFAULT_ORIENTATION;
+
+    for(int i = 1; i < argc; ++i) {
+        String arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if(arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        }
+        else if((arg == "-o" || arg == "--output") && hasValue) {
+            outputDir = argv[++i];
+        }
+        else if((arg == "-s" || arg == "--size") && hasValue) {
+            size = StringConverter::parseUnsignedInt(argv[++i]);
+        }
+        else if((arg == "-f" || arg == "--format") && hasValue) {
+            format = argv[++i];
+        }
+        else if(arg == "-c" || arg == "--cube") {
+            cube = true;
+        }
+        else if((arg == "-r" || arg == "--orientation") && hasValue) {
+            String mode = argv[++i];
+            if(mode == "unreal") {
+                orientation = SpacescapePlugin::SRO_UNREAL_ORIENTATION;
+            }
+            else if(mode == "unity") {
+                orientation = SpacescapePlugin::SRO_UNITY_ORIENTATION;
+            }
+            else if(mode == "source") {
+                orientation = SpacescapePlugin::SRO_SOURCE_ORIENTATION;
+            }
+            else if(mode != "default") {
+                fprintf(stderr, "Unknown orientation: %s\n", mode.c_str());
+                return 1;
+            }
+        }
+        else if(arg == "--hdr") {
+            hdr = true;
+        }
+        else if(arg == "--cpu-noise") {
+            cpuNoise = true;
+        }
+        else if(arg == "--software") {
+            software = true;
+        }
+        else if(arg == "--strip" && hasValue) {
+            stripHeight = StringConverter::parseUnsignedInt(argv[++i]);
+        }
+        else if(arg == "--compress" && hasValue) {
+            String mode = argv[++i];
+            if(mode == "bc1") {
+                compression = PF_DXT1;
+            }
+            else if(mode == "bc3") {
+                compression = PF_DXT5;
+            }
+            else if(mode == "bc6h") {
+                compression = PF_BC6H_UF16;
+            }
+            else if(mode == "bc7") {
+                compression = PF_BC7_UNORM;
+            }
+            else {
+                fprintf(stderr, "Unknown compression: %s\n", mode.c_str());
+                return 1;
+            }
+        }
+        else if(arg == "--quality" && hasValue) {
+            String mode = argv[++i];
+            if(mode == "fast") {
+                quality = SpacescapeBlockCompressor::BCQ_FAST;
+            }
+            else if(mode == "high") {
+                quality = SpacescapeBlockCompressor::BCQ_HIGH;
+            }
+            else if(mode != "normal") {
+                fprintf(stderr, "Unknown quality: %s\n", mode.c_str());
+                return 1;
+            }
+        }
+        else if(arg == "--mipmaps") {
+            mipmaps = true;
+        }
+        else if(arg == "--noise-cache" && hasValue) {
+            noiseCacheDir = argv[++i];
+        }
+        else if(arg == "--media" && hasValue) {
+            mediaDirs.push_back(argv[++i]);
+        }
+        else if(arg == "--plugins" && hasValue) {
+            pluginsFile = argv[++i];
+        }
+        else if(arg == "--resources" && hasValue) {
+            resourcesFile = argv[++i];
+        }
+        else if(arg == "--rendersystem" && hasValue) {
+            renderSystemName = argv[++i];
+        }
+        else if(arg == "--log" && hasValue) {
+            logFile = argv[++i];
+        }
+        else if(arg == "--convert-catalog" && i + 2 < argc) {
+            catalogSource = argv[++i];
+            catalogDest = argv[++i];
+        }
+        else if(arg == "-v" || arg == "--verbose") {
+            verbose = true;
+        }
+        else if(!arg.empty() && arg[0] == '-') {
+            fprintf(stderr, "Unknown option or missing value: %s\n", arg.c_str());
+            printUsage(argv[0]);
+            return 1;
+        }
+        else {
+            scenes.push_back(arg);
+        }
+    }
+
+    if(!catalogSource.empty()) {
+        // no render system needed, only the log for catalog errors
+        LogManager* logManager = OGRE_NEW LogManager();
+        logManager->createLog(logFile, true, false, false);
+
+        SpacescapeStarCatalog catalog;
+        bool converted = catalog.loadCSV(catalogSource) && catalog.save(catalogDest);
+        if(converted) {
+            printf("Wrote %u stars to %s\n", (unsigned int)catalog.getNumStars(), catalogDest.c_str());
+        }
+        else {
+            fprintf(stderr, "Failed to convert %s - see %s\n", catalogSource.c_str(), logFile.c_str());
+        }
+
+        OGRE_DELETE logManager;
+        return converted ? 0 : 1;
+    }
+
+    if(scenes.empty() || size == 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    Clock::time_point start = Clock::now();
+
+    // keep the Ogre log out of the console
+    LogManager* logManager = OGRE_NEW LogManager();
+    logManager->createLog(logFile, true, false, false);
+
+    Root* root = OGRE_NEW Root(pluginsFile, "", "");
+
+    RenderSystem* renderSystem = NULL;
+    if(!software) {
+        if(!renderSystemName.empty()) {
+            renderSystem = root->getRenderSystemByName(renderSystemName);
+        }
+        else if(!root->getAvailableRenderers().empty()) {
+            // prefer the render system the editor uses
+            renderSystem = root->getRenderSystemByName("OpenGL Rendering Subsystem");
+            if(!renderSystem) {
+                renderSystem = root->getAvailableRenderers().front();
+            }
+        }
+
+        if(!renderSystem) {
+            fprintf(stderr, "No render system found - check %s or use --software\n", pluginsFile.c_str());
+            OGRE_DELETE root;
+            OGRE_DELETE logManager;
+            return 1;
+        }
+
+        root->setRenderSystem(renderSystem);
+        root->initialise(false);
+
+        // the render system needs a context to render the cube faces with, 
+        // a hidden 1x1 window is enough (use an EGL build of the GL render
+        // systems or run under xvfb on machines without a display)
+        NameValuePairList windowParams;
+        windowParams["hidden"] = "true";
+        root->createRenderWindow("spacescape-cli", 1, 1, false, &windowParams);
+    }
+
+    setupResources(resourcesFile);
+    for(size_t i = 0; i < mediaDirs.size(); ++i) {
+        ResourceGroupManager::getSingleton().addResourceLocation(mediaDirs[i], "FileSystem");
+        ResourceGroupManager::getSingleton().addResourceLocation(mediaDirs[i] + "/materials/textures", "FileSystem");
+    }
+
+    // material and program scripts need the texture and program managers
+    // a render system creates, so only parse them when there is one.  In
+    // software mode the layers only open files (billboard textures, star
+    // data) and resource locations are indexed as soon as they are added
+    if(renderSystem) {
+        ResourceGroupManager::getSingleton().initialiseAllResourceGroups();
+    }
+
+    // the plugin adds its layers to the first scene manager
+    root->createSceneManager();
+
+    printf("Startup %.1f ms (%s)\n", elapsedMs(start), renderSystem ? renderSystem->getName().c_str() : "software");
+
+    int failures = 0;
+    {
+        SpacescapePlugin plugin;
+        StageTimer stageTimer;
+        stageTimer.setVerbose(verbose);
+        plugin.addProgressListener(&stageTimer);
+        plugin.setHDREnabled(hdr);
+        plugin.setSoftwareRenderingEnabled(software);
+        plugin.setDefaultCPUNoise(cpuNoise);
+        plugin.setExportStripHeight(stripHeight);
+        plugin.setExportMipmapsEnabled(mipmaps);
+        plugin.setExportCompression(compression, quality);
+        plugin.setNoiseCacheDirectory(noiseCacheDir);
+
+        for(size_t i = 0; i < scenes.size(); ++i) {
+            String baseName, extension, path;
+            StringUtil::splitFullFilename(scenes[i], baseName, extension, path);
+
+            String output = outputDir + "/" + baseName + (cube ? ".dds" : "." + format);
+
+            printf("%s\n", scenes[i].c_str());
+
+            try {
+                plugin.clear();
+
+                Clock::time_point loadStart = Clock::now();
+                if(!plugin.loadConfigFile(scenes[i])) {
+                    stageTimer.finish();
+                    fprintf(stderr, "  failed to load %s\n", scenes[i].c_str());
+                    ++failures;
+                    continue;
+                }
+
+                stageTimer.finish();
+                double loadMs = elapsedMs(loadStart);
+
+                Clock::time_point exportStart = Clock::now();
+                plugin.writeToFile(output, size, cube ? TEX_TYPE_CUBE_MAP : TEX_TYPE_2D, orientation);
+                stageTimer.finish();
+                double exportMs = elapsedMs(exportStart);
+
+                printf("  load %10.1f ms\n  export %8.1f ms -> %s\n", loadMs, exportMs, output.c_str());
+            }
+            catch(Exception& e) {
+                stageTimer.finish();
+                fprintf(stderr, "  failed: %s\n", e.getFullDescription().c_str());
+                ++failures;
+            }
+        }
+
+        plugin.clear();
+        plugin.removeProgressListener(&stageTimer);
+    }
+
+    OGRE_DELETE root;
+    OGRE_DELETE logManager;
+
+    printf("Exported %u of %u scenes in %.1f ms\n", 
+        (unsigned int)(scenes.size() - failures), (unsigned int)scenes.size(), elapsedMs(start));
+
+    return failures ? 1 : 0;
+}
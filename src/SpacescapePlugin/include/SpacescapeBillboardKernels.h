@@ -0,0 +1,94 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef __SPACESCAPEBILLBOARDKERNELS_H__
+#define __SPACESCAPEBILLBOARDKERNELS_H__
+
+#include "SpacescapePrerequisites.h"
+#include "OgreVector3.h"
+
+namespace Ogre
+{
+    /** The SpacescapeBillboardKernels class builds the corners of camera
+    facing billboard quads for whole arrays of billboards at once.  
+    Billboards are passed as separate position and size arrays and 
+    processed 4 (SSE4.1) or 8 (AVX2, also used on AVX-512 CPUs) at a time 
+    with the instruction set SpacescapeNoiseKernels picked for the CPU.
+    @remarks The vector versions perform exactly the same float operations
+    in the same order as the scalar version (no fused multiply-add), which
+    matches SpacescapeBillboardSet's per billboard path for accurate facing
+    point billboards, so quads are bit identical on every instruction set.
+    */
+    class _SpacescapePluginExport SpacescapeBillboardKernels
+    {
+    public:
+        // Settings shared by every billboard in a batch
+        struct FacingParams
+        {
+            // camera position in billboard space
+            Vector3 camPos;
+
+            // camera up vector in billboard space
+            Vector3 camUp;
+
+            // if true the up vector is replaced with +Z for billboards
+            // that line up with it (used by static geometry)
+            bool fixedUp;
+
+            // parametric offsets of the billboard origin
+            Real left;
+            Real right;
+            Real top;
+            Real bottom;
+        };
+
+        /** Build accurate facing quads for an array of point billboards
+        @param params The camera and origin settings
+        @param x Array of billboard x positions
+        @param y Array of billboard y positions
+        @param z Array of billboard z positions
+        @param width Array of billboard widths
+        @param height Array of billboard heights
+        @param corners Array of 12 * count floats the corner positions are
+        written to, corner c axis a of billboard i is at (c * 3 + a) * count + i
+        with corners in left-top, right-top, left-bottom, right-bottom order
+        @param count Number of billboards
+        */
+        static void genFacingQuads(const FacingParams& params, const float* x, const float* y, const float* z,
+            const float* width, const float* height, float* corners, size_t count);
+
+        /** Scalar reference version of genFacingQuads
+        @see genFacingQuads
+        */
+        static void genFacingQuadsScalar(const FacingParams& params, const float* x, const float* y, const float* z,
+            const float* width, const float* height, float* corners, size_t count);
+    };
+}
+
+#endif
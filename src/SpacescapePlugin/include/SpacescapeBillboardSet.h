@@ -121,34 +121,46 @@ namespace Ogre {
         bool mAllDefaultRotation;
         bool mWorldSpace;
         
-        typedef list<SpacescapeBillboard*>::type SpacescapeActiveBillboardList;
-        typedef list<SpacescapeBillboard*>::type SpacescapeFreeBillboardList;
-        typedef vector<SpacescapeBillboard*>::type SpacescapeBillboardPool;
+        typedef vector<uint32>::type SpacescapeBillboardIndexList;
         
-        /** Active billboard list.
+        /* Active billboards, stored as parallel arrays with one entry per billboard.
          @remarks
-         This is a linked list of pointers to billboards in the billboard pool.
-         @par
-         This allows very fast insertions and deletions from anywhere in the list to activate / deactivate billboards
-         (required for particle systems etc.) as well as reuse of Billboard instances in the pool
-         without construction & destruction which avoids memory thrashing.
-         */
-        SpacescapeActiveBillboardList mActiveBillboards;
-        
-        /** Free billboard queue.
-         @remarks
-         This contains a list of the billboards free for use as new instances
-         as required by the set. Billboard instances are preconstructed up to the estimated size in the
-         mBillboardPool vector and are referenced on this deque at startup. As they get used this deque
-         reduces, as they get released back to to the set they get added back to the deque.
+         Building the vertices walks each array front to back instead of chasing
+         list nodes, and billboards are created and removed without touching the
+         heap once the pool is reserved. Removing a billboard moves the last one
+         into its slot, so an index only stays valid until the next removal.
          */
-        SpacescapeFreeBillboardList mFreeBillboards;
-        
-        /** Pool of billboard instances for use and reuse in the active billboard list.
+        /// Billboard positions
+        vector<Vector3>::type mPositions;
+        /// Billboard directions, only used by BBT_ORIENTED_SELF and BBT_PERPENDICULAR_SELF
+        vector<Vector3>::type mDirections;
+        /// Billboard widths, only used where mOwnDimensions is set
+        vector<Real>::type mWidths;
+        /// Billboard heights, only used where mOwnDimensions is set
+        vector<Real>::type mHeights;
+        /// Non zero where a billboard has its own dimensions
+        vector<uchar>::type mOwnDimensions;
+        /// Billboard vertex colours
+        vector<ColourValue>::type mColours;
+        /// Billboard HDR colours
+        vector<ColourValue>::type mHDRColours;
+        /// Billboard rotations
+        vector<Radian>::type mRotations;
+        /// Index into mTextureCoords, unless mUseTexcoordRects is set
+        vector<uint16>::type mTexcoordIndices;
+        /// Billboard texture coordinate rects, only used where mUseTexcoordRects is set
+        vector<FloatRect>::type mTexcoordRects;
+        /// Non zero where a billboard has its own texture coordinate rect
+        vector<uchar>::type mUseTexcoordRects;
+        
+        /** Order to draw the active billboards in when sorting is enabled.
          @remarks
-         This vector will be preallocated with the estimated size of the set,and will extend as required.
+         Kept between frames, the order barely changes as the camera moves so
+         it is usually fixed up in place instead of sorted from scratch.
          */
-        SpacescapeBillboardPool mBillboardPool;
+        SpacescapeBillboardIndexList mSortedBillboards;
+        /// Sort keys of mSortedBillboards, reused between frames
+        vector<float>::type mSortKeys;
         
         /// The vertex position data for all billboards in this set.
         VertexData* mVertexData;
@@ -191,10 +203,10 @@ namespace Ogre {
         Vector3 mCommonUpVector;
         
         /// Internal method for culling individual billboards
-        inline bool billboardVisible(Camera* cam, const SpacescapeBillboard& bill);
+        inline bool billboardVisible(Camera* cam, const Vector3& position, Real radius);
         
         /// Number of visible billboards (will be == getNumBillboards if mCullIndividual == false)
-        unsigned short mNumVisibleBillboards;
+        size_t mNumVisibleBillboards;
         
         /// Internal method for increasing pool size
         virtual void increasePool(size_t size);
@@ -208,9 +220,12 @@ namespace Ogre {
         //-----------------------------------------------------------------------
         /** Internal method for generating billboard corners.
          @remarks
-         Optional parameter pBill is only present for type BBT_ORIENTED_SELF and BBT_PERPENDICULAR_SELF
+         Optional parameters position and direction are only needed for accurate facing
+         and types BBT_ORIENTED_SELF and BBT_PERPENDICULAR_SELF
          */
-        void genBillboardAxes(Vector3* pX, Vector3 *pY, const SpacescapeBillboard* pBill = 0);
+        void genBillboardAxes(Vector3* pX, Vector3 *pY,
+                              const Vector3& position = Vector3::ZERO,
+                              const Vector3& direction = Vector3::ZERO);
         
         /** Internal method, generates parametric offsets based on origin.
          */
@@ -218,9 +233,65 @@ namespace Ogre {
         
         /** Internal method for generating vertex data.
          @param offsets Array of 4 Vector3 offsets
-         @param pBillboard Reference to billboard
+         @param position Billboard position
+         @param colour Billboard vertex colour
+         @param hdrColour Billboard HDR colour
+         @param rotation Billboard rotation
+         @param texcoords Billboard texture coordinate rect
+         */
+        void genVertices(const Vector3* const offsets, const Vector3& position,
+                         const ColourValue& colour, const ColourValue& hdrColour,
+                         const Radian& rotation, const FloatRect& texcoords);
+        
+        /** Internal method for generating the vertices of one billboard.
+         @remarks
+         Shared by injectBillboard and the internal billboard arrays.
          */
-        void genVertices(const Vector3* const offsets, const SpacescapeBillboard& pBillboard);
+        void injectBillboard(const Vector3& position, const Vector3& direction,
+                             bool ownDimensions, Real width, Real height,
+                             const ColourValue& colour, const ColourValue& hdrColour,
+                             const Radian& rotation, const FloatRect& texcoords);
+        
+        /** Internal method for generating the vertices of an active billboard.
+         @param index Index of the billboard in the billboard arrays
+         */
+        inline void injectActiveBillboard(size_t index);
+        
+        /** Internal method for generating the vertices of all the active billboards
+         in batches across the thread pool.
+         @remarks
+         Only used for accurate facing BBT_POINT billboards without rotation or
+         individual culling, see canInjectFacingBillboards.
+         @param order Order to draw the billboards in, or null for the array order
+         @param rangeStart Index of the first billboard when drawn in array order
+         @param numBillboards Number of billboards
+         */
+        void injectFacingBillboards(const uint32* order, size_t rangeStart, size_t numBillboards);
+        
+        /** Internal method, returns true if injectFacingBillboards can generate
+         the vertices for the current settings.
+         */
+        bool canInjectFacingBillboards(void) const;
+        
+        /** Internal method for writing the per instance data of all the active
+         billboards in batches across the thread pool.
+         @param order Order to draw the billboards in, or null for the array order
+         @param rangeStart Index of the first billboard when drawn in array order
+         @param numBillboards Number of billboards
+         */
+        void injectInstances(const uint32* order, size_t rangeStart, size_t numBillboards);
+        
+        /** Internal method, gets the billboards that are drawn clamped to
+         the billboards in the set.
+         @param first Set to the index of the first billboard to draw
+         @param count Set to the number of billboards to draw
+         */
+        void _getBillboardRange(size_t& first, size_t& count) const;
+        
+        /** Internal method, returns true if the billboards can be drawn as
+         instances of one quad for the current settings.
+         */
+        bool canInstance(void) const;
         
         /** Internal method generates vertex offsets.
          @remarks
@@ -240,8 +311,11 @@ namespace Ogre {
             /// Direction to sort in
             Vector3 sortDir;
             
-            SortByDirectionFunctor(const Vector3& dir);
-            float operator()(SpacescapeBillboard* bill) const;
+            /// Billboard positions
+            const Vector3* positions;
+            
+            SortByDirectionFunctor(const Vector3& dir, const Vector3* pos);
+            float operator()(uint32 index) const;
         };
         
         /** Sort by distance functor */
@@ -250,11 +324,14 @@ namespace Ogre {
             /// Position to sort in
             Vector3 sortPos;
             
-            SortByDistanceFunctor(const Vector3& pos);
-            float operator()(SpacescapeBillboard* bill) const;
+            /// Billboard positions
+            const Vector3* positions;
+            
+            SortByDistanceFunctor(const Vector3& pos, const Vector3* positions);
+            float operator()(uint32 index) const;
         };
         
-        static RadixSort<SpacescapeActiveBillboardList, SpacescapeBillboard*, float> mRadixSorter;
+        static RadixSort<SpacescapeBillboardIndexList, uint32, float> mRadixSorter;
         
         /// Use point rendering?
         bool mPointRendering;
@@ -272,6 +349,16 @@ namespace Ogre {
         bool mAutoUpdate;
         /// True if the billboard data changed. Will cause vertex buffer update.
         bool mBillboardDataChanged;
+        /// Are the quads built once, facing the origin, instead of per camera?
+        bool mStaticGeometry;
+        /// Draw the billboards as instances of one quad when possible?
+        bool mInstancingEnabled;
+        /// Were the current buffers created for instancing?
+        bool mInstanced;
+        /// Index of the first billboard to draw
+        size_t mRangeStart;
+        /// Number of billboards to draw
+        size_t mRangeCount;
         
         /** Internal method creates vertex and index buffers.
          */
@@ -315,15 +402,14 @@ namespace Ogre {
          @param colour
          Optional base colour of the billboard.
          @return
-         On success, a pointer to a newly created Billboard is
-         returned.
+         On success, the index of the new billboard is returned.
          @par
          On failure (i.e. no more space and can't autoextend),
-         @c NULL is returned.
+         INVALID_BILLBOARD is returned.
          @see
          BillboardSet::setAutoextend
          */
-        SpacescapeBillboard* createBillboard(
+        size_t createBillboard(
                                    const Vector3& position,
                                    const ColourValue& colour = ColourValue::White );
         
@@ -340,15 +426,14 @@ namespace Ogre {
          @param colour
          Optional base colour of the billboard.
          @return
-         On success, a pointer to a newly created Billboard is
-         returned.
+         On success, the index of the new billboard is returned.
          @par
          On failure (i.e. no more space and can't autoextend),
-         @c NULL is returned.
+         INVALID_BILLBOARD is returned.
          @see
          BillboardSet::setAutoextend
          */
-        SpacescapeBillboard* createBillboard(
+        size_t createBillboard(
                                    Real x, Real y, Real z,
                                    const ColourValue& colour = ColourValue::White );
         
@@ -415,30 +500,59 @@ namespace Ogre {
          */
         virtual void clear();
         
-        /** Returns a pointer to the billboard at the supplied index.
-         @note
-         This method requires linear time since the billboard list is a linked list.
+        /** Returns a copy of the billboard at the supplied index.
+         @remarks
+         Billboards are stored as arrays of their attributes, so changes to the
+         copy only take effect once passed back to setBillboard.
          @param index
          The index of the billboard that is requested.
-         @return
-         On success, a valid pointer to the requested billboard is
-         returned.
-         @par
-         On failure, @c NULL is returned.
          */
-        virtual SpacescapeBillboard* getBillboard(unsigned int index) const;
+        virtual SpacescapeBillboard getBillboard(size_t index) const;
         
-        /** Removes the billboard at the supplied index.
-         @note
-         This method requires linear time since the billboard list is a linked list.
+        /** Replaces every attribute of the billboard at the supplied index.
+         @param index
+         The index of the billboard to change.
+         @param billboard
+         The new billboard attributes.
+         */
+        virtual void setBillboard(size_t index, const SpacescapeBillboard& billboard);
+        
+        /** Sets the colour of the billboard at the supplied index.
+         @see
+         SpacescapeBillboard::setColour
+         */
+        void setBillboardColour(size_t index, const ColourValue& colour);
+        
+        /** Sets the width and height of the billboard at the supplied index.
+         @see
+         SpacescapeBillboard::setDimensions
+         */
+        void setBillboardDimensions(size_t index, Real width, Real height);
+        
+        /** Sets the HDR colour of the billboard at the supplied index. */
+        void setBillboardHDRColour(size_t index, const ColourValue& colour);
+        
+        /** Sets the position of the billboard at the supplied index.
+         @see
+         SpacescapeBillboard::setPosition
          */
-        virtual void removeBillboard(unsigned int index);
+        void setBillboardPosition(size_t index, const Vector3& position);
         
-        /** Removes a billboard from the set.
+        /** Removes the billboard at the supplied index.
          @note
-         This version is more efficient than removing by index.
+         The last billboard in the set takes the index of the removed one.
          */
-        virtual void removeBillboard(SpacescapeBillboard* pBill);
+        virtual void removeBillboard(size_t index);
+        
+        /// Index returned by createBillboard when no billboard could be created
+        static const size_t INVALID_BILLBOARD = ~static_cast<size_t>(0);
+        
+        /// Custom parameter holding the camera position in billboard space
+        /// when instancing, use with GpuProgramParameters::ACT_CUSTOM
+        static const size_t CUSTOM_CAMERA_POSITION = 0;
+        /// Custom parameter holding the camera up vector in billboard space
+        /// when instancing, w is 1 when the up vector is fixed
+        static const size_t CUSTOM_CAMERA_UP = 1;
         
         /** Sets the point which acts as the origin point for all billboards in this set.
          @remarks
@@ -681,7 +795,7 @@ namespace Ogre {
          more expensive, but more accurate version.
          @param acc True to use the slower but more accurate model. Default is false.
          */
-        virtual void setUseAccurateFacing(bool acc) { mAccurateFacing = acc; }
+        virtual void setUseAccurateFacing(bool acc) { mAccurateFacing = acc; mBillboardDataChanged = true; }
         /** Gets whether or not billboards use an 'accurate' facing model
          based on the vector from each billboard to the camera, rather than
          an optimised version using just the camera direction.
@@ -709,6 +823,12 @@ namespace Ogre {
         /** Gets the sort mode of this billboard set */
         virtual SortMode _getSortMode(void) const;
         
+        /** Returns true if the material blends billboards in a way that
+         doesn't depend on the order they are drawn in (e.g. additive
+         blending without depth writes), so sorting can be skipped.
+         */
+        virtual bool isBlendingOrderIndependent(void) const;
+        
         /** Sets whether billboards should be treated as being in world space.
          @remarks
          This is most useful when you are driving the billboard set from
@@ -829,6 +949,78 @@ namespace Ogre {
          */
         void notifyBillboardDataChanged(void) { mBillboardDataChanged = true; }
         
+        /** Set whether the billboard quads are built once instead of for 
+         every camera.
+         @remarks
+         Static geometry suits billboards that never move relative to a camera
+         sitting at the origin of the billboard set, like stars on a sky sphere.
+         The quads face the origin with an up vector that doesn't depend on the
+         camera, so they are generated and uploaded to a static vertex buffer 
+         once and the camera can turn freely without any per frame work.  
+         Billboards aren't sorted or culled individually in this mode, and 
+         changes to them need notifyBillboardDataChanged like when auto update
+         is off. The set wide settings (default dimensions, origin, type, 
+         texture coordinates...) rebuild the quads by themselves. Requires 
+         accurate facing and BBT_POINT billboards.
+         */
+        void setStaticGeometry(bool staticGeometry);
+        
+        /** Return whether the billboard quads are built once instead of for
+         every camera. */
+        bool isStaticGeometry(void) const { return mStaticGeometry; }
+        
+        /** Set whether the billboards are drawn as instances of a single quad.
+         @remarks
+         Instead of generating four vertices per billboard on the CPU, one
+         static quad is drawn once per billboard with a per instance buffer of
+         position, size, colours and texture coordinates. The material must 
+         use a vertex program that builds the camera facing corners, reading:
+         @par
+         - vertex: billboard position (per instance)
+         - normal: HDR colour (per instance)
+         - colour: colour (per instance)
+         - uv0: parametric corner offset in xy, texture coordinate selector in zw
+         - uv1: billboard width and height (per instance)
+         - uv2: texture coordinate rect left, top, right, bottom (per instance)
+         @par
+         along with the CUSTOM_CAMERA_POSITION and CUSTOM_CAMERA_UP custom
+         parameters. The per instance buffer is only written when the 
+         billboards or the set wide settings (default dimensions, texture 
+         coordinates...) change, or every frame when sorted.
+         @par
+         Only accurate facing BBT_POINT billboards without rotation or 
+         individual culling are instanced, and only when the render system
+         supports instance data (see isInstancingSupported), otherwise the 
+         quads are generated on the CPU as usual.
+         */
+        void setInstancingEnabled(bool enabled);
+        
+        /** Return whether the billboards are drawn as instances of a single
+         quad when possible. */
+        bool isInstancingEnabled(void) const { return mInstancingEnabled; }
+        
+        /** Return true if the current render system can draw billboards as
+         instances of a single quad. */
+        static bool isInstancingSupported(void);
+        
+        /** Set the range of billboards that are drawn.
+         @remarks
+         Billboards outside the range are kept but not drawn, so one set can
+         hold several versions of its billboards (i.e. full detail and 
+         preview versions) and switch between them without recreating them.
+         All the billboards are drawn by default.
+         @param first Index of the first billboard to draw
+         @param count Number of billboards to draw, the range is clamped to
+         the end of the set
+         */
+        void setBillboardRange(size_t first, size_t count);
+        
+        /** Return the index of the first billboard that is drawn. */
+        size_t getBillboardRangeStart(void) const { return mRangeStart; }
+        
+        /** Return the number of billboards that are drawn. */
+        size_t getBillboardRangeCount(void) const { return mRangeCount; }
+        
     };
     
     /** Factory object for creating BillboardSet instances */
@@ -0,0 +1,133 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef __SPACESCAPEBLOCKCOMPRESSOR_H__
+#define __SPACESCAPEBLOCKCOMPRESSOR_H__
+
+#include "SpacescapePrerequisites.h"
+#include "OgrePixelFormat.h"
+
+namespace Ogre
+{
+    /** The SpacescapeBlockCompressor class compresses images to the GPU
+    block formats for .dds exports using the shared thread pool.
+    @remarks Supported formats are PF_DXT1 (BC1), PF_DXT5 (BC3), 
+    PF_BC7_UNORM for low dynamic range images and PF_BC6H_UF16 for high
+    dynamic range images.  Every block fits a line through its colours and
+    the higher quality settings refine the line end points to fit the 
+    quantized palette better.  BC7 blocks are written in mode 6 (one 
+    RGBA line with 4 bit indices) and BC6H blocks in mode 11 (one line 
+    with 10 bit end points) which suit the smooth gradients of space 
+    backgrounds.
+    */
+    class _SpacescapePluginExport SpacescapeBlockCompressor
+    {
+    public:
+        // compression quality
+        enum Quality
+        {
+            BCQ_FAST = 0,
+            BCQ_NORMAL,
+            BCQ_HIGH
+        };
+
+        /** Constructor
+        @param format The compressed pixel format to write
+        @param quality The compression quality
+        */
+        SpacescapeBlockCompressor(PixelFormat format, Quality quality = BCQ_NORMAL);
+
+        /** Compress an image
+        @param src The image to compress, in any pixel format.  Images 
+        that aren't a multiple of 4 pixels wide or high are padded by 
+        repeating the last column or row.
+        @param dest Memory for getCompressedSize() bytes, blocks are 
+        written left to right, top to bottom
+        */
+        void compress(const PixelBox& src, uchar* dest) const;
+
+        /** Get the number of bytes in a compressed 4x4 block
+        @param format The compressed pixel format
+        @return the block size or 0 if the format isn't supported
+        */
+        static size_t getBlockSize(PixelFormat format);
+
+        /** Get the number of bytes an image compresses to
+        @param format The compressed pixel format
+        @param width The image width
+        @param height The image height
+        @return the compressed size
+        */
+        static size_t getCompressedSize(PixelFormat format, unsigned int width, unsigned int height);
+
+        /** Get the compressed pixel format
+        @return the pixel format
+        */
+        PixelFormat getFormat(void) const { return mFormat; }
+
+        /** Check whether a pixel format can be compressed to
+        @param format The compressed pixel format
+        @return true if supported
+        */
+        static bool isSupported(PixelFormat format) { return getBlockSize(format) != 0; }
+
+    private:
+        /** Utility function to compress a BC1 colour block
+        @param pixels The 16 RGBA block pixels in the 0 - 255 range
+        @param dest Return param - the 8 byte block
+        */
+        void compressBC1(const float* pixels, uchar* dest) const;
+
+        /** Utility function to compress a BC6H block
+        @param pixels The 16 RGBA block pixels as unquantized half floats
+        @param dest Return param - the 16 byte block
+        */
+        void compressBC6H(const float* pixels, uchar* dest) const;
+
+        /** Utility function to compress a BC7 block
+        @param pixels The 16 RGBA block pixels in the 0 - 255 range
+        @param dest Return param - the 16 byte block
+        */
+        void compressBC7(const float* pixels, uchar* dest) const;
+
+        /** Utility function to get the number of end point refinement
+        passes for the quality setting
+        @return the number of passes
+        */
+        int getNumRefinements(void) const;
+
+        // compressed pixel format
+        PixelFormat mFormat;
+
+        // compression quality
+        Quality mQuality;
+    };
+}
+
+#endif
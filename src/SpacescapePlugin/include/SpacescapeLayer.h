@@ -35,10 +35,16 @@ THE SOFTWARE.
 #include "OgreMovableObject.h"
 #include "OgreCommon.h"
 #include "SpacescapePlugin.h"
+#include "SpacescapeNoiseKernels.h"
 #include "SpacescapeNoiseMaterial.h"
 
 namespace Ogre
 {
+    // forward declarations
+    class SpacescapeMaskSampler;
+    class SpacescapeSoftwareRenderer;
+    struct SpacescapeNoiseParams;
+
     /** The SpacescapeLayer class defines a layer of a space background.
     Subclasses of this layer will draw different types of layers, whether
     they are point stars or 3d objects or billboards, etc.
@@ -54,6 +60,11 @@ namespace Ogre
         */
         ~SpacescapeLayer(void);
 
+        /** Add the draw calls for this layer to a software renderer
+        @param renderer The renderer to add to
+        */
+        virtual void addToSoftwareRenderer(SpacescapeSoftwareRenderer& renderer) = 0;
+
         /** Get the display high resolution flag value
         @return the high resolution flag value
         */
@@ -79,6 +90,26 @@ namespace Ogre
         */
         virtual void init(NameValuePairList params) = 0;
 
+        /** Load what generating the CPU side data of this layer (i.e. the 
+        point or billboard lists) needs for the given params ahead of 
+        calling prepareData() and then init() with the same params
+        @remarks Must be called on the render thread like init() - star 
+        catalogs are loaded and noise masks rendered or read from the noise
+        cache here.  Nothing else is created in the render system, init() 
+        does that and uses the prepared data instead of generating it again.
+        @param params Layer params that will be specific to the derived class
+        */
+        void prepare(const NameValuePairList& params);
+
+        /** Generate the CPU side data of this layer from what prepare() 
+        loaded
+        @remarks Only this layer is touched and nothing is logged, loaded or
+        rendered so any number of layers can run this on worker threads at 
+        once.  Does nothing if prepare() had nothing to leave to it.  If 
+        generating fails init() simply generates the data again.
+        */
+        void prepareData(void);
+
         /** Set whether to display the high resolution implementation
         or the faster preview version
         @param displayHighRes Whether to display the high resolution or not
@@ -107,6 +138,15 @@ namespace Ogre
         virtual MovableObject* getMovableObject() { return this; }
 
     protected:
+        /** Generate the CPU side data of this layer from what init() 
+        loaded, see prepareData()
+        */
+        virtual void buildData(void) {}
+
+        // largest width/height of each face of the density masks layers
+        // use to place stars
+        static const unsigned int MAX_MASK_SIZE = 4096;
+
         /** Utility function to add a sphere section with the given material name
         and num segments
         @remarks Thank you http://www.ogre3d.org/wiki/index.php/ManualSphereMeshes
@@ -125,6 +165,21 @@ namespace Ogre
         Real fbmNoise(Vector3 v, unsigned int octaves = 1, Real gain = 0.5, 
             Real lacunarity = 2.0);
 
+        /** Utility noise function for fbm perlin noise at an array of points
+        @remarks Each octave goes through the batch noise kernels for all
+        the points at once
+        @param x Array of x coordinates
+        @param y Array of y coordinates
+        @param z Array of z coordinates
+        @param out Array the noise values are written to
+        @param count Number of points
+        @param octaves Number of octaves
+        @param gain Noise gain at each level - same as persistance
+        @param lacunarity Applied at each level
+        */
+        void fbmNoise(const float* x, const float* y, const float* z, float* out, size_t count,
+            unsigned int octaves = 1, Real gain = 0.5, Real lacunarity = 2.0);
+
         /** Utility function to convert a blend mode string to int
         @param param blend mode string like "one" or "dest_colour"
         */
@@ -176,7 +231,94 @@ namespace Ogre
                                   ColourValue outerColor, unsigned int octaves, Real lacunarity,
                                   Real gain, Real power, Real threshold, Real dither, Real scale, Real offset,
                                   Real hdrPower = 1.0, Real hdrMultiplier = 1.0);
+
+        /** Render noise to six cube faces in memory on the CPU
+        @remarks The faces line up with the ones renderNoiseToTexture renders
+        @param faces Array of six pixel boxes to write to, in any pixel format
+        @param size The width/height of each face
+        @param seed The seed for the random noise
+        @param noiseType The noise type - either "fbm" or "ridged"
+        @param innerColor Noise inner color
+        @param outerColor Noise outer color
+        @param octaves Number of octaves
+        @param lacunarity Lacunarity
+        @param gain Applied to each octave
+        @param power Power function to apply to final noise
+        @param threshold Lower shelf/threshold
+        @param dither Amount to dither the noise
+        @param scale Initial scale amount applied to unit sphere noise coords
+        @param offset Used for ridged noise
+        @param hdrPower HDR power function applied after the regular power function
+        @param hdrMultiplier HDR multiplier applied to the final colour
+        */
+        void renderNoiseToMemory( const PixelBox* faces, unsigned int size, unsigned int seed,
+                                  const String& noiseType, ColourValue innerColor,
+                                  ColourValue outerColor, unsigned int octaves, Real lacunarity,
+                                  Real gain, Real power, Real threshold, Real dither, Real scale, Real offset,
+                                  Real hdrPower = 1.0, Real hdrMultiplier = 1.0);
+
+        /** Render noise to 3d texture on the CPU
+        @remarks Produces the same noise as renderNoiseToTexture but doesn't
+        need a render system - faces are split into tiles and rendered on the 
+        shared thread pool
+        @param texture the texture to render to
+        @param seed The seed for the random noise
+        @param noiseType The noise type - either "fbm" or "ridged"
+        @param innerColor Noise inner color
+        @param outerColor Noise outer color
+        @param octaves Number of octaves
+        @param lacunarity Lacunarity
+        @param gain Applied to each octave
+        @param power Power function to apply to final noise
+        @param threshold Lower shelf/threshold
+        @param dither Amount to dither the noise
+        @param scale Initial scale amount applied to unit sphere noise coords
+        @param offset Used for ridged noise
+        @param hdrPower HDR power function applied after the regular power function
+        @param hdrMultiplier HDR multiplier applied to the final colour
+        */
+        void renderNoiseToTextureCPU( TexturePtr& texture, unsigned int seed,
+                                  const String& noiseType, ColourValue innerColor,
+                                  ColourValue outerColor, unsigned int octaves, Real lacunarity,
+                                  Real gain, Real power, Real threshold, Real dither, Real scale, Real offset,
+                                  Real hdrPower = 1.0, Real hdrMultiplier = 1.0);
         
+        /** Upload a noise cube from the plugin's noise cache to a texture
+        @param texture The cubic texture to upload to
+        @param source What renders the cube on a miss, i.e. "gpu" or "cpu"
+        @param seed The seed for the random noise
+        @param params The noise settings
+        @param key Set to the cube key if the cache is enabled so a miss
+        can be added once rendered, left empty if it isn't
+        @return true if the cube was cached and uploaded, false if not
+        */
+        bool uploadCachedNoise(TexturePtr& texture, const String& source, unsigned int seed,
+                               const SpacescapeNoiseParams& params, String& key);
+
+        /** Render a density mask and build a sampler over it
+        @remarks Nothing is rendered if the sampler was built with the same
+        settings already.  The CPU noise generator writes the mask straight
+        into the sampler, the render system path reads it back from a 
+        render target
+        @param sampler The sampler to build
+        @param size The width/height of each mask face
+        @param cpu Generate the mask on the CPU, always the case when 
+        software rendering
+        @param seed The seed for the random noise
+        @param noiseType The noise type - either "fbm" or "ridged"
+        @param octaves Number of octaves
+        @param lacunarity Lacunarity
+        @param gain Applied to each octave
+        @param power Power function to apply to final noise
+        @param threshold Lower shelf/threshold
+        @param scale Initial scale amount applied to unit sphere noise coords
+        @param offset Used for ridged noise
+        */
+        void updateMaskSampler(SpacescapeMaskSampler& sampler, unsigned int size,
+                               bool cpu, unsigned int seed, const String& noiseType, unsigned int octaves,
+                               Real lacunarity, Real gain, Real power, Real threshold, 
+                               Real scale, Real offset);
+
         /** Ridge function for Ridged FBM noise
         @param noiseVal
         @param offset
@@ -195,6 +337,22 @@ namespace Ogre
         Real ridgedFbmNoise(Vector3 v, unsigned int octaves = 1,
             Real gain = 0.5, Real lacunarity = 2.0, Real offset = 1.0);
 
+        /** Utility noise function for ridged fbm perlin noise at an array of points
+        @remarks Each octave goes through the batch noise kernels for all
+        the points at once
+        @param x Array of x coordinates
+        @param y Array of y coordinates
+        @param z Array of z coordinates
+        @param out Array the noise values are written to
+        @param count Number of points
+        @param octaves Number of octaves
+        @param gain Noise gain at each level - same as persistance
+        @param lacunarity Applied at each level
+        @param offset
+        */
+        void ridgedFbmNoise(const float* x, const float* y, const float* z, float* out, size_t count,
+            unsigned int octaves = 1, Real gain = 0.5, Real lacunarity = 2.0, Real offset = 1.0);
+
         /** Rotate a point on a cube so that it is in the right position
         for a particular cube face.  The initial point should be on the top face
         @param p The 3d point on a cube
@@ -315,12 +473,26 @@ namespace Ogre
         // noise manual object
         ManualObject* mRTTManualObject;
 
+        // noise kernel lookup tables matching grad, built by initNoise
+        SpacescapeNoiseKernels::Tables mNoiseTables;
+
         // parameters
         NameValuePairList mParams;
 
         // perlin noise permutations
         unsigned char mPermutations[512];
 
+        // set once prepare() loaded what prepareData() still has to 
+        // generate the CPU side data from
+        bool mPreparePending;
+
+        // set once prepareData() generated data that init() still has to use
+        bool mPrepared;
+
+        // set while init() is called by prepare() - star catalogs and noise
+        // masks are loaded but nothing else is built
+        bool mPreparing;
+
 		// the pixel format to use for FBO
 		PixelFormat mFBOPixelFormat;
 		PixelFormat mMaskFBOPixelFormat;
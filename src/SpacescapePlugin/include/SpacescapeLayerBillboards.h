@@ -32,8 +32,11 @@ THE SOFTWARE.
 
 #include "SpacescapePrerequisites.h"
 #include "SpacescapeLayer.h"
+#include "SpacescapeMaskSampler.h"
 #include "OgreBillboardSet.h"
 #include "SpacescapeBillboardSet.h"
+#include "SpacescapeSoftwareRenderer.h"
+#include "SpacescapeStarCatalog.h"
 
 namespace Ogre
 {
@@ -52,6 +55,11 @@ namespace Ogre
         */
         ~SpacescapeLayerBillboards(void);
 
+        /** Add the draw calls for this layer to a software renderer
+        @param renderer The renderer to add to
+        */
+        void addToSoftwareRenderer(SpacescapeSoftwareRenderer& renderer);
+
        /** Get the layer type
         @return the layer type
         */
@@ -63,17 +71,24 @@ namespace Ogre
         int getLayerType(void) { return SpacescapePlugin::SLT_BILLBOARDS; }
 
        /** Return our billboard set
-        @return this object instance
+        @return the billboard set, or this object instance in software mode
         */
-        MovableObject* getMovableObject() { return mBillboardSet; }
+        MovableObject* getMovableObject() { return mBillboardSet ? (MovableObject*)mBillboardSet : this; }
 
         /** Initialize this layer based on the given params
         @remarks Params for this layer type are:
         NAME -  VALUE TYPE
+        dataFile - string (i.e. "stars.ssc") CSV or binary star catalog to place the billboards from
         destBlendFactor - string (i.e. one, dest_colour  etc.)
+        magnitudeLimit - Real (i.e. 6.5) faintest apparent magnitude of data file stars
+        maskCPUNoise - bool (string i.e. "true") generate the noise mask on the CPU instead of the GPU
+        maskSize - unsigned int (string i.e. "1024") width/height of each noise mask face, up to 4096
         minSize - Real (i.e. 1.0)
         maxSize - Real (i.e. 2.0)
         numBillboards - int (i.e. 200 etc.)
+        regionDec - Real (i.e. -30.0) declination of the data file sky region centre in degrees
+        regionRA - Real (i.e. 90.0) right ascension of the data file sky region centre in degrees
+        regionRadius - Real (i.e. 20.0) radius of the data file sky region in degrees, 180 for the whole sky
         seed - int (i.e. 2,3 etc.)
         sourceBlendFactor - string (i.e. one, dest_colour  etc.)
         texture - string (i.e. "my-flare.png")
@@ -81,34 +96,90 @@ namespace Ogre
         */
         void init(Ogre::NameValuePairList params);
 
+        /** Set whether to display the full detail billboards or the faster
+        preview version
+        @remarks Layers with more billboards than the preview budget draw 
+        their brightest billboards and impostors for the rest in the 
+        preview, see SpacescapePreviewLOD
+        @param displayHighRes Whether to display the full detail or not
+        */
+        void setDisplayHighRes(bool displayHighRes);
+
     protected:
+        /** Generate the sprite list from the loaded star catalog or noise 
+        mask, see prepareData()
+        */
+        void buildData(void);
+
         /** Utility function for updating saved params list
         @param params The list of params
         */
         void updateParams(NameValuePairList params);
 
     private:
+        /** Utility function to add a billboard to the sprite list
+        @remarks When software rendering the list holds the billboards the 
+        way the software renderer draws them, otherwise it holds the 
+        billboards waiting for createBillboards() to add them to the 
+        billboard set
+        @param position The billboard position
+        @param size The billboard width and height
+        @param colour The billboard colour
+        @param hdrColour The billboard colour used in HDR mode
+        */
+        void addBillboard(const Vector3& position, Real size, const ColourValue& colour, const ColourValue& hdrColour);
         
+        /** Utility function to add the billboards in the sprite list to 
+        the billboard set
+        @remarks The list is freed afterwards, the billboard set keeps its 
+        own copy of the billboards.  Dense layers are ordered for the 
+        preview with their impostors appended, see SpacescapePreviewLOD
+        */
+        void createBillboards(void);
+
         /** Utility function for preparing the billboard set
+        @param numImpostors Number of preview impostors to make room for
          */
-        void createBillboardSet();
+        void createBillboardSet(size_t numImpostors);
         
-        /** Utility function for building based on class params
+        /** Utility function for building the sprite list based on class params
         */
         void build(void);
 
-        /** Utility function for building based on class params (masked)
+        /** Utility function for building the sprite list based on class 
+        params (masked)
+        @remarks The mask must be up to date, see updateMask()
         */
         void buildMasked(void) ;
 
-        /** Utility function for building based on predefined positions/colours
+        /** Utility function for building the sprite list based on 
+        predefined positions/colours
+        @remarks The catalog must be loaded into mStarCatalog, it is 
+        cleared afterwards
          */
-        void buildFromFile(const String &filename);
+        void buildFromCatalog(void);
         
+        /** Utility function to load our sprite texture into an image for
+        software rendering
+        @param img The image to load into
+        @return true if the texture was loaded
+        */
+        bool loadTextureImage(Image& img);
+
+        /** Utility function to draw the full detail or the preview billboards
+        */
+        void updateBillboardRange(void);
+
         /** Update the material with new params - will create if needed
         */
         void updateMaterial(void);
 
+        /** Utility function to render the density mask into the mask 
+        sampler unless only the number of billboards changed
+        @remarks Must be called on the render thread
+        */
+        void updateMask(void);
+
         // billboard set to use
         SpacescapeBillboardSet* mBillboardSet;
 
@@ -128,6 +199,12 @@ namespace Ogre
         // option multiplier to use in HDR mode
         Real mHDRMultiplier;
         
+        // faintest apparent magnitude of data file stars
+        Real mMagnitudeLimit;
+
+        // flag for generating the noise mask on the cpu instead of the gpu
+        bool mMaskCPUNoise;
+
         // flag to enable/disable the noise mask
         bool mMaskEnabled;
 
@@ -152,9 +229,15 @@ namespace Ogre
         // noise power
         Real mMaskPower;
 
+        // density mask sampler, kept for rebuilds that don't change the mask
+        SpacescapeMaskSampler mMaskSampler;
+
         // random seed for mask
         unsigned int mMaskSeed;
 
+        // width/height of each noise mask face
+        unsigned int mMaskSize;
+
         // threshold for the mask (floor / cutoff)
         Real mMaskThreshold;
 
@@ -173,8 +256,40 @@ namespace Ogre
         // number of billboards
         unsigned int mNumBillboards;
 
+        // number of billboards the full detail version draws from the 
+        // start of the billboard set
+        size_t mNumFullBillboards;
+
+        // number of billboards the preview draws
+        size_t mPreviewBillboardCount;
+
+        // first billboard the preview draws
+        size_t mPreviewBillboardStart;
+
+        // declination of the centre of the data file sky region in degrees
+        Real mRegionDec;
+
+        // right ascension of the centre of the data file sky region in 
+        // degrees
+        Real mRegionRA;
+
+        // angular radius of the data file sky region in degrees, 180 for
+        // the whole sky
+        Real mRegionRadius;
+
         // source blend factor
         SceneBlendFactor mSourceBlendFactor;
+
+        // billboards for software rendering, or billboards waiting to be
+        // added to the billboard set
+        SpacescapeSoftwareRenderer::SpriteList mSprites;
+
+        // hdr colours of the billboards waiting to be added to the 
+        // billboard set
+        std::vector<ColourValue> mSpriteHDRColours;
+
+        // the data file catalog while the sprite list is built from it
+        SpacescapeStarCatalog mStarCatalog;
         
         // optional file to use for positions/colours
         String mStarDataFilename;
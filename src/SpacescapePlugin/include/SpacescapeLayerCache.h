@@ -0,0 +1,163 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef __SPACESCAPELAYERCACHE_H__
+#define __SPACESCAPELAYERCACHE_H__
+
+#include "SpacescapePrerequisites.h"
+#include <map>
+#include <vector>
+
+namespace Ogre
+{
+    /** The SpacescapeLayerCache class keeps the rendered contribution of
+    every layer of the last software render so the next render only has to
+    draw the layers whose params changed and blend the rest back in.
+    @remarks A layer's draw calls blend into the colour below them as 
+    offset + scale * colour (see SpacescapeSoftwareRenderer::beginLayer) so
+    each entry stores an offset and a scale cube.  Entries are looked up by
+    a key that holds everything the layer's pixels depend on.
+
+    The entries are kept in full float so a cached render matches an 
+    uncached one, which makes them big (up to size * size * 144 bytes per
+    layer).  The cache holds at most getMemoryBudget() bytes, the least 
+    recently used entries are evicted to make room and layers that don't
+    fit at all are simply drawn every time.
+    */
+    class _SpacescapePluginExport SpacescapeLayerCache
+    {
+    public:
+        /** The contribution of a layer to the six cube faces
+        */
+        struct Entry
+        {
+            // RGBA offsets, one array per face
+            std::vector<float> offset[6];
+
+            // RGBA scales, one array per face - empty when the scale is 1 
+            // everywhere (i.e. additive layers)
+            std::vector<float> scale[6];
+
+            /** Get the memory the entry uses
+            @return the size in bytes
+            */
+            size_t getMemorySize(void) const;
+        };
+
+        // default memory budget
+        static const size_t DEFAULT_MEMORY_BUDGET = (size_t)1024 * 1024 * 1024;
+
+        /** Constructor
+        */
+        SpacescapeLayerCache(void);
+
+        /** Destructor
+        */
+        ~SpacescapeLayerCache(void);
+
+        /** Remove all entries
+        */
+        void clear(void);
+
+        /** Find an entry and mark it as used
+        @param key The layer key
+        @return the entry or NULL if the key isn't cached
+        */
+        const Entry* find(const String& key);
+
+        /** Get the maximum memory the entries may use
+        @return the size in bytes
+        */
+        size_t getMemoryBudget(void) const { return mMemoryBudget; }
+
+        /** Get the memory all the entries use
+        @return the size in bytes
+        */
+        size_t getMemorySize(void) const { return mMemorySize; }
+
+        /** Add an entry and mark it as used
+        @param key The layer key
+        @param entry The entry - the cache deletes it when it is removed
+        */
+        void insert(const String& key, Entry* entry);
+
+        /** Mark the end of a render - the entries it found or inserted 
+        can be evicted again by later renders
+        */
+        void release(void);
+
+        /** Make room for a new entry by evicting the least recently used
+        entries that aren't in use by the current render
+        @param size The size of the new entry in bytes
+        @return false if the entry doesn't fit in the budget
+        */
+        bool reserve(size_t size);
+
+        /** Set the maximum memory the entries may use
+        @param budget The size in bytes
+        */
+        void setMemoryBudget(size_t budget);
+
+    private:
+        // a cached entry and when it was last used
+        struct Slot
+        {
+            // the entry
+            Entry* entry;
+
+            // value of mUseCount when the entry was last used
+            size_t lastUsed;
+
+            // used by the current render
+            bool used;
+        };
+
+        typedef std::map<String, Slot> SlotMap;
+
+        /** Remove least recently used entries that aren't in use until 
+        the cache uses at most the given amount of memory
+        @param size The size in bytes
+        */
+        void evict(size_t size);
+
+        // maximum memory the entries may use
+        size_t mMemoryBudget;
+
+        // memory the entries use
+        size_t mMemorySize;
+
+        // entries by key
+        SlotMap mSlots;
+
+        // use counter for finding the least recently used entry
+        size_t mUseCount;
+    };
+}
+
+#endif
@@ -52,6 +52,11 @@ namespace Ogre
         */
         ~SpacescapeLayerNoise(void);
 
+        /** Add the draw calls for this layer to a software renderer
+        @param renderer The renderer to add to
+        */
+        void addToSoftwareRenderer(SpacescapeSoftwareRenderer& renderer);
+
        /** Get the layer type
         @return the layer type
         */
@@ -65,6 +70,7 @@ namespace Ogre
         /** Initialize this layer based on the given params
         @remarks Params for this layer type are:
         NAME -  VALUE TYPE
+        cpuNoise - bool (string i.e. "true") generate the noise cube on the CPU instead of the GPU
         destBlendFactor - string (i.e. one, dest_colour  etc.)
         ditherAmount - real (string i.e. "0.1") should be in range 0.0 to 1.0
         gain - real (string i.e. "2.0")
@@ -137,10 +143,6 @@ namespace Ogre
         */
         void updateCubedMaterialParams(void);
 
-        /** Utility function for updating the cubed texture material.
-        */
-        void updateCubedMaterialParamsOld(void);
-
         /** Utility function for updating material fragment program 
         parameters.
         @param mat The material to update
@@ -155,6 +157,9 @@ namespace Ogre
         // true if this layer is built
         bool mBuilt;
 
+        // flag for generating the noise cube on the cpu instead of the gpu
+        bool mCPUNoise;
+
         // destination blend factor
         SceneBlendFactor mDestBlendFactor;
 
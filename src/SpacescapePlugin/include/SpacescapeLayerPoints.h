@@ -32,6 +32,8 @@ THE SOFTWARE.
 
 #include "SpacescapePrerequisites.h"
 #include "SpacescapeLayer.h"
+#include "SpacescapeMaskSampler.h"
+#include "SpacescapeSoftwareRenderer.h"
 
 namespace Ogre
 {
@@ -49,6 +51,11 @@ namespace Ogre
         */
         ~SpacescapeLayerPoints(void);
 
+        /** Add the draw calls for this layer to a software renderer
+        @param renderer The renderer to add to
+        */
+        void addToSoftwareRenderer(SpacescapeSoftwareRenderer& renderer);
+
        /** Get the layer type
         @return the layer type
         */
@@ -63,6 +70,8 @@ namespace Ogre
         @remarks Params for this layer type are:
         NAME -  VALUE TYPE
         farColor - ColourValue (string i.e. "0.0 0.5 1.0")
+        maskCPUNoise - bool (string i.e. "true") generate the noise mask on the CPU instead of the GPU
+        maskSize - unsigned int (string i.e. "1024") width/height of each noise mask face, up to 4096
         nearColor - ColourValue (string i.e. "0.1 0.9 1.0")
         numPoints - unsigned int (string i.e. "100")
         pointSize - unsigned int (string i.e. "1")
@@ -70,26 +79,71 @@ namespace Ogre
         */
         void init(Ogre::NameValuePairList params);
 
+        /** Set whether to display the full detail points or the faster
+        preview version
+        @remarks Layers with more points than the preview budget draw their
+        brightest points and impostors for the rest in the preview, see
+        SpacescapePreviewLOD
+        @param displayHighRes Whether to display the full detail or not
+        */
+        void setDisplayHighRes(bool displayHighRes);
+
     protected:
+        /** Generate the point list from the loaded noise mask, see 
+        prepareData()
+        */
+        void buildData(void);
+
         /** Utility function for updating saved params list
         @param params The list of params
         */
         void updateParams(NameValuePairList params);
 
     private:
+        /** Utility function to add a point to the point list
+        @remarks When software rendering the list holds the points the way 
+        the software renderer draws them, otherwise it holds the points 
+        waiting for createManualObject() to add them to the manual object
+        @param p The point position
+        @param c The point colour
+        */
+        void addPoint(const Vector3& p, ColourValue c);
 
-        /** Utility function for building based on class params
+        /** Utility function for building the point list based on class params
         */
         void build(void);
 
-        /** Utility function for building based on class params when masked
+        /** Utility function for building the point list based on class params 
+        when masked
+        @remarks The mask must be up to date, see updateMask()
         */
         void buildMasked(void);
 
+        /** Utility function to add the points in the point list to the 
+        manual object
+        @remarks The points are written straight into one interleaved vertex
+        buffer in parallel chunks and uploaded at once.  The list is freed 
+        afterwards, the manual object keeps its own copy of the points in 
+        the hardware buffer.  Dense layers are ordered for the preview with
+        their impostors appended, see SpacescapePreviewLOD
+        */
+        void createManualObject(void);
+
         /** Create the material we'll need if not created already
         */
         void createMaterial(void);
 
+        /** Utility function to render the density mask into the mask 
+        sampler unless only the number of points changed
+        @remarks Must be called on the render thread
+        */
+        void updateMask(void);
+
+        /** Utility function to draw the full detail or the preview 
+        version of the points
+        */
+        void updateVertexRange(void);
+
         // dest blend factor
         SceneBlendFactor mDestBlendFactor;
 
@@ -106,6 +160,12 @@ namespace Ogre
         // option multiplier to use in HDR mode
         Real mHDRMultiplier;
 
+        // material for the preview impostors
+        MaterialPtr mImpostorMaterial;
+
+        // flag for generating the noise mask on the cpu instead of the gpu
+        bool mMaskCPUNoise;
+
         // flag to enable/disable the noise mask
         bool mMaskEnabled;
 
@@ -130,9 +190,15 @@ namespace Ogre
         // noise power
         Real mMaskPower;
 
+        // density mask sampler, kept for rebuilds that don't change the mask
+        SpacescapeMaskSampler mMaskSampler;
+
         // random seed for mask
         unsigned int mMaskSeed;
 
+        // width/height of each noise mask face
+        unsigned int mMaskSize;
+
         // threshold for the mask (floor / cutoff)
         Real mMaskThreshold;
 
@@ -145,9 +211,23 @@ namespace Ogre
         // num points
         unsigned int mNumPoints;
 
+        // number of vertices the full detail version draws from the start
+        // of the vertex buffer
+        size_t mNumFullVertices;
+
+        // number of preview impostors
+        size_t mNumImpostors;
+
+        // points for software rendering, or points waiting to be added to
+        // the manual object
+        SpacescapeSoftwareRenderer::PointList mPoints;
+
         // point size
         unsigned int mPointSize;
 
+        // first vertex the preview draws
+        size_t mPreviewVertexStart;
+
         // source blend factor
         SceneBlendFactor mSourceBlendFactor;
     };
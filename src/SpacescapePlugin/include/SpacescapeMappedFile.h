@@ -0,0 +1,103 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef __SPACESCAPEMAPPEDFILE_H__
+#define __SPACESCAPEMAPPEDFILE_H__
+
+#include "SpacescapePrerequisites.h"
+
+namespace Ogre
+{
+    /** The SpacescapeMappedFile class maps a whole file into memory read 
+    only, so large files (noise cache cubes, star catalogs) can be used
+    in place without reading them into buffers first.
+    @remarks Empty files can't be mapped.
+    */
+    class _SpacescapePluginExport SpacescapeMappedFile
+    {
+    public:
+        /** Constructor
+        */
+        SpacescapeMappedFile(void);
+
+        /** Destructor
+        @remarks unmaps the file if it is still mapped
+        */
+        ~SpacescapeMappedFile(void);
+
+        /** Unmap the file
+        */
+        void close(void);
+
+        /** Get the mapped file contents
+        @return the start of the file or NULL if no file is mapped
+        */
+        const uchar* getData(void) const { return mData; }
+
+        /** Get the size of the mapped file
+        @return the size in bytes
+        */
+        size_t getSize(void) const { return mSize; }
+
+        /** Is a file mapped?
+        @return true if a file is mapped
+        */
+        bool isOpen(void) const { return mData != 0; }
+
+        /** Map a file, unmapping the current one first
+        @param filename The file to map
+        @return true on success, false if the file can't be opened or mapped
+        */
+        bool open(const String& filename);
+
+        /** Move a file over another one in a single step, so readers see
+        either the old file or the new one and never a missing file
+        @remarks Files that are mapped elsewhere keep their old contents
+        on POSIX systems.  On Windows the replace fails while the
+        destination is mapped.
+        @param source The file to move
+        @param destination The file to replace
+        @return true on success, false if the source is left in place
+        */
+        static bool replace(const String& source, const String& destination);
+
+    private:
+        // no copies - the mapping would get unmapped twice
+        SpacescapeMappedFile(const SpacescapeMappedFile&);
+        SpacescapeMappedFile& operator=(const SpacescapeMappedFile&);
+
+        // start of the mapped file or NULL
+        uchar* mData;
+
+        // size of the mapping in bytes
+        size_t mSize;
+    };
+}
+
+#endif
@@ -0,0 +1,178 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef __SPACESCAPEMASKSAMPLER_H__
+#define __SPACESCAPEMASKSAMPLER_H__
+
+#include "SpacescapePrerequisites.h"
+#include "SpacescapeRandom.h"
+#include "OgrePixelFormat.h"
+#include "OgreMath.h"
+
+namespace Ogre
+{
+    /** The SpacescapeMaskSampler class picks random positions on a cube 
+    map density mask so that the density of positions on the sphere is 
+    proportional to the square of the mask value.
+    @remarks The mask is sampled bilinearly and weighted by the solid 
+    angle of the cube face at each position, so stars don't bunch up in 
+    face corners.  The faces are split into tiles and an alias table 
+    (Vose's method) over the tiles picks a tile in proportion to an upper
+    bound of its density, then a position in the tile is kept or thrown
+    away against that bound.  Tiles are small so almost all positions are
+    kept and every sample takes a few random numbers no matter how sparse
+    the mask is.  The table is kept with a key of the mask settings so 
+    layers can reuse it when only their star count changes.
+    */
+    class _SpacescapePluginExport SpacescapeMaskSampler
+    {
+    public:
+        /** Constructor
+        */
+        SpacescapeMaskSampler(void);
+
+        /** Build the table for the mask
+        @remarks Call once the mask faces are filled in (see getFace)
+        @param key The key of the mask settings (see getKey)
+        */
+        void build(const String& key);
+
+        /** Free the mask and the table
+        */
+        void clear(void);
+
+        /** Get a mask face to fill in before calling build()
+        @param face The face, orientation is +X (0), -X (1), +Y (2), -Y (3), 
+        +Z (4), -Z (5)
+        @return the face in PF_L8
+        */
+        PixelBox getFace(unsigned int face);
+
+        /** Get the key of the mask settings the table was built with
+        @return the key or an empty string if the table isn't built
+        */
+        const String& getKey(void) const { return mKey; }
+
+        /** Get the width/height of each mask face
+        @return the size
+        */
+        unsigned int getSize(void) const { return mSize; }
+
+        /** Get whether there is anything to sample
+        @return true if the table isn't built or the mask is all zero
+        */
+        bool isEmpty(void) const { return mProbability.empty(); }
+
+        /** Pick a random position on the mask
+        @remarks The sampler must not be empty.  After MAX_SAMPLE_TRIES
+        positions are thrown away the densest one of them is used, so 
+        tiles whose bound is far above their density can't stall a layer.
+        @param random The random number generator to use
+        @param face Set to the cube face
+        @param u Set to the horizontal position on the face in the range 0..1
+        @param v Set to the vertical position on the face in the range 0..1
+        */
+        void sample(SpacescapeRandom& random, unsigned int& face, Real& u, Real& v) const;
+
+        /** Pick a random position on the mask the way layers did before the
+        sampler, for scenes made with SpacescapeRandom::GENERATOR_RAND
+        @remarks Positions are picked evenly on the cube faces and kept 
+        against the square of the nearest mask texel, so they bunch up at
+        the cube corners.  The random numbers are used in the same order 
+        as before so those scenes keep their stars.
+        @param random The random number generator to use
+        @param numTested The number of positions thrown away in a row, set
+        to 0 before the first call
+        @param face Set to the cube face
+        @param u Set to the horizontal position on the face in the range 0..1
+        @param v Set to the vertical position on the face in the range 0..1
+        @return false when numTested reaches MAX_REJECTION_TESTS, the layers
+        drop a star then and keep going
+        */
+        bool sampleRejection(SpacescapeRandom& random, unsigned int& numTested, unsigned int& face, Real& u, Real& v) const;
+
+        /** Allocate the mask faces, this frees the table
+        @param size The width/height of each mask face
+        */
+        void setSize(unsigned int size);
+
+    private:
+        /** Utility function to get the density at a position on the mask
+        @param face The cube face
+        @param u The horizontal position on the face in the range 0..1
+        @param v The vertical position on the face in the range 0..1
+        @return the bilinear mask value squared times the solid angle weight
+        */
+        Real getDensity(unsigned int face, Real u, Real v) const;
+
+        /** Utility function to get the solid angle of the cube face at a 
+        position relative to the face center
+        @param x The horizontal position on the face in the range -1..1
+        @param y The vertical position on the face in the range -1..1
+        @return the solid angle weight, 1 at the face center
+        */
+        static inline Real getSolidAngle(Real x, Real y)
+        {
+            Real d = 1.0 + x * x + y * y;
+            return 1.0 / (d * Math::Sqrt(d));
+        }
+
+        // positions sampleRejection() throws away before it gives up
+        static const unsigned int MAX_REJECTION_TESTS = 99999;
+
+        // positions sample() tries before it takes the best one
+        static const unsigned int MAX_SAMPLE_TRIES = 1024;
+
+        // width/height of the tiles the table picks from in texels
+        static const unsigned int TILE_SIZE = 4;
+
+        // the tile to use instead when a tile isn't picked
+        std::vector<uint32> mAlias;
+
+        // the key of the mask settings the table was built with
+        String mKey;
+
+        // the mask value of each texel, face after face
+        std::vector<uchar> mMask;
+
+        // the probability of picking each tile over its alias
+        std::vector<float> mProbability;
+
+        // the width/height of each face
+        unsigned int mSize;
+
+        // the upper bound of the density in each tile
+        std::vector<float> mTileBound;
+
+        // the number of tiles along each face edge
+        unsigned int mTilesPerRow;
+    };
+}
+
+#endif
@@ -0,0 +1,104 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef __SPACESCAPEMIPMAPGENERATOR_H__
+#define __SPACESCAPEMIPMAPGENERATOR_H__
+
+#include "SpacescapePrerequisites.h"
+#include "SpacescapePlugin.h"
+#include "OgrePixelFormat.h"
+#include "OgreVector3.h"
+#include <vector>
+
+namespace Ogre
+{
+    /** The SpacescapeMipmapGenerator class builds the mip chain of a skybox
+    cube map on the CPU.  Each level is filtered from the one above with a
+    [1 3 3 1] tent kernel weighted by texel solid angle, and taps that fall
+    off the edge of a face are read from the neighbouring face so the 
+    smaller levels don't show seams along the cube edges.
+    @remarks Faces must be square and are expected to be a power of two in
+    size.  Levels are filtered on the shared thread pool.
+    */
+    class _SpacescapePluginExport SpacescapeMipmapGenerator
+    {
+    public:
+        /** Constructor
+        @param orientation Orientation mode the faces were rendered with, 
+        used to find the neighbouring faces
+        */
+        SpacescapeMipmapGenerator(SpacescapePlugin::SpacescapeRTTOrientation orientation = SpacescapePlugin::SRO_DEFAULT_ORIENTATION);
+
+        /** Destructor
+        */
+        ~SpacescapeMipmapGenerator(void);
+
+        /** Generate the mip levels of a cube map
+        @param faces Pixel boxes for every level of all six faces, face 
+        after face (faces[face * (numMipmaps + 1) + level]).  Level 0 of
+        every face must be filled in, the other levels are written.  Any 
+        pixel format can be used.
+        @param numMipmaps The number of levels below level 0 to generate
+        */
+        void generate(const PixelBox* faces, unsigned int numMipmaps) const;
+
+    private:
+        /** Utility function to filter rows of a face from the level above
+        @param src The six faces of the level above as RGB floats
+        @param srcSize The width/height of the level above
+        @param face The face to filter
+        @param rowStart The first row to filter
+        @param rowEnd One past the last row to filter
+        @param dest The RGB float face to write to
+        */
+        void downsampleRows(const std::vector<float>* src, unsigned int srcSize, unsigned int face, unsigned int rowStart, unsigned int rowEnd, float* dest) const;
+
+        /** Utility function to get a texel, following the cube edges into 
+        the neighbouring faces for positions outside the face
+        @param src The six faces as RGB floats
+        @param size The width/height of the faces
+        @param face The face the position is relative to
+        @param x The texel column, may be outside the face
+        @param y The texel row, may be outside the face
+        @return the RGB texel
+        */
+        const float* getTexel(const std::vector<float>* src, unsigned int size, unsigned int face, int x, int y) const;
+
+        // view direction through the centre of each face
+        Vector3 mFaceForward[6];
+
+        // direction the face u axis runs along
+        Vector3 mFaceRight[6];
+
+        // direction the face v axis runs along (top to bottom)
+        Vector3 mFaceDown[6];
+    };
+}
+
+#endif
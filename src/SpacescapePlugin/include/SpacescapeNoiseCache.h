@@ -0,0 +1,200 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef __SPACESCAPENOISECACHE_H__
+#define __SPACESCAPENOISECACHE_H__
+
+#include "SpacescapePrerequisites.h"
+#include "SpacescapeMappedFile.h"
+#include "SpacescapeNoiseGenerator.h"
+#include "SpacescapeRandom.h"
+#include "OgrePixelFormat.h"
+
+namespace Ogre
+{
+    /** The SpacescapeNoiseCache class keeps baked noise cubes on disk so 
+    layers don't have to render the same noise again every time a scene is
+    opened, HDR is toggled or a mask is regenerated.
+    @remarks Cubes are content addressed - the file name is a hash of a key
+    that holds everything the pixels depend on (see getKey) and the key is
+    stored in the file too so hash collisions are never loaded.  Files are
+    a small header followed by the six faces tightly packed in the pixel
+    format they were rendered in, and are memory mapped when read so a hit
+    costs little more than the copy to the destination.
+
+    The files take at most getMaxSize() bytes, the least recently used 
+    ones are removed whenever a new cube is added.  Reading a cube 
+    refreshes its file's modified time, which is what the age is taken
+    from.  The editor keeps its cache in
+    the "noise" folder of the user's cache directory (QStandardPaths::
+    CacheLocation), the command line exporter only uses one when given
+    --noise-cache.  Deleting the folder at any time just clears the cache.
+    */
+    class _SpacescapePluginExport SpacescapeNoiseCache
+    {
+    public:
+        /** A cached noise cube mapped into memory
+        @remarks The faces point straight into the mapped file and are only
+        valid until the cube is closed or destroyed.
+        */
+        class _SpacescapePluginExport Cube
+        {
+        public:
+            /** Constructor
+            */
+            Cube(void);
+
+            /** Destructor
+            @remarks unmaps the file if it is still mapped
+            */
+            ~Cube(void);
+
+            /** Unmap the file
+            */
+            void close(void);
+
+            /** Get a face
+            @param face The cube face (0 - 5)
+            @return the face pixels
+            */
+            const PixelBox& getFace(unsigned int face) const { return mFaces[face]; }
+
+            /** Is a file mapped?
+            @return true if the faces are valid
+            */
+            bool isOpen(void) const { return mFile.isOpen(); }
+
+        private:
+            friend class SpacescapeNoiseCache;
+
+            // no copies - the mapping would get unmapped twice
+            Cube(const Cube&);
+            Cube& operator=(const Cube&);
+
+            // the six faces in the mapped file
+            PixelBox mFaces[6];
+
+            // the mapped file
+            SpacescapeMappedFile mFile;
+        };
+
+        // default limit on the size of the cache files
+        static const uint64 DEFAULT_MAX_SIZE = (uint64)4 * 1024 * 1024 * 1024;
+
+        /** Constructor
+        @param directory The directory the cache files are kept in, it is
+        created if it doesn't exist
+        */
+        SpacescapeNoiseCache(const String& directory);
+
+        /** Destructor
+        */
+        ~SpacescapeNoiseCache(void);
+
+        /** Get the directory the cache files are kept in
+        @return the directory
+        */
+        const String& getDirectory(void) const { return mDirectory; }
+
+        /** Build the key of a noise cube
+        @param source What rendered the cube, i.e. "gpu" or "cpu" - they
+        don't produce exactly the same pixels
+        @param seed The seed for the random noise
+        @param generator The generator the seed shuffles the permutation 
+        table with
+        @param params The noise settings
+        @param size The width/height of each face
+        @param format The pixel format of the faces
+        @return the key
+        */
+        static String getKey(const String& source, unsigned int seed, SpacescapeRandom::Generator generator,
+            const SpacescapeNoiseParams& params, unsigned int size, PixelFormat format);
+
+        /** Get the maximum size of all the cache files together
+        @return the size in bytes
+        */
+        uint64 getMaxSize(void) const { return mMaxSize; }
+
+        /** Map a cached cube into memory
+        @param key The cube key (see getKey)
+        @param size The width/height of each face
+        @param format The pixel format of the faces
+        @param cube The cube to map the file into
+        @return true if the cube is cached, false if not
+        */
+        bool open(const String& key, unsigned int size, PixelFormat format, Cube& cube);
+
+        /** Copy a cached cube to six faces
+        @param key The cube key (see getKey)
+        @param faces Array of six pixel boxes to write to, all in the 
+        format and size the key was built with
+        @return true if the cube is cached, false if not
+        */
+        bool read(const String& key, const PixelBox* faces);
+
+        /** Set the maximum size of all the cache files together
+        @remarks Takes effect the next time a cube is added
+        @param maxSize The size in bytes
+        */
+        void setMaxSize(uint64 maxSize) { mMaxSize = maxSize; }
+
+        /** Add a cube to the cache
+        @remarks The file is written under a temporary name and renamed
+        into place so other processes never map a partly written cube.
+        The least recently used files are then removed until the cache 
+        fits in getMaxSize() again.
+        @param key The cube key (see getKey)
+        @param faces Array of six pixel boxes to store, all in the format 
+        and size the key was built with
+        @return true on success, false on error
+        */
+        bool write(const String& key, const PixelBox* faces);
+
+    private:
+        /** Remove the least recently used cache files until the rest fit
+        in mMaxSize
+        @param keep A file that is never removed (the one just added)
+        */
+        void evict(const String& keep);
+
+        /** Get the file a key is stored in
+        @param key The cube key
+        @return the filename (with path)
+        */
+        String getFilename(const String& key) const;
+
+        // directory the cache files are kept in (with a trailing slash)
+        String mDirectory;
+
+        // maximum size of all the cache files together
+        uint64 mMaxSize;
+    };
+}
+
+#endif
@@ -0,0 +1,225 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef __SPACESCAPENOISEGENERATOR_H__
+#define __SPACESCAPENOISEGENERATOR_H__
+
+#include "SpacescapePrerequisites.h"
+#include "SpacescapeNoiseKernels.h"
+#include "OgreColourValue.h"
+#include "OgrePixelFormat.h"
+#include "OgreString.h"
+#include "OgreVector3.h"
+
+namespace Ogre
+{
+    /** The SpacescapeNoiseParams struct holds all the settings that
+    define a noise cube.  These are the same values that get passed to
+    SpacescapeLayer::renderNoiseToTexture for the GPU noise.
+    */
+    struct _SpacescapePluginExport SpacescapeNoiseParams
+    {
+        SpacescapeNoiseParams(void);
+
+        // noise type - either "fbm" or "ridged"
+        String noiseType;
+
+        // colour where the noise is 1
+        ColourValue innerColor;
+
+        // colour where the noise is 0
+        ColourValue outerColor;
+
+        // num octaves for noise
+        unsigned int octaves;
+
+        // lacunarity for noise
+        Real lacunarity;
+
+        // noise gain for fbm noise and ridged
+        Real gain;
+
+        // power function to apply to final noise
+        Real power;
+
+        // lower shelf/threshold
+        Real threshold;
+
+        // amount to dither the noise
+        Real dither;
+
+        // initial scale amount applied to unit sphere noise coords
+        Real scale;
+
+        // offset for ridged fbm noise
+        Real offset;
+
+        // hdr power function applied after the regular power function
+        Real hdrPower;
+
+        // hdr multiplier applied to the final colour
+        Real hdrMultiplier;
+    };
+
+    /** The SpacescapeNoiseGenerator class generates the same FBM and Ridged
+    FBM noise as the shaders in SpacescapeNoiseMaterial.cpp but on the CPU.
+    It emulates the 8 bit permutation and gradient textures the shaders
+    sample from, evaluates whole rows of texels at once with the
+    SpacescapeNoiseKernels batch functions and samples each texel at its centre along the same view
+    direction the RTT camera in SpacescapePlugin::_rtt uses, so the cube
+    faces line up with the GPU version without seams.
+    @remarks All the generator state is read only once constructed so any
+    number of threads can render with the same generator at once.
+    */
+    class _SpacescapePluginExport SpacescapeNoiseGenerator
+    {
+    public:
+        /** Constructor
+        @param permutations The 512 entry permutation table (see SpacescapeLayer::initNoise)
+        @param params The noise settings
+        */
+        SpacescapeNoiseGenerator(const uchar* permutations, const SpacescapeNoiseParams& params);
+
+        /** Destructor
+        */
+        ~SpacescapeNoiseGenerator(void);
+
+        /** Get the final colour for a direction
+        @param dir The normalised direction
+        @return the colour (alpha holds the noise value)
+        */
+        ColourValue getColour(const Vector3& dir) const;
+
+        /** Get the final colours for arrays of directions
+        @param dx Array of normalised direction x components
+        @param dy Array of normalised direction y components
+        @param dz Array of normalised direction z components
+        @param dest Array of count RGBA colours to write to (alpha holds the noise value)
+        @param count Number of directions
+        */
+        void getColours(const float* dx, const float* dy, const float* dz, float* dest, size_t count) const;
+
+        /** Get the view direction through a cube face texel the same way
+        the RTT camera sees it
+        @param face The cube face (0 - 5)
+        @param u Horizontal position on the face in the range -1..1
+        @param v Vertical position on the face in the range -1..1 (top to bottom)
+        @return the direction (not normalised)
+        */
+        static Vector3 getFaceDirection(unsigned int face, Real u, Real v);
+
+        /** Get the final noise value for a direction after the shelf and
+        power functions are applied
+        @param dir The normalised direction
+        @return the noise value
+        */
+        Real getNoise(const Vector3& dir) const;
+
+        /** Get the noise settings
+        @return the noise settings
+        */
+        const SpacescapeNoiseParams& getParams(void) const { return mParams; }
+
+        /** Render all six faces of a noise cube using the shared thread
+        pool.  Faces are split into row tiles so all the cores get used.
+        @param size The width/height of each face
+        @param faces Array of six pixel boxes to write to, in any pixel format
+        */
+        void renderCube(unsigned int size, const PixelBox* faces) const;
+
+        /** Render a range of rows of a cube face
+        @param face The cube face (0 - 5)
+        @param size The width/height of the face
+        @param rowStart The first row to render
+        @param rowEnd One past the last row to render
+        @param dest The pixel box for the whole face to write to
+        */
+        void renderFaceRows(unsigned int face, unsigned int size, unsigned int rowStart, unsigned int rowEnd, const PixelBox& dest) const;
+
+    private:
+        /** Utility noise function for fbm perlin noise
+        @param x
+        @param y
+        @param z
+        @param octaves Number of octaves
+        @return The noise value
+        */
+        float fbmNoise(float x, float y, float z, unsigned int octaves) const;
+
+        /** Utility noise function for fbm perlin noise on arrays of points
+        @remarks The coordinate arrays are used as scratch space
+        @param x Array of x coordinates
+        @param y Array of y coordinates
+        @param z Array of z coordinates
+        @param out Array the noise values are written to
+        @param noise Scratch array for the per octave noise
+        @param count Number of points
+        @param octaves Number of octaves
+        */
+        void fbmNoise(float* x, float* y, float* z, float* out, float* noise, size_t count, unsigned int octaves) const;
+
+        /** Utility noise function for ridged fbm perlin noise
+        @param x
+        @param y
+        @param z
+        @param octaves Number of octaves
+        @return The noise value
+        */
+        float ridgedFbmNoise(float x, float y, float z, unsigned int octaves) const;
+
+        /** Utility noise function for ridged fbm perlin noise on arrays of points
+        @remarks The coordinate arrays are used as scratch space
+        @param x Array of x coordinates
+        @param y Array of y coordinates
+        @param z Array of z coordinates
+        @param out Array the noise values are written to
+        @param noise Scratch array for the per octave noise
+        @param count Number of points
+        @param octaves Number of octaves
+        */
+        void ridgedFbmNoise(float* x, float* y, float* z, float* out, float* noise, size_t count, unsigned int octaves) const;
+
+        /** Apply the shelf and power functions to a raw noise value
+        @param n The noise value in the range -1..1
+        @return the final noise value
+        */
+        float shapeNoise(float n) const;
+
+        // noise settings
+        SpacescapeNoiseParams mParams;
+
+        // true for ridged fbm noise
+        bool mRidged;
+
+        // permutation and gradient tables as the noise shaders see them
+        SpacescapeNoiseKernels::Tables mTables;
+    };
+}
+
+#endif
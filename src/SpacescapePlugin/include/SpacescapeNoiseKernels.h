@@ -0,0 +1,152 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef __SPACESCAPENOISEKERNELS_H__
+#define __SPACESCAPENOISEKERNELS_H__
+
+#include "SpacescapePrerequisites.h"
+
+namespace Ogre
+{
+    /** The SpacescapeNoiseKernels class evaluates Perlin improved noise and
+    simplex noise for whole arrays of points at once.  Points are passed as
+    separate x, y and z arrays and evaluated 4 (SSE4.1, NEON), 8 (AVX2) or
+    16 (AVX-512) at a time, picking the best instruction set the CPU 
+    supports at runtime.
+    @remarks Every vector version performs exactly the same float
+    operations in the same order as the scalar reference functions (no
+    fused multiply-add) so results are bit identical to the scalar
+    reference on every instruction set.  The scalar reference itself 
+    matches the double precision SpacescapeLayer::perlinNoise and 
+    SpacescapeLayer::simplexNoise to within float precision (about 1e-6).
+    tests/NoiseKernelsTest.cpp checks both for each instruction set the 
+    CPU supports.
+    */
+    class _SpacescapePluginExport SpacescapeNoiseKernels
+    {
+    public:
+        // Instruction sets the kernels are implemented with
+        enum InstructionSet
+        {
+            SIS_SCALAR = 0,
+            SIS_SSE41,
+            SIS_AVX2,
+            SIS_NEON,
+            SIS_AVX512
+        };
+
+        /** The lookup tables the kernels read from.  Build once per
+        permutation table and share between threads - they are read only.
+        */
+        struct _SpacescapePluginExport Tables
+        {
+            /** Build the tables from a permutation table
+            @param permutations The 512 entry permutation table (see SpacescapeLayer::initNoise)
+            @param gpuCompatible If true the gradients and hashes are built
+            the way the noise shaders see them through their 8 bit lookup
+            textures, otherwise they match SpacescapeLayer::grad
+            */
+            void init(const uchar* permutations, bool gpuCompatible);
+
+            // permutation table
+            int perm[512];
+
+            // gradient index for each permutation table entry
+            int hash[512];
+
+            // gradient x, y and z components for each gradient index
+            float gradX[256];
+            float gradY[256];
+            float gradZ[256];
+        };
+
+        /** Get the fastest instruction set this CPU supports
+        @return the instruction set
+        */
+        static InstructionSet getBestInstructionSet(void);
+
+        /** Get the instruction set the batch functions currently use
+        @return the instruction set
+        */
+        static InstructionSet getInstructionSet(void);
+
+        /** Get a printable name for an instruction set
+        @param set The instruction set
+        @return the name
+        */
+        static const char* getInstructionSetName(InstructionSet set);
+
+        /** Perlin improved noise (3d) scalar reference
+        @param tables The lookup tables
+        @param x
+        @param y
+        @param z
+        @return the noise value
+        */
+        static float perlinNoise(const Tables& tables, float x, float y, float z);
+
+        /** Perlin improved noise (3d) for an array of points
+        @param tables The lookup tables
+        @param x Array of x coordinates
+        @param y Array of y coordinates
+        @param z Array of z coordinates
+        @param out Array the noise values are written to
+        @param count Number of points
+        */
+        static void perlinNoise(const Tables& tables, const float* x, const float* y, const float* z, float* out, size_t count);
+
+        /** Force the batch functions to use a particular instruction set
+        @remarks Mainly for comparing results and timings.  Falls back to
+        the best supported instruction set if the one requested isn't supported.
+        @param set The instruction set
+        */
+        static void setInstructionSet(InstructionSet set);
+
+        /** Perlin simplex noise (3d) scalar reference
+        @param tables The lookup tables
+        @param x
+        @param y
+        @param z
+        @return the noise value
+        */
+        static float simplexNoise(const Tables& tables, float x, float y, float z);
+
+        /** Perlin simplex noise (3d) for an array of points
+        @param tables The lookup tables
+        @param x Array of x coordinates
+        @param y Array of y coordinates
+        @param z Array of z coordinates
+        @param out Array the noise values are written to
+        @param count Number of points
+        */
+        static void simplexNoise(const Tables& tables, const float* x, const float* y, const float* z, float* out, size_t count);
+    };
+}
+
+#endif
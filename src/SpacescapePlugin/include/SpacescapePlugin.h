@@ -31,6 +31,8 @@ THE SOFTWARE.
 #define __SPACESCAPEPLUGIN_H__
 
 #include "SpacescapePrerequisites.h"
+#include "SpacescapeBlockCompressor.h"
+#include "SpacescapeRandom.h"
 #include "OgrePlugin.h"
 #include "OgreCommon.h"
 #include "OgreDataStream.h"
@@ -41,6 +43,9 @@ namespace Ogre
 {
     // forward declaration
     class SpacescapeLayer;
+    class SpacescapeLayerCache;
+    class SpacescapeNoiseCache;
+    class SpacescapeSoftwareRenderer;
 
     /** The SpacescapePlugin class is an Ogre Plugin.  It creates 
     and manages SpacescapeLayer objects and can open and save .xml 
@@ -103,6 +108,21 @@ namespace Ogre
         */
         int duplicateLayer(unsigned int layerId);
 
+        /** Get whether noise layers generate their noise on the CPU by default
+        @return true if noise layers use the CPU noise generator
+        */
+        bool getDefaultCPUNoise() { return mDefaultCPUNoise; }
+
+        /** Get the block compression used for .dds exports
+        @return the compressed pixel format, PF_UNKNOWN when disabled
+        */
+        PixelFormat getExportCompression() { return mExportCompression; }
+
+        /** Get the number of rows streaming exports render and write at a time
+        @return the number of rows, 0 when streaming exports are disabled
+        */
+        unsigned int getExportStripHeight() { return mExportStripHeight; }
+
         /** Get copy of layers list
         @return List of layers
         */
@@ -111,6 +131,19 @@ namespace Ogre
 		/// @copydoc Plugin::getName
 		const String& getName() const;
 
+        /** Get the directory baked noise cubes are cached in
+        @return the directory, empty when the noise cache is disabled
+        */
+        String getNoiseCacheDirectory();
+
+        /** Get the random number generator layers build the scene with
+        @remarks Scenes record their generator when they are saved, scenes
+        saved before that was done use SpacescapeRandom::GENERATOR_RAND and
+        new scenes use SpacescapeRandom::GENERATOR_CURRENT
+        @return the generator
+        */
+        SpacescapeRandom::Generator getRandomGenerator() { return mRandomGenerator; }
+
         /** Get the root scene node for all the layers
         @return the SceneNode pointer for all the layers
         */
@@ -127,10 +160,25 @@ namespace Ogre
 		/// @copydoc Plugin::initialise
 		void initialise();
 
+        /** Are mip maps generated for exports?
+         @return true if enabled, false if disabled
+         */
+        bool isExportMipmapsEnabled();
+
         /** Is High defintion rendering enabled?
          @return true if enabled, false if disabled
          */
         bool isHDREnabled();
+
+        /** Is the software render layer cache enabled?
+         @return true if enabled, false if disabled
+         */
+        bool isLayerCacheEnabled();
+
+        /** Is software rendering enabled?
+         @return true if enabled, false if disabled
+         */
+        bool isSoftwareRenderingEnabled();
         
         /** Load a config file
         @param stream The stream of the file to read
@@ -182,16 +230,91 @@ namespace Ogre
         */
         void setDebugBoxVisible(bool visible);
 
+        /** Make noise layers generate their noise on the CPU by default
+        @remarks Noise layers use the CPU noise generator when this is set
+        or their cpuNoise param is true.  Set it before loading a scene so
+        the noise is only rendered once - layers that are already built
+        pick it up the next time they are updated.  The setting isn't saved
+        with the scene.
+        @param enabled true to use the CPU noise generator, false to use 
+        the cpuNoise param of each layer
+        */
+        void setDefaultCPUNoise(bool enabled);
+
+        /** Set the block compression used for .dds exports
+        @remarks Faces, cube maps and their mip maps are compressed on the 
+        CPU with a SpacescapeBlockCompressor.  Use PF_BC6H_UF16 for HDR 
+        skyboxes, PF_BC7_UNORM, PF_DXT5 or PF_DXT1 for LDR skyboxes (HDR
+        colours are clamped to 1).  Other file types aren't compressed.
+        @param format The compressed pixel format, PF_UNKNOWN to disable
+        @param quality The compression quality
+        */
+        void setExportCompression(PixelFormat format, SpacescapeBlockCompressor::Quality quality = SpacescapeBlockCompressor::BCQ_NORMAL);
+
+        /** Enable/Disable generating mip maps for exports
+        @remarks Mip maps are filtered on the CPU across the cube face edges
+        so the smaller levels stay seamless.  .dds files get the mip maps 
+        embedded, other file types get a separate file per level with a
+        "_mipN" suffix.  Streaming exports don't include mip maps.
+        @param enabled true to enable, false to disable
+        */
+        void setExportMipmapsEnabled(bool enabled);
+
+        /** Set the number of rows streaming exports render and write at a time
+        @remarks When set, writeToFile renders each face a strip of rows at a
+        time and streams the strips to the file so memory use depends on the
+        strip size instead of the face size.  Only .dds, .hdr, .pfm and .tga
+        files can be streamed, other file types are written whole.
+        @param rows The number of rows in a strip, 0 to write whole faces
+        */
+        void setExportStripHeight(unsigned int rows);
+
         /** Enable/Disable HDR mode
          @param enable true to enable, false to disable
          */
         void setHDREnabled(bool enabled);
         
+        /** Enable/Disable the software render layer cache
+         @remarks When enabled, software rendered exports keep the 
+         contribution of every layer in memory and the next export only
+         draws the layers whose params changed, the rest are blended back 
+         in from the cache.  The cache holds six faces of float RGBA (plus a
+         scale cube for non additive layers) per layer so it isn't used for
+         streaming exports, and it evicts the least recently used layers to
+         stay inside SpacescapeLayerCache::getMemoryBudget().  Only the
+         software renderer (see setSoftwareRenderingEnabled) uses the cache,
+         exports through the render system still draw every layer.
+         @param enabled true to enable, false to disable
+         */
+        void setLayerCacheEnabled(bool enabled);
+
         /** Show or hide a layer
         @param layerId the layer to hide/show
         @param visible true to show, false to hide
         */
         void setLayerVisible(unsigned int layerId, bool visible);
+
+        /** Set the directory baked noise cubes are cached in
+         @remarks Noise layers and noise masks look for a cube baked with
+         the same settings, size and pixel format in this directory before
+         rendering one, and add the cubes they render to it.  The directory
+         can be shared between sessions and deleted at any time to reclaim
+         space, and the oldest cubes are removed once the files take more
+         than SpacescapeNoiseCache::DEFAULT_MAX_SIZE bytes (see 
+         SpacescapeNoiseCache::setMaxSize).
+         @param directory The directory (it is created if needed), or an 
+         empty string to disable the noise cache
+         */
+        void setNoiseCacheDirectory(const String& directory);
+
+        /** Enable/Disable software rendering
+         @remarks In software mode layers don't create any materials, 
+         textures or hardware buffers and writeToFile renders on the CPU with
+         a SpacescapeSoftwareRenderer so no render system is needed.  Layers 
+         aren't displayed in the scene and writeToMaterial isn't available.
+         @param enable true to enable, false to disable
+         */
+        void setSoftwareRenderingEnabled(bool enabled);
         
 
 		/// @copydoc Plugin::shutdown
@@ -241,10 +364,67 @@ namespace Ogre
 		@param orientation Orientation mode for non-Ogre skybox orientations
         */
         bool _rtt(TexturePtr& texture, int numMipMaps, SpacescapeRTTOrientation orientation = SRO_DEFAULT_ORIENTATION);
+
+        /** For internal use only - get the orientation of the camera _rtt 
+        renders a cube face with
+        @remarks SpacescapeSoftwareRenderer::getFaceDirection and the CPU
+        noise generator must see each face the same way this camera does
+        @param face The cube face (0 - 5)
+        @param orientation Orientation mode for non-Ogre skybox orientations
+        @return the camera scene node orientation
+        */
+        static Quaternion _getRTTFaceOrientation(int face, SpacescapeRTTOrientation orientation = SRO_DEFAULT_ORIENTATION);
+
+        /** For internal use only - layers use this to look up baked noise
+        @return the noise cache or NULL when disabled
+        */
+        SpacescapeNoiseCache* _getNoiseCache() { return mNoiseCache; }
  
     private:
+        /** Utility function to add the draw calls for all the visible 
+        layers to a software renderer
+        @param renderer The renderer to add to
+        */
+        void addLayersToSoftwareRenderer(SpacescapeSoftwareRenderer& renderer);
+
+        /** Utility function to add a created layer to the scene
+        @param layer The layer to add, prepared or not
+        @param params The list of name & value pairs that are parameters for the layer type
+        @return the layer id of the added layer
+        */
+        int addLayer(SpacescapeLayer* layer, const NameValuePairList& params);
+
         void buildDebugBox(SceneNode *sceneNode);
+
+        /** Utility function to create a layer of the given type
+        @param type The layer type (see the SpacescapeLayerType enum)
+        @param name The layer name
+        @return the created layer or NULL if the type is unknown
+        */
+        SpacescapeLayer* createLayer(int type, const String& name);
+
+        /** Utility function to prepare layers in parallel on the thread pool
+        @remarks see SpacescapeLayer::prepare() and prepareData()
+        @param layers The layers to prepare
+        @param params The params for each layer
+        */
+        void prepareLayers(const SpacescapeLayerList& layers, const std::vector<NameValuePairList>& params);
         
+        /** Utility function to destroy and re-create all layers with their
+        current params, used when a setting the layers are built with has changed
+        */
+        void recreateLayers();
+
+        /** Utility function to save an image and its mip maps
+        @remarks Can be called from several threads at once.  Mip level 
+        conversion and block compression run in parallel, saves that go 
+        through Ogre's codecs are serialized.
+        @param img The image to save
+        @param basename The filename (and path) to save to without the extension
+        @param ext The file extension including the "."
+        */
+        void saveImage(Image& img, const String& basename, const String& ext);
+
         /** Utility function to send progress events to all listeners
         @param percentComplete Percent complete
         @param msg Task status message
@@ -259,6 +439,17 @@ namespace Ogre
         */
 		bool updateRTT(unsigned int size, SpacescapeRTTOrientation orientation = SRO_DEFAULT_ORIENTATION);
 
+        /** Utility function to write faces to a file a strip of rows at a time
+        @param filename The filename (and path) of the file to write
+        @param firstFace The first face to write
+        @param numFaces The number of faces to write - 6 for a cube map
+        @param size The size / resolution of the skybox image
+        @param renderer The software renderer to render strips with in software mode
+        @param rtt The render to texture to copy strips from otherwise
+        @return true on success
+        */
+        bool writeFaceStrips(const String& filename, unsigned int firstFace, unsigned int numFaces, unsigned int size, const SpacescapeSoftwareRenderer& renderer, TexturePtr& rtt);
+
         // layers list
         SpacescapeLayerList mLayers;
 
@@ -269,9 +460,36 @@ namespace Ogre
         SceneNode* mSceneNode;
 
         ManualObject* mDebugBox;
+
+        // noise layers generate noise on the cpu even without cpuNoise
+        bool mDefaultCPUNoise;
+
+        // block compressed format for .dds exports or PF_UNKNOWN
+        PixelFormat mExportCompression;
+
+        // block compression quality for .dds exports
+        SpacescapeBlockCompressor::Quality mExportCompressionQuality;
+
+        // generate mip maps on the cpu for exports
+        bool mExportMipmaps;
+
+        // rows streaming exports render and write at a time, 0 to write whole faces
+        unsigned int mExportStripHeight;
         
         // enable high definition rendering mode
         bool mHDREnabled;
+
+        // layer contributions kept between software renders or NULL
+        SpacescapeLayerCache* mLayerCache;
+
+        // baked noise cubes kept on disk or NULL
+        SpacescapeNoiseCache* mNoiseCache;
+
+        // random number generator the layers of the scene are built with
+        SpacescapeRandom::Generator mRandomGenerator;
+
+        // render exports on the cpu instead of the render system
+        bool mSoftwareRendering;
         
         // a unique id used for getting unique material/texture names
         unsigned int mUniqueId;
@@ -0,0 +1,91 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef __SPACESCAPEPREVIEWLOD_H__
+#define __SPACESCAPEPREVIEWLOD_H__
+
+#include "SpacescapePrerequisites.h"
+#include "SpacescapeSoftwareRenderer.h"
+
+namespace Ogre
+{
+    /** The SpacescapePreviewLOD class picks what dense point and billboard
+    layers draw in the interactive preview.
+    @remarks Stars are sorted into importance tiers by brightness and size.
+    The preview draws the brightest tiers as they are and replaces the rest
+    with impostors.  An impostor is drawn in place of one of the stars it
+    stands for at IMPOSTOR_SCALE times their size, carrying the summed light
+    of its whole group, so the preview is as bright as the full layer when 
+    blending adds up light.  Groups only hold stars of one tier and stop 
+    growing before a colour channel would go past 1, so nothing is lost to
+    8 bit vertex colours.  Stars are grouped in the order
+    the layer generated them, which is random across the sky, so on average
+    the impostors follow the density (and mask) of the layer.
+    @par Stars are returned in an order that puts the stars only the full 
+    detail version draws first, dimmest first, followed by the rest.  With
+    the impostors appended both versions are contiguous ranges: the full 
+    version is [0, count) and the preview [omitted, count + impostors).
+    */
+    class _SpacescapePluginExport SpacescapePreviewLOD
+    {
+    public:
+        // most points or billboards a layer draws in the preview
+        static const size_t PREVIEW_BUDGET = 131072;
+
+        // size of an impostor relative to the stars it stands for
+        static const unsigned int IMPOSTOR_SCALE = 2;
+
+        /** Order a point list for previewing and build its impostors
+        @param points The points
+        @param order Filled with the point indices in draw order
+        @param impostors Filled with the impostors to draw after the points
+        @return The number of points at the start of order only the full 
+        detail version draws, or 0 with order and impostors left empty when
+        the preview can draw the points as they are
+        */
+        static size_t build(const SpacescapeSoftwareRenderer::PointList& points, 
+            std::vector<uint32>& order, SpacescapeSoftwareRenderer::PointList& impostors);
+
+        /** Order a sprite list for previewing and build its impostors
+        @param sprites The sprites
+        @param hdrColours The HDR colour of each sprite
+        @param order Filled with the sprite indices in draw order
+        @param impostors Filled with the impostors to draw after the sprites
+        @param impostorHDRColours Filled with the HDR colour of each impostor
+        @return The number of sprites at the start of order only the full 
+        detail version draws, or 0 with order and impostors left empty when
+        the preview can draw the sprites as they are
+        */
+        static size_t build(const SpacescapeSoftwareRenderer::SpriteList& sprites, 
+            const std::vector<ColourValue>& hdrColours, std::vector<uint32>& order, 
+            SpacescapeSoftwareRenderer::SpriteList& impostors, std::vector<ColourValue>& impostorHDRColours);
+    };
+}
+
+#endif
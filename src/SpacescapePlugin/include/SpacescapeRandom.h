@@ -0,0 +1,158 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef __SPACESCAPERANDOM_H__
+#define __SPACESCAPERANDOM_H__
+
+#include "SpacescapePrerequisites.h"
+#include <cstdlib>
+#include <mutex>
+
+namespace Ogre
+{
+    /** The SpacescapeRandom class is a small seedable random number 
+    generator (PCG32 - permuted congruential generator) that layers use 
+    instead of srand()/rand().
+    @remarks Every generator has its own state so any number of threads 
+    can use their own generators at once and the sequence for a seed is 
+    the same on every platform and compiler.
+
+    Scenes saved before the generator was recorded in the scene file were
+    built with srand()/rand(), GENERATOR_RAND still builds them that way 
+    so they look the way they did on the platform they were made on.  
+    rand() has a single global state so GENERATOR_RAND generators take 
+    turns - each one holds a lock until it is destroyed.
+    */
+    class _SpacescapePluginExport SpacescapeRandom
+    {
+    public:
+        // the generators, scene files record which one they were made with
+        enum Generator
+        {
+            // the C library srand()/rand(), files without a generator
+            GENERATOR_RAND = 1,
+
+            // PCG32
+            GENERATOR_PCG32 = 2,
+
+            // the generator new scenes use
+            GENERATOR_CURRENT = GENERATOR_PCG32
+        };
+
+        /** Constructor
+        @param seed The seed
+        @param generator The generator to use
+        @param stream Selects one of 2^63 independent sequences for the seed
+        (PCG32 only)
+        */
+        SpacescapeRandom(uint64 seed = 0, Generator generator = GENERATOR_CURRENT, uint64 stream = 0);
+
+        /** Get the next value
+        @return a value in the range 0 .. 2^32 - 1, or 0 .. RAND_MAX with 
+        GENERATOR_RAND
+        */
+        inline uint32 next(void)
+        {
+            if(mGenerator == GENERATOR_RAND) {
+                return (uint32)rand();
+            }
+
+            uint64 old = mState;
+            mState = old * MULTIPLIER + mIncrement;
+            uint32 xorShifted = (uint32)(((old >> 18) ^ old) >> 27);
+            uint32 rot = (uint32)(old >> 59);
+            return (xorShifted >> rot) | (xorShifted << ((32 - rot) & 31));
+        }
+
+        /** Get the next value below a bound without modulo bias
+        @param bound The upper bound (exclusive), must be more than 0
+        @return a value in the range 0 .. bound - 1
+        */
+        inline uint32 nextBounded(uint32 bound)
+        {
+            if(mGenerator == GENERATOR_RAND) {
+                // biased, but it is what srand()/rand() scenes were built with
+                return (uint32)rand() % bound;
+            }
+
+            // reject the few values that would make lower results more likely
+            uint32 threshold = (0u - bound) % bound;
+            for(;;) {
+                uint32 r = next();
+                if(r >= threshold) {
+                    return r % bound;
+                }
+            }
+        }
+
+        /** Get the next value in the unit range
+        @return a value in the range 0 .. 1 (exclusive) with 24 bits of 
+        precision so it is exact as a float, or 0 .. 1 (inclusive) with 
+        GENERATOR_RAND
+        */
+        inline Real nextUnit(void)
+        {
+            if(mGenerator == GENERATOR_RAND) {
+                return (Real)(rand() / ((double) RAND_MAX));
+            }
+
+            return (Real)(next() >> 8) * (Real)(1.0 / 16777216.0);
+        }
+
+        /** Get the generator
+        @return the generator
+        */
+        Generator getGenerator(void) const { return mGenerator; }
+
+        /** Restart the sequence
+        @param seed The seed
+        @param stream Selects one of 2^63 independent sequences for the seed
+        (PCG32 only)
+        */
+        void setSeed(uint64 seed, uint64 stream = 0);
+
+    private:
+        // the LCG multiplier
+        static const uint64 MULTIPLIER = 6364136223846793005ULL;
+
+        // the generator
+        Generator mGenerator;
+
+        // the LCG increment, always odd - selects the stream
+        uint64 mIncrement;
+
+        // the lock on the global rand() state for GENERATOR_RAND
+        std::unique_lock<std::recursive_mutex> mRandLock;
+
+        // the LCG state
+        uint64 mState;
+    };
+}
+
+#endif
@@ -0,0 +1,437 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef __SPACESCAPESOFTWARERENDERER_H__
+#define __SPACESCAPESOFTWARERENDERER_H__
+
+#include "SpacescapePrerequisites.h"
+#include "SpacescapePlugin.h"
+#include "SpacescapeLayerCache.h"
+#include "SpacescapeNoiseGenerator.h"
+#include "OgreBlendMode.h"
+#include "OgreColourValue.h"
+#include "OgreImage.h"
+#include "OgrePixelFormat.h"
+#include "OgreVector3.h"
+#include <vector>
+
+namespace Ogre
+{
+    /** The SpacescapeSoftwareRenderer class is a CPU only version of the
+    render to texture done in SpacescapePlugin::_rtt.  Layers add their 
+    points, billboard sprites and noise in draw order and the renderer 
+    rasterizes them into the six cube faces with the same camera setup and
+    the same SceneBlendFactor blending the render system uses, so a 
+    skybox can be exported on a machine without a GPU.  Like the RTT the 
+    tiles carry an alpha channel that starts out at 1 and is blended with
+    the same factors, so the destination alpha blend factors see the same
+    values they would on the GPU.
+    @remarks Faces are split into square tiles that are rendered on the
+    shared thread pool.  Every tile runs through all the draw calls in 
+    order so the result doesn't depend on the number of threads.  Call 
+    prepare() once all the draw calls are added, after that any number of
+    threads can render faces or rows of faces at the same time.
+
+    Draw calls can be grouped into layers with beginLayer().  When a layer
+    cache is set, prepare() renders the contribution of every layer that
+    isn't cached yet into the cache and rendering only blends the cached 
+    layers back in, so a re-render after a layer changed only redraws that
+    layer.
+    */
+    class _SpacescapePluginExport SpacescapeSoftwareRenderer
+    {
+    public:
+        /** A point drawn as a square of pointSize pixels centred on the 
+        projected position, like the render system draws point lists
+        */
+        struct Point
+        {
+            // position on or around the unit sphere
+            Vector3 position;
+
+            // colour
+            ColourValue colour;
+        };
+
+        /** A textured billboard that faces the camera the same way an 
+        accurate facing SpacescapeBillboardSet billboard does
+        */
+        struct Sprite
+        {
+            // centre of the billboard
+            Vector3 position;
+
+            // billboard width
+            Real width;
+
+            // billboard height
+            Real height;
+
+            // colour the texture is multiplied with
+            ColourValue colour;
+        };
+
+        typedef std::vector<Point> PointList;
+        typedef std::vector<Sprite> SpriteList;
+
+        /** Constructor
+        @param orientation Orientation mode for non-Ogre skybox orientations
+        @param clamp Clamp colours to 0..1 after every draw like an 8 bit 
+        render target does - turn off for HDR
+        */
+        SpacescapeSoftwareRenderer(SpacescapePlugin::SpacescapeRTTOrientation orientation = SpacescapePlugin::SRO_DEFAULT_ORIENTATION, bool clamp = true);
+
+        /** Destructor
+        */
+        ~SpacescapeSoftwareRenderer(void);
+
+        /** Add a draw call that covers every pixel with noise
+        @param permutations The 512 entry permutation table (see SpacescapeLayer::initNoise)
+        @param params The noise settings
+        @param sourceFactor Source blend factor
+        @param destFactor Destination blend factor
+        */
+        void addNoise(const uchar* permutations, const SpacescapeNoiseParams& params, SceneBlendFactor sourceFactor, SceneBlendFactor destFactor);
+
+        /** Add a draw call for a list of points
+        @param points The points to draw
+        @param pointSize The point size in pixels
+        @param sourceFactor Source blend factor
+        @param destFactor Destination blend factor
+        */
+        void addPoints(const PointList& points, unsigned int pointSize, SceneBlendFactor sourceFactor, SceneBlendFactor destFactor);
+
+        /** Add a draw call for a list of billboard sprites
+        @param sprites The sprites to draw
+        @param texture The sprite texture or NULL to draw untextured sprites
+        @param mipmaps Sample from a mipmap chain like a texture loaded 
+        with mipmaps does, otherwise only the full size image is used
+        @param sourceFactor Source blend factor
+        @param destFactor Destination blend factor
+        */
+        void addSprites(const SpriteList& sprites, const Image* texture, bool mipmaps, SceneBlendFactor sourceFactor, SceneBlendFactor destFactor);
+
+        /** Start a new layer - the draw calls added after this belong to it
+        @remarks A layer blends into the colour below it as offset + scale *
+        colour (per channel, alpha included) when none of its draw calls 
+        use a destination blend factor that depends on the destination 
+        colour or alpha, or a source blend factor that depends on the 
+        destination alpha.  That is what lets the layer cache store it on 
+        its own.  Layers that don't are always 
+        drawn.  With clamping on, each layer is clamped as a whole instead 
+        of after every draw, which gives the same result unless draws inside
+        a layer take a pixel outside 0..1 and back again.
+        @param key Everything the layer's pixels depend on (i.e. its params)
+        - the face size, orientation and clamping are added by the renderer
+        */
+        void beginLayer(const String& key);
+
+        /** Get the axes of a cube face the same way the RTT camera sees it
+        @remarks The face directions are linear in u and v so the 
+        direction through u,v is forward + right * u + down * v
+        @param face The cube face (0 - 5)
+        @param orientation Orientation mode for non-Ogre skybox orientations
+        @param forward Set to the direction through the face center
+        @param right Set to the step in direction for u going from 0 to 1
+        @param down Set to the step in direction for v going from 0 to 1
+        */
+        static void getFaceBasis(unsigned int face, SpacescapePlugin::SpacescapeRTTOrientation orientation,
+            Vector3& forward, Vector3& right, Vector3& down);
+
+        /** Get the view direction through a cube face position the same
+        way the RTT camera sees it for the given orientation
+        @param face The cube face (0 - 5)
+        @param u Horizontal position on the face in the range -1..1
+        @param v Vertical position on the face in the range -1..1 (top to bottom)
+        @param orientation Orientation mode for non-Ogre skybox orientations
+        @return the direction (not normalised)
+        */
+        static Vector3 getFaceDirection(unsigned int face, Real u, Real v, SpacescapePlugin::SpacescapeRTTOrientation orientation);
+
+        /** Set the cache layer contributions are kept in between renders
+        @remarks must be called before prepare().  The cache only keeps the
+        layers of the last render that used it.
+        @param cache The cache or NULL to draw every layer
+        */
+        void setLayerCache(SpacescapeLayerCache* cache) { mLayerCache = cache; }
+
+        /** Project and sort all the draw calls into face tiles
+        @remarks must be called after the last draw call is added and 
+        before rendering
+        @param size The width/height of each face
+        */
+        void prepare(unsigned int size);
+
+        /** Prepare and render all six faces using the shared thread pool
+        @param size The width/height of each face
+        @param faces Array of six pixel boxes to write to, in any pixel format
+        */
+        void renderCube(unsigned int size, const PixelBox* faces);
+
+        /** Render a whole face using the shared thread pool
+        @param face The cube face (0 - 5)
+        @param dest The pixel box to write to, in any pixel format
+        */
+        void renderFace(unsigned int face, const PixelBox& dest) const;
+
+        /** Render a range of rows of a face using the shared thread pool
+        @param face The cube face (0 - 5)
+        @param rowStart The first row to render
+        @param rowEnd One past the last row to render
+        @param dest The pixel box for just these rows to write to, in any pixel format
+        */
+        void renderFaceRows(unsigned int face, unsigned int rowStart, unsigned int rowEnd, const PixelBox& dest) const;
+
+    private:
+        // draw call types
+        enum DrawType
+        {
+            DT_NOISE = 0,
+            DT_POINTS,
+            DT_SPRITES
+        };
+
+        /** A single mipmap level of a sprite texture
+        */
+        struct TextureLevel
+        {
+            // level width
+            unsigned int width;
+
+            // level height
+            unsigned int height;
+
+            // RGBA colours
+            std::vector<float> data;
+        };
+
+        /** A layer worth of primitives with its blend settings
+        */
+        struct DrawCall
+        {
+            // what this draw call draws
+            DrawType type;
+
+            // source blend factor
+            SceneBlendFactor sourceFactor;
+
+            // destination blend factor
+            SceneBlendFactor destFactor;
+
+            // noise generator for noise draw calls
+            SpacescapeNoiseGenerator* generator;
+
+            // points for point draw calls
+            PointList points;
+
+            // point size in pixels
+            unsigned int pointSize;
+
+            // sprites for sprite draw calls
+            SpriteList sprites;
+
+            // sprite texture mipmap chain - empty when untextured
+            std::vector<TextureLevel> texture;
+
+            // start of each tile's primitives in binIndices (one more than
+            // the number of tiles)
+            std::vector<uint32> binOffsets[6];
+
+            // primitive indices sorted by tile
+            std::vector<uint32> binIndices[6];
+        };
+
+        /** A group of draw calls that can be cached together
+        */
+        struct Layer
+        {
+            // everything the layer's pixels depend on
+            String key;
+
+            // index of the first draw call of the layer
+            size_t firstCall;
+
+            // cached contribution, NULL when the layer is drawn
+            const SpacescapeLayerCache::Entry* cached;
+        };
+
+        /** Sort the primitives of a draw call into the tiles of a face
+        @param call The draw call
+        @param face The cube face (0 - 5)
+        */
+        void binPrimitives(DrawCall* call, unsigned int face);
+
+        /** Blend a colour into a pixel
+        @param dest The RGBA pixel to blend into, or the RGBA offset followed
+        by the RGBA scale of an affine pixel
+        @param src The colour to blend
+        @param call The draw call with the blend factors
+        @param affine Blend into an affine pixel
+        */
+        void blend(float* dest, const ColourValue& src, const DrawCall* call, bool affine) const;
+
+        /** Blend a cached layer into a tile
+        @param entry The cached layer
+        @param face The cube face (0 - 5)
+        @param tile The pixels to draw
+        @param buffer The RGBA tile buffer
+        */
+        void blendCachedLayer(const SpacescapeLayerCache::Entry* entry, unsigned int face, const Box& tile, float* buffer) const;
+
+        /** Draw a range of draw calls into a tile
+        @param firstCall The first draw call
+        @param lastCall One past the last draw call
+        @param face The cube face (0 - 5)
+        @param tile The pixels to draw
+        @param buffer The tile buffer
+        @param affine The buffer holds affine pixels (see blend)
+        */
+        void drawCalls(size_t firstCall, size_t lastCall, unsigned int face, const Box& tile, float* buffer, bool affine) const;
+
+        /** Draw the noise of a draw call into a tile
+        @param call The draw call
+        @param face The cube face (0 - 5)
+        @param tile The pixels to draw
+        @param buffer The tile buffer
+        @param affine The buffer holds affine pixels (see blend)
+        */
+        void drawNoise(const DrawCall* call, unsigned int face, const Box& tile, float* buffer, bool affine) const;
+
+        /** Draw the points of a draw call into a tile
+        @param call The draw call
+        @param face The cube face (0 - 5)
+        @param tile The pixels to draw
+        @param buffer The tile buffer
+        @param affine The buffer holds affine pixels (see blend)
+        */
+        void drawPoints(const DrawCall* call, unsigned int face, const Box& tile, float* buffer, bool affine) const;
+
+        /** Draw the sprites of a draw call into a tile
+        @param call The draw call
+        @param face The cube face (0 - 5)
+        @param tile The pixels to draw
+        @param buffer The tile buffer
+        @param affine The buffer holds affine pixels (see blend)
+        */
+        void drawSprites(const DrawCall* call, unsigned int face, const Box& tile, float* buffer, bool affine) const;
+
+        /** Get the index one past the last draw call of a layer
+        @param layer The layer index
+        @return the draw call index
+        */
+        size_t getLayerEnd(size_t layer) const;
+
+        /** Get the pixels a point covers on a face
+        @param point The point
+        @param pointSize The point size in pixels
+        @param face The cube face (0 - 5)
+        @param bounds Return param
+        @return false if the point isn't drawn on this face
+        */
+        bool getPointBounds(const Point& point, unsigned int pointSize, unsigned int face, Box& bounds) const;
+
+        /** Get the billboard axes and the pixels a sprite covers on a face
+        @param sprite The sprite
+        @param face The cube face (0 - 5)
+        @param axisX Return param - the billboard x axis
+        @param axisY Return param - the billboard y axis
+        @param bounds Return param
+        @return false if the sprite isn't drawn on this face
+        */
+        bool getSpriteBounds(const Sprite& sprite, unsigned int face, Vector3& axisX, Vector3& axisY, Box& bounds) const;
+
+        /** Split a range of rows into tiles that each sit inside a single
+        bin so every primitive is drawn once per pixel
+        @param rowStart The first row
+        @param rowEnd One past the last row
+        @param tiles The list to add the tiles to
+        */
+        void getTiles(unsigned int rowStart, unsigned int rowEnd, std::vector<Box>& tiles) const;
+
+        /** Check whether a layer blends as offset + scale * colour
+        @param layer The layer index
+        @return true if the layer can be cached
+        */
+        bool isLayerAffine(size_t layer) const;
+
+        /** Render the contribution of a layer to all six faces
+        @param layer The layer index
+        @return the new cache entry
+        */
+        SpacescapeLayerCache::Entry* renderLayer(size_t layer) const;
+
+        /** Render a tile and write it to the destination
+        @param face The cube face (0 - 5)
+        @param tile The pixels to render
+        @param rowStart The face row the first row of dest holds
+        @param dest The pixel box to write to
+        */
+        void renderTile(unsigned int face, const Box& tile, unsigned int rowStart, const PixelBox& dest) const;
+
+        /** Sample a sprite texture with bilinear filtering and wrapping
+        @param level The mipmap level to sample
+        @param u Horizontal texture coordinate
+        @param v Vertical texture coordinate
+        @return the texture colour
+        */
+        static ColourValue sampleTexture(const TextureLevel& level, Real u, Real v);
+
+        // clamp colours to 0..1 like an 8 bit render target
+        bool mClamp;
+
+        // draw calls in draw order
+        std::vector<DrawCall*> mDrawCalls;
+
+        // view direction through the centre of each face
+        Vector3 mFaceForward[6];
+
+        // direction the face u axis runs along
+        Vector3 mFaceRight[6];
+
+        // direction the face v axis runs along (top to bottom)
+        Vector3 mFaceDown[6];
+
+        // cache for layer contributions or NULL
+        SpacescapeLayerCache* mLayerCache;
+
+        // draw call layers in draw order
+        std::vector<Layer> mLayers;
+
+        // orientation mode
+        SpacescapePlugin::SpacescapeRTTOrientation mOrientation;
+
+        // face width/height the draw calls were prepared for
+        unsigned int mSize;
+
+        // number of bins across a face
+        unsigned int mTilesPerSide;
+    };
+}
+
+#endif
@@ -0,0 +1,222 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef __SPACESCAPESTARCATALOG_H__
+#define __SPACESCAPESTARCATALOG_H__
+
+#include "SpacescapePrerequisites.h"
+#include "SpacescapeMappedFile.h"
+#include "OgreMath.h"
+#include "OgreVector3.h"
+
+namespace Ogre
+{
+    /** The SpacescapeStarCatalog class holds the stars billboard layers 
+    can be built from, one column per star property.
+    @remarks Catalogs are read from HYG style CSV files or from the binary
+    catalog format save() writes.  Binary catalogs are a small header 
+    followed by each column as a tightly packed little endian float array,
+    and are memory mapped so the columns are used straight from the file 
+    without any parsing.  Saved catalogs are also indexed - the stars are
+    grouped into a grid of cells on each cube face and sorted brightest 
+    first inside every cell - so getStars() only visits the cells of the
+    requested sky region and stops each cell at the limiting magnitude.
+    */
+    class _SpacescapePluginExport SpacescapeStarCatalog
+    {
+    public:
+        /** The star properties
+        */
+        enum Column
+        {
+            // position x
+            SC_X = 0,
+
+            // position y
+            SC_Y,
+
+            // position z
+            SC_Z,
+
+            // B-V colour index, optional
+            SC_BV,
+
+            // absolute magnitude
+            SC_ABSMAG,
+
+            // distance in parsecs
+            SC_DISTANCE,
+
+            SC_NUM_COLUMNS
+        };
+
+        /** Constructor
+        */
+        SpacescapeStarCatalog(void);
+
+        /** Free the stars
+        */
+        void clear(void);
+
+        /** Get the apparent magnitude of a star
+        @param star The star
+        @return the apparent magnitude, minus infinity for stars closer 
+        than 0.1 parsecs
+        */
+        Real getApparentMagnitude(size_t star) const;
+
+        /** Get the values of a star property
+        @param column The property
+        @return one value per star or NULL if the catalog doesn't have the
+        property
+        */
+        const float* getColumn(Column column) const { return mColumns[column]; }
+
+        /** Get the number of stars
+        @return the number of stars
+        */
+        size_t getNumStars(void) const { return mNumStars; }
+
+        /** Get the stars at least as bright as a magnitude within a region
+        of the sky
+        @remarks Indexed catalogs only visit the cells that overlap the 
+        region and stop each cell at the first star that's too faint, 
+        otherwise every star is tested.
+        @param magnitudeLimit The faintest apparent magnitude to include
+        @param direction The centre of the region
+        @param radius The angular radius of the region, PI or more for the 
+        whole sky
+        @param stars Filled with the matching stars
+        */
+        void getStars(Real magnitudeLimit, const Vector3& direction, const Radian& radius, 
+            std::vector<uint32>& stars) const;
+
+        /** Get whether the catalog is indexed
+        @return true if the catalog is indexed
+        */
+        bool hasIndex(void) const { return mCells != 0; }
+
+        /** Load a catalog, binary or CSV
+        @param filename The catalog file
+        @return true on success, false on error
+        */
+        bool load(const String& filename);
+
+        /** Load a binary catalog
+        @param filename The catalog file
+        @return true on success, false on error
+        */
+        bool loadBinary(const String& filename);
+
+        /** Load a CSV catalog
+        @remarks The first line names the columns, x, y, z, absmag and 
+        distance are required and bv (or colorIndex) is optional.  Quotes
+        aren't handled.  The file is mapped and split into chunks of whole
+        lines that are parsed on the thread pool straight into the columns.
+        @param filename The catalog file
+        @return true on success, false on error
+        */
+        bool loadCSV(const String& filename);
+
+        /** Save the catalog in the binary format
+        @remarks The saved catalog is indexed, so its stars are in a 
+        different order than this catalog's
+        @param filename The file to write
+        @return true on success, false on error
+        */
+        bool save(const String& filename) const;
+
+    private:
+        /** Get the index cell a direction falls in
+        @param direction The direction
+        @param gridSize The number of cells along each cube face edge
+        @return the cell
+        */
+        static uint32 getCell(const Vector3& direction, uint32 gridSize);
+
+        /** Get the direction through a point on a cube face
+        @param face The cube face
+        @param u The horizontal face position, -1 to 1
+        @param v The vertical face position, -1 to 1
+        @return the normalised direction
+        */
+        static Vector3 getFaceDirection(uint32 face, Real u, Real v);
+
+        /** Parse the rows of a CSV catalog
+        @remarks Rows with fewer than minFields fields are skipped.
+        @param begin The start of the first row
+        @param end The end of the last row
+        @param fieldColumns The catalog column of each CSV field or -1
+        @param numFields The number of entries in fieldColumns
+        @param minFields The number of fields a row needs
+        @param columns Where to write each column or NULL to skip it
+        @return the number of rows written
+        */
+        static size_t parseCSVRows(const char* begin, const char* end, 
+            const int* fieldColumns, size_t numFields, size_t minFields, float* const* columns);
+
+        /** Parse a number from a CSV field
+        @remarks Handles an optional sign, digits, a fraction and an exponent
+        without the locale lookups and allocations of StringConverter.  Like
+        StringConverter::parseReal anything that isn't a number is 0.  Numbers
+        with more significant digits or a bigger exponent than a double can 
+        scale exactly fall back to a stream in the classic locale, so the 
+        result always matches strtod.
+        @param begin The start of the field
+        @param end The end of the field
+        @return the number
+        */
+        static float parseFloat(const char* begin, const char* end);
+
+        // no copies - columns may point into the mapped file
+        SpacescapeStarCatalog(const SpacescapeStarCatalog&);
+        SpacescapeStarCatalog& operator=(const SpacescapeStarCatalog&);
+
+        // the values of each property or NULL, in mData or in mFile
+        const float* mColumns[SC_NUM_COLUMNS];
+
+        // the values of each property when not mapped
+        std::vector<float> mData[SC_NUM_COLUMNS];
+
+        // the first star of each index cell followed by the number of 
+        // stars, in mFile, or NULL if the catalog isn't indexed
+        const uint64* mCells;
+
+        // the mapped binary catalog
+        SpacescapeMappedFile mFile;
+
+        // the number of index cells along each cube face edge
+        uint32 mGridSize;
+
+        // the number of stars
+        size_t mNumStars;
+    };
+}
+
+#endif
@@ -0,0 +1,182 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef __SPACESCAPESTRIPWRITER_H__
+#define __SPACESCAPESTRIPWRITER_H__
+
+#include "SpacescapePrerequisites.h"
+#include "SpacescapeBlockCompressor.h"
+#include "OgrePixelFormat.h"
+#include <fstream>
+#include <vector>
+
+namespace Ogre
+{
+    /** The SpacescapeStripWriter class writes skybox images to disk a strip
+    of rows at a time so exports don't need to hold a whole face in memory.
+    @remarks Only formats that can be written without compressing the whole
+    image at once are supported: .dds (single faces or cube maps, optionally
+    with mipmaps, uncompressed or block compressed), Radiance .hdr, .pfm and
+    .tga.  Rows must be written top to bottom, level after level, face after
+    face, in the pixel format returned by getFormat().
+    */
+    class _SpacescapePluginExport SpacescapeStripWriter
+    {
+    public:
+        /** Constructor
+        */
+        SpacescapeStripWriter(void);
+
+        /** Destructor
+        @remarks closes the file if it is still open
+        */
+        ~SpacescapeStripWriter(void);
+
+        /** Finish writing and close the file
+        @return true if all the rows were written
+        */
+        bool close(void);
+
+        /** Get the pixel format rows must be written in
+        @return the pixel format
+        */
+        PixelFormat getFormat(void) const { return mFormat; }
+
+        /** Check whether a file type can be written a strip at a time
+        @param extension The file extension including the dot (i.e. ".dds")
+        @param numFaces The number of faces the file will hold
+        @return true if supported
+        */
+        static bool isSupported(const String& extension, unsigned int numFaces = 1);
+
+        /** Create the file and write its header
+        @param filename The filename (and path) of the file to write
+        @param size The width/height of each face
+        @param numFaces The number of faces - 6 for a .dds cube map, otherwise 1
+        @param hdr Write floating point colours when the file type supports it
+        @param numMipmaps The number of mip levels after level 0 (.dds only)
+        @return true on success
+        */
+        bool open(const String& filename, unsigned int size, unsigned int numFaces, bool hdr, unsigned int numMipmaps = 0);
+
+        /** Set the block compression for .dds files
+        @remarks must be called before open().  Rows are compressed a row of
+        blocks at a time as they are written.
+        @param format The compressed pixel format (see SpacescapeBlockCompressor)
+        or PF_UNKNOWN to write uncompressed files
+        @param quality The compression quality
+        */
+        void setCompression(PixelFormat format, SpacescapeBlockCompressor::Quality quality = SpacescapeBlockCompressor::BCQ_NORMAL);
+
+        /** Write the next rows of the image
+        @param rows The rows to write - must be in getFormat() with no 
+        padding between rows and can't run past the end of a mip level
+        @return true on success
+        */
+        bool writeRows(const PixelBox& rows);
+
+    private:
+        // file types that can be streamed
+        enum FileType
+        {
+            FT_DDS = 0,
+            FT_HDR,
+            FT_PFM,
+            FT_TGA
+        };
+
+        /** Utility function to get the file type for an extension
+        @param extension The file extension including the dot
+        @param type Return param
+        @return false if the extension isn't supported
+        */
+        static bool getFileType(const String& extension, FileType& type);
+
+        /** Utility function to get the mip level the next row belongs to
+        @param rowsLeft Return param - rows left in that level
+        @return the width/height of the level
+        */
+        unsigned int getCurrentLevelSize(size_t& rowsLeft) const;
+
+        /** Utility function to get the number of rows in a face including
+        its mipmaps
+        @return the number of rows
+        */
+        size_t getRowsPerFace(void) const;
+
+        /** Utility function to write a Radiance RGBE scanline, run length
+        encoded when the width allows it
+        @param row The RGB float row
+        */
+        void writeRGBERow(const float* row);
+
+        /** Utility function to write a little endian 32 bit value
+        @param value The value to write
+        */
+        void writeUInt32(uint32 value);
+
+        // block compressed format for .dds files or PF_UNKNOWN
+        PixelFormat mCompression;
+
+        // block compression quality
+        SpacescapeBlockCompressor::Quality mCompressionQuality;
+
+        // the output file
+        std::ofstream mFile;
+
+        // the file type being written
+        FileType mFileType;
+
+        // pixel format rows are written in
+        PixelFormat mFormat;
+
+        // number of faces in the file
+        unsigned int mNumFaces;
+
+        // number of mip levels after level 0
+        unsigned int mNumMipmaps;
+
+        // number of rows waiting for the rest of their blocks
+        size_t mNumPendingRows;
+
+        // rows waiting for the rest of their blocks
+        std::vector<uchar> mPendingRows;
+
+        // number of rows (of all faces) written so far
+        size_t mRowsWritten;
+
+        // RGBE scanline scratch buffer for .hdr files
+        std::vector<uchar> mScanline;
+
+        // face width/height
+        unsigned int mSize;
+    };
+}
+
+#endif
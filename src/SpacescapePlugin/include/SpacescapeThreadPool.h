@@ -0,0 +1,203 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef __SPACESCAPETHREADPOOL_H__
+#define __SPACESCAPETHREADPOOL_H__
+
+#include "SpacescapePrerequisites.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Ogre
+{
+    /** The SpacescapeThreadPool class is a small work stealing thread pool
+    used by the CPU side generators (noise, geometry, export).  Every worker
+    owns a task queue, pops work from the front of its own queue and steals
+    from the back of the other queues when it runs dry so uneven tasks (like
+    cube face tiles of varying cost) balance themselves across all cores.
+    */
+    class _SpacescapePluginExport SpacescapeThreadPool
+    {
+    public:
+        typedef std::function<void(void)> Task;
+
+        /** The TaskGroup class queues tasks on a thread pool one at a time
+        and waits for them all together, so the calling thread can keep 
+        producing work (like reading back the next cube face) while the 
+        earlier tasks run
+        */
+        class _SpacescapePluginExport TaskGroup
+        {
+        public:
+            /** Constructor
+            @param pool The thread pool to run the tasks on
+            */
+            TaskGroup(SpacescapeThreadPool& pool);
+
+            /** Destructor
+            @remarks waits for any tasks still running, exceptions they 
+            throw are dropped
+            */
+            ~TaskGroup(void);
+
+            /** Queue a task
+            @param task The task to run
+            */
+            void run(const Task& task);
+
+            /** Wait for all the queued tasks to complete
+            @remarks The calling thread helps out with the work.  If any of 
+            the tasks throw, the first exception is rethrown here once all 
+            the tasks are done.
+            */
+            void wait(void);
+
+        private:
+            friend class SpacescapeThreadPool;
+
+            // completion state shared with the tasks - the last task may 
+            // still be signalling after the waiter has seen the count reach zero
+            struct State
+            {
+                std::atomic<size_t> remaining;
+                std::exception_ptr error;
+                std::mutex mutex;
+                std::condition_variable done;
+            };
+
+            /** Utility function to queue a task without waking the workers
+            @param task The task to run
+            */
+            void add(const Task& task);
+
+            // the pool the tasks run on
+            SpacescapeThreadPool& mPool;
+
+            // shared completion state
+            std::shared_ptr<State> mState;
+        };
+
+        /** Constructor
+        @param numThreads The number of worker threads to create, use 0
+        to create one worker per hardware thread
+        */
+        SpacescapeThreadPool(unsigned int numThreads = 0);
+
+        /** Destructor
+        @remarks waits for all queued tasks to finish
+        */
+        ~SpacescapeThreadPool(void);
+
+        /** Get the shared thread pool (created on first use)
+        @return the shared thread pool
+        */
+        static SpacescapeThreadPool& getSingleton(void);
+
+        /** Destroy the shared thread pool if it was created
+        @remarks called when the plugin is uninstalled so the worker threads
+        are joined before the library is unloaded
+        */
+        static void destroySingleton(void);
+
+        /** Get the number of worker threads
+        @return the number of worker threads
+        */
+        unsigned int getNumThreads(void) const { return (unsigned int)mThreads.size(); }
+
+        /** Run a function for every index in the range 0..count-1 and wait
+        for all of them to complete
+        @remarks The calling thread helps out with the work so it is safe to
+        call this from inside another task.  If any of the calls throw, the
+        first exception is rethrown here once all the calls are done.
+        @param count The number of indices
+        @param func The function to call for every index
+        */
+        void parallelFor(size_t count, const std::function<void(size_t)>& func);
+
+    private:
+        // a single worker task queue
+        struct WorkQueue
+        {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        /** Utility function to get a task to run, first from the given
+        queue then by stealing from the other queues
+        @param index The index of the queue to check first
+        @param task Return param
+        @return true if a task was found
+        */
+        bool popTask(unsigned int index, Task& task);
+
+        /** Utility function to add a task to the next queue
+        @param task The task to add
+        */
+        void pushTask(const Task& task);
+
+        /** Utility function to wake up the idle workers after tasks were added
+        */
+        void wakeWorkers(void);
+
+        /** Worker thread main loop
+        @param index The index of this worker's queue
+        */
+        void workerThread(unsigned int index);
+
+        // index of the queue the next task gets added to
+        std::atomic<unsigned int> mNextQueue;
+
+        // number of queued tasks that haven't been picked up yet
+        std::atomic<size_t> mNumQueuedTasks;
+
+        // one task queue per worker
+        std::vector<WorkQueue*> mQueues;
+
+        // set when the pool is shutting down
+        bool mShutdown;
+
+        // worker threads
+        std::vector<std::thread> mThreads;
+
+        // idle workers wait on this for new tasks
+        std::condition_variable mWakeCondition;
+
+        // mutex for the wake condition
+        std::mutex mWakeMutex;
+    };
+}
+
+#endif
@@ -65,7 +65,7 @@ namespace Ogre {
     void SpacescapeBillboard::setRotation(const Radian& rotation)
     {
         mRotation = rotation;
-        if (mRotation != Radian(0))
+        if (mRotation != Radian(0) && mParentSet)
             mParentSet->_notifyBillboardRotated();
     }
     //-----------------------------------------------------------------------
@@ -91,7 +91,8 @@ namespace Ogre {
         mOwnDimensions = true;
         mWidth = width;
         mHeight = height;
-        mParentSet->_notifyBillboardResized();
+        if (mParentSet)
+            mParentSet->_notifyBillboardResized();
     }
     //-----------------------------------------------------------------------
     bool SpacescapeBillboard::hasOwnDimensions(void) const
@@ -0,0 +1,330 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include "SpacescapeBillboardKernels.h"
+#include "SpacescapeNoiseKernels.h"
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#   define SPACESCAPE_BILLBOARD_X86
+#   include <immintrin.h>
+#   if defined(_MSC_VER)
+#       define SPACESCAPE_TARGET(x)
+#   else
+#       define SPACESCAPE_TARGET(x) __attribute__((target(x)))
+#   endif
+#endif
+
+namespace Ogre
+{
+    // above this the up vector is too close to the billboard direction
+    // to build a stable quad from (see SpacescapeBillboardSet::genBillboardAxes)
+    static const float FIXED_UP_LIMIT = 0.99f;
+
+    /** Utility function to build the quad of a single billboard
+    @param params The camera and origin settings
+    @param x Array of billboard x positions
+    @param y Array of billboard y positions
+    @param z Array of billboard z positions
+    @param width Array of billboard widths
+    @param height Array of billboard heights
+    @param corners Array of corner positions
+    @param stride Distance between the corner arrays
+    @param i Index of the billboard
+    */
+    static inline void genFacingQuad(const SpacescapeBillboardKernels::FacingParams& params, const float* x, const float* y, const float* z,
+        const float* width, const float* height, float* corners, size_t stride, size_t i)
+    {
+        // cam -> billboard direction
+        float dx = x[i] - params.camPos.x;
+        float dy = y[i] - params.camPos.y;
+        float dz = z[i] - params.camPos.z;
+        float len = std::sqrt(dx * dx + dy * dy + dz * dz);
+        if(len > 0.0f) {
+            float inv = 1.0f / len;
+            dx *= inv;
+            dy *= inv;
+            dz *= inv;
+        }
+
+        float ux = params.camUp.x, uy = params.camUp.y, uz = params.camUp.z;
+        if(params.fixedUp && std::fabs(dx * ux + dy * uy + dz * uz) > FIXED_UP_LIMIT) {
+            ux = 0.0f;
+            uy = 0.0f;
+            uz = 1.0f;
+        }
+
+        // x axis is direction cross up
+        float xx = dy * uz - dz * uy;
+        float xy = dz * ux - dx * uz;
+        float xz = dx * uy - dy * ux;
+        len = std::sqrt(xx * xx + xy * xy + xz * xz);
+        if(len > 0.0f) {
+            float inv = 1.0f / len;
+            xx *= inv;
+            xy *= inv;
+            xz *= inv;
+        }
+
+        // y axis is x axis cross direction
+        float yx = xy * dz - xz * dy;
+        float yy = xz * dx - xx * dz;
+        float yz = xx * dy - xy * dx;
+
+        float left = params.left * width[i];
+        float right = params.right * width[i];
+        float top = params.top * height[i];
+        float bottom = params.bottom * height[i];
+
+        float lx = xx * left, ly = xy * left, lz = xz * left;
+        float rx = xx * right, ry = xy * right, rz = xz * right;
+        float tx = yx * top, ty = yy * top, tz = yz * top;
+        float bx = yx * bottom, by = yy * bottom, bz = yz * bottom;
+
+        float* c = corners + i;
+        c[0 * stride] = (lx + tx) + x[i];
+        c[1 * stride] = (ly + ty) + y[i];
+        c[2 * stride] = (lz + tz) + z[i];
+        c[3 * stride] = (rx + tx) + x[i];
+        c[4 * stride] = (ry + ty) + y[i];
+        c[5 * stride] = (rz + tz) + z[i];
+        c[6 * stride] = (lx + bx) + x[i];
+        c[7 * stride] = (ly + by) + y[i];
+        c[8 * stride] = (lz + bz) + z[i];
+        c[9 * stride] = (rx + bx) + x[i];
+        c[10 * stride] = (ry + by) + y[i];
+        c[11 * stride] = (rz + bz) + z[i];
+    }
+
+#if defined(SPACESCAPE_BILLBOARD_X86)
+    /*
+     * SSE4.1 - 4 billboards at a time
+     */
+    SPACESCAPE_TARGET("sse4.1") static inline void normalise4(__m128& x, __m128& y, __m128& z)
+    {
+        // vectors of zero length are left alone like Vector3::normalise
+        __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+        __m128 valid = _mm_cmpgt_ps(len, _mm_setzero_ps());
+        __m128 inv = _mm_div_ps(_mm_set1_ps(1.0f), len);
+        x = _mm_blendv_ps(x, _mm_mul_ps(x, inv), valid);
+        y = _mm_blendv_ps(y, _mm_mul_ps(y, inv), valid);
+        z = _mm_blendv_ps(z, _mm_mul_ps(z, inv), valid);
+    }
+
+    SPACESCAPE_TARGET("sse4.1") static void genFacingQuadsSSE41(const SpacescapeBillboardKernels::FacingParams& params, const float* px, const float* py, const float* pz,
+        const float* width, const float* height, float* corners, size_t count)
+    {
+        const __m128 camX = _mm_set1_ps(params.camPos.x), camY = _mm_set1_ps(params.camPos.y), camZ = _mm_set1_ps(params.camPos.z);
+        const __m128 upX = _mm_set1_ps(params.camUp.x), upY = _mm_set1_ps(params.camUp.y), upZ = _mm_set1_ps(params.camUp.z);
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        const __m128 limit = _mm_set1_ps(FIXED_UP_LIMIT);
+        const __m128 left = _mm_set1_ps(params.left), right = _mm_set1_ps(params.right);
+        const __m128 top = _mm_set1_ps(params.top), bottom = _mm_set1_ps(params.bottom);
+
+        size_t i = 0;
+        for(; i + 4 <= count; i += 4) {
+            __m128 x = _mm_loadu_ps(px + i), y = _mm_loadu_ps(py + i), z = _mm_loadu_ps(pz + i);
+
+            // cam -> billboard direction
+            __m128 dx = _mm_sub_ps(x, camX), dy = _mm_sub_ps(y, camY), dz = _mm_sub_ps(z, camZ);
+            normalise4(dx, dy, dz);
+
+            __m128 ux = upX, uy = upY, uz = upZ;
+            if(params.fixedUp) {
+                __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, ux), _mm_mul_ps(dy, uy)), _mm_mul_ps(dz, uz));
+                __m128 fixed = _mm_cmpgt_ps(_mm_andnot_ps(signMask, d), limit);
+                ux = _mm_blendv_ps(ux, _mm_setzero_ps(), fixed);
+                uy = _mm_blendv_ps(uy, _mm_setzero_ps(), fixed);
+                uz = _mm_blendv_ps(uz, _mm_set1_ps(1.0f), fixed);
+            }
+
+            // x axis is direction cross up
+            __m128 xx = _mm_sub_ps(_mm_mul_ps(dy, uz), _mm_mul_ps(dz, uy));
+            __m128 xy = _mm_sub_ps(_mm_mul_ps(dz, ux), _mm_mul_ps(dx, uz));
+            __m128 xz = _mm_sub_ps(_mm_mul_ps(dx, uy), _mm_mul_ps(dy, ux));
+            normalise4(xx, xy, xz);
+
+            // y axis is x axis cross direction
+            __m128 yx = _mm_sub_ps(_mm_mul_ps(xy, dz), _mm_mul_ps(xz, dy));
+            __m128 yy = _mm_sub_ps(_mm_mul_ps(xz, dx), _mm_mul_ps(xx, dz));
+            __m128 yz = _mm_sub_ps(_mm_mul_ps(xx, dy), _mm_mul_ps(xy, dx));
+
+            __m128 w = _mm_loadu_ps(width + i), h = _mm_loadu_ps(height + i);
+            __m128 l = _mm_mul_ps(left, w), r = _mm_mul_ps(right, w);
+            __m128 t = _mm_mul_ps(top, h), b = _mm_mul_ps(bottom, h);
+
+            __m128 lx = _mm_mul_ps(xx, l), ly = _mm_mul_ps(xy, l), lz = _mm_mul_ps(xz, l);
+            __m128 rx = _mm_mul_ps(xx, r), ry = _mm_mul_ps(xy, r), rz = _mm_mul_ps(xz, r);
+            __m128 tx = _mm_mul_ps(yx, t), ty = _mm_mul_ps(yy, t), tz = _mm_mul_ps(yz, t);
+            __m128 bx = _mm_mul_ps(yx, b), by = _mm_mul_ps(yy, b), bz = _mm_mul_ps(yz, b);
+
+            float* c = corners + i;
+            _mm_storeu_ps(c + 0 * count, _mm_add_ps(_mm_add_ps(lx, tx), x));
+            _mm_storeu_ps(c + 1 * count, _mm_add_ps(_mm_add_ps(ly, ty), y));
+            _mm_storeu_ps(c + 2 * count, _mm_add_ps(_mm_add_ps(lz, tz), z));
+            _mm_storeu_ps(c + 3 * count, _mm_add_ps(_mm_add_ps(rx, tx), x));
+            _mm_storeu_ps(c + 4 * count, _mm_add_ps(_mm_add_ps(ry, ty), y));
+            _mm_storeu_ps(c + 5 * count, _mm_add_ps(_mm_add_ps(rz, tz), z));
+            _mm_storeu_ps(c + 6 * count, _mm_add_ps(_mm_add_ps(lx, bx), x));
+            _mm_storeu_ps(c + 7 * count, _mm_add_ps(_mm_add_ps(ly, by), y));
+            _mm_storeu_ps(c + 8 * count, _mm_add_ps(_mm_add_ps(lz, bz), z));
+            _mm_storeu_ps(c + 9 * count, _mm_add_ps(_mm_add_ps(rx, bx), x));
+            _mm_storeu_ps(c + 10 * count, _mm_add_ps(_mm_add_ps(ry, by), y));
+            _mm_storeu_ps(c + 11 * count, _mm_add_ps(_mm_add_ps(rz, bz), z));
+        }
+
+        for(; i < count; ++i) {
+            genFacingQuad(params, px, py, pz, width, height, corners, count, i);
+        }
+    }
+
+    /*
+     * AVX2 - 8 billboards at a time
+     */
+    SPACESCAPE_TARGET("avx2") static inline void normalise8(__m256& x, __m256& y, __m256& z)
+    {
+        // vectors of zero length are left alone like Vector3::normalise
+        __m256 len = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z)));
+        __m256 valid = _mm256_cmp_ps(len, _mm256_setzero_ps(), _CMP_GT_OQ);
+        __m256 inv = _mm256_div_ps(_mm256_set1_ps(1.0f), len);
+        x = _mm256_blendv_ps(x, _mm256_mul_ps(x, inv), valid);
+        y = _mm256_blendv_ps(y, _mm256_mul_ps(y, inv), valid);
+        z = _mm256_blendv_ps(z, _mm256_mul_ps(z, inv), valid);
+    }
+
+    SPACESCAPE_TARGET("avx2") static void genFacingQuadsAVX2(const SpacescapeBillboardKernels::FacingParams& params, const float* px, const float* py, const float* pz,
+        const float* width, const float* height, float* corners, size_t count)
+    {
+        const __m256 camX = _mm256_set1_ps(params.camPos.x), camY = _mm256_set1_ps(params.camPos.y), camZ = _mm256_set1_ps(params.camPos.z);
+        const __m256 upX = _mm256_set1_ps(params.camUp.x), upY = _mm256_set1_ps(params.camUp.y), upZ = _mm256_set1_ps(params.camUp.z);
+        const __m256 signMask = _mm256_set1_ps(-0.0f);
+        const __m256 limit = _mm256_set1_ps(FIXED_UP_LIMIT);
+        const __m256 left = _mm256_set1_ps(params.left), right = _mm256_set1_ps(params.right);
+        const __m256 top = _mm256_set1_ps(params.top), bottom = _mm256_set1_ps(params.bottom);
+
+        size_t i = 0;
+        for(; i + 8 <= count; i += 8) {
+            __m256 x = _mm256_loadu_ps(px + i), y = _mm256_loadu_ps(py + i), z = _mm256_loadu_ps(pz + i);
+
+            // cam -> billboard direction
+            __m256 dx = _mm256_sub_ps(x, camX), dy = _mm256_sub_ps(y, camY), dz = _mm256_sub_ps(z, camZ);
+            normalise8(dx, dy, dz);
+
+            __m256 ux = upX, uy = upY, uz = upZ;
+            if(params.fixedUp) {
+                __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, ux), _mm256_mul_ps(dy, uy)), _mm256_mul_ps(dz, uz));
+                __m256 fixed = _mm256_cmp_ps(_mm256_andnot_ps(signMask, d), limit, _CMP_GT_OQ);
+                ux = _mm256_blendv_ps(ux, _mm256_setzero_ps(), fixed);
+                uy = _mm256_blendv_ps(uy, _mm256_setzero_ps(), fixed);
+                uz = _mm256_blendv_ps(uz, _mm256_set1_ps(1.0f), fixed);
+            }
+
+            // x axis is direction cross up
+            __m256 xx = _mm256_sub_ps(_mm256_mul_ps(dy, uz), _mm256_mul_ps(dz, uy));
+            __m256 xy = _mm256_sub_ps(_mm256_mul_ps(dz, ux), _mm256_mul_ps(dx, uz));
+            __m256 xz = _mm256_sub_ps(_mm256_mul_ps(dx, uy), _mm256_mul_ps(dy, ux));
+            normalise8(xx, xy, xz);
+
+            // y axis is x axis cross direction
+            __m256 yx = _mm256_sub_ps(_mm256_mul_ps(xy, dz), _mm256_mul_ps(xz, dy));
+            __m256 yy = _mm256_sub_ps(_mm256_mul_ps(xz, dx), _mm256_mul_ps(xx, dz));
+            __m256 yz = _mm256_sub_ps(_mm256_mul_ps(xx, dy), _mm256_mul_ps(xy, dx));
+
+            __m256 w = _mm256_loadu_ps(width + i), h = _mm256_loadu_ps(height + i);
+            __m256 l = _mm256_mul_ps(left, w), r = _mm256_mul_ps(right, w);
+            __m256 t = _mm256_mul_ps(top, h), b = _mm256_mul_ps(bottom, h);
+
+            __m256 lx = _mm256_mul_ps(xx, l), ly = _mm256_mul_ps(xy, l), lz = _mm256_mul_ps(xz, l);
+            __m256 rx = _mm256_mul_ps(xx, r), ry = _mm256_mul_ps(xy, r), rz = _mm256_mul_ps(xz, r);
+            __m256 tx = _mm256_mul_ps(yx, t), ty = _mm256_mul_ps(yy, t), tz = _mm256_mul_ps(yz, t);
+            __m256 bx = _mm256_mul_ps(yx, b), by = _mm256_mul_ps(yy, b), bz = _mm256_mul_ps(yz, b);
+
+            float* c = corners + i;
+            _mm256_storeu_ps(c + 0 * count, _mm256_add_ps(_mm256_add_ps(lx, tx), x));
+            _mm256_storeu_ps(c + 1 * count, _mm256_add_ps(_mm256_add_ps(ly, ty), y));
+            _mm256_storeu_ps(c + 2 * count, _mm256_add_ps(_mm256_add_ps(lz, tz), z));
+            _mm256_storeu_ps(c + 3 * count, _mm256_add_ps(_mm256_add_ps(rx, tx), x));
+            _mm256_storeu_ps(c + 4 * count, _mm256_add_ps(_mm256_add_ps(ry, ty), y));
+            _mm256_storeu_ps(c + 5 * count, _mm256_add_ps(_mm256_add_ps(rz, tz), z));
+            _mm256_storeu_ps(c + 6 * count, _mm256_add_ps(_mm256_add_ps(lx, bx), x));
+            _mm256_storeu_ps(c + 7 * count, _mm256_add_ps(_mm256_add_ps(ly, by), y));
+            _mm256_storeu_ps(c + 8 * count, _mm256_add_ps(_mm256_add_ps(lz, bz), z));
+            _mm256_storeu_ps(c + 9 * count, _mm256_add_ps(_mm256_add_ps(rx, bx), x));
+            _mm256_storeu_ps(c + 10 * count, _mm256_add_ps(_mm256_add_ps(ry, by), y));
+            _mm256_storeu_ps(c + 11 * count, _mm256_add_ps(_mm256_add_ps(rz, bz), z));
+        }
+
+        for(; i < count; ++i) {
+            genFacingQuad(params, px, py, pz, width, height, corners, count, i);
+        }
+    }
+#endif
+
+    /** Build accurate facing quads for an array of point billboards
+    @param params The camera and origin settings
+    @param x Array of billboard x positions
+    @param y Array of billboard y positions
+    @param z Array of billboard z positions
+    @param width Array of billboard widths
+    @param height Array of billboard heights
+    @param corners Array of 12 * count floats the corner positions are
+    written to, corner c axis a of billboard i is at (c * 3 + a) * count + i
+    with corners in left-top, right-top, left-bottom, right-bottom order
+    @param count Number of billboards
+    */
+    void SpacescapeBillboardKernels::genFacingQuads(const FacingParams& params, const float* x, const float* y, const float* z,
+        const float* width, const float* height, float* corners, size_t count)
+    {
+        switch(SpacescapeNoiseKernels::getInstructionSet()) {
+#if defined(SPACESCAPE_BILLBOARD_X86)
+            case SpacescapeNoiseKernels::SIS_AVX512:
+            case SpacescapeNoiseKernels::SIS_AVX2:
+                genFacingQuadsAVX2(params, x, y, z, width, height, corners, count);
+                break;
+            case SpacescapeNoiseKernels::SIS_SSE41:
+                genFacingQuadsSSE41(params, x, y, z, width, height, corners, count);
+                break;
+#endif
+            default:
+                genFacingQuadsScalar(params, x, y, z, width, height, corners, count);
+                break;
+        }
+    }
+
+    /** Scalar reference version of genFacingQuads
+    @see genFacingQuads
+    */
+    void SpacescapeBillboardKernels::genFacingQuadsScalar(const FacingParams& params, const float* x, const float* y, const float* z,
+        const float* width, const float* height, float* corners, size_t count)
+    {
+        for(size_t i = 0; i < count; ++i) {
+            genFacingQuad(params, x, y, z, width, height, corners, count, i);
+        }
+    }
+}
@@ -29,8 +29,12 @@
 
 #include "SpacescapeBillboard.h"
 #include "SpacescapeBillboardSet.h"
+#include "SpacescapeBillboardKernels.h"
+#include "SpacescapeThreadPool.h"
 
 #include "OgreMaterialManager.h"
+#include "OgreTechnique.h"
+#include "OgrePass.h"
 #include "OgreHardwareBuffer.h"
 #include "OgreHardwareBufferManager.h"
 #include "OgreCamera.h"
@@ -41,13 +45,17 @@
 #include "OgreException.h"
 #include "OgreSceneNode.h"
 #include "OgreLogManager.h"
+#include "OgreVector4.h"
 #include <algorithm>
 
 #define EXR_SUPPORT
 
 namespace Ogre {
     // Init statics
-    RadixSort<SpacescapeBillboardSet::SpacescapeActiveBillboardList, SpacescapeBillboard*, float> SpacescapeBillboardSet::mRadixSorter;
+    RadixSort<SpacescapeBillboardSet::SpacescapeBillboardIndexList, uint32, float> SpacescapeBillboardSet::mRadixSorter;
+    const size_t SpacescapeBillboardSet::INVALID_BILLBOARD;
+    const size_t SpacescapeBillboardSet::CUSTOM_CAMERA_POSITION;
+    const size_t SpacescapeBillboardSet::CUSTOM_CAMERA_UP;
     
     //-----------------------------------------------------------------------
     SpacescapeBillboardSet::SpacescapeBillboardSet() :
@@ -71,7 +79,12 @@ namespace Ogre {
     mPoolSize(0),
     mExternalData(false),
     mAutoUpdate(true),
-    mBillboardDataChanged(true)
+    mBillboardDataChanged(true),
+    mStaticGeometry(false),
+    mInstancingEnabled(false),
+    mInstanced(false),
+    mRangeStart(0),
+    mRangeCount(~static_cast<size_t>(0))
     {
         setDefaultDimensions( 100, 100 );
         setMaterialName( "BaseWhite" );
@@ -102,10 +115,15 @@ namespace Ogre {
     mCommonUpVector(Vector3::UNIT_Y),
     mPointRendering(false),
     mBuffersCreated(false),
-    mPoolSize(poolSize),
+    mPoolSize(0),
     mExternalData(externalData),
     mAutoUpdate(true),
-    mBillboardDataChanged(true)
+    mBillboardDataChanged(true),
+    mStaticGeometry(false),
+    mInstancingEnabled(false),
+    mInstanced(false),
+    mRangeStart(0),
+    mRangeCount(~static_cast<size_t>(0))
     {
         setDefaultDimensions( 100, 100 );
         setMaterialName( "BaseWhite" );
@@ -116,44 +134,39 @@ namespace Ogre {
     //-----------------------------------------------------------------------
     SpacescapeBillboardSet::~SpacescapeBillboardSet()
     {
-        // Free pool items
-        SpacescapeBillboardPool::iterator i;
-        for (i = mBillboardPool.begin(); i != mBillboardPool.end(); ++i)
-        {
-            OGRE_DELETE *i;
-        }
-        
         // Delete shared buffers
         _destroyBuffers();
     }
     //-----------------------------------------------------------------------
-    SpacescapeBillboard* SpacescapeBillboardSet::createBillboard(
+    size_t SpacescapeBillboardSet::createBillboard(
                                          const Vector3& position,
                                          const ColourValue& colour)
     {
-        if( mFreeBillboards.empty() )
+        if( mPositions.size() >= mPoolSize )
         {
             if( mAutoExtendPool )
             {
-                setPoolSize( getPoolSize() * 2 );
+                setPoolSize( std::max<size_t>( getPoolSize() * 2, 1 ) );
             }
             else
             {
-                return 0;
+                return INVALID_BILLBOARD;
             }
         }
         
-        // Get a new billboard
-        SpacescapeBillboard* newBill = mFreeBillboards.front();
-        mActiveBillboards.splice(
-                                 mActiveBillboards.end(), mFreeBillboards, mFreeBillboards.begin());
-        newBill->setPosition(position);
-        newBill->setColour(colour);
-        newBill->mDirection = Vector3::ZERO;
-        newBill->setRotation(Radian(0));
-        newBill->setTexcoordIndex(0);
-        newBill->resetDimensions();
-        newBill->_notifyOwner(this);
+        // Append the new billboard to the arrays, the pool is already reserved
+        size_t index = mPositions.size();
+        mPositions.push_back(position);
+        mDirections.push_back(Vector3::ZERO);
+        mWidths.push_back(mDefaultWidth);
+        mHeights.push_back(mDefaultHeight);
+        mOwnDimensions.push_back(0);
+        mColours.push_back(colour);
+        mHDRColours.push_back(ColourValue::White);
+        mRotations.push_back(Radian(0));
+        mTexcoordIndices.push_back(0);
+        mTexcoordRects.push_back(FloatRect());
+        mUseTexcoordRects.push_back(0);
         
         // Merge into bounds
         Real adjust = std::max(mDefaultWidth, mDefaultHeight);
@@ -166,11 +179,11 @@ namespace Ogre {
         
         mBoundingRadius = Math::boundingRadiusFromAABB(mAABB);
         
-        return newBill;
+        return index;
     }
     
     //-----------------------------------------------------------------------
-    SpacescapeBillboard* SpacescapeBillboardSet::createBillboard(
+    size_t SpacescapeBillboardSet::createBillboard(
                                              Real x, Real y, Real z,
                                              const ColourValue& colour )
     {
@@ -180,84 +193,180 @@ namespace Ogre {
     //-----------------------------------------------------------------------
     int SpacescapeBillboardSet::getNumBillboards(void) const
     {
-        return static_cast< int >( mActiveBillboards.size() );
+        return static_cast< int >( mPositions.size() );
     }
     
     //-----------------------------------------------------------------------
     void SpacescapeBillboardSet::clear()
     {
-        // Move actives to free list
-        mFreeBillboards.splice(mFreeBillboards.end(), mActiveBillboards);
+        // Empty the arrays but keep their memory for the next billboards
+        mPositions.clear();
+        mDirections.clear();
+        mWidths.clear();
+        mHeights.clear();
+        mOwnDimensions.clear();
+        mColours.clear();
+        mHDRColours.clear();
+        mRotations.clear();
+        mTexcoordIndices.clear();
+        mTexcoordRects.clear();
+        mUseTexcoordRects.clear();
+        mSortedBillboards.clear();
+        mSortKeys.clear();
+        
+        mBillboardDataChanged = true;
     }
     
     //-----------------------------------------------------------------------
-    SpacescapeBillboard* SpacescapeBillboardSet::getBillboard( unsigned int index ) const
+    SpacescapeBillboard SpacescapeBillboardSet::getBillboard( size_t index ) const
     {
         assert(
-               index < mActiveBillboards.size() &&
+               index < mPositions.size() &&
                "Billboard index out of bounds." );
         
-        /* We can't access it directly, so we check whether it's in the first
-         or the second half, then we start either from the beginning or the
-         end of the list
-         */
-        SpacescapeActiveBillboardList::const_iterator it;
-        if( index >= ( mActiveBillboards.size() >> 1 ) )
-        {
-            index = static_cast<unsigned int>(mActiveBillboards.size()) - index;
-            for( it = mActiveBillboards.end(); index; --index, --it );
-        }
-        else
-        {
-            for( it = mActiveBillboards.begin(); index; --index, ++it );
-        }
+        SpacescapeBillboard bb(mPositions[index], 0, mColours[index]);
+        bb.mDirection = mDirections[index];
+        bb.mRotation = mRotations[index];
+        bb.mHDRColour = mHDRColours[index];
+        bb.mOwnDimensions = mOwnDimensions[index] != 0;
+        bb.mWidth = mWidths[index];
+        bb.mHeight = mHeights[index];
+        bb.mTexcoordIndex = mTexcoordIndices[index];
+        bb.mTexcoordRect = mTexcoordRects[index];
+        bb.mUseTexcoordRect = mUseTexcoordRects[index] != 0;
         
-        return *it;
+        return bb;
     }
     
     //-----------------------------------------------------------------------
-    void SpacescapeBillboardSet::removeBillboard(unsigned int index)
+    void SpacescapeBillboardSet::setBillboard( size_t index, const SpacescapeBillboard& bb )
     {
         assert(
-               index < mActiveBillboards.size() &&
+               index < mPositions.size() &&
                "Billboard index out of bounds." );
         
-        /* We can't access it directly, so we check whether it's in the first
-         or the second half, then we start either from the beginning or the
-         end of the list.
-         We then remove the billboard form the 'used' list and add it to
-         the 'free' list.
-         */
-        SpacescapeActiveBillboardList::iterator it;
-        if( index >= ( mActiveBillboards.size() >> 1 ) )
-        {
-            index = static_cast<unsigned int>(mActiveBillboards.size()) - index;
-            for( it = mActiveBillboards.end(); index; --index, --it );
-        }
-        else
+        mPositions[index] = bb.mPosition;
+        mDirections[index] = bb.mDirection;
+        mColours[index] = bb.mColour;
+        mHDRColours[index] = bb.mHDRColour;
+        mTexcoordIndices[index] = bb.mTexcoordIndex;
+        mTexcoordRects[index] = bb.mTexcoordRect;
+        mUseTexcoordRects[index] = bb.mUseTexcoordRect;
+        
+        mRotations[index] = bb.mRotation;
+        if (bb.mRotation != Radian(0))
+            _notifyBillboardRotated();
+        
+        mOwnDimensions[index] = bb.mOwnDimensions;
+        if (bb.mOwnDimensions)
         {
-            for( it = mActiveBillboards.begin(); index; --index, ++it );
+            mWidths[index] = bb.mWidth;
+            mHeights[index] = bb.mHeight;
+            _notifyBillboardResized();
         }
         
-        mFreeBillboards.splice(mFreeBillboards.end(), mActiveBillboards, it);
+        mBillboardDataChanged = true;
+    }
+    
+    //-----------------------------------------------------------------------
+    void SpacescapeBillboardSet::setBillboardColour( size_t index, const ColourValue& colour )
+    {
+        assert(
+               index < mPositions.size() &&
+               "Billboard index out of bounds." );
+        
+        mColours[index] = colour;
+        mBillboardDataChanged = true;
+    }
+    
+    //-----------------------------------------------------------------------
+    void SpacescapeBillboardSet::setBillboardDimensions( size_t index, Real width, Real height )
+    {
+        assert(
+               index < mPositions.size() &&
+               "Billboard index out of bounds." );
+        
+        mOwnDimensions[index] = 1;
+        mWidths[index] = width;
+        mHeights[index] = height;
+        _notifyBillboardResized();
+        mBillboardDataChanged = true;
     }
     
     //-----------------------------------------------------------------------
-    void SpacescapeBillboardSet::removeBillboard( Ogre::SpacescapeBillboard* pBill )
+    void SpacescapeBillboardSet::setBillboardHDRColour( size_t index, const ColourValue& colour )
     {
-        SpacescapeActiveBillboardList::iterator it =
-        std::find(mActiveBillboards.begin(), mActiveBillboards.end(), pBill);
         assert(
-               it != mActiveBillboards.end() &&
-               "Billboard isn't in the active list." );
+               index < mPositions.size() &&
+               "Billboard index out of bounds." );
         
-        mFreeBillboards.splice(mFreeBillboards.end(), mActiveBillboards, it);
+        mHDRColours[index] = colour;
+        mBillboardDataChanged = true;
+    }
+    
+    //-----------------------------------------------------------------------
+    void SpacescapeBillboardSet::setBillboardPosition( size_t index, const Vector3& position )
+    {
+        assert(
+               index < mPositions.size() &&
+               "Billboard index out of bounds." );
+        
+        mPositions[index] = position;
+        mBillboardDataChanged = true;
+    }
+    
+    //-----------------------------------------------------------------------
+    void SpacescapeBillboardSet::removeBillboard( size_t index )
+    {
+        assert(
+               index < mPositions.size() &&
+               "Billboard index out of bounds." );
+        
+        /* Move the last billboard into the removed slot so removal
+         doesn't have to shift the rest of the arrays
+         */
+        size_t last = mPositions.size() - 1;
+        if (index != last)
+        {
+            mPositions[index] = mPositions[last];
+            mDirections[index] = mDirections[last];
+            mWidths[index] = mWidths[last];
+            mHeights[index] = mHeights[last];
+            mOwnDimensions[index] = mOwnDimensions[last];
+            mColours[index] = mColours[last];
+            mHDRColours[index] = mHDRColours[last];
+            mRotations[index] = mRotations[last];
+            mTexcoordIndices[index] = mTexcoordIndices[last];
+            mTexcoordRects[index] = mTexcoordRects[last];
+            mUseTexcoordRects[index] = mUseTexcoordRects[last];
+        }
+        
+        mPositions.pop_back();
+        mDirections.pop_back();
+        mWidths.pop_back();
+        mHeights.pop_back();
+        mOwnDimensions.pop_back();
+        mColours.pop_back();
+        mHDRColours.pop_back();
+        mRotations.pop_back();
+        mTexcoordIndices.pop_back();
+        mTexcoordRects.pop_back();
+        mUseTexcoordRects.pop_back();
+        
+        mBillboardDataChanged = true;
     }
     
     //-----------------------------------------------------------------------
     void SpacescapeBillboardSet::setBillboardOrigin( BillboardOrigin origin )
     {
-        mOriginType = origin;
+        if (origin != mOriginType)
+        {
+            mOriginType = origin;
+            mBillboardDataChanged = true;
+            // the instanced quad holds the origin offsets
+            if (mInstanced)
+                _destroyBuffers();
+        }
     }
     
     //-----------------------------------------------------------------------
@@ -270,6 +379,7 @@ namespace Ogre {
     void SpacescapeBillboardSet::setBillboardRotationType(BillboardRotationType rotationType)
     {
         mRotationType = rotationType;
+        mBillboardDataChanged = true;
     }
     //-----------------------------------------------------------------------
     BillboardRotationType SpacescapeBillboardSet::getBillboardRotationType(void) const
@@ -281,11 +391,13 @@ namespace Ogre {
     {
         mDefaultWidth = width;
         mDefaultHeight = height;
+        mBillboardDataChanged = true;
     }
     //-----------------------------------------------------------------------
     void SpacescapeBillboardSet::setDefaultWidth(Real width)
     {
         mDefaultWidth = width;
+        mBillboardDataChanged = true;
     }
     //-----------------------------------------------------------------------
     Real SpacescapeBillboardSet::getDefaultWidth(void) const
@@ -296,6 +408,7 @@ namespace Ogre {
     void SpacescapeBillboardSet::setDefaultHeight(Real height)
     {
         mDefaultHeight = height;
+        mBillboardDataChanged = true;
     }
     //-----------------------------------------------------------------------
     Real SpacescapeBillboardSet::getDefaultHeight(void) const
@@ -325,35 +438,104 @@ namespace Ogre {
         return mMaterialName;
     }
     
+    //-----------------------------------------------------------------------
+    /** Insertion sort a billboard order that is nearly sorted already
+    @param order The billboard order
+    @param keys Storage for the sort keys
+    @param func The sort functor
+    @return false if the order changed too much to fix up cheaply, the
+    order is left partly sorted
+    */
+    template<typename Functor>
+    static bool fixupBillboardOrder(vector<uint32>::type& order, vector<float>::type& keys, const Functor& func)
+    {
+        size_t count = order.size();
+        keys.resize(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            keys[i] = func(order[i]);
+        }
+        
+        // give up once the moves would cost more than a radix sort
+        size_t budget = count * 4;
+        for (size_t i = 1; i < count; ++i)
+        {
+            float key = keys[i];
+            uint32 index = order[i];
+            size_t j = i;
+            while (j > 0 && keys[j - 1] > key)
+            {
+                keys[j] = keys[j - 1];
+                order[j] = order[j - 1];
+                --j;
+                
+                if (--budget == 0)
+                {
+                    keys[j] = key;
+                    order[j] = index;
+                    return false;
+                }
+            }
+            keys[j] = key;
+            order[j] = index;
+        }
+        return true;
+    }
     //-----------------------------------------------------------------------
     void SpacescapeBillboardSet::_sortBillboards( Camera* cam)
     {
+        // Sort indices rather than moving the billboard data around.
+        // The order stays a permutation of the drawn billboard indices 
+        // until billboards are added or removed or the range changes
+        size_t rangeStart, numBillboards;
+        _getBillboardRange(rangeStart, numBillboards);
+        bool fixup = mSortedBillboards.size() == numBillboards;
+        if (!fixup)
+        {
+            mSortedBillboards.resize(numBillboards);
+            for (size_t i = 0; i < mSortedBillboards.size(); ++i)
+            {
+                mSortedBillboards[i] = static_cast<uint32>(rangeStart + i);
+            }
+        }
+        
+        if (mSortedBillboards.empty())
+            return;
+        
         switch (_getSortMode())
         {
             case SM_DIRECTION:
-                mRadixSorter.sort(mActiveBillboards, SortByDirectionFunctor(-mCamDir));
+            {
+                SortByDirectionFunctor func(-mCamDir, &mPositions[0]);
+                if (!fixup || !fixupBillboardOrder(mSortedBillboards, mSortKeys, func))
+                    mRadixSorter.sort(mSortedBillboards, func);
                 break;
+            }
             case SM_DISTANCE:
-                mRadixSorter.sort(mActiveBillboards, SortByDistanceFunctor(mCamPos));
+            {
+                SortByDistanceFunctor func(mCamPos, &mPositions[0]);
+                if (!fixup || !fixupBillboardOrder(mSortedBillboards, mSortKeys, func))
+                    mRadixSorter.sort(mSortedBillboards, func);
                 break;
+            }
         }
     }
-    SpacescapeBillboardSet::SortByDirectionFunctor::SortByDirectionFunctor(const Vector3& dir)
-    : sortDir(dir)
+    SpacescapeBillboardSet::SortByDirectionFunctor::SortByDirectionFunctor(const Vector3& dir, const Vector3* pos)
+    : sortDir(dir), positions(pos)
     {
     }
-    float SpacescapeBillboardSet::SortByDirectionFunctor::operator()(SpacescapeBillboard* bill) const
+    float SpacescapeBillboardSet::SortByDirectionFunctor::operator()(uint32 index) const
     {
-        return sortDir.dotProduct(bill->getPosition());
+        return sortDir.dotProduct(positions[index]);
     }
-    SpacescapeBillboardSet::SortByDistanceFunctor::SortByDistanceFunctor(const Vector3& pos)
-    : sortPos(pos)
+    SpacescapeBillboardSet::SortByDistanceFunctor::SortByDistanceFunctor(const Vector3& pos, const Vector3* positions)
+    : sortPos(pos), positions(positions)
     {
     }
-    float SpacescapeBillboardSet::SortByDistanceFunctor::operator()(SpacescapeBillboard* bill) const
+    float SpacescapeBillboardSet::SortByDistanceFunctor::operator()(uint32 index) const
     {
         // Sort descending by squared distance
-        return - (sortPos - bill->getPosition()).squaredLength();
+        return - (sortPos - positions[index]).squaredLength();
     }
     //-----------------------------------------------------------------------
     SortMode SpacescapeBillboardSet::_getSortMode(void) const
@@ -371,6 +553,59 @@ namespace Ogre {
         }
     }
     //-----------------------------------------------------------------------
+    /** Utility function, returns true if a blend equation gives the same
+    result whatever order the billboards are drawn in
+    @param op The blend operation
+    @param source The source blend factor
+    @param dest The destination blend factor
+    */
+    static bool isBlendOrderIndependent(SceneBlendOperation op, SceneBlendFactor source, SceneBlendFactor dest)
+    {
+        // min and max ignore the factors
+        if (op == SBO_MIN || op == SBO_MAX)
+            return true;
+        
+        bool sourceUsesDest = source == SBF_DEST_COLOUR || source == SBF_ONE_MINUS_DEST_COLOUR ||
+            source == SBF_DEST_ALPHA || source == SBF_ONE_MINUS_DEST_ALPHA;
+        
+        // dest + src * factor and dest - src * factor just sum up the billboards
+        if ((op == SBO_ADD || op == SBO_REVERSE_SUBTRACT) && dest == SBF_ONE && !sourceUsesDest)
+            return true;
+        
+        // dest * src multiplies them up
+        return op == SBO_ADD &&
+            ((source == SBF_DEST_COLOUR && dest == SBF_ZERO) ||
+             (source == SBF_ZERO && dest == SBF_SOURCE_COLOUR));
+    }
+    //-----------------------------------------------------------------------
+    bool SpacescapeBillboardSet::isBlendingOrderIndependent(void) const
+    {
+        Technique* technique = mMaterial.isNull() ? 0 : mMaterial->getBestTechnique();
+        if (!technique)
+            return false;
+        
+        for (unsigned short i = 0; i < technique->getNumPasses(); ++i)
+        {
+            const Pass* pass = technique->getPass(i);
+            
+            // billboards hiding each other depend on the order too
+            if (pass->getDepthWriteEnabled() && pass->getDepthCheckEnabled())
+                return false;
+            
+            if (!isBlendOrderIndependent(pass->getSceneBlendingOperation(),
+                                         pass->getSourceBlendFactor(), pass->getDestBlendFactor()))
+                return false;
+            
+            if (pass->hasSeparateSceneBlending() || pass->hasSeparateSceneBlendingOperations())
+            {
+                if (!isBlendOrderIndependent(pass->getSceneBlendingOperationAlpha(),
+                                             pass->getSourceBlendFactorAlpha(), pass->getDestBlendFactorAlpha()))
+                    return false;
+            }
+        }
+        return true;
+    }
+    //-----------------------------------------------------------------------
     void SpacescapeBillboardSet::_notifyCurrentCamera( Camera* cam )
     {
         MovableObject::_notifyCurrentCamera(cam);
@@ -420,6 +655,15 @@ namespace Ogre {
         if(!mBuffersCreated)
             _createBuffers();
         
+        // static geometry is built for a camera at the origin, facing each
+        // billboard with a fixed up vector
+        if (mStaticGeometry)
+        {
+            mCamQ = Quaternion::IDENTITY;
+            mCamPos = Vector3::ZERO;
+            mCamDir = Vector3::NEGATIVE_UNIT_Z;
+        }
+        
         // Only calculate vertex offets et al if we're not point rendering
         if (!mPointRendering)
         {
@@ -454,9 +698,10 @@ namespace Ogre {
 			numBillboards = std::min(mPoolSize, numBillboards);
             
 			size_t billboardSize;
-			if (mPointRendering)
+			if (mPointRendering || mInstanced)
 			{
-				// just one vertex per billboard (this also excludes texcoords)
+				// just one vertex per billboard (this also excludes texcoords),
+				// or one instance
 				billboardSize = mMainBuf->getVertexSize();
 			}
 			else
@@ -479,12 +724,195 @@ namespace Ogre {
     }
     //-----------------------------------------------------------------------
     void SpacescapeBillboardSet::injectBillboard(const SpacescapeBillboard& bb)
+    {
+        // Texcoords
+        assert( bb.mUseTexcoordRect || bb.mTexcoordIndex < mTextureCoords.size() );
+        const Ogre::FloatRect & r =
+        bb.mUseTexcoordRect ? bb.mTexcoordRect : mTextureCoords[bb.mTexcoordIndex];
+        
+        injectBillboard(bb.mPosition, bb.mDirection, bb.mOwnDimensions, bb.mWidth, bb.mHeight,
+                        bb.mColour, bb.mHDRColour, bb.mRotation, r);
+    }
+    //-----------------------------------------------------------------------
+    void SpacescapeBillboardSet::injectActiveBillboard(size_t index)
+    {
+        // Texcoords
+        assert( mUseTexcoordRects[index] || mTexcoordIndices[index] < mTextureCoords.size() );
+        const Ogre::FloatRect & r = mUseTexcoordRects[index] ?
+        mTexcoordRects[index] : mTextureCoords[mTexcoordIndices[index]];
+        
+        injectBillboard(mPositions[index], mDirections[index], mOwnDimensions[index] != 0,
+                        mWidths[index], mHeights[index], mColours[index], mHDRColours[index],
+                        mRotations[index], r);
+    }
+    //-----------------------------------------------------------------------
+    bool SpacescapeBillboardSet::canInjectFacingBillboards(void) const
+    {
+        // every billboard must be visible so each one has a fixed place
+        // in the vertex buffer
+        return !mPointRendering &&
+            mBillboardType == BBT_POINT &&
+            mAccurateFacing &&
+            mAllDefaultRotation &&
+            (mStaticGeometry || !mCullIndividual) &&
+            mPositions.size() <= mPoolSize;
+    }
+    //-----------------------------------------------------------------------
+    void SpacescapeBillboardSet::injectFacingBillboards(const uint32* order, size_t rangeStart, size_t numBillboards)
+    {
+        // billboards per task, and per kernel call within a task
+        static const size_t CHUNK_SIZE = 4096;
+        static const size_t BATCH_SIZE = 256;
+        
+        SpacescapeBillboardKernels::FacingParams params;
+        params.camPos = mCamPos;
+        params.camUp = mCamQ * Vector3::UNIT_Y;
+        params.fixedUp = mStaticGeometry;
+        params.left = mLeftOff;
+        params.right = mRightOff;
+        params.top = mTopOff;
+        params.bottom = mBottomOff;
+        
+        VertexElementType colourType = Root::getSingleton().getRenderSystem()->getColourVertexElementType();
+        size_t vertexSize = mMainBuf->getVertexSize();
+        uchar* vertices = static_cast<uchar*>(static_cast<void*>(mLockPtr));
+        size_t numChunks = (numBillboards + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        
+        SpacescapeThreadPool::getSingleton().parallelFor(numChunks, [&](size_t chunk) {
+            float x[BATCH_SIZE], y[BATCH_SIZE], z[BATCH_SIZE];
+            float width[BATCH_SIZE], height[BATCH_SIZE];
+            float corners[12 * BATCH_SIZE];
+            
+            size_t chunkEnd = std::min(chunk * CHUNK_SIZE + CHUNK_SIZE, numBillboards);
+            for (size_t first = chunk * CHUNK_SIZE; first < chunkEnd; first += BATCH_SIZE)
+            {
+                size_t count = std::min(BATCH_SIZE, chunkEnd - first);
+                
+                // Gather the batch, sizes default unless set per billboard
+                for (size_t i = 0; i < count; ++i)
+                {
+                    size_t index = order ? order[first + i] : rangeStart + first + i;
+                    x[i] = mPositions[index].x;
+                    y[i] = mPositions[index].y;
+                    z[i] = mPositions[index].z;
+                    bool own = !mAllDefaultSize && mOwnDimensions[index];
+                    width[i] = own ? mWidths[index] : mDefaultWidth;
+                    height[i] = own ? mHeights[index] : mDefaultHeight;
+                }
+                
+                SpacescapeBillboardKernels::genFacingQuads(params, x, y, z, width, height, corners, count);
+                
+                // Write the vertices in order, same layout as genVertices
+                float* pVert = static_cast<float*>(static_cast<void*>(vertices + first * 4 * vertexSize));
+                for (size_t i = 0; i < count; ++i)
+                {
+                    size_t index = order ? order[first + i] : rangeStart + first + i;
+                    RGBA colour = VertexElement::convertColourValue(mColours[index], colourType);
+                    const ColourValue& hdrColour = mHDRColours[index];
+                    const Ogre::FloatRect & r = mUseTexcoordRects[index] ?
+                    mTexcoordRects[index] : mTextureCoords[mTexcoordIndices[index]];
+                    
+                    for (size_t corner = 0; corner < 4; ++corner)
+                    {
+                        // Positions
+                        *pVert++ = corners[(corner * 3 + 0) * count + i];
+                        *pVert++ = corners[(corner * 3 + 1) * count + i];
+                        *pVert++ = corners[(corner * 3 + 2) * count + i];
+#ifdef EXR_SUPPORT
+                        // Normal
+                        *pVert++ = hdrColour.r;
+                        *pVert++ = hdrColour.g;
+                        *pVert++ = hdrColour.b;
+#endif
+                        // Colour
+                        *static_cast<RGBA*>(static_cast<void*>(pVert++)) = colour;
+                        // Texture coords
+                        *pVert++ = corner & 1 ? r.right : r.left;
+                        *pVert++ = corner & 2 ? r.bottom : r.top;
+                    }
+                }
+            }
+        });
+        
+        mLockPtr = static_cast<float*>(static_cast<void*>(vertices + numBillboards * 4 * vertexSize));
+        mNumVisibleBillboards = numBillboards;
+    }
+    //-----------------------------------------------------------------------
+    bool SpacescapeBillboardSet::canInstance(void) const
+    {
+        // the vertex program only builds accurate facing quads
+        return mInstancingEnabled &&
+            !mExternalData &&
+            canInjectFacingBillboards() &&
+            isInstancingSupported();
+    }
+    //-----------------------------------------------------------------------
+    void SpacescapeBillboardSet::injectInstances(const uint32* order, size_t rangeStart, size_t numBillboards)
+    {
+        // billboards per task
+        static const size_t CHUNK_SIZE = 4096;
+        
+        VertexElementType colourType = Root::getSingleton().getRenderSystem()->getColourVertexElementType();
+        size_t instanceSize = mMainBuf->getVertexSize();
+        uchar* instances = static_cast<uchar*>(static_cast<void*>(mLockPtr));
+        size_t numChunks = (numBillboards + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        
+        SpacescapeThreadPool::getSingleton().parallelFor(numChunks, [&](size_t chunk) {
+            size_t chunkEnd = std::min(chunk * CHUNK_SIZE + CHUNK_SIZE, numBillboards);
+            float* pInst = static_cast<float*>(static_cast<void*>(instances + chunk * CHUNK_SIZE * instanceSize));
+            for (size_t i = chunk * CHUNK_SIZE; i < chunkEnd; ++i)
+            {
+                size_t index = order ? order[i] : rangeStart + i;
+                const Vector3& position = mPositions[index];
+                const ColourValue& hdrColour = mHDRColours[index];
+                const Ogre::FloatRect & r = mUseTexcoordRects[index] ?
+                mTexcoordRects[index] : mTextureCoords[mTexcoordIndices[index]];
+                bool own = !mAllDefaultSize && mOwnDimensions[index];
+                
+                // Position
+                *pInst++ = position.x;
+                *pInst++ = position.y;
+                *pInst++ = position.z;
+#ifdef EXR_SUPPORT
+                // Normal
+                *pInst++ = hdrColour.r;
+                *pInst++ = hdrColour.g;
+                *pInst++ = hdrColour.b;
+#endif
+                // Colour
+                *static_cast<RGBA*>(static_cast<void*>(pInst++)) =
+                    VertexElement::convertColourValue(mColours[index], colourType);
+                // Size
+                *pInst++ = own ? mWidths[index] : mDefaultWidth;
+                *pInst++ = own ? mHeights[index] : mDefaultHeight;
+                // Texture coord rect
+                *pInst++ = r.left;
+                *pInst++ = r.top;
+                *pInst++ = r.right;
+                *pInst++ = r.bottom;
+            }
+        });
+        
+        mLockPtr = static_cast<float*>(static_cast<void*>(instances + numBillboards * instanceSize));
+        mNumVisibleBillboards = numBillboards;
+    }
+    //-----------------------------------------------------------------------
+    void SpacescapeBillboardSet::injectBillboard(const Vector3& position, const Vector3& direction,
+                                                 bool ownDimensions, Real width, Real height,
+                                                 const ColourValue& colour, const ColourValue& hdrColour,
+                                                 const Radian& rotation, const FloatRect& texcoords)
     {
         // Don't accept injections beyond pool size
         if (mNumVisibleBillboards == mPoolSize) return;
         
         // Skip if not visible (NB always true if not bounds checking individual billboards)
-        if (!billboardVisible(mCurrentCamera, bb)) return;
+        // static geometry has to include every billboard for later cameras
+        if (!mStaticGeometry && mCullIndividual &&
+            !billboardVisible(mCurrentCamera, position, ownDimensions ?
+                              std::max(width, height) : std::max(mDefaultWidth, mDefaultHeight)))
+        {
+            return;
+        }
         
         if (!mPointRendering &&
             (mBillboardType == BBT_ORIENTED_SELF ||
@@ -492,7 +920,7 @@ namespace Ogre {
              (mAccurateFacing && mBillboardType != BBT_PERPENDICULAR_COMMON)))
         {
             // Have to generate axes & offsets per billboard
-            genBillboardAxes(&mCamX, &mCamY, &bb);
+            genBillboardAxes(&mCamX, &mCamY, position, direction);
         }
         
         // If they're all the same size or we're point rendering
@@ -511,7 +939,7 @@ namespace Ogre {
                 genVertOffsets(mLeftOff, mRightOff, mTopOff, mBottomOff,
                                mDefaultWidth, mDefaultHeight, mCamX, mCamY, mVOffset);
             }
-            genVertices(mVOffset, bb);
+            genVertices(mVOffset, position, colour, hdrColour, rotation, texcoords);
         }
         else // not all default size and not point rendering
         {
@@ -519,18 +947,23 @@ namespace Ogre {
             // If it has own dimensions, or self-oriented, gen offsets
             if (mBillboardType == BBT_ORIENTED_SELF ||
                 mBillboardType == BBT_PERPENDICULAR_SELF ||
-                bb.mOwnDimensions ||
+                ownDimensions ||
                 (mAccurateFacing && mBillboardType != BBT_PERPENDICULAR_COMMON))
             {
                 // Generate using own dimensions
+                if (!ownDimensions)
+                {
+                    width = mDefaultWidth;
+                    height = mDefaultHeight;
+                }
                 genVertOffsets(mLeftOff, mRightOff, mTopOff, mBottomOff,
-                               bb.mWidth, bb.mHeight, mCamX, mCamY, vOwnOffset);
+                               width, height, mCamX, mCamY, vOwnOffset);
                 // Create vertex data
-                genVertices(vOwnOffset, bb);
+                genVertices(vOwnOffset, position, colour, hdrColour, rotation, texcoords);
             }
             else // Use default dimension, already computed before the loop, for faster creation
             {
-                genVertices(mVOffset, bb);
+                genVertices(mVOffset, position, colour, hdrColour, rotation, texcoords);
             }
         }
         // Increment visibles
@@ -550,7 +983,7 @@ namespace Ogre {
     //-----------------------------------------------------------------------
     void SpacescapeBillboardSet::_updateBounds(void)
     {
-        if (mActiveBillboards.empty())
+        if (mPositions.empty())
         {
             // No billboards, null bbox
             mAABB.setNull();
@@ -562,16 +995,13 @@ namespace Ogre {
             
             Vector3 min(Math::POS_INFINITY, Math::POS_INFINITY, Math::POS_INFINITY);
             Vector3 max(Math::NEG_INFINITY, Math::NEG_INFINITY, Math::NEG_INFINITY);
-            SpacescapeActiveBillboardList::iterator i, iend;
-            
-            iend = mActiveBillboards.end();
             Matrix4 invWorld;
             if (mWorldSpace && getParentSceneNode())
                 invWorld = getParentSceneNode()->_getFullTransform().inverse();
             
-            for (i = mActiveBillboards.begin(); i != iend; ++i)
+            for (size_t i = 0; i < mPositions.size(); ++i)
             {
-                Vector3 pos = (*i)->getPosition();
+                Vector3 pos = mPositions[i];
                 // transform from world space to local space
                 if (mWorldSpace && getParentSceneNode())
                     pos = invWorld * pos;
@@ -605,23 +1035,65 @@ namespace Ogre {
     void SpacescapeBillboardSet::_updateRenderQueue(RenderQueue* queue)
     {
         // If we're driving this from our own data, update geometry if need to.
-        if (!mExternalData && (mAutoUpdate || mBillboardDataChanged || !mBuffersCreated))
+        if (!mExternalData)
         {
-            if (mSortingEnabled)
+            // instances use a different buffer layout
+            bool instanced = canInstance();
+            if (mBuffersCreated && instanced != mInstanced)
+            {
+                _destroyBuffers();
+            }
+            
+            // static geometry doesn't depend on the camera so isn't sorted,
+            // neither are billboards that blend the same in any order
+            bool sorted = mSortingEnabled && !mStaticGeometry && !isBlendingOrderIndependent();
+            
+            // instances only depend on the camera when sorted
+            if (mBillboardDataChanged || !mBuffersCreated || (mAutoUpdate && (sorted || !instanced)))
             {
-                _sortBillboards(mCurrentCamera);
+                if (sorted)
+                {
+                    _sortBillboards(mCurrentCamera);
+                }
+                
+                size_t rangeStart, numBillboards;
+                _getBillboardRange(rangeStart, numBillboards);
+                beginBillboards(numBillboards);
+                if (instanced)
+                {
+                    injectInstances(sorted && numBillboards ? &mSortedBillboards[0] : 0, rangeStart, numBillboards);
+                }
+                else if (canInjectFacingBillboards())
+                {
+                    injectFacingBillboards(sorted && numBillboards ? &mSortedBillboards[0] : 0, rangeStart, numBillboards);
+                }
+                else if (sorted)
+                {
+                    for (size_t i = 0; i < numBillboards; ++i)
+                    {
+                        injectActiveBillboard(mSortedBillboards[i]);
+                    }
+                }
+                else
+                {
+                    for (size_t i = 0; i < numBillboards; ++i)
+                    {
+                        injectActiveBillboard(rangeStart + i);
+                    }
+                }
+                endBillboards();
+                mBillboardDataChanged = false;
             }
             
-            beginBillboards(mActiveBillboards.size());
-            SpacescapeActiveBillboardList::iterator it;
-            for(it = mActiveBillboards.begin();
-                it != mActiveBillboards.end();
-                ++it )
+            if (instanced)
             {
-                injectBillboard(*(*it));
+                // the vertex program faces the quads like genFacingQuads,
+                // static geometry faces the origin with a fixed up vector
+                Vector3 camPos = mStaticGeometry ? Vector3::ZERO : mCamPos;
+                Vector3 camUp = mStaticGeometry ? Vector3::UNIT_Y : mCamQ * Vector3::UNIT_Y;
+                setCustomParameter(CUSTOM_CAMERA_POSITION, Vector4(camPos.x, camPos.y, camPos.z, 1.0f));
+                setCustomParameter(CUSTOM_CAMERA_UP, Vector4(camUp.x, camUp.y, camUp.z, mStaticGeometry ? 1.0f : 0.0f));
             }
-            endBillboards();
-            mBillboardDataChanged = false;
         }
         
         //only set the render queue group if it has been explicitly set.
@@ -687,6 +1159,20 @@ namespace Ogre {
             op.indexData = 0;
             op.vertexData->vertexCount = mNumVisibleBillboards;
         }
+        else if (mInstanced)
+        {
+            // one quad per instance
+            op.operationType = RenderOperation::OT_TRIANGLE_LIST;
+            op.useIndexes = true;
+            op.useGlobalInstancingVertexBufferIsAvailable = false;
+            op.numberOfInstances = mNumVisibleBillboards;
+            
+            op.vertexData->vertexCount = 4;
+            
+            op.indexData = mIndexData;
+            op.indexData->indexCount = mNumVisibleBillboards ? 6 : 0;
+            op.indexData->indexStart = 0;
+        }
         else
         {
             op.operationType = RenderOperation::OT_TRIANGLE_LIST;
@@ -740,21 +1226,14 @@ namespace Ogre {
     //-----------------------------------------------------------------------
     void SpacescapeBillboardSet::setPoolSize( size_t size )
     {
-        // If we're driving this from our own data, allocate billboards
+        // If we're driving this from our own data, reserve the billboard arrays
         if (!mExternalData)
         {
-            // Never shrink below size()
-            size_t currSize = mBillboardPool.size();
-            if (currSize >= size)
+            // Never shrink below the current pool
+            if (mPoolSize >= size)
                 return;
             
             this->increasePool(size);
-            
-            for( size_t i = currSize; i < size; ++i )
-            {
-                // Add new items to the queue
-                mFreeBillboards.push_back( mBillboardPool[i] );
-            }
         }
         
         mPoolSize = size;
@@ -762,6 +1241,31 @@ namespace Ogre {
         _destroyBuffers();
     }
     
+    //-----------------------------------------------------------------------
+    /** Fill an index buffer with two triangles for each billboard
+    @param pIdx The locked index buffer
+    @param poolSize The number of billboards
+    */
+    template<typename IndexType>
+    static void fillBillboardIndices(IndexType* pIdx, size_t poolSize)
+    {
+        for(
+            size_t idx, idxOff, bboard = 0;
+            bboard < poolSize;
+            ++bboard )
+        {
+            // Do indexes
+            idx    = bboard * 6;
+            idxOff = bboard * 4;
+            
+            pIdx[idx] = static_cast<IndexType>(idxOff); // + 0;, for clarity
+            pIdx[idx+1] = static_cast<IndexType>(idxOff + 2);
+            pIdx[idx+2] = static_cast<IndexType>(idxOff + 1);
+            pIdx[idx+3] = static_cast<IndexType>(idxOff + 1);
+            pIdx[idx+4] = static_cast<IndexType>(idxOff + 2);
+            pIdx[idx+5] = static_cast<IndexType>(idxOff + 3);
+        }
+    }
     //-----------------------------------------------------------------------
     void SpacescapeBillboardSet::_createBuffers(void)
     {
@@ -787,11 +1291,17 @@ namespace Ogre {
                                                   "expect.", LML_CRITICAL);
         }
         
+        // Instances draw one quad per billboard, reading the billboard data
+        // from a second buffer
+        mInstanced = canInstance();
+        unsigned short mainSource = mInstanced ? 1 : 0;
+        size_t numQuads = mInstanced ? 1 : mPoolSize;
+        
         mVertexData = OGRE_NEW VertexData();
         if (mPointRendering)
             mVertexData->vertexCount = mPoolSize;
         else
-            mVertexData->vertexCount = mPoolSize * 4;
+            mVertexData->vertexCount = numQuads * 4;
         
         mVertexData->vertexStart = 0;
         
@@ -799,39 +1309,80 @@ namespace Ogre {
         VertexDeclaration* decl = mVertexData->vertexDeclaration;
         VertexBufferBinding* binding = mVertexData->vertexBufferBinding;
         
+        // Quad corners as parametric offsets and texture coord selectors
+        if (mInstanced)
+        {
+            decl->addElement(0, 0, VET_FLOAT4, VES_TEXTURE_COORDINATES, 0);
+        }
+        
         size_t offset = 0;
-        decl->addElement(0, offset, VET_FLOAT3, VES_POSITION);
+        decl->addElement(mainSource, offset, VET_FLOAT3, VES_POSITION);
         offset += VertexElement::getTypeSize(VET_FLOAT3);
 #ifdef EXR_SUPPORT
-        decl->addElement(0, offset, VET_FLOAT3, VES_NORMAL);
+        decl->addElement(mainSource, offset, VET_FLOAT3, VES_NORMAL);
         offset += VertexElement::getTypeSize(VET_FLOAT3);
 #endif
-        decl->addElement(0, offset, VET_COLOUR, VES_DIFFUSE);
+        decl->addElement(mainSource, offset, VET_COLOUR, VES_DIFFUSE);
         offset += VertexElement::getTypeSize(VET_COLOUR);
+        if (mInstanced)
+        {
+            // Size and texture coord rect per instance
+            decl->addElement(mainSource, offset, VET_FLOAT2, VES_TEXTURE_COORDINATES, 1);
+            offset += VertexElement::getTypeSize(VET_FLOAT2);
+            decl->addElement(mainSource, offset, VET_FLOAT4, VES_TEXTURE_COORDINATES, 2);
+        }
         // Texture coords irrelevant when enabled point rendering (generated
         // in point sprite mode, and unused in standard point mode)
-        if (!mPointRendering)
+        else if (!mPointRendering)
         {
             decl->addElement(0, offset, VET_FLOAT2, VES_TEXTURE_COORDINATES, 0);
         }
         
         mMainBuf =
         HardwareBufferManager::getSingleton().createVertexBuffer(
-                                                                 decl->getVertexSize(0),
-                                                                 mVertexData->vertexCount,
+                                                                 decl->getVertexSize(mainSource),
+                                                                 mInstanced ? mPoolSize : mVertexData->vertexCount,
                                                                  mAutoUpdate ? HardwareBuffer::HBU_DYNAMIC_WRITE_ONLY_DISCARDABLE :
                                                                  HardwareBuffer::HBU_STATIC_WRITE_ONLY);
         // bind position and diffuses
-        binding->setBinding(0, mMainBuf);
+        binding->setBinding(mainSource, mMainBuf);
+        
+        if (mInstanced)
+        {
+            mMainBuf->setIsInstanceData(true);
+            mMainBuf->setInstanceDataStepRate(1);
+            
+            // The quad is only rebuilt when the origin changes
+            Real left, right, top, bottom;
+            getParametricOffsets(left, right, top, bottom);
+            float quad[16] = {
+                left, top, 0.0f, 0.0f,
+                right, top, 1.0f, 0.0f,
+                left, bottom, 0.0f, 1.0f,
+                right, bottom, 1.0f, 1.0f
+            };
+            
+            HardwareVertexBufferSharedPtr quadBuf =
+            HardwareBufferManager::getSingleton().createVertexBuffer(
+                                                                     decl->getVertexSize(0), 4,
+                                                                     HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+            quadBuf->writeData(0, sizeof(quad), quad, true);
+            binding->setBinding(0, quadBuf);
+        }
         
         if (!mPointRendering)
         {
             mIndexData  = OGRE_NEW IndexData();
             mIndexData->indexStart = 0;
-            mIndexData->indexCount = mPoolSize * 6;
+            mIndexData->indexCount = numQuads * 6;
+            
+            // 16 bit indices only reach the first 16384 billboards, larger
+            // pools still draw in one call with 32 bit indices
+            HardwareIndexBuffer::IndexType indexType = mVertexData->vertexCount > 65536 ?
+                HardwareIndexBuffer::IT_32BIT : HardwareIndexBuffer::IT_16BIT;
             
             mIndexData->indexBuffer = HardwareBufferManager::getSingleton().
-            createIndexBuffer(HardwareIndexBuffer::IT_16BIT,
+            createIndexBuffer(indexType,
                               mIndexData->indexCount,
                               HardwareBuffer::HBU_STATIC_WRITE_ONLY);
             
@@ -847,28 +1398,14 @@ namespace Ogre {
              2-----3
              */
             
-            ushort* pIdx = static_cast<ushort*>(
-                                                mIndexData->indexBuffer->lock(0,
-                                                                              mIndexData->indexBuffer->getSizeInBytes(),
-                                                                              HardwareBuffer::HBL_DISCARD) );
+            void* pIdx = mIndexData->indexBuffer->lock(0,
+                                                       mIndexData->indexBuffer->getSizeInBytes(),
+                                                       HardwareBuffer::HBL_DISCARD);
             
-            for(
-                size_t idx, idxOff, bboard = 0;
-                bboard < mPoolSize;
-                ++bboard )
-            {
-                // Do indexes
-                idx    = bboard * 6;
-                idxOff = bboard * 4;
-                
-                pIdx[idx] = static_cast<unsigned short>(idxOff); // + 0;, for clarity
-                pIdx[idx+1] = static_cast<unsigned short>(idxOff + 2);
-                pIdx[idx+2] = static_cast<unsigned short>(idxOff + 1);
-                pIdx[idx+3] = static_cast<unsigned short>(idxOff + 1);
-                pIdx[idx+4] = static_cast<unsigned short>(idxOff + 2);
-                pIdx[idx+5] = static_cast<unsigned short>(idxOff + 3);
-                
-            }
+            if (indexType == HardwareIndexBuffer::IT_32BIT)
+                fillBillboardIndices(static_cast<uint32*>(pIdx), numQuads);
+            else
+                fillBillboardIndices(static_cast<uint16*>(pIdx), numQuads);
             
             mIndexData->indexBuffer->unlock();
         }
@@ -891,12 +1428,13 @@ namespace Ogre {
         mMainBuf.setNull();
         
         mBuffersCreated = false;
+        mInstanced = false;
         
     }
     //-----------------------------------------------------------------------
     unsigned int SpacescapeBillboardSet::getPoolSize(void) const
     {
-        return static_cast< unsigned int >( mBillboardPool.size() );
+        return static_cast< unsigned int >( mPoolSize );
     }
     
     //-----------------------------------------------------------------------
@@ -992,7 +1530,7 @@ namespace Ogre {
         mCullIndividual = cullIndividual;
     }
     //-----------------------------------------------------------------------
-    bool SpacescapeBillboardSet::billboardVisible(Camera* cam, const SpacescapeBillboard& bill)
+    bool SpacescapeBillboardSet::billboardVisible(Camera* cam, const Vector3& position, Real radius)
     {
         // Return always visible if not culling individually
         if (!mCullIndividual) return true;
@@ -1003,16 +1541,8 @@ namespace Ogre {
         
         getWorldTransforms(&xworld);
 
-        sph.setCenter(xworld * bill.mPosition);
-        
-        if (bill.mOwnDimensions)
-        {
-            sph.setRadius(std::max(bill.mWidth, bill.mHeight));
-        }
-        else
-        {
-            sph.setRadius(std::max(mDefaultWidth, mDefaultHeight));
-        }
+        sph.setCenter(xworld * position);
+        sph.setRadius(radius);
         
         return cam->isVisible(sph);
         
@@ -1020,19 +1550,24 @@ namespace Ogre {
     //-----------------------------------------------------------------------
     void SpacescapeBillboardSet::increasePool(size_t size)
     {
-        size_t oldSize = mBillboardPool.size();
-        
-        // Increase size
-        mBillboardPool.reserve(size);
-        mBillboardPool.resize(size);
-        
-        // Create new billboards
-        for( size_t i = oldSize; i < size; ++i )
-            mBillboardPool[i] = OGRE_NEW SpacescapeBillboard();
+        // Reserve room so creating billboards doesn't reallocate
+        mPositions.reserve(size);
+        mDirections.reserve(size);
+        mWidths.reserve(size);
+        mHeights.reserve(size);
+        mOwnDimensions.reserve(size);
+        mColours.reserve(size);
+        mHDRColours.reserve(size);
+        mRotations.reserve(size);
+        mTexcoordIndices.reserve(size);
+        mTexcoordRects.reserve(size);
+        mUseTexcoordRects.reserve(size);
+        mSortedBillboards.reserve(size);
         
     }
     //-----------------------------------------------------------------------
-    void SpacescapeBillboardSet::genBillboardAxes(Vector3* pX, Vector3 *pY, const SpacescapeBillboard* bb)
+    void SpacescapeBillboardSet::genBillboardAxes(Vector3* pX, Vector3 *pY,
+                                                  const Vector3& position, const Vector3& direction)
     {
         // If we're using accurate facing, recalculate camera direction per BB
         if (mAccurateFacing &&
@@ -1041,7 +1576,7 @@ namespace Ogre {
              mBillboardType == BBT_ORIENTED_SELF))
         {
             // cam -> bb direction
-            mCamDir = bb->mPosition - mCamPos;
+            mCamDir = position - mCamPos;
             mCamDir.normalise();
         }
         
@@ -1054,6 +1589,12 @@ namespace Ogre {
                     // Point billboards will have 'up' based on but not equal to cameras
                     // Use pY temporarily to avoid allocation
                     *pY = mCamQ * Vector3::UNIT_Y;
+                    
+                    // the fixed up vector of static geometry can line up
+                    // with billboards at the poles
+                    if (mStaticGeometry && Math::Abs(mCamDir.dotProduct(*pY)) > 0.99f)
+                        *pY = Vector3::UNIT_Z;
+                    
                     *pX = mCamDir.crossProduct(*pY);
                     pX->normalise();
                     *pY = pX->crossProduct(mCamDir); // both normalised already
@@ -1078,7 +1619,7 @@ namespace Ogre {
                 // Y-axis is direction
                 // X-axis is cross with camera direction
                 // Scale direction first
-                *pY = bb->mDirection;
+                *pY = direction;
                 *pX = mCamDir.crossProduct(*pY);
                 pX->normalise();
                 break;
@@ -1093,9 +1634,9 @@ namespace Ogre {
             case BBT_PERPENDICULAR_SELF:
                 // X-axis is up-vector cross own direction
                 // Y-axis is own direction cross X-axis
-                *pX = mCommonUpVector.crossProduct(bb->mDirection);
+                *pX = mCommonUpVector.crossProduct(direction);
                 pX->normalise();
-                *pY = bb->mDirection.crossProduct(*pX); // both should be normalised
+                *pY = direction.crossProduct(*pX); // both should be normalised
                 break;
         }
         
@@ -1104,6 +1645,7 @@ namespace Ogre {
     void SpacescapeBillboardSet::setBillboardType(BillboardType bbt)
     {
         mBillboardType = bbt;
+        mBillboardDataChanged = true;
     }
     //-----------------------------------------------------------------------
     BillboardType SpacescapeBillboardSet::getBillboardType(void) const
@@ -1114,6 +1656,7 @@ namespace Ogre {
     void SpacescapeBillboardSet::setCommonDirection(const Vector3& vec)
     {
         mCommonDirection = vec;
+        mBillboardDataChanged = true;
     }
     //-----------------------------------------------------------------------
     const Vector3& SpacescapeBillboardSet::getCommonDirection(void) const
@@ -1124,6 +1667,7 @@ namespace Ogre {
     void SpacescapeBillboardSet::setCommonUpVector(const Vector3& vec)
     {
         mCommonUpVector = vec;
+        mBillboardDataChanged = true;
     }
     //-----------------------------------------------------------------------
     const Vector3& SpacescapeBillboardSet::getCommonUpVector(void) const
@@ -1137,24 +1681,21 @@ namespace Ogre {
     }
     //-----------------------------------------------------------------------
     void SpacescapeBillboardSet::genVertices(
-                                   const Vector3* const offsets, const SpacescapeBillboard& bb)
+                                   const Vector3* const offsets, const Vector3& position,
+                                   const ColourValue& colourValue, const ColourValue& hdrColour,
+                                   const Radian& rotation, const FloatRect& r)
     {
         RGBA colour;
-        Root::getSingleton().convertColourValue(bb.mColour, &colour);
+        Root::getSingleton().convertColourValue(colourValue, &colour);
         RGBA* pCol;
         
-        // Texcoords
-        assert( bb.mUseTexcoordRect || bb.mTexcoordIndex < mTextureCoords.size() );
-        const Ogre::FloatRect & r =
-        bb.mUseTexcoordRect ? bb.mTexcoordRect : mTextureCoords[bb.mTexcoordIndex];
-        
         if (mPointRendering)
         {
             // Single vertex per billboard, ignore offsets
             // position
-            *mLockPtr++ = bb.mPosition.x;
-            *mLockPtr++ = bb.mPosition.y;
-            *mLockPtr++ = bb.mPosition.z;
+            *mLockPtr++ = position.x;
+            *mLockPtr++ = position.y;
+            *mLockPtr++ = position.z;
             // Colour
             // Convert float* to RGBA*
             pCol = static_cast<RGBA*>(static_cast<void*>(mLockPtr));
@@ -1163,18 +1704,18 @@ namespace Ogre {
             mLockPtr = static_cast<float*>(static_cast<void*>(pCol));
             // No texture coords in point rendering
         }
-        else if (mAllDefaultRotation || bb.mRotation == Radian(0))
+        else if (mAllDefaultRotation || rotation == Radian(0))
         {
             // Left-top
             // Positions
-            *mLockPtr++ = offsets[0].x + bb.mPosition.x;
-            *mLockPtr++ = offsets[0].y + bb.mPosition.y;
-            *mLockPtr++ = offsets[0].z + bb.mPosition.z;
+            *mLockPtr++ = offsets[0].x + position.x;
+            *mLockPtr++ = offsets[0].y + position.y;
+            *mLockPtr++ = offsets[0].z + position.z;
 #ifdef EXR_SUPPORT
             // Normal
-            *mLockPtr++ = bb.mHDRColour.r;
-            *mLockPtr++ = bb.mHDRColour.g;
-            *mLockPtr++ = bb.mHDRColour.b;
+            *mLockPtr++ = hdrColour.r;
+            *mLockPtr++ = hdrColour.g;
+            *mLockPtr++ = hdrColour.b;
 #endif
             // Colour
             // Convert float* to RGBA*
@@ -1188,14 +1729,14 @@ namespace Ogre {
             
             // Right-top
             // Positions
-            *mLockPtr++ = offsets[1].x + bb.mPosition.x;
-            *mLockPtr++ = offsets[1].y + bb.mPosition.y;
-            *mLockPtr++ = offsets[1].z + bb.mPosition.z;
+            *mLockPtr++ = offsets[1].x + position.x;
+            *mLockPtr++ = offsets[1].y + position.y;
+            *mLockPtr++ = offsets[1].z + position.z;
 #ifdef EXR_SUPPORT
             // Normal
-            *mLockPtr++ = bb.mHDRColour.r;
-            *mLockPtr++ = bb.mHDRColour.g;
-            *mLockPtr++ = bb.mHDRColour.b;
+            *mLockPtr++ = hdrColour.r;
+            *mLockPtr++ = hdrColour.g;
+            *mLockPtr++ = hdrColour.b;
 #endif
             // Colour
             // Convert float* to RGBA*
@@ -1209,14 +1750,14 @@ namespace Ogre {
             
             // Left-bottom
             // Positions
-            *mLockPtr++ = offsets[2].x + bb.mPosition.x;
-            *mLockPtr++ = offsets[2].y + bb.mPosition.y;
-            *mLockPtr++ = offsets[2].z + bb.mPosition.z;
+            *mLockPtr++ = offsets[2].x + position.x;
+            *mLockPtr++ = offsets[2].y + position.y;
+            *mLockPtr++ = offsets[2].z + position.z;
 #ifdef EXR_SUPPORT
             // Normal
-            *mLockPtr++ = bb.mHDRColour.r;
-            *mLockPtr++ = bb.mHDRColour.g;
-            *mLockPtr++ = bb.mHDRColour.b;
+            *mLockPtr++ = hdrColour.r;
+            *mLockPtr++ = hdrColour.g;
+            *mLockPtr++ = hdrColour.b;
 #endif
             // Colour
             // Convert float* to RGBA*
@@ -1230,14 +1771,14 @@ namespace Ogre {
             
             // Right-bottom
             // Positions
-            *mLockPtr++ = offsets[3].x + bb.mPosition.x;
-            *mLockPtr++ = offsets[3].y + bb.mPosition.y;
-            *mLockPtr++ = offsets[3].z + bb.mPosition.z;
+            *mLockPtr++ = offsets[3].x + position.x;
+            *mLockPtr++ = offsets[3].y + position.y;
+            *mLockPtr++ = offsets[3].z + position.z;
 #ifdef EXR_SUPPORT
             // Normal
-            *mLockPtr++ = bb.mHDRColour.r;
-            *mLockPtr++ = bb.mHDRColour.g;
-            *mLockPtr++ = bb.mHDRColour.b;
+            *mLockPtr++ = hdrColour.r;
+            *mLockPtr++ = hdrColour.g;
+            *mLockPtr++ = hdrColour.b;
 #endif
             // Colour
             // Convert float* to RGBA*
@@ -1254,22 +1795,22 @@ namespace Ogre {
             // TODO: Cache axis when billboard type is BBT_POINT or BBT_PERPENDICULAR_COMMON
             Vector3 axis = (offsets[3] - offsets[0]).crossProduct(offsets[2] - offsets[1]).normalisedCopy();
             
-            Matrix3 rotation;
-            rotation.FromAngleAxis(axis, bb.mRotation);
+            Matrix3 rotationMatrix;
+            rotationMatrix.FromAngleAxis(axis, rotation);
             
             Vector3 pt;
             
             // Left-top
             // Positions
-            pt = rotation * offsets[0];
-            *mLockPtr++ = pt.x + bb.mPosition.x;
-            *mLockPtr++ = pt.y + bb.mPosition.y;
-            *mLockPtr++ = pt.z + bb.mPosition.z;
+            pt = rotationMatrix * offsets[0];
+            *mLockPtr++ = pt.x + position.x;
+            *mLockPtr++ = pt.y + position.y;
+            *mLockPtr++ = pt.z + position.z;
 #ifdef EXR_SUPPORT
             // Normal
-            *mLockPtr++ = bb.mHDRColour.r;
-            *mLockPtr++ = bb.mHDRColour.g;
-            *mLockPtr++ = bb.mHDRColour.b;
+            *mLockPtr++ = hdrColour.r;
+            *mLockPtr++ = hdrColour.g;
+            *mLockPtr++ = hdrColour.b;
 #endif
             // Colour
             // Convert float* to RGBA*
@@ -1283,15 +1824,15 @@ namespace Ogre {
             
             // Right-top
             // Positions
-            pt = rotation * offsets[1];
-            *mLockPtr++ = pt.x + bb.mPosition.x;
-            *mLockPtr++ = pt.y + bb.mPosition.y;
-            *mLockPtr++ = pt.z + bb.mPosition.z;
+            pt = rotationMatrix * offsets[1];
+            *mLockPtr++ = pt.x + position.x;
+            *mLockPtr++ = pt.y + position.y;
+            *mLockPtr++ = pt.z + position.z;
 #ifdef EXR_SUPPORT
             // Normal
-            *mLockPtr++ = bb.mHDRColour.r;
-            *mLockPtr++ = bb.mHDRColour.g;
-            *mLockPtr++ = bb.mHDRColour.b;
+            *mLockPtr++ = hdrColour.r;
+            *mLockPtr++ = hdrColour.g;
+            *mLockPtr++ = hdrColour.b;
 #endif
             // Colour
             // Convert float* to RGBA*
@@ -1305,15 +1846,15 @@ namespace Ogre {
             
             // Left-bottom
             // Positions
-            pt = rotation * offsets[2];
-            *mLockPtr++ = pt.x + bb.mPosition.x;
-            *mLockPtr++ = pt.y + bb.mPosition.y;
-            *mLockPtr++ = pt.z + bb.mPosition.z;
+            pt = rotationMatrix * offsets[2];
+            *mLockPtr++ = pt.x + position.x;
+            *mLockPtr++ = pt.y + position.y;
+            *mLockPtr++ = pt.z + position.z;
 #ifdef EXR_SUPPORT
             // Normal
-            *mLockPtr++ = bb.mHDRColour.r;
-            *mLockPtr++ = bb.mHDRColour.g;
-            *mLockPtr++ = bb.mHDRColour.b;
+            *mLockPtr++ = hdrColour.r;
+            *mLockPtr++ = hdrColour.g;
+            *mLockPtr++ = hdrColour.b;
 #endif
             // Colour
             // Convert float* to RGBA*
@@ -1327,15 +1868,15 @@ namespace Ogre {
             
             // Right-bottom
             // Positions
-            pt = rotation * offsets[3];
-            *mLockPtr++ = pt.x + bb.mPosition.x;
-            *mLockPtr++ = pt.y + bb.mPosition.y;
-            *mLockPtr++ = pt.z + bb.mPosition.z;
+            pt = rotationMatrix * offsets[3];
+            *mLockPtr++ = pt.x + position.x;
+            *mLockPtr++ = pt.y + position.y;
+            *mLockPtr++ = pt.z + position.z;
 #ifdef EXR_SUPPORT
             // Normal
-            *mLockPtr++ = bb.mHDRColour.r;
-            *mLockPtr++ = bb.mHDRColour.g;
-            *mLockPtr++ = bb.mHDRColour.b;
+            *mLockPtr++ = hdrColour.r;
+            *mLockPtr++ = hdrColour.g;
+            *mLockPtr++ = hdrColour.b;
 #endif
             // Colour
             // Convert float* to RGBA*
@@ -1349,8 +1890,8 @@ namespace Ogre {
         }
         else
         {
-            const Real      cos_rot  ( Math::Cos(bb.mRotation)   );
-            const Real      sin_rot  ( Math::Sin(bb.mRotation)   );
+            const Real      cos_rot  ( Math::Cos(rotation)   );
+            const Real      sin_rot  ( Math::Sin(rotation)   );
             
             float width = (r.right-r.left)/2;
             float height = (r.bottom-r.top)/2;
@@ -1364,14 +1905,14 @@ namespace Ogre {
             
             // Left-top
             // Positions
-            *mLockPtr++ = offsets[0].x + bb.mPosition.x;
-            *mLockPtr++ = offsets[0].y + bb.mPosition.y;
-            *mLockPtr++ = offsets[0].z + bb.mPosition.z;
+            *mLockPtr++ = offsets[0].x + position.x;
+            *mLockPtr++ = offsets[0].y + position.y;
+            *mLockPtr++ = offsets[0].z + position.z;
 #ifdef EXR_SUPPORT
             // Normal
-            *mLockPtr++ = bb.mHDRColour.r;
-            *mLockPtr++ = bb.mHDRColour.g;
-            *mLockPtr++ = bb.mHDRColour.b;
+            *mLockPtr++ = hdrColour.r;
+            *mLockPtr++ = hdrColour.g;
+            *mLockPtr++ = hdrColour.b;
 #endif
             // Colour
             // Convert float* to RGBA*
@@ -1385,14 +1926,14 @@ namespace Ogre {
             
             // Right-top
             // Positions
-            *mLockPtr++ = offsets[1].x + bb.mPosition.x;
-            *mLockPtr++ = offsets[1].y + bb.mPosition.y;
-            *mLockPtr++ = offsets[1].z + bb.mPosition.z;
+            *mLockPtr++ = offsets[1].x + position.x;
+            *mLockPtr++ = offsets[1].y + position.y;
+            *mLockPtr++ = offsets[1].z + position.z;
 #ifdef EXR_SUPPORT
             // Normal
-            *mLockPtr++ = bb.mHDRColour.r;
-            *mLockPtr++ = bb.mHDRColour.g;
-            *mLockPtr++ = bb.mHDRColour.b;
+            *mLockPtr++ = hdrColour.r;
+            *mLockPtr++ = hdrColour.g;
+            *mLockPtr++ = hdrColour.b;
 #endif
             // Colour
             // Convert float* to RGBA*
@@ -1406,14 +1947,14 @@ namespace Ogre {
             
             // Left-bottom
             // Positions
-            *mLockPtr++ = offsets[2].x + bb.mPosition.x;
-            *mLockPtr++ = offsets[2].y + bb.mPosition.y;
-            *mLockPtr++ = offsets[2].z + bb.mPosition.z;
+            *mLockPtr++ = offsets[2].x + position.x;
+            *mLockPtr++ = offsets[2].y + position.y;
+            *mLockPtr++ = offsets[2].z + position.z;
 #ifdef EXR_SUPPORT
             // Normal
-            *mLockPtr++ = bb.mHDRColour.r;
-            *mLockPtr++ = bb.mHDRColour.g;
-            *mLockPtr++ = bb.mHDRColour.b;
+            *mLockPtr++ = hdrColour.r;
+            *mLockPtr++ = hdrColour.g;
+            *mLockPtr++ = hdrColour.b;
 #endif
             // Colour
             // Convert float* to RGBA*
@@ -1427,14 +1968,14 @@ namespace Ogre {
             
             // Right-bottom
             // Positions
-            *mLockPtr++ = offsets[3].x + bb.mPosition.x;
-            *mLockPtr++ = offsets[3].y + bb.mPosition.y;
-            *mLockPtr++ = offsets[3].z + bb.mPosition.z;
+            *mLockPtr++ = offsets[3].x + position.x;
+            *mLockPtr++ = offsets[3].y + position.y;
+            *mLockPtr++ = offsets[3].z + position.z;
 #ifdef EXR_SUPPORT
             // Normal
-            *mLockPtr++ = bb.mHDRColour.r;
-            *mLockPtr++ = bb.mHDRColour.g;
-            *mLockPtr++ = bb.mHDRColour.b;
+            *mLockPtr++ = hdrColour.r;
+            *mLockPtr++ = hdrColour.g;
+            *mLockPtr++ = hdrColour.b;
 #endif
             // Colour
             // Convert float* to RGBA*
@@ -1514,6 +2055,7 @@ namespace Ogre {
         mTextureCoords.resize( numCoords );
         //  copy in data
         std::copy( coords, coords+numCoords, &mTextureCoords.front() );
+        mBillboardDataChanged = true;
     }
     
     void SpacescapeBillboardSet::setTextureStacksAndSlices( uchar stacks, uchar slices )
@@ -1541,6 +2083,7 @@ namespace Ogre {
             }
         }
         assert( coordIndex == (size_t)stacks * slices );
+        mBillboardDataChanged = true;
     }
     //-----------------------------------------------------------------------
     Ogre::FloatRect const * SpacescapeBillboardSet::getTextureCoords( uint16 * oNumCoords )
@@ -1578,6 +2121,56 @@ namespace Ogre {
         }
     }
     
+    //-----------------------------------------------------------------------
+    void SpacescapeBillboardSet::setStaticGeometry(bool staticGeometry)
+    {
+        if (staticGeometry != mStaticGeometry)
+        {
+            mStaticGeometry = staticGeometry;
+            
+            // static geometry lives in a static buffer that's only written
+            // when the billboards change
+            setAutoUpdate(!staticGeometry);
+            mBillboardDataChanged = true;
+        }
+    }
+    
+    //-----------------------------------------------------------------------
+    void SpacescapeBillboardSet::setInstancingEnabled(bool enabled)
+    {
+        // buffers are recreated on the next update if the layout changes
+        mInstancingEnabled = enabled;
+    }
+    
+    //-----------------------------------------------------------------------
+    void SpacescapeBillboardSet::setBillboardRange(size_t first, size_t count)
+    {
+        if (first != mRangeStart || count != mRangeCount)
+        {
+            mRangeStart = first;
+            mRangeCount = count;
+            
+            // the sort order only holds the drawn billboards
+            mSortedBillboards.clear();
+            mBillboardDataChanged = true;
+        }
+    }
+    
+    //-----------------------------------------------------------------------
+    void SpacescapeBillboardSet::_getBillboardRange(size_t& first, size_t& count) const
+    {
+        first = std::min(mRangeStart, mPositions.size());
+        count = std::min(mRangeCount, mPositions.size() - first);
+    }
+    
+    //-----------------------------------------------------------------------
+    bool SpacescapeBillboardSet::isInstancingSupported(void)
+    {
+        RenderSystem* renderSystem = Root::getSingleton().getRenderSystem();
+        return renderSystem &&
+            renderSystem->getCapabilities()->hasCapability(RSC_VERTEX_BUFFER_INSTANCE_DATA);
+    }
+    
     //-----------------------------------------------------------------------
     //-----------------------------------------------------------------------
     String SpacescapeBillboardSetFactory::FACTORY_TYPE_NAME = "SpacescapeBillboardSet";
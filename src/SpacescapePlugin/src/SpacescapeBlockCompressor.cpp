@@ -0,0 +1,722 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include "SpacescapeBlockCompressor.h"
+#include "SpacescapeThreadPool.h"
+#include "OgreBitwise.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Ogre
+{
+    // blocks per task, so single strips of blocks still use all the threads
+    static const unsigned int BLOCKS_PER_TASK = 64;
+
+    // bc6h and bc7 4 bit index interpolation weights (out of 64)
+    static const int sWeights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    // bc1 palette index to interpolation weight
+    static const float sBC1Weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+    /** Utility class to pack bit fields into a block, low bits first
+    */
+    class BlockBitWriter
+    {
+    public:
+        BlockBitWriter(uchar* dest, size_t size) : mDest(dest), mPos(0) 
+        {
+            memset(dest, 0, size);
+        }
+
+        void write(uint32 value, unsigned int numBits)
+        {
+            for(unsigned int i = 0; i < numBits; ++i, ++mPos) {
+                if((value >> i) & 1) {
+                    mDest[mPos >> 3] |= (uchar)(1 << (mPos & 7));
+                }
+            }
+        }
+
+    private:
+        uchar* mDest;
+        unsigned int mPos;
+    };
+
+    /** Utility function to fit a line through the block pixels along their
+    principal axis
+    @param pixels The 16 RGBA block pixels
+    @param channels The number of channels to fit (3 or 4)
+    @param e0 Return param - the line start
+    @param e1 Return param - the line end
+    */
+    static void fitLine(const float* pixels, int channels, float* e0, float* e1)
+    {
+        float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        float minimum[4] = { 1e30f, 1e30f, 1e30f, 1e30f };
+        float maximum[4] = { -1e30f, -1e30f, -1e30f, -1e30f };
+        for(int i = 0; i < 16; ++i) {
+            for(int c = 0; c < channels; ++c) {
+                float v = pixels[i * 4 + c];
+                mean[c] += v * (1.0f / 16.0f);
+                minimum[c] = std::min<float>(minimum[c], v);
+                maximum[c] = std::max<float>(maximum[c], v);
+            }
+        }
+
+        float cov[4][4] = { { 0.0f } };
+        for(int i = 0; i < 16; ++i) {
+            float d[4];
+            for(int c = 0; c < channels; ++c) {
+                d[c] = pixels[i * 4 + c] - mean[c];
+            }
+            for(int a = 0; a < channels; ++a) {
+                for(int b = 0; b < channels; ++b) {
+                    cov[a][b] += d[a] * d[b];
+                }
+            }
+        }
+
+        // power iteration starting from the bounding box diagonal
+        float axis[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for(int c = 0; c < channels; ++c) {
+            axis[c] = maximum[c] - minimum[c];
+        }
+        for(int iteration = 0; iteration < 8; ++iteration) {
+            float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            float largest = 0.0f;
+            for(int a = 0; a < channels; ++a) {
+                for(int b = 0; b < channels; ++b) {
+                    next[a] += cov[a][b] * axis[b];
+                }
+                largest = std::max<float>(largest, fabsf(next[a]));
+            }
+            if(largest <= 0.0f) {
+                break;
+            }
+            for(int c = 0; c < channels; ++c) {
+                axis[c] = next[c] / largest;
+            }
+        }
+
+        float length = 0.0f;
+        for(int c = 0; c < channels; ++c) {
+            length += axis[c] * axis[c];
+        }
+
+        float tMin = 0.0f;
+        float tMax = 0.0f;
+        if(length > 0.0f) {
+            length = sqrtf(length);
+            for(int c = 0; c < channels; ++c) {
+                axis[c] /= length;
+            }
+
+            tMin = 1e30f;
+            tMax = -1e30f;
+            for(int i = 0; i < 16; ++i) {
+                float t = 0.0f;
+                for(int c = 0; c < channels; ++c) {
+                    t += (pixels[i * 4 + c] - mean[c]) * axis[c];
+                }
+                tMin = std::min<float>(tMin, t);
+                tMax = std::max<float>(tMax, t);
+            }
+        }
+
+        for(int c = 0; c < 4; ++c) {
+            e0[c] = c < channels ? mean[c] + axis[c] * tMin : pixels[c];
+            e1[c] = c < channels ? mean[c] + axis[c] * tMax : pixels[c];
+        }
+    }
+
+    /** Utility function to find the line end points that best fit the 
+    block pixels for the given interpolation weights (least squares)
+    @param pixels The 16 RGBA block pixels
+    @param channels The number of channels to fit (3 or 4)
+    @param weights The 16 pixel weights - 0 at the line start, 1 at the end
+    @param e0 Return param - the line start
+    @param e1 Return param - the line end
+    @return false if the weights don't determine the end points
+    */
+    static bool refineLine(const float* pixels, int channels, const float* weights, float* e0, float* e1)
+    {
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        float ax[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        float bx[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for(int i = 0; i < 16; ++i) {
+            float b = weights[i];
+            float a = 1.0f - b;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for(int c = 0; c < channels; ++c) {
+                ax[c] += a * pixels[i * 4 + c];
+                bx[c] += b * pixels[i * 4 + c];
+            }
+        }
+
+        float det = aa * bb - ab * ab;
+        if(fabsf(det) < 1e-6f) {
+            return false;
+        }
+
+        for(int c = 0; c < channels; ++c) {
+            e0[c] = (ax[c] * bb - bx[c] * ab) / det;
+            e1[c] = (bx[c] * aa - ax[c] * ab) / det;
+        }
+
+        return true;
+    }
+
+    /** Utility function to quantize a colour to 5:6:5 bits
+    @param c The RGB colour in the 0 - 255 range
+    @return the packed colour
+    */
+    static uint16 packRGB565(const float* c)
+    {
+        int r = (int)floorf(std::min<float>(std::max<float>(c[0], 0.0f), 255.0f) * (31.0f / 255.0f) + 0.5f);
+        int g = (int)floorf(std::min<float>(std::max<float>(c[1], 0.0f), 255.0f) * (63.0f / 255.0f) + 0.5f);
+        int b = (int)floorf(std::min<float>(std::max<float>(c[2], 0.0f), 255.0f) * (31.0f / 255.0f) + 0.5f);
+        return (uint16)((r << 11) | (g << 5) | b);
+    }
+
+    /** Utility function to expand a 5:6:5 colour
+    @param packed The packed colour
+    @param c Return param - the RGB colour in the 0 - 255 range
+    */
+    static void unpackRGB565(uint16 packed, float* c)
+    {
+        int r = (packed >> 11) & 31;
+        int g = (packed >> 5) & 63;
+        int b = packed & 31;
+        c[0] = (float)((r << 3) | (r >> 2));
+        c[1] = (float)((g << 2) | (g >> 4));
+        c[2] = (float)((b << 3) | (b >> 2));
+    }
+
+    /** Utility function to write a BC1 colour block for a pair of end points
+    @param pixels The 16 RGBA block pixels in the 0 - 255 range
+    @param e0 The line start
+    @param e1 The line end
+    @param dest Return param - the 8 byte block
+    @param weights Return param - the pixel weights between e0 and e1
+    @return the squared error of the block
+    */
+    static float encodeBC1(const float* pixels, const float* e0, const float* e1, uchar* dest, float* weights)
+    {
+        uint16 c0 = packRGB565(e0);
+        uint16 c1 = packRGB565(e1);
+
+        // the four colour palette needs c0 > c1
+        bool swapped = c0 < c1;
+        if(swapped) {
+            std::swap(c0, c1);
+        }
+
+        float palette[4][3];
+        unpackRGB565(c0, palette[0]);
+        unpackRGB565(c1, palette[1]);
+        for(int c = 0; c < 3; ++c) {
+            palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+            palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+        }
+
+        // equal end points only have one colour to pick
+        int numColours = c0 == c1 ? 1 : 4;
+
+        uint32 indices = 0;
+        float error = 0.0f;
+        for(int i = 0; i < 16; ++i) {
+            int bestIndex = 0;
+            float bestDist = 1e30f;
+            for(int k = 0; k < numColours; ++k) {
+                float dist = 0.0f;
+                for(int c = 0; c < 3; ++c) {
+                    float d = pixels[i * 4 + c] - palette[k][c];
+                    dist += d * d;
+                }
+                if(dist < bestDist) {
+                    bestDist = dist;
+                    bestIndex = k;
+                }
+            }
+
+            indices |= (uint32)bestIndex << (i * 2);
+            error += bestDist;
+            weights[i] = swapped ? 1.0f - sBC1Weights[bestIndex] : sBC1Weights[bestIndex];
+        }
+
+        BlockBitWriter bits(dest, 8);
+        bits.write(c0, 16);
+        bits.write(c1, 16);
+        bits.write(indices, 32);
+
+        return error;
+    }
+
+    /** Utility function to write a BC3 alpha block
+    @param pixels The 16 RGBA block pixels in the 0 - 255 range
+    @param dest Return param - the 8 byte block
+    */
+    static void encodeBC3Alpha(const float* pixels, uchar* dest)
+    {
+        int a0 = 0;
+        int a1 = 255;
+        int alpha[16];
+        for(int i = 0; i < 16; ++i) {
+            alpha[i] = (int)floorf(std::min<float>(std::max<float>(pixels[i * 4 + 3], 0.0f), 255.0f) + 0.5f);
+            a0 = std::max<int>(a0, alpha[i]);
+            a1 = std::min<int>(a1, alpha[i]);
+        }
+
+        // a0 > a1 selects the eight alpha palette
+        int palette[8] = { a0, a1, 0, 0, 0, 0, 0, 0 };
+        for(int k = 2; k < 8; ++k) {
+            palette[k] = ((8 - k) * a0 + (k - 1) * a1) / 7;
+        }
+
+        BlockBitWriter bits(dest, 8);
+        bits.write(a0, 8);
+        bits.write(a1, 8);
+        for(int i = 0; i < 16; ++i) {
+            int bestIndex = 0;
+            if(a0 != a1) {
+                for(int k = 1; k < 8; ++k) {
+                    if(abs(alpha[i] - palette[k]) < abs(alpha[i] - palette[bestIndex])) {
+                        bestIndex = k;
+                    }
+                }
+            }
+            bits.write(bestIndex, 3);
+        }
+    }
+
+    /** Utility function to write a BC7 mode 6 block for a pair of end points
+    @param pixels The 16 RGBA block pixels in the 0 - 255 range
+    @param e0 The line start
+    @param e1 The line end
+    @param dest Return param - the 16 byte block
+    @param weights Return param - the pixel weights between e0 and e1
+    @return the squared error of the block
+    */
+    static float encodeBC7Mode6(const float* pixels, const float* e0, const float* e1, uchar* dest, float* weights)
+    {
+        // 7 bit end points with a shared low bit (p bit) per end point
+        int q[2][4];
+        int p[2];
+        int endpoint[2][4];
+        const float* e[2] = { e0, e1 };
+        for(int j = 0; j < 2; ++j) {
+            float bestError = 1e30f;
+            for(int pBit = 0; pBit < 2; ++pBit) {
+                int candidate[4];
+                float error = 0.0f;
+                for(int c = 0; c < 4; ++c) {
+                    float v = std::min<float>(std::max<float>(e[j][c], 0.0f), 255.0f);
+                    candidate[c] = std::min<int>(127, (int)floorf((v - pBit) * 0.5f + 0.5f));
+                    candidate[c] = std::max<int>(0, candidate[c]);
+                    float d = v - (float)((candidate[c] << 1) | pBit);
+                    error += d * d;
+                }
+                if(error < bestError) {
+                    bestError = error;
+                    p[j] = pBit;
+                    for(int c = 0; c < 4; ++c) {
+                        q[j][c] = candidate[c];
+                        endpoint[j][c] = (candidate[c] << 1) | pBit;
+                    }
+                }
+            }
+        }
+
+        int palette[16][4];
+        for(int k = 0; k < 16; ++k) {
+            for(int c = 0; c < 4; ++c) {
+                palette[k][c] = ((64 - sWeights4[k]) * endpoint[0][c] + sWeights4[k] * endpoint[1][c] + 32) >> 6;
+            }
+        }
+
+        int indices[16];
+        float error = 0.0f;
+        for(int i = 0; i < 16; ++i) {
+            int bestIndex = 0;
+            float bestDist = 1e30f;
+            for(int k = 0; k < 16; ++k) {
+                float dist = 0.0f;
+                for(int c = 0; c < 4; ++c) {
+                    float d = pixels[i * 4 + c] - (float)palette[k][c];
+                    dist += d * d;
+                }
+                if(dist < bestDist) {
+                    bestDist = dist;
+                    bestIndex = k;
+                }
+            }
+
+            indices[i] = bestIndex;
+            error += bestDist;
+            weights[i] = sWeights4[bestIndex] / 64.0f;
+        }
+
+        // the first index is stored without its top bit so it must be < 8
+        int flip = indices[0] >= 8 ? 1 : 0;
+
+        BlockBitWriter bits(dest, 16);
+        bits.write(1 << 6, 7);
+        for(int c = 0; c < 4; ++c) {
+            bits.write(q[flip][c], 7);
+            bits.write(q[1 - flip][c], 7);
+        }
+        bits.write(p[flip], 1);
+        bits.write(p[1 - flip], 1);
+        for(int i = 0; i < 16; ++i) {
+            bits.write(flip ? 15 - indices[i] : indices[i], i == 0 ? 3 : 4);
+        }
+
+        return error;
+    }
+
+    /** Utility function to expand a 10 bit BC6H end point
+    @param q The quantized end point
+    @return the unquantized value
+    */
+    static int unquantizeBC6H(int q)
+    {
+        if(q == 0) {
+            return 0;
+        }
+        else if(q == 1023) {
+            return 0xFFFF;
+        }
+        return ((q << 16) + 0x8000) >> 10;
+    }
+
+    /** Utility function to quantize a BC6H end point to 10 bits
+    @param v The unquantized value
+    @return the closest quantized end point
+    */
+    static int quantizeBC6H(float v)
+    {
+        int guess = (int)floorf(std::min<float>(std::max<float>(v, 0.0f), 65535.0f) * (1023.0f / 65535.0f) + 0.5f);
+        int best = guess;
+        for(int q = std::max<int>(0, guess - 1); q <= std::min<int>(1023, guess + 1); ++q) {
+            if(fabsf((float)unquantizeBC6H(q) - v) < fabsf((float)unquantizeBC6H(best) - v)) {
+                best = q;
+            }
+        }
+        return best;
+    }
+
+    /** Utility function to write a BC6H mode 11 block for a pair of end points
+    @param pixels The 16 RGBA block pixels as unquantized half floats
+    @param e0 The line start
+    @param e1 The line end
+    @param dest Return param - the 16 byte block
+    @param weights Return param - the pixel weights between e0 and e1
+    @return the squared error of the block
+    */
+    static float encodeBC6HMode11(const float* pixels, const float* e0, const float* e1, uchar* dest, float* weights)
+    {
+        int q[2][3];
+        int endpoint[2][3];
+        for(int c = 0; c < 3; ++c) {
+            q[0][c] = quantizeBC6H(e0[c]);
+            q[1][c] = quantizeBC6H(e1[c]);
+            endpoint[0][c] = unquantizeBC6H(q[0][c]);
+            endpoint[1][c] = unquantizeBC6H(q[1][c]);
+        }
+
+        int palette[16][3];
+        for(int k = 0; k < 16; ++k) {
+            for(int c = 0; c < 3; ++c) {
+                palette[k][c] = ((64 - sWeights4[k]) * endpoint[0][c] + sWeights4[k] * endpoint[1][c] + 32) >> 6;
+            }
+        }
+
+        int indices[16];
+        float error = 0.0f;
+        for(int i = 0; i < 16; ++i) {
+            int bestIndex = 0;
+            float bestDist = 1e30f;
+            for(int k = 0; k < 16; ++k) {
+                float dist = 0.0f;
+                for(int c = 0; c < 3; ++c) {
+                    float d = pixels[i * 4 + c] - (float)palette[k][c];
+                    dist += d * d;
+                }
+                if(dist < bestDist) {
+                    bestDist = dist;
+                    bestIndex = k;
+                }
+            }
+
+            indices[i] = bestIndex;
+            error += bestDist;
+            weights[i] = sWeights4[bestIndex] / 64.0f;
+        }
+
+        // the first index is stored without its top bit so it must be < 8
+        int flip = indices[0] >= 8 ? 1 : 0;
+
+        BlockBitWriter bits(dest, 16);
+        bits.write(0x03, 5);
+        for(int j = 0; j < 2; ++j) {
+            for(int c = 0; c < 3; ++c) {
+                bits.write(q[j ^ flip][c], 10);
+            }
+        }
+        for(int i = 0; i < 16; ++i) {
+            bits.write(flip ? 15 - indices[i] : indices[i], i == 0 ? 3 : 4);
+        }
+
+        return error;
+    }
+
+    /** Constructor
+    @param format The compressed pixel format to write
+    @param quality The compression quality
+    */
+    SpacescapeBlockCompressor::SpacescapeBlockCompressor(PixelFormat format, Quality quality) :
+        mFormat(format),
+        mQuality(quality)
+    {
+    }
+
+    /** Compress an image
+    @param src The image to compress, in any pixel format
+    @param dest Memory for getCompressedSize() bytes
+    */
+    void SpacescapeBlockCompressor::compress(const PixelBox& src, uchar* dest) const
+    {
+        size_t blockSize = getBlockSize(mFormat);
+        if(!blockSize) {
+            return;
+        }
+
+        unsigned int width = (unsigned int)src.getWidth();
+        unsigned int height = (unsigned int)src.getHeight();
+        unsigned int blocksX = (width + 3) / 4;
+        unsigned int blocksY = (height + 3) / 4;
+        unsigned int tasksX = (blocksX + BLOCKS_PER_TASK - 1) / BLOCKS_PER_TASK;
+
+        SpacescapeThreadPool::getSingleton().parallelFor(tasksX * blocksY, [&](size_t task) {
+            unsigned int blockY = (unsigned int)(task / tasksX);
+            unsigned int firstBlockX = (unsigned int)(task % tasksX) * BLOCKS_PER_TASK;
+            unsigned int lastBlockX = std::min<unsigned int>(firstBlockX + BLOCKS_PER_TASK, blocksX);
+
+            // convert the rows of pixels these blocks cover to float
+            Box area(src.left + firstBlockX * 4, src.top + blockY * 4, 
+                src.left + std::min<unsigned int>(lastBlockX * 4, width), 
+                src.top + std::min<unsigned int>(blockY * 4 + 4, height));
+            unsigned int areaWidth = (unsigned int)area.getWidth();
+            unsigned int areaHeight = (unsigned int)area.getHeight();
+            std::vector<float> rows(areaWidth * areaHeight * 4);
+            PixelUtil::bulkPixelConversion(src.getSubVolume(area), 
+                PixelBox(areaWidth, areaHeight, 1, PF_FLOAT32_RGBA, &rows[0]));
+
+            for(unsigned int blockX = firstBlockX; blockX < lastBlockX; ++blockX) {
+                // gather the block, repeating the last row/column at the edges
+                float pixels[64];
+                for(unsigned int y = 0; y < 4; ++y) {
+                    unsigned int row = std::min<unsigned int>(y, areaHeight - 1);
+                    for(unsigned int x = 0; x < 4; ++x) {
+                        unsigned int column = std::min<unsigned int>((blockX - firstBlockX) * 4 + x, areaWidth - 1);
+                        const float* p = &rows[(row * areaWidth + column) * 4];
+                        float* out = &pixels[(y * 4 + x) * 4];
+                        if(mFormat == PF_BC6H_UF16) {
+                            // half float bits scaled so the hardware's 
+                            // final 31/64 scale gives them back
+                            for(int c = 0; c < 3; ++c) {
+                                float v = std::min<float>(std::max<float>(p[c], 0.0f), 65504.0f);
+                                out[c] = Bitwise::floatToHalf(v) * (64.0f / 31.0f);
+                            }
+                            out[3] = 1.0f;
+                        }
+                        else {
+                            for(int c = 0; c < 4; ++c) {
+                                out[c] = std::min<float>(std::max<float>(p[c], 0.0f), 1.0f) * 255.0f;
+                            }
+                        }
+                    }
+                }
+
+                uchar* block = dest + ((size_t)blockY * blocksX + blockX) * blockSize;
+                switch(mFormat) {
+                    case PF_DXT1:
+                        compressBC1(pixels, block);
+                        break;
+                    case PF_DXT5:
+                        encodeBC3Alpha(pixels, block);
+                        compressBC1(pixels, block + 8);
+                        break;
+                    case PF_BC6H_UF16:
+                        compressBC6H(pixels, block);
+                        break;
+                    case PF_BC7_UNORM:
+                        compressBC7(pixels, block);
+                        break;
+                    default:
+                        break;
+                }
+            }
+        });
+    }
+
+    /** Utility function to compress a BC1 colour block
+    @param pixels The 16 RGBA block pixels in the 0 - 255 range
+    @param dest Return param - the 8 byte block
+    */
+    void SpacescapeBlockCompressor::compressBC1(const float* pixels, uchar* dest) const
+    {
+        float e0[4], e1[4], weights[16];
+        fitLine(pixels, 3, e0, e1);
+        float bestError = encodeBC1(pixels, e0, e1, dest, weights);
+
+        int numRefinements = getNumRefinements();
+        for(int i = 0; i < numRefinements && bestError > 0.0f; ++i) {
+            uchar block[8];
+            float blockWeights[16];
+            if(!refineLine(pixels, 3, weights, e0, e1)) {
+                break;
+            }
+
+            float error = encodeBC1(pixels, e0, e1, block, blockWeights);
+            if(error >= bestError) {
+                break;
+            }
+
+            bestError = error;
+            memcpy(dest, block, 8);
+            memcpy(weights, blockWeights, sizeof(weights));
+        }
+    }
+
+    /** Utility function to compress a BC6H block
+    @param pixels The 16 RGBA block pixels as unquantized half floats
+    @param dest Return param - the 16 byte block
+    */
+    void SpacescapeBlockCompressor::compressBC6H(const float* pixels, uchar* dest) const
+    {
+        float e0[4], e1[4], weights[16];
+        fitLine(pixels, 3, e0, e1);
+        float bestError = encodeBC6HMode11(pixels, e0, e1, dest, weights);
+
+        int numRefinements = getNumRefinements();
+        for(int i = 0; i < numRefinements && bestError > 0.0f; ++i) {
+            uchar block[16];
+            float blockWeights[16];
+            if(!refineLine(pixels, 3, weights, e0, e1)) {
+                break;
+            }
+
+            float error = encodeBC6HMode11(pixels, e0, e1, block, blockWeights);
+            if(error >= bestError) {
+                break;
+            }
+
+            bestError = error;
+            memcpy(dest, block, 16);
+            memcpy(weights, blockWeights, sizeof(weights));
+        }
+    }
+
+    /** Utility function to compress a BC7 block
+    @param pixels The 16 RGBA block pixels in the 0 - 255 range
+    @param dest Return param - the 16 byte block
+    */
+    void SpacescapeBlockCompressor::compressBC7(const float* pixels, uchar* dest) const
+    {
+        float e0[4], e1[4], weights[16];
+        fitLine(pixels, 4, e0, e1);
+        float bestError = encodeBC7Mode6(pixels, e0, e1, dest, weights);
+
+        int numRefinements = getNumRefinements();
+        for(int i = 0; i < numRefinements && bestError > 0.0f; ++i) {
+            uchar block[16];
+            float blockWeights[16];
+            if(!refineLine(pixels, 4, weights, e0, e1)) {
+                break;
+            }
+
+            float error = encodeBC7Mode6(pixels, e0, e1, block, blockWeights);
+            if(error >= bestError) {
+                break;
+            }
+
+            bestError = error;
+            memcpy(dest, block, 16);
+            memcpy(weights, blockWeights, sizeof(weights));
+        }
+    }
+
+    /** Get the number of bytes in a compressed 4x4 block
+    @param format The compressed pixel format
+    @return the block size or 0 if the format isn't supported
+    */
+    size_t SpacescapeBlockCompressor::getBlockSize(PixelFormat format)
+    {
+        switch(format) {
+            case PF_DXT1:
+                return 8;
+            case PF_DXT5:
+            case PF_BC6H_UF16:
+            case PF_BC7_UNORM:
+                return 16;
+            default:
+                return 0;
+        }
+    }
+
+    /** Get the number of bytes an image compresses to
+    @param format The compressed pixel format
+    @param width The image width
+    @param height The image height
+    @return the compressed size
+    */
+    size_t SpacescapeBlockCompressor::getCompressedSize(PixelFormat format, unsigned int width, unsigned int height)
+    {
+        return (size_t)((width + 3) / 4) * ((height + 3) / 4) * getBlockSize(format);
+    }
+
+    /** Utility function to get the number of end point refinement
+    passes for the quality setting
+    @return the number of passes
+    */
+    int SpacescapeBlockCompressor::getNumRefinements(void) const
+    {
+        switch(mQuality) {
+            case BCQ_FAST:
+                return 0;
+            case BCQ_HIGH:
+                return 8;
+            default:
+                return 2;
+        }
+    }
+}
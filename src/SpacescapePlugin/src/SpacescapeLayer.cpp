@@ -28,6 +28,10 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
 #include "SpacescapeLayer.h"
+#include "SpacescapeMaskSampler.h"
+#include "SpacescapeNoiseCache.h"
+#include "SpacescapeNoiseGenerator.h"
+#include "SpacescapeRandom.h"
 #include "OgreMaterialManager.h"
 #include "OgreMaterial.h"
 #include "OgreTechnique.h"
@@ -38,6 +42,7 @@ THE SOFTWARE.
 #include "OgreSceneNode.h"
 #include "OgreRoot.h"
 #include "OgreRenderSystemCapabilities.h"
+#include "OgreLogManager.h"
 
 namespace Ogre
 {
@@ -48,6 +53,31 @@ namespace Ogre
         {1,1,0},    {0,-1,1},    {-1,1,0},    {0,-1,-1}
     };
 
+    /** Utility function for gathering the noise function args into a
+    SpacescapeNoiseParams struct
+    */
+    static SpacescapeNoiseParams makeNoiseParams(const String& noiseType,
+        ColourValue innerColor, ColourValue outerColor, unsigned int octaves,
+        Real lacunarity, Real gain, Real power, Real threshold, Real dither,
+        Real scale, Real offset, Real hdrPower, Real hdrMultiplier)
+    {
+        SpacescapeNoiseParams params;
+        params.noiseType = noiseType;
+        params.innerColor = innerColor;
+        params.outerColor = outerColor;
+        params.octaves = octaves;
+        params.lacunarity = lacunarity;
+        params.gain = gain;
+        params.power = power;
+        params.threshold = threshold;
+        params.dither = dither;
+        params.scale = scale;
+        params.offset = offset;
+        params.hdrPower = hdrPower;
+        params.hdrMultiplier = hdrMultiplier;
+        return params;
+    }
+
     /* Constructor
     */
     SpacescapeLayer::SpacescapeLayer(const String& name,SpacescapePlugin* plugin) :
@@ -55,6 +85,9 @@ namespace Ogre
         mDisplayHighRes(false),
         mHDREnabled(false),
         mRTTManualObject(0),
+        mPreparePending(false),
+        mPrepared(false),
+        mPreparing(false),
         mPlugin(plugin),
         mSeed(0)
     {
@@ -103,7 +136,8 @@ namespace Ogre
 
         float fDeltaRingAngle = (Math::PI / rings);
         float fDeltaSegAngle = (2 * Math::PI / segments);
-        unsigned short wVerticeIndex = 0 ;
+        // ManualObject switches to 32 bit indices by itself when needed
+        uint32 wVerticeIndex = 0 ;
 
         // Generate the group of rings for the sphere
         for(unsigned int ring = 0; ring <= rings; ring++ ) {
@@ -145,20 +179,57 @@ namespace Ogre
     */
     Real SpacescapeLayer::fbmNoise(Vector3 v, unsigned int octaves, Real gain, Real lacunarity)
     {
-        Real noiseSum = 0.0;
-        Real amplitude = 1.0;
-        Real amplitudeSum = 0.0;
+        float x = v.x, y = v.y, z = v.z, n;
+        fbmNoise(&x, &y, &z, &n, 1, octaves, gain, lacunarity);
+        return n;
+    }
+
+    /** Utility noise function for fbm perlin noise at an array of points
+    @remarks Each octave goes through the batch noise kernels for all
+    the points at once
+    @param x Array of x coordinates
+    @param y Array of y coordinates
+    @param z Array of z coordinates
+    @param out Array the noise values are written to
+    @param count Number of points
+    @param octaves Number of octaves
+    @param gain Noise gain at each level - same as persistance
+    @param lacunarity Applied at each level
+    */
+    void SpacescapeLayer::fbmNoise(const float* x, const float* y, const float* z, float* out, size_t count,
+        unsigned int octaves, Real gain, Real lacunarity)
+    {
+        // the scaled points and one octave of noise
+        std::vector<float> scratch(count * 4);
+        float* sx = &scratch[0];
+        float* sy = sx + count;
+        float* sz = sy + count;
+        float* noise = sz + count;
+        std::copy(x, x + count, sx);
+        std::copy(y, y + count, sy);
+        std::copy(z, z + count, sz);
+        std::fill(out, out + count, 0.0f);
+
+        float amplitude = 1.0;
+        float amplitudeSum = 0.0;
         
         // make some fbm noise
         for( unsigned int i = 0; i < octaves; i++) {
-            noiseSum += perlinNoise(v.x, v.y, v.z) * amplitude;
+            SpacescapeNoiseKernels::perlinNoise(mNoiseTables, sx, sy, sz, noise, count);
+            for(size_t j = 0; j < count; j++) {
+                out[j] += noise[j] * amplitude;
+                sx[j] *= lacunarity;
+                sy[j] *= lacunarity;
+                sz[j] *= lacunarity;
+            }
             amplitudeSum += amplitude;
             amplitude *= gain;
-            v *= lacunarity;
         }
         
         // get noiseSum in range -1..1    
-        return noiseSum / amplitudeSum;
+        for(size_t j = 0; j < count; j++) {
+            out[j] /= amplitudeSum;
+        }
     }
 
     /** Utility function to convert a blend mode string to int
@@ -243,13 +314,13 @@ namespace Ogre
             mPermutations[i] = i;
         }
 
-        // seed the random number generator
-        srand(seed);
+        // seed the random number generator the scene was made with
+        SpacescapeRandom random(seed, mPlugin->getRandomGenerator());
 
         // randomize the permutation table
         for(int i = 0; i < 256; i++) {
             // for each value swap with a random slot in the array 
-            uchar swapIndex = rand() % 256;
+            uchar swapIndex = random.nextBounded(256);
 
             int oldVal = mPermutations[i];
             mPermutations[i] = mPermutations[swapIndex];
@@ -262,6 +333,8 @@ namespace Ogre
             mGradients[i] = Vector3(grad3[h][0],grad3[h][1],grad3[h][2]).normalisedCopy();
             mGradients[i + 256] = mGradients[i];
         }
+
+        mNoiseTables.init(mPermutations, false);
     }
     
     #define lerp(t,a,b) ( (a)+(t)*((b)-(a)) )
@@ -331,6 +404,15 @@ namespace Ogre
         Real hdrMultiplier
 		)
 	{
+        // skip the rtt if this cube was baked before
+        String cacheKey;
+        SpacescapeNoiseParams cacheParams = makeNoiseParams(noiseType, innerColor, 
+            outerColor, octaves, lacunarity, gain, power, threshold, dither, scale, 
+            offset, hdrPower, hdrMultiplier);
+        if(uploadCachedNoise(texture, "gpu", seed, cacheParams, cacheKey)) {
+            return;
+        }
+
 		// update the rtt material
 		MaterialPtr material = mNoiseMaterial->getMaterial();
 
@@ -513,6 +595,341 @@ namespace Ogre
 
         // show other layers again
         mPlugin->getSceneNode()->setVisible(true,false);
+
+        if(!cacheKey.empty()) {
+            // read the faces back and add them to the cache
+            unsigned int size = (unsigned int)texture->getWidth();
+            PixelFormat format = texture->getFormat();
+            size_t faceSize = PixelUtil::getMemorySize(size, size, 1, format);
+            uchar* data = OGRE_ALLOC_T(uchar, faceSize * 6, MEMCATEGORY_GENERAL);
+
+            PixelBox faces[6];
+            for(int f = 0; f < 6; ++f) {
+                faces[f] = PixelBox(size, size, 1, format, data + f * faceSize);
+                texture->getBuffer(f)->blitToMemory(faces[f]);
+            }
+
+            mPlugin->_getNoiseCache()->write(cacheKey, faces);
+
+            OGRE_FREE(data, MEMCATEGORY_GENERAL);
+        }
+    }
+
+    /** Render noise to six cube faces in memory on the CPU
+    @remarks The faces line up with the ones renderNoiseToTexture renders
+    @param faces Array of six pixel boxes to write to, in any pixel format
+    @param size The width/height of each face
+    @param seed The seed for the random noise
+    @param noiseType The noise type - either "fbm" or "ridged"
+    @param innerColor Noise inner color
+    @param outerColor Noise outer color
+    @param octaves Number of octaves
+    @param lacunarity Lacunarity
+    @param gain Applied to each octave
+    @param power Power function to apply to final noise
+    @param threshold Lower shelf/threshold
+    @param dither Amount to dither the noise
+    @param scale Initial scale amount applied to unit sphere noise coords
+    @param offset Used for ridged noise
+    @param hdrPower HDR power function applied after the regular power function
+    @param hdrMultiplier HDR multiplier applied to the final colour
+    */
+    void SpacescapeLayer::renderNoiseToMemory(const PixelBox* faces,
+        unsigned int size,
+        unsigned int seed,
+        const String& noiseType,
+        ColourValue innerColor,
+        ColourValue outerColor,
+        unsigned int octaves,
+        Real lacunarity, Real gain,
+        Real power, Real threshold,
+        Real dither,
+        Real scale,
+        Real offset,
+        Real hdrPower,
+        Real hdrMultiplier
+        )
+    {
+        SpacescapeNoiseParams params = makeNoiseParams(noiseType, innerColor, 
+            outerColor, octaves, lacunarity, gain, power, threshold, dither, scale, 
+            offset, hdrPower, hdrMultiplier);
+
+        // initialize permutations table
+        initNoise(seed);
+
+        // reuse the cube if it was baked before
+        SpacescapeNoiseCache* cache = mPlugin->_getNoiseCache();
+        String key;
+        if(cache) {
+            key = SpacescapeNoiseCache::getKey("cpu", seed, mPlugin->getRandomGenerator(), params, size, faces[0].format);
+            if(cache->read(key, faces)) {
+                return;
+            }
+        }
+
+        SpacescapeNoiseGenerator generator(mPermutations, params);
+        generator.renderCube(size, faces);
+
+        if(cache) {
+            cache->write(key, faces);
+        }
+    }
+
+    /** Render noise to 3d texture on the CPU
+    @remarks Produces the same noise as renderNoiseToTexture but doesn't
+    need a render system - faces are split into tiles and rendered on the 
+    shared thread pool
+    @param texture the texture to render to
+    @param seed The seed for the random noise
+    @param noiseType The noise type - either "fbm" or "ridged"
+    @param innerColor Noise inner color
+    @param outerColor Noise outer color
+    @param octaves Number of octaves
+    @param lacunarity Lacunarity
+    @param gain Applied to each octave
+    @param power Power function to apply to final noise
+    @param threshold Lower shelf/threshold
+    @param dither Amount to dither the noise
+    @param scale Initial scale amount applied to unit sphere noise coords
+    @param offset Used for ridged noise
+    @param hdrPower HDR power function applied after the regular power function
+    @param hdrMultiplier HDR multiplier applied to the final colour
+    */
+    void SpacescapeLayer::renderNoiseToTextureCPU(TexturePtr& texture,
+        unsigned int seed,
+        const String& noiseType,
+        ColourValue innerColor,
+        ColourValue outerColor,
+        unsigned int octaves,
+        Real lacunarity, Real gain,
+        Real power, Real threshold,
+        Real dither,
+        Real scale,
+        Real offset,
+        Real hdrPower,
+        Real hdrMultiplier
+        )
+    {
+        // upload straight from the cache file if this cube was baked before
+        String cacheKey;
+        SpacescapeNoiseParams params = makeNoiseParams(noiseType, innerColor, 
+            outerColor, octaves, lacunarity, gain, power, threshold, dither, scale, 
+            offset, hdrPower, hdrMultiplier);
+        if(uploadCachedNoise(texture, "cpu", seed, params, cacheKey)) {
+            return;
+        }
+
+        // render all six faces straight into the texture format
+        unsigned int size = (unsigned int)texture->getWidth();
+        PixelFormat format = texture->getFormat();
+        size_t faceSize = PixelUtil::getMemorySize(size, size, 1, format);
+        uchar* data = OGRE_ALLOC_T(uchar, faceSize * 6, MEMCATEGORY_GENERAL);
+
+        PixelBox faces[6];
+        for(int f = 0; f < 6; ++f) {
+            faces[f] = PixelBox(size, size, 1, format, data + f * faceSize);
+        }
+
+        // uploadCachedNoise already missed, so render without looking again
+        initNoise(seed);
+        SpacescapeNoiseGenerator generator(mPermutations, params);
+        generator.renderCube(size, faces);
+
+        if(!cacheKey.empty()) {
+            mPlugin->_getNoiseCache()->write(cacheKey, faces);
+        }
+
+        // write to the surface
+        for(int f = 0; f < 6; ++f) {
+            HardwarePixelBufferSharedPtr pb = texture->getBuffer(f);
+            if(!pb->isLocked()) {
+                // blit from memory to the texture surface
+                pb->blitFromMemory(faces[f]);
+            }
+        }
+
+        OGRE_FREE(data, MEMCATEGORY_GENERAL);
+    }
+
+    /** Load what generating the CPU side data of this layer (i.e. the 
+    point or billboard lists) needs for the given params ahead of calling
+    prepareData() and then init() with the same params
+    @remarks Must be called on the render thread
+    @param params Layer params that will be specific to the derived class
+    */
+    void SpacescapeLayer::prepare(const NameValuePairList& params)
+    {
+        mPreparing = true;
+
+        try {
+            init(params);
+        }
+        catch(std::exception& e) {
+            // init() loads and generates everything itself instead
+            Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
+                "Unable to prepare layer " << getName() << ": " << e.what();
+            mPreparePending = false;
+            mPrepared = false;
+        }
+
+        mPreparing = false;
+
+        // rand() has a single global state, generate the data of scenes 
+        // made with it here instead of holding its lock on a worker thread
+        if(mPlugin->getRandomGenerator() == SpacescapeRandom::GENERATOR_RAND) {
+            prepareData();
+        }
+    }
+
+    /** Generate the CPU side data of this layer from what prepare() loaded
+    @remarks Safe to call on worker threads
+    */
+    void SpacescapeLayer::prepareData(void)
+    {
+        if(!mPreparePending) {
+            return;
+        }
+
+        mPreparePending = false;
+
+        try {
+            buildData();
+            mPrepared = true;
+        }
+        catch(std::exception&) {
+            // init() generates the data again and reports the error on the
+            // render thread
+        }
+    }
+
+    /** Upload a noise cube from the plugin's noise cache to a texture
+    @param texture The cubic texture to upload to
+    @param source What renders the cube on a miss, i.e. "gpu" or "cpu"
+    @param seed The seed for the random noise
+    @param params The noise settings
+    @param key Set to the cube key if the cache is enabled so a miss
+    can be added once rendered, left empty if it isn't
+    @return true if the cube was cached and uploaded, false if not
+    */
+    bool SpacescapeLayer::uploadCachedNoise(TexturePtr& texture, const String& source, 
+        unsigned int seed, const SpacescapeNoiseParams& params, String& key)
+    {
+        key.clear();
+
+        // only the top level is cached
+        SpacescapeNoiseCache* cache = mPlugin->_getNoiseCache();
+        if(!cache || texture->getNumMipmaps() > 0) {
+            return false;
+        }
+
+        unsigned int size = (unsigned int)texture->getWidth();
+        key = SpacescapeNoiseCache::getKey(source, seed, mPlugin->getRandomGenerator(), params, size, texture->getFormat());
+
+        SpacescapeNoiseCache::Cube cube;
+        if(!cache->open(key, size, texture->getFormat(), cube)) {
+            return false;
+        }
+
+        // callers expect the permutation table to be set up for this seed
+        initNoise(seed);
+
+        for(int f = 0; f < 6; ++f) {
+            HardwarePixelBufferSharedPtr pb = texture->getBuffer(f);
+            if(!pb->isLocked()) {
+                // blit from the mapped file to the texture surface
+                pb->blitFromMemory(cube.getFace(f));
+            }
+        }
+
+        return true;
+    }
+
+    /** Render a density mask and build a sampler over it
+    @remarks Nothing is rendered if the sampler was built with the same
+    settings already.  The CPU noise generator writes the mask straight
+    into the sampler, the render system path reads it back from a 
+    render target
+    @param sampler The sampler to build
+    @param size The width/height of each mask face
+    @param cpu Generate the mask on the CPU, always the case when 
+    software rendering
+    @param seed The seed for the random noise
+    @param noiseType The noise type - either "fbm" or "ridged"
+    @param octaves Number of octaves
+    @param lacunarity Lacunarity
+    @param gain Applied to each octave
+    @param power Power function to apply to final noise
+    @param threshold Lower shelf/threshold
+    @param scale Initial scale amount applied to unit sphere noise coords
+    @param offset Used for ridged noise
+    */
+    void SpacescapeLayer::updateMaskSampler(SpacescapeMaskSampler& sampler, unsigned int size,
+        bool cpu, unsigned int seed, const String& noiseType, unsigned int octaves, 
+        Real lacunarity, Real gain, Real power, Real threshold, Real scale, Real offset)
+    {
+        cpu |= mPlugin->isSoftwareRenderingEnabled();
+
+        // the key holds everything the mask depends on
+        SpacescapeNoiseParams params = makeNoiseParams(noiseType, ColourValue::White, 
+            ColourValue::Black, octaves, lacunarity, gain, power, threshold, 0.0, scale, 
+            offset, 1.0, 1.0);
+        String key = SpacescapeNoiseCache::getKey(cpu ? "cpu" : "gpu", seed, mPlugin->getRandomGenerator(), params, 
+            size, PF_L8);
+        if(key == sampler.getKey()) {
+            return;
+        }
+
+        if(sampler.getSize() != size) {
+            sampler.setSize(size);
+        }
+
+        // face orientation is +X (0), -X (1), +Y (2), -Y (3), +Z (4), -Z (5)
+        PixelBox faces[6];
+        for(unsigned int i = 0 ; i < 6; ++i) {
+            faces[i] = sampler.getFace(i);
+        }
+
+        if(cpu) {
+            // generate the same noise mask on the cpu
+            renderNoiseToMemory(faces, size, seed, noiseType, ColourValue::White, 
+                ColourValue::Black, octaves, lacunarity, gain, power, threshold, 0.0, 
+                scale, offset);
+        }
+        else {
+            // remove the old noise texture if it exists
+            String name = "SpacescapeMaskTexture" + StringConverter::toString(mUniqueID);
+            TexturePtr t = TextureManager::getSingleton().getByName(name);
+            if(!t.isNull()) {
+                TextureManager::getSingleton().remove(t->getHandle());
+            }
+
+            // create the noise texture (cubic)
+            t = TextureManager::getSingleton().createManual(
+                name,
+                ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME,
+                TEX_TYPE_CUBE_MAP,
+                size, size, 
+                1,
+                0, // no mip maps
+                mMaskFBOPixelFormat,
+                TU_RENDERTARGET
+            );
+
+            // rtt a noise mask to a cubic texture
+            renderNoiseToTexture(t, seed, noiseType, ColourValue::White, 
+                ColourValue::Black, octaves, lacunarity, gain, power, threshold, 0.0, 
+                scale, offset);
+
+            // copy the texture into the sampler
+            for(int i = 0 ; i < 6; ++i) {
+                t->getBuffer(i)->blitToMemory(faces[i]);
+            }
+
+            // free the temp noise mask texture
+            TextureManager::getSingleton().remove(t->getHandle());
+        }
+
+        sampler.build(key);
     }
 
     /** Ridge function for Ridged FBM noise
@@ -536,24 +953,62 @@ namespace Ogre
     */
     Real SpacescapeLayer::ridgedFbmNoise(Vector3 v, unsigned int octaves, Real gain, Real lacunarity, Real offset)
     {
-        float noiseSum = 0.0;
+        float x = v.x, y = v.y, z = v.z, n;
+        ridgedFbmNoise(&x, &y, &z, &n, 1, octaves, gain, lacunarity, offset);
+        return n;
+    }
+
+    /** Utility noise function for ridged fbm perlin noise at an array of points
+    @remarks Each octave goes through the batch noise kernels for all
+    the points at once
+    @param x Array of x coordinates
+    @param y Array of y coordinates
+    @param z Array of z coordinates
+    @param out Array the noise values are written to
+    @param count Number of points
+    @param octaves Number of octaves
+    @param gain Noise gain at each level - same as persistance
+    @param lacunarity Applied at each level
+    @param offset
+    */
+    void SpacescapeLayer::ridgedFbmNoise(const float* x, const float* y, const float* z, float* out, size_t count,
+        unsigned int octaves, Real gain, Real lacunarity, Real offset)
+    {
+        // the scaled points, one octave of noise and the previous octave
+        std::vector<float> scratch(count * 5);
+        float* sx = &scratch[0];
+        float* sy = sx + count;
+        float* sz = sy + count;
+        float* noise = sz + count;
+        float* prev = noise + count;
+        std::copy(x, x + count, sx);
+        std::copy(y, y + count, sy);
+        std::copy(z, z + count, sz);
+        std::fill(prev, prev + count, 1.0f);
+        std::fill(out, out + count, 0.0f);
+
         float amplitude = 1.0;
         float amplitudeSum = 0.0;
-        float prev = 1.0;
-        float n;
         
         // make some ridged fbm noise
         for( unsigned int i = 0; i < octaves; i++) {
-            n = ridge(perlinNoise(v.x, v.y, v.z), offset);
-            noiseSum += n * amplitude * prev;
-            prev = n;
+            SpacescapeNoiseKernels::perlinNoise(mNoiseTables, sx, sy, sz, noise, count);
+            for(size_t j = 0; j < count; j++) {
+                float n = ridge(noise[j], offset);
+                out[j] += n * amplitude * prev[j];
+                prev[j] = n;
+                sx[j] *= lacunarity;
+                sy[j] *= lacunarity;
+                sz[j] *= lacunarity;
+            }
             amplitudeSum += amplitude;
             amplitude *= gain;
-            v *= lacunarity;
         }
         
         // get noiseSum in range -1..1    
-        return noiseSum / amplitudeSum;  
+        for(size_t j = 0; j < count; j++) {
+            out[j] /= amplitudeSum;
+        }
     }
 
     /** Set hdr enabled
@@ -693,6 +1148,7 @@ namespace Ogre
         return 32.0 * (n0 + n1 + n2 + n3); // TODO: The scale factor is preliminary!
     }
 
+
     /** Utility function for updating saved params list
     @param params The list of params
     */
@@ -28,6 +28,9 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
 #include "SpacescapeLayerBillboards.h"
+#include "SpacescapePreviewLOD.h"
+#include "SpacescapeRandom.h"
+#include "SpacescapeStarCatalog.h"
 #include "OgreRoot.h"
 #include "OgreBillboard.h"
 #include "OgreMaterialManager.h"
@@ -52,6 +55,38 @@ namespace Ogre
         UV = uv0;\n\
     }";
     
+    // faces one quad per billboard instance to the camera the same way as
+    // SpacescapeBillboardKernels::genFacingQuads
+    static const String spacescape_billboards_instanced_glsl_vp = "attribute vec4 vertex;\n\
+    attribute vec3 normal;\n\
+    attribute vec4 colour;\n\
+    attribute vec4 uv0;\n\
+    attribute vec2 uv1;\n\
+    attribute vec4 uv2;\n\
+    uniform mat4 worldViewProj;\n\
+    uniform vec4 cameraPosition;\n\
+    uniform vec4 cameraUp;\n\
+    varying vec3 hdrColor;\n\
+    varying vec2 UV;\n\
+    void main()\n\
+    {\n\
+        vec3 dir = vertex.xyz - cameraPosition.xyz;\n\
+        float len = length(dir);\n\
+        if(len > 0.0) dir /= len;\n\
+        vec3 up = cameraUp.xyz;\n\
+        if(cameraUp.w > 0.5 && abs(dot(dir, up)) > 0.99) up = vec3(0.0, 0.0, 1.0);\n\
+        vec3 x = cross(dir, up);\n\
+        len = length(x);\n\
+        if(len > 0.0) x /= len;\n\
+        vec3 y = cross(x, dir);\n\
+        vec3 pos = vertex.xyz + x * (uv0.x * uv1.x) + y * (uv0.y * uv1.y);\n\
+        gl_Position = worldViewProj * vec4(pos, 1.0);\n\
+        hdrColor = normal;\n\
+        UV = mix(uv2.xy, uv2.zw, uv0.zw);\n\
+        gl_FrontColor = colour;\n\
+        gl_TexCoord[0] = vec4(UV, 0.0, 1.0);\n\
+    }";
+    
 	static const String spacescape_billboards_glsl_fp = "uniform sampler2D tex;\n\
 														    varying vec3 hdrColor;\n\
 															    varying vec2 UV;\n\
@@ -73,6 +108,8 @@ namespace Ogre
         mFarColor(ColourValue(1.0,1.0,1.0)),
         mHDRPower(1.0),
         mHDRMultiplier(1.0),
+        mMagnitudeLimit(6.5),
+        mMaskCPUNoise(false),
         mMaskEnabled(false),
         mMaskGain(0.5),
         mMaskLacunarity(2.0),
@@ -81,11 +118,18 @@ namespace Ogre
         mMaskPower(1.0),
         mMaskScale(1.0),
         mMaskSeed(1),
+        mMaskSize(512),
         mMaskThreshold(0.0),
         mMaxSize(0.2),
         mMinSize(0.2),
         mNearColor(ColourValue(1.0,1.0,1.0)),
         mNumBillboards(100),
+        mNumFullBillboards(0),
+        mPreviewBillboardCount(0),
+        mPreviewBillboardStart(0),
+        mRegionDec(0.0),
+        mRegionRA(0.0),
+        mRegionRadius(180.0),
         mSourceBlendFactor(SBF_ONE),
         mStarDataFilename("")
     {
@@ -106,36 +150,93 @@ namespace Ogre
         */
     }
 
-    /** Utility function for building based on class params
+    /** Utility function to add a billboard to the sprite list
+    @remarks When software rendering the list holds the billboards the way
+    the software renderer draws them, otherwise it holds the billboards 
+    waiting for createBillboards() to add them to the billboard set
+    @param position The billboard position
+    @param size The billboard width and height
+    @param colour The billboard colour
+    @param hdrColour The billboard colour used in HDR mode
+    */
+    void SpacescapeLayerBillboards::addBillboard(const Vector3& position, Real size, const ColourValue& colour, const ColourValue& hdrColour)
+    {
+        SpacescapeSoftwareRenderer::Sprite sprite;
+        sprite.position = position;
+        sprite.width = size;
+        sprite.height = size;
+        sprite.colour = colour;
+
+        if(!mPlugin->isSoftwareRenderingEnabled()) {
+            mSpriteHDRColours.push_back(hdrColour);
+        }
+        else if(mHDREnabled) {
+            // the hdr shader outputs the hdr colour with the texture alpha
+            sprite.colour = ColourValue(hdrColour.r, hdrColour.g, hdrColour.b, 1.0);
+        }
+
+        mSprites.push_back(sprite);
+    }
+
+    /** Add the draw calls for this layer to a software renderer
+    @param renderer The renderer to add to
+    */
+    void SpacescapeLayerBillboards::addToSoftwareRenderer(SpacescapeSoftwareRenderer& renderer)
+    {
+        Image img;
+        bool textured = loadTextureImage(img);
+
+        // textures only get mip maps in non-hdr mode, see updateMaterial()
+        renderer.addSprites(mSprites, textured ? &img : 0, !mHDREnabled, mSourceBlendFactor, mDestBlendFactor);
+    }
+
+    /** Generate the sprite list from the loaded star catalog or noise mask
+    */
+    void SpacescapeLayerBillboards::buildData(void)
+    {
+        if(mStarDataFilename != "") {
+            buildFromCatalog();
+        }
+        else if(mMaskEnabled) {
+            buildMasked();
+        }
+        else {
+            build();
+        }
+    }
+
+    /** Utility function for building the sprite list based on class params
     */
     void SpacescapeLayerBillboards::build(void) 
     {
-        createBillboardSet();
+        // clear the old list
+        mSprites.clear();
+        mSpriteHDRColours.clear();
 
-        // seed random number generator
-        srand(mSeed);
+        // seed the random number generator the scene was made with
+        SpacescapeRandom random(mSeed, mPlugin->getRandomGenerator());
 
         // now create the billboards
         Vector3 v;
         ColourValue c;
         for(unsigned int i = 0; i < mNumBillboards; ++i) {
            // nice distribution of random points on sphere
-            Real u = -1.0 + 2.0 * rand() / ((double) RAND_MAX);
-            Real a = Ogre::Math::TWO_PI * rand() / ((double) RAND_MAX);
+            Real u = -1.0 + 2.0 * random.nextUnit();
+            Real a = Ogre::Math::TWO_PI * random.nextUnit();
             Real s = sqrt(1 - u*u);
 
 //            v.x = s * cos(a);
 //            v.y = s * sin(a);
 //            v.z = u;
 //            v.normalise();
-            SpacescapeBillboard* b = mBillboardSet->createBillboard(
+            v = Vector3(
                 s * cos(a),
                 s * sin(a),
                 u
             );
 
             // random distance
-            double dist = rand() / ((double) RAND_MAX);
+            double dist = random.nextUnit();
 
             if(mHDREnabled) {
                 dist = powf(dist, mHDRPower);
@@ -144,123 +245,52 @@ namespace Ogre
             // size is based on distance and min/max allowed sizes
             // closer distances are larger
             Real size = mMinSize + (mMaxSize - mMinSize) * (1.0 - dist);
-            b->setDimensions(size, size);
 
             // color is based on distance (linear interpolation here)
             c = mNearColor + (dist * (mFarColor - mNearColor));
-            b->setColour(c);
-            
-            if(mHDREnabled) {
-                c *= mHDRMultiplier;
-                b->mHDRColour = c;
-            }
+            addBillboard(v, size, c, c * mHDRMultiplier);
         }
-
-        mBuilt = true;
     }
 
-    /** Utility function for building based on class params (masked)
+    /** Utility function for building the sprite list based on class params 
+    (masked)
+    @remarks The mask must be up to date, see updateMask()
     */
     void SpacescapeLayerBillboards::buildMasked(void) 
     {
-        createBillboardSet();
+        // clear the old list
+        mSprites.clear();
+        mSpriteHDRColours.clear();
 
-        // remove the old noise texture if it exists (new one might be diff size due to layer switch ups)
-        TexturePtr t = TextureManager::getSingleton().getByName("SpacescapeBillboardMask");
-        if(!t.isNull()) {
-            TextureManager::getSingleton().remove(t->getHandle());
+        if(mMaskSampler.isEmpty()) {
+            // nothing to place billboards on
+            return;
         }
 
-        // should be a good approximation
-        uint maskSize = 512;
-
-        // create the noise texture (cubic)
-        t = TextureManager::getSingleton().createManual(
-            "SpacescapeBillboardMask",
-            ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME,
-            TEX_TYPE_CUBE_MAP,
-            maskSize, maskSize, 
-            1,
-            0, // no mip maps
-            mMaskFBOPixelFormat,
-            TU_RENDERTARGET
-        );
+        // seed the random number generator the scene was made with
+        SpacescapeRandom random(mSeed, mPlugin->getRandomGenerator());
 
-        // rtt a noise mask to a cubic texture then use this texture
-        // in place of the noise functions below
-        renderNoiseToTexture(
-            t,
-            mMaskSeed,
-            mMaskNoiseType,
-            ColourValue::White,
-            ColourValue::Black,
-            mMaskOctaves,
-            mMaskLacunarity,
-            mMaskGain,
-            mMaskPower,
-            mMaskThreshold,
-            0.0,
-            mMaskScale,
-            mMaskOffset
-        );
-
-        // face orientation is +X (0), -X (1), +Y (2), -Y (3), +Z (4), -Z (5)
-        // copy the texture into buffers
-        uchar* faceBuffers[6];
-        for(int i = 0 ; i < 6; ++i) {
-            faceBuffers[i] = OGRE_ALLOC_T( uchar, maskSize * maskSize * 4, MEMCATEGORY_GENERAL);
-            t->getBuffer(i)->blitToMemory(
-                PixelBox(t->getWidth(), t->getHeight(), 1, t->getFormat(), faceBuffers[i])
-            );
-        }
-
-        // seed random number generator
-        srand(mSeed);
-
-        // now create the billboards
-        unsigned int numPoints = std::min<unsigned int>(RAND_MAX,mNumBillboards);
+        // now create the billboards, scenes made with rand() keep placing 
+        // them the old way
+        bool rejection = random.getGenerator() == SpacescapeRandom::GENERATOR_RAND;
+        unsigned int numPoints = rejection ? std::min<unsigned int>(RAND_MAX, mNumBillboards) : mNumBillboards;
         unsigned int numPointsTested = 0;
-        unsigned int maxNumTestPoints = 99999;
 
-        Real n;
-        //Real scale = 2.0 / (Real)maskSize;
         ColourValue c;
-        Real noiseScale = 1.0 / 255.0;
         while(numPoints) {
-            // pick random co-ords on the top face
-            Real rU = rand() / ((double) RAND_MAX);
-            Real rV = rand() / ((double) RAND_MAX);
-
-            // scale u,v to 0..maskSize
-            uint u = std::min<uint>(rU * maskSize,maskSize);
-            uint v = std::min<uint>(rV * maskSize,maskSize);
-
-            // pick a random face
-            uchar face = rand() % 6;
-
-            // use noise mask to discard positions
-            ++numPointsTested;
-
-            // get the noise value at this position 0..255
-            n = faceBuffers[face][((v * maskSize) + u) * 4];
-
-            // scale n to between 0..1
-            n *= noiseScale;
-
-            // get a random value between 0..1 to use for density test
-            double r = rand() / ((double) RAND_MAX);
-
-            // now see if the random value is less than the noise value
-            // should give us a greater density of points for higher noise values
-            if(r > (n * n)) {
-
-                // only test a certain number of points so we don't infinite loop
-                if(numPointsTested == maxNumTestPoints) {
-                    numPoints--;
-                }
+            // pick a random position weighted by the mask density
+            unsigned int face;
+            Real rU, rV;
+            if(!rejection) {
+                mMaskSampler.sample(random, face, rU, rV);
+            }
+            else if(!mMaskSampler.sampleRejection(random, numPointsTested, face, rU, rV)) {
+                // too many positions thrown away, drop this billboard
+                numPoints--;
                 continue;
             }
-            
+            numPoints--;
+
             // scale u and v to range -1 .. 1
             Vector3 p = Vector3( (rU * 2.0) - 1.0 , 1.0, (rV * 2.0) - 1.0);
 
@@ -268,13 +298,8 @@ namespace Ogre
             rotatePoint(p,face);
             p.z = -p.z;
 
-            // use this position
-            SpacescapeBillboard* b = mBillboardSet->createBillboard(p.normalisedCopy());
-            numPoints--;
-            numPointsTested = 0;
-
             // random distance
-            float dist = rand() / ((double) RAND_MAX);
+            float dist = random.nextUnit();
 
             if(mHDREnabled) {
                 dist = powf(dist, mHDRPower);
@@ -283,178 +308,157 @@ namespace Ogre
             // size is based on distance and min/max allowed sizes
             // closer distances are larger
             Real size = mMinSize + (mMaxSize - mMinSize) * (1.0 - dist);
-            b->setDimensions(size, size);
             
             // color is based on distance (linear interpolation here)
             c = mNearColor + (dist * (mFarColor - mNearColor));
-            b->setColour(c);
 
-            if(mHDREnabled) {
-                c *= mHDRMultiplier;
-                b->mHDRColour = c;
-            }
-        }
-
-        for(int i = 0 ; i < 6; ++i) {
-            OGRE_FREE(faceBuffers[i],MEMCATEGORY_GENERAL);
+            // use this position
+            addBillboard(p.normalisedCopy(), size, c, c * mHDRMultiplier);
         }
-
-        // free the temp noise mask texture
-        TextureManager::getSingleton().remove(t->getHandle());
-
-        mBuilt = true;
     }
 
-    /** Utility function for building based on predefined positions/colours
+    /** Utility function for building the sprite list based on predefined 
+    positions/colours
+    @remarks The catalog must be loaded into mStarCatalog, it is cleared
+    afterwards
      */
-    void SpacescapeLayerBillboards::buildFromFile(const String &filename)
+    void SpacescapeLayerBillboards::buildFromCatalog(void)
     {
-        createBillboardSet();
-        
-        // load/parse the file - we don't handle quotes!!
-        std::fstream dataFile(filename, std::ios_base::in);
-        std::string line;
-        int xOffset = -1;
-        int yOffset = -1;
-        int zOffset = -1;
-        int bvOffset = -1;
-        int magOffset = -1;
-        int nameOffset = -1;
-        int distanceOffset = -1;
-        int isHeader = true;
-        
-        double maxDist = 20000.0; // in parsecs?
+        // clear the old list
+        mSprites.clear();
+        mSpriteHDRColours.clear();
         
+        // the catalog failed to load
+        const SpacescapeStarCatalog& catalog = mStarCatalog;
+        if(!catalog.getNumStars()) {
+            return;
+        }
+
+        // catalog x points at RA 0 Dec 0 and z at the north celestial pole
+        Radian ra = Degree(mRegionRA);
+        Radian dec = Degree(mRegionDec);
+        Vector3 regionDirection(Math::Cos(dec) * Math::Cos(ra), Math::Cos(dec) * Math::Sin(ra), Math::Sin(dec));
+
         // remember magnitude is reversed! -1.5 is brightest and 6.5 is dimmest
         double magMin = -1.5;
         double magMax = 6.5;
         double magRatio = 1.0 / (magMax - magMin);
-        while(getline(dataFile, line)) {
-            std::stringstream ss(line);
-            std::string item;
-            if(isHeader) {
-                int offset = 0;
-                while(std::getline(ss, item, ',')) {
-                    if(item == "x" || item == "X") {
-                        xOffset = offset;
-                    }
-                    else if(item == "y" || item == "Y") {
-                        yOffset = offset;
-                    }
-                    else if(item == "z" || item == "Z") {
-                        zOffset = offset;
-                    }
-                    else if(item == "colorIndex" || item == "ColorIndex" || item == "bv" || item == "BV") {
-                        bvOffset = offset;
-                    }
-                    else if(item == "AbsMag" || item == "absmag") {
-                        magOffset = offset;
-                    }
-                    else if(item == "distance" || item == "Distance") {
-                        distanceOffset = offset;
-                    }
-                    else if(item == "ProperName" || item == "name") {
-                        nameOffset = offset;
-                    }
-                    offset++;
-                }
-            }
-            else {
-                if(xOffset == -1 || yOffset == -1 || zOffset == -1 || distanceOffset == -1 || magOffset == -1) {
-                    Ogre::LogManager::getSingleton().getDefaultLog()->stream() <<
-                    "CSV file first line must have x,y,z,absmag,distance";
-                    break;
-                }
-                
-                std::vector<std::string> elems;
-                while(std::getline(ss,item,',')) {
-                    elems.push_back(item);
-                }
-                
-                if(elems.size() < 6) {
-                    continue;
-                }
-                
 
-                // scale distance from 0..maxDist to 0..1
-                Real dist = Ogre::StringConverter::parseReal(elems[distanceOffset]);
-                
-                // skip objects like our sun that are too close
-                if(dist < 0.1) continue;
+        std::vector<uint32> stars;
+        catalog.getStars(mMagnitudeLimit, regionDirection, Degree(mRegionRadius), stars);
 
-                // magnitude is inverse! wierdo astronomers
-                Real mag = Ogre::StringConverter::parseReal(elems[magOffset]);
-                
-                Real brightness = mag - 5*log10(10.0/dist);
-                // skip objects that are too faint
+        const float* xs = catalog.getColumn(SpacescapeStarCatalog::SC_X);
+        const float* ys = catalog.getColumn(SpacescapeStarCatalog::SC_Y);
+        const float* zs = catalog.getColumn(SpacescapeStarCatalog::SC_Z);
+        const float* bvs = catalog.getColumn(SpacescapeStarCatalog::SC_BV);
+        const float* dists = catalog.getColumn(SpacescapeStarCatalog::SC_DISTANCE);
+        
+        double maxDist = 20000.0; // in parsecs?
+        
+        for(size_t j = 0; j < stars.size(); ++j) {
+            uint32 i = stars[j];
 
-                if(brightness > magMax) continue;
-                
-                // position gets normalised
-                Vector3 pos = Ogre::StringConverter::parseVector3(elems[xOffset] + " " + elems[yOffset] + " " + elems[zOffset]);
-                pos.normalise();
-                SpacescapeBillboard* b = mBillboardSet->createBillboard(pos);
-                
-                
-                dist = std::min<Real>(dist,maxDist);
-                dist *= 1.0/maxDist;
-                dist = std::max<Real>(0,dist);
+            // scale distance from 0..maxDist to 0..1
+            Real dist = dists[i];
+            
+            // skip objects like our sun that are too close
+            if(dist < 0.1) continue;
 
-                // size is based on distance and min/max allowed sizes
-                // closer distances are larger
-                Real size = mMinSize + (mMaxSize - mMinSize) * (1.0 - dist);
-                b->setDimensions(size, size);
+            // magnitude is inverse! wierdo astronomers, getStars() already
+            // skipped objects that are too faint
+            Real brightness = catalog.getApparentMagnitude(i);
+            
+            // position gets normalised
+            Vector3 pos(xs[i], ys[i], zs[i]);
+            pos.normalise();
+            
+            dist = std::min<Real>(dist,maxDist);
+            dist *= 1.0/maxDist;
+            dist = std::max<Real>(0,dist);
+
+            // size is based on distance and min/max allowed sizes
+            // closer distances are larger
+            Real size = mMinSize + (mMaxSize - mMinSize) * (1.0 - dist);
 
-                ColourValue c;
+            ColourValue c;
+            ColourValue hdrColour;
+            
+            if(bvs) {
+                c = getColourValueFromBV(bvs[i]);
                 
-                if(bvOffset != -1) {
-                    c = getColourValueFromBV(Ogre::StringConverter::parseReal(elems[bvOffset]));
-                    b->setColour(c);
-                    
-                    mag = (magMax - magMin) - brightness - magMin;
-                    
-                    if(mHDREnabled) {
-                        if(mHDRPower != 1.0) {
-                            mag *= magRatio;
-                            mag = pow(mag,mHDRPower);
-                            mag *= (magMax - magMin);
-                        }
-                        c *= mag;
-                        c *= mHDRMultiplier;
-                        b->mHDRColour = c;
+                // stars fainter than magMax are only shown when the limit
+                // is raised, keep them from going negative
+                Real mag = std::max<Real>(0, (magMax - magMin) - brightness - magMin);
+                
+                if(mHDREnabled) {
+                    if(mHDRPower != 1.0) {
+                        mag *= magRatio;
+                        mag = pow(mag,mHDRPower);
+                        mag *= (magMax - magMin);
                     }
                 }
-                else {
-                    if(mHDREnabled) {
-                        dist = powf(dist, mHDRPower);
-                    }
-                    
-                    // color is based on distance (linear interpolation here)
-                    c = mNearColor + (dist * (mFarColor - mNearColor));
-                    b->setColour(c);
-                    
-                    if(mHDREnabled) {
-                        c *= mHDRMultiplier;
-                        b->mHDRColour = c;
-                    }
+                hdrColour = c * mag * mHDRMultiplier;
+            }
+            else {
+                if(mHDREnabled) {
+                    dist = powf(dist, mHDRPower);
                 }
                 
-
-//                Ogre::LogManager::getSingleton().getDefaultLog()->stream() <<
-//                "Billboard: mag: " << Ogre::StringConverter::toString(mag) << "(" << elems[magOffset] << ")";
-//                Ogre::LogManager::getSingleton().getDefaultLog()->stream() <<
-//                "Billboard: " << elems[xOffset] << " " << elems[yOffset] << " " << elems[zOffset] << " distance: " << Ogre::StringConverter::toString(dist) << "(" << elems[distanceOffset] << ")" << " color: " << Ogre::StringConverter::toString(c) << "(" << elems[bvOffset] << ") mag: " << elems[magOffset];
+                // color is based on distance (linear interpolation here)
+                c = mNearColor + (dist * (mFarColor - mNearColor));
+                hdrColour = c * mHDRMultiplier;
             }
-            isHeader = false;
+
+            addBillboard(pos, size, c, hdrColour);
         }
-        dataFile.close();
-        
-        mBuilt = true;
+
+        // the sprite list holds everything needed from the catalog now
+        mStarCatalog.clear();
     }
     
+    /** Utility function to add the billboards in the sprite list to the
+    billboard set
+    @remarks The list is freed afterwards, the billboard set keeps its own
+    copy of the billboards
+    */
+    void SpacescapeLayerBillboards::createBillboards(void)
+    {
+        // dense layers draw their brightest billboards and impostors for 
+        // the rest in the preview
+        std::vector<uint32> order;
+        SpacescapeSoftwareRenderer::SpriteList impostors;
+        std::vector<ColourValue> impostorHDRColours;
+        size_t omitted = SpacescapePreviewLOD::build(mSprites, mSpriteHDRColours, order, impostors, impostorHDRColours);
+
+        createBillboardSet(impostors.size());
+
+        size_t numSprites = mSprites.size();
+        for(size_t i = 0; i < numSprites + impostors.size(); ++i) {
+            size_t index = order.empty() || i >= numSprites ? i : order[i];
+            const SpacescapeSoftwareRenderer::Sprite& sprite = i < numSprites ? mSprites[index] : impostors[i - numSprites];
+            size_t b = mBillboardSet->createBillboard(sprite.position, sprite.colour);
+            mBillboardSet->setBillboardDimensions(b, sprite.width, sprite.height);
+
+            if(mHDREnabled) {
+                mBillboardSet->setBillboardHDRColour(b, i < numSprites ? mSpriteHDRColours[index] : impostorHDRColours[i - numSprites]);
+            }
+        }
+
+        mNumFullBillboards = numSprites;
+        mPreviewBillboardStart = omitted;
+        mPreviewBillboardCount = numSprites + impostors.size() - omitted;
+        updateBillboardRange();
+
+        mBillboardSet->notifyBillboardDataChanged();
+
+        SpacescapeSoftwareRenderer::SpriteList().swap(mSprites);
+        std::vector<ColourValue>().swap(mSpriteHDRColours);
+    }
+
     /** Utility function for preparing the billboard set
+    @param numImpostors Number of preview impostors to make room for
      */
-    void SpacescapeLayerBillboards::createBillboardSet()
+    void SpacescapeLayerBillboards::createBillboardSet(size_t numImpostors)
     {
         // get the default scene manager
         if(!Ogre::Root::getSingleton().getSceneManagerIterator().hasMoreElements()) {
@@ -463,6 +467,10 @@ namespace Ogre
         }
         SceneManager* sceneMgr = Root::getSingleton().getSceneManagerIterator().peekNextValue();
         
+        // data files decide the number of billboards themselves, size the
+        // pool once instead of doubling it while adding them
+        size_t poolSize = std::max<size_t>(std::max<size_t>(mNumBillboards, mSprites.size()) + numImpostors, 1);
+
         // create the billboardset if it doesn't exist
         String name = "SpacescapeLayerBillboardset" + StringConverter::toString(mUniqueID);
         if(!sceneMgr->hasMovableObject(name, SpacescapeBillboardSetFactory::FACTORY_TYPE_NAME)) {
@@ -470,7 +478,7 @@ namespace Ogre
                 Ogre::Root::getSingleton().addMovableObjectFactory(OGRE_NEW SpacescapeBillboardSetFactory());
             }
             NameValuePairList params;
-            params["poolSize"] = StringConverter::toString(mNumBillboards);
+            params["poolSize"] = StringConverter::toString(poolSize);
             mBillboardSet = static_cast<SpacescapeBillboardSet*>(sceneMgr->createMovableObject(name, SpacescapeBillboardSetFactory::FACTORY_TYPE_NAME, &params));
         }
         else {
@@ -484,11 +492,19 @@ namespace Ogre
         }
         
         // initialize the billboard set
-        mBillboardSet->setPoolSize(mNumBillboards);
+        mBillboardSet->setPoolSize(poolSize);
         mBillboardSet->setMaterialName(mMaterial->getName());
         mBillboardSet->setDefaultDimensions(mMinSize,mMinSize);
         mBillboardSet->setCastShadows(false);
         mBillboardSet->setUseAccurateFacing(true);
+
+        // stars never move relative to the camera at the centre of the sky
+        // so build their quads once instead of every frame
+        mBillboardSet->setStaticGeometry(true);
+        
+        // draw them as instances of one quad where the render system can,
+        // matching the vertex program picked in updateMaterial()
+        mBillboardSet->setInstancingEnabled(SpacescapeBillboardSet::isInstancingSupported());
     }
 
     /** Initialize this layer based on the given params
@@ -521,6 +537,10 @@ namespace Ogre
                 shouldUpdate |= mMinSize != StringConverter::parseReal(ii->second);
                 mMinSize = StringConverter::parseReal(ii->second);
             }
+            else if(ii->first == "maskCPUNoise") {
+                shouldUpdate |= mMaskCPUNoise != StringConverter::parseBool(ii->second);
+                mMaskCPUNoise = StringConverter::parseBool(ii->second);
+            }
             else if(ii->first == "maskEnabled") {
                 shouldUpdate |= mMaskEnabled != StringConverter::parseBool(ii->second);
                 mMaskEnabled = StringConverter::parseBool(ii->second);
@@ -557,6 +577,11 @@ namespace Ogre
                 shouldUpdate |= mMaskSeed != StringConverter::parseInt(ii->second);
                 mMaskSeed = StringConverter::parseInt(ii->second);
             }
+            else if(ii->first == "maskSize") {
+                unsigned int maskSize = Math::Clamp<unsigned int>(StringConverter::parseUnsignedInt(ii->second), 1, MAX_MASK_SIZE);
+                shouldUpdate |= mMaskSize != maskSize;
+                mMaskSize = maskSize;
+            }
             else if(ii->first == "maskThreshold") {
                 shouldUpdate |= mMaskThreshold != std::min<Real>(1.0,std::max<Real>(0.0,StringConverter::parseReal(ii->second)));
                 mMaskThreshold = std::min<Real>(1.0,std::max<Real>(0.0,StringConverter::parseReal(ii->second)));
@@ -596,6 +621,22 @@ namespace Ogre
                 shouldUpdate |= mHDRMultiplier != StringConverter::parseReal(ii->second);
                 mHDRMultiplier = StringConverter::parseReal(ii->second);
             }
+            else if(ii->first == "magnitudeLimit") {
+                shouldUpdate |= mMagnitudeLimit != StringConverter::parseReal(ii->second);
+                mMagnitudeLimit = StringConverter::parseReal(ii->second);
+            }
+            else if(ii->first == "regionDec") {
+                shouldUpdate |= mRegionDec != StringConverter::parseReal(ii->second);
+                mRegionDec = StringConverter::parseReal(ii->second);
+            }
+            else if(ii->first == "regionRA") {
+                shouldUpdate |= mRegionRA != StringConverter::parseReal(ii->second);
+                mRegionRA = StringConverter::parseReal(ii->second);
+            }
+            else if(ii->first == "regionRadius") {
+                shouldUpdate |= mRegionRadius != StringConverter::parseReal(ii->second);
+                mRegionRadius = StringConverter::parseReal(ii->second);
+            }
             else if(ii->first == "dataFile") {
                 shouldUpdate |= mStarDataFilename != ii->second;
                 mStarDataFilename = ii->second;
@@ -607,19 +648,81 @@ namespace Ogre
 
         // build/update based on these settings
         if(shouldUpdate || !mBuilt) {
-            // update material fragment program parameters
-            updateMaterial();
+            bool software = mPlugin->isSoftwareRenderingEnabled();
+
+            // generate the billboards unless prepareData() already has, 
+            // the catalog and mask are always loaded on this thread
+            if(!mPrepared || shouldUpdate) {
+                if(mStarDataFilename != "") {
+                    // binary catalogs are mapped, CSV catalogs are parsed
+                    mStarCatalog.load(mStarDataFilename);
+                }
+                else if(mMaskEnabled) {
+                    updateMask();
+                }
+
+                if(mPreparing) {
+                    mPreparePending = true;
+                }
+                else {
+                    buildData();
+                }
+            }
+
+            // prepareData() generates the billboards on a worker thread
+            if(mPreparing) {
+                return;
+            }
 
-            if(mStarDataFilename != "") {
-                buildFromFile(mStarDataFilename);
+            if(!software) {
+                // update material fragment program parameters
+                updateMaterial();
+                createBillboards();
             }
-            else if(mMaskEnabled) {
-                buildMasked();
+
+            mPreparePending = false;
+            mPrepared = false;
+            mBuilt = true;
+        }
+    }
+
+    /** Utility function to load our sprite texture into an image for
+    software rendering - mirrors the texture loading in updateMaterial()
+    @param img The image to load into
+    @return true if the texture was loaded
+    */
+    bool SpacescapeLayerBillboards::loadTextureImage(Image& img)
+    {
+        if(mTextureName.empty()) {
+            return false;
+        }
+
+        try {
+            if(mTextureName.find_last_of('/') != String::npos) {
+                String::size_type index_of_extension = mTextureName.find_last_of('.');
+                if(index_of_extension == String::npos) {
+                    return false;
+                }
+
+                std::ifstream ifs(mTextureName.c_str(), std::ios::binary | std::ios::in);
+                if(!ifs.is_open()) {
+                    return false;
+                }
+
+                DataStreamPtr data_stream(new FileStreamDataStream(mTextureName, &ifs, false));
+                img.load(data_stream, mTextureName.substr(index_of_extension + 1));
+                ifs.close();
             }
             else {
-                build();
+                img.load(mTextureName, ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
             }
         }
+        catch(...) {
+            // couldn't find the file
+            return false;
+        }
+
+        return true;
     }
 
     /** Update the material with new params - will create if needed
@@ -640,43 +743,76 @@ namespace Ogre
             // create a single texture unit state for our billboard texture
             mMaterial->getTechnique(0)->getPass(0)->createTextureUnitState();
             
-            if(mHDREnabled) {
+            // instanced billboards always need the vertex program that
+            // builds their quads
+            bool instanced = SpacescapeBillboardSet::isInstancingSupported();
+            
+            if(mHDREnabled || instanced) {
                 GpuProgramParametersSharedPtr params;
                 HighLevelGpuProgramPtr gpuProgram;
                 Pass* pass = mMaterial->getTechnique(0)->getPass(0);
                 
-                // load the vertex program
-                gpuProgram = HighLevelGpuProgramManager::getSingleton().
-                createProgram("spacescape_billboards_glsl_vp",
-                              ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME,
-                              "glsl",
-                              GPT_VERTEX_PROGRAM);
-                gpuProgram->setSource(spacescape_billboards_glsl_vp);
-                gpuProgram->load();
-                
-                // set the vertex program
-                pass->setVertexProgram("spacescape_billboards_glsl_vp");
-                
-                // set vertex program params
-                params = pass->getVertexProgramParameters();
-                params->setNamedAutoConstant("worldViewProj",GpuProgramParameters::ACT_WORLDVIEWPROJ_MATRIX);
-                
-                // load the fragment program
-                gpuProgram = HighLevelGpuProgramManager::getSingleton().
-                createProgram("spacescape_billboards_glsl_fp",
-                              ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME,
-                              "glsl",
-                              GPT_FRAGMENT_PROGRAM);
-                gpuProgram->setSource(spacescape_billboards_glsl_fp);
-                
-                params = gpuProgram->getDefaultParameters();
-                params->setNamedConstant("tex",(int)0);
-                
-                gpuProgram->load();
-                
+                if(instanced) {
+                    // load the vertex program, shared by all billboard layers
+                    if(HighLevelGpuProgramManager::getSingleton().getByName("spacescape_billboards_instanced_glsl_vp",
+                        ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME).isNull()) {
+                        gpuProgram = HighLevelGpuProgramManager::getSingleton().
+                        createProgram("spacescape_billboards_instanced_glsl_vp",
+                                      ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME,
+                                      "glsl",
+                                      GPT_VERTEX_PROGRAM);
+                        gpuProgram->setSource(spacescape_billboards_instanced_glsl_vp);
+                        gpuProgram->load();
+                    }
+                    
+                    // set the vertex program
+                    pass->setVertexProgram("spacescape_billboards_instanced_glsl_vp");
+                    
+                    // set vertex program params, the camera comes from the
+                    // billboard set's custom parameters
+                    params = pass->getVertexProgramParameters();
+                    params->setNamedAutoConstant("worldViewProj",GpuProgramParameters::ACT_WORLDVIEWPROJ_MATRIX);
+                    params->setNamedAutoConstant("cameraPosition",GpuProgramParameters::ACT_CUSTOM,
+                        SpacescapeBillboardSet::CUSTOM_CAMERA_POSITION);
+                    params->setNamedAutoConstant("cameraUp",GpuProgramParameters::ACT_CUSTOM,
+                        SpacescapeBillboardSet::CUSTOM_CAMERA_UP);
+                }
+                else {
+                    // load the vertex program
+                    gpuProgram = HighLevelGpuProgramManager::getSingleton().
+                    createProgram("spacescape_billboards_glsl_vp",
+                                  ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME,
+                                  "glsl",
+                                  GPT_VERTEX_PROGRAM);
+                    gpuProgram->setSource(spacescape_billboards_glsl_vp);
+                    gpuProgram->load();
+                    
+                    // set the vertex program
+                    pass->setVertexProgram("spacescape_billboards_glsl_vp");
+                    
+                    // set vertex program params
+                    params = pass->getVertexProgramParameters();
+                    params->setNamedAutoConstant("worldViewProj",GpuProgramParameters::ACT_WORLDVIEWPROJ_MATRIX);
+                }
                 
-                // set the fragment program
-                pass->setFragmentProgram("spacescape_billboards_glsl_fp");
+                if(mHDREnabled) {
+                    // load the fragment program
+                    gpuProgram = HighLevelGpuProgramManager::getSingleton().
+                    createProgram("spacescape_billboards_glsl_fp",
+                                  ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME,
+                                  "glsl",
+                                  GPT_FRAGMENT_PROGRAM);
+                    gpuProgram->setSource(spacescape_billboards_glsl_fp);
+                    
+                    params = gpuProgram->getDefaultParameters();
+                    params->setNamedConstant("tex",(int)0);
+                    
+                    gpuProgram->load();
+                    
+                    
+                    // set the fragment program
+                    pass->setFragmentProgram("spacescape_billboards_glsl_fp");
+                }
             }
         }
         
@@ -756,6 +892,37 @@ namespace Ogre
         mMaterial->load();
     }
 
+    /** Set whether to display the full detail billboards or the faster
+    preview version
+    @remarks Layers with more billboards than the preview budget draw their
+    brightest billboards and impostors for the rest in the preview, see
+    SpacescapePreviewLOD
+    @param displayHighRes Whether to display the full detail or not
+    */
+    void SpacescapeLayerBillboards::setDisplayHighRes(bool displayHighRes)
+    {
+        mDisplayHighRes = displayHighRes;
+        updateBillboardRange();
+    }
+
+    /** Utility function to draw the full detail or the preview billboards
+    */
+    void SpacescapeLayerBillboards::updateBillboardRange(void)
+    {
+        if(!mBillboardSet) {
+            return;
+        }
+
+        // the full detail billboards come first, the preview range ends 
+        // with the impostors
+        if(mDisplayHighRes) {
+            mBillboardSet->setBillboardRange(0, mNumFullBillboards);
+        }
+        else {
+            mBillboardSet->setBillboardRange(mPreviewBillboardStart, mPreviewBillboardCount);
+        }
+    }
+
     /** Utility function for updating saved params list
     @param params The list of params
     */
@@ -767,7 +934,9 @@ namespace Ogre
         mParams["destBlendFactor"] = getBlendMode(mDestBlendFactor);
         mParams["dataFile"] = mStarDataFilename;
         mParams["farColor"] = StringConverter::toString(mFarColor);
+        mParams["magnitudeLimit"] = StringConverter::toString(mMagnitudeLimit);
         mParams["minSize"] = StringConverter::toString(mMinSize);
+        mParams["maskCPUNoise"] = StringConverter::toString(mMaskCPUNoise);
         mParams["maskEnabled"] = StringConverter::toString(mMaskEnabled);
         mParams["maskGain"] = StringConverter::toString(mMaskGain);
         mParams["maskLacunarity"] = StringConverter::toString(mMaskLacunarity);
@@ -777,13 +946,39 @@ namespace Ogre
         mParams["maskPower"] = StringConverter::toString(mMaskPower);
         mParams["maskScale"] = StringConverter::toString(mMaskScale);
         mParams["maskSeed"] = StringConverter::toString(mMaskSeed);
+        mParams["maskSize"] = StringConverter::toString(mMaskSize);
         mParams["maskThreshold"] = StringConverter::toString(mMaskThreshold);
         mParams["maxSize"] = StringConverter::toString(mMaxSize);
         mParams["nearColor"] = StringConverter::toString(mNearColor);
         mParams["numBillboards"] = StringConverter::toString(mNumBillboards);
+        mParams["regionDec"] = StringConverter::toString(mRegionDec);
+        mParams["regionRA"] = StringConverter::toString(mRegionRA);
+        mParams["regionRadius"] = StringConverter::toString(mRegionRadius);
         mParams["sourceBlendFactor"] = getBlendMode(mSourceBlendFactor);
         mParams["texture"] = mTextureName;
         mParams["hdrPower"] = StringConverter::toString(mHDRPower);
         mParams["hdrMultiplier"] = StringConverter::toString(mHDRMultiplier);
     }
+
+    /** Utility function to render the density mask into the mask sampler
+    unless only the number of billboards changed
+    @remarks Must be called on the render thread
+    */
+    void SpacescapeLayerBillboards::updateMask(void)
+    {
+        updateMaskSampler(
+            mMaskSampler,
+            mMaskSize,
+            mMaskCPUNoise,
+            mMaskSeed,
+            mMaskNoiseType,
+            mMaskOctaves,
+            mMaskLacunarity,
+            mMaskGain,
+            mMaskPower,
+            mMaskThreshold,
+            mMaskScale,
+            mMaskOffset
+        );
+    }
 }
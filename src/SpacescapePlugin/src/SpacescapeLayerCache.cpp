@@ -0,0 +1,167 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include "SpacescapeLayerCache.h"
+
+namespace Ogre
+{
+    /** Get the memory the entry uses
+    @return the size in bytes
+    */
+    size_t SpacescapeLayerCache::Entry::getMemorySize(void) const
+    {
+        size_t size = 0;
+        for(int i = 0; i < 6; ++i) {
+            size += (offset[i].size() + scale[i].size()) * sizeof(float);
+        }
+        return size;
+    }
+
+    /** Constructor
+    */
+    SpacescapeLayerCache::SpacescapeLayerCache(void) :
+        mMemoryBudget(DEFAULT_MEMORY_BUDGET),
+        mMemorySize(0),
+        mUseCount(0)
+    {
+    }
+
+    /** Destructor
+    */
+    SpacescapeLayerCache::~SpacescapeLayerCache(void)
+    {
+        clear();
+    }
+
+    /** Remove all entries
+    */
+    void SpacescapeLayerCache::clear(void)
+    {
+        for(SlotMap::iterator ii = mSlots.begin(); ii != mSlots.end(); ++ii) {
+            OGRE_DELETE_T(ii->second.entry, Entry, MEMCATEGORY_GENERAL);
+        }
+        mSlots.clear();
+        mMemorySize = 0;
+    }
+
+    /** Remove least recently used entries that aren't in use until 
+    the cache uses at most the given amount of memory
+    @param size The size in bytes
+    */
+    void SpacescapeLayerCache::evict(size_t size)
+    {
+        while(mMemorySize > size) {
+            SlotMap::iterator oldest = mSlots.end();
+            for(SlotMap::iterator ii = mSlots.begin(); ii != mSlots.end(); ++ii) {
+                if(!ii->second.used && (oldest == mSlots.end() || ii->second.lastUsed < oldest->second.lastUsed)) {
+                    oldest = ii;
+                }
+            }
+
+            if(oldest == mSlots.end()) {
+                // everything left is in use by the current render
+                return;
+            }
+
+            mMemorySize -= oldest->second.entry->getMemorySize();
+            OGRE_DELETE_T(oldest->second.entry, Entry, MEMCATEGORY_GENERAL);
+            mSlots.erase(oldest);
+        }
+    }
+
+    /** Find an entry and mark it as used
+    @param key The layer key
+    @return the entry or NULL if the key isn't cached
+    */
+    const SpacescapeLayerCache::Entry* SpacescapeLayerCache::find(const String& key)
+    {
+        SlotMap::iterator ii = mSlots.find(key);
+        if(ii == mSlots.end()) {
+            return 0;
+        }
+
+        ii->second.lastUsed = ++mUseCount;
+        ii->second.used = true;
+        return ii->second.entry;
+    }
+
+    /** Add an entry and mark it as used
+    @param key The layer key
+    @param entry The entry - the cache deletes it when it is removed
+    */
+    void SpacescapeLayerCache::insert(const String& key, Entry* entry)
+    {
+        SlotMap::iterator ii = mSlots.find(key);
+        if(ii != mSlots.end()) {
+            mMemorySize -= ii->second.entry->getMemorySize();
+            OGRE_DELETE_T(ii->second.entry, Entry, MEMCATEGORY_GENERAL);
+        }
+
+        Slot slot = { entry, ++mUseCount, true };
+        mSlots[key] = slot;
+        mMemorySize += entry->getMemorySize();
+    }
+
+    /** Mark the end of a render - the entries it found or inserted 
+    can be evicted again by later renders
+    */
+    void SpacescapeLayerCache::release(void)
+    {
+        for(SlotMap::iterator ii = mSlots.begin(); ii != mSlots.end(); ++ii) {
+            ii->second.used = false;
+        }
+
+        // the budget may have been lowered during the render
+        evict(mMemoryBudget);
+    }
+
+    /** Make room for a new entry by evicting the least recently used
+    entries that aren't in use by the current render
+    @param size The size of the new entry in bytes
+    @return false if the entry doesn't fit in the budget
+    */
+    bool SpacescapeLayerCache::reserve(size_t size)
+    {
+        if(size > mMemoryBudget) {
+            return false;
+        }
+
+        evict(mMemoryBudget - size);
+        return mMemorySize + size <= mMemoryBudget;
+    }
+
+    /** Set the maximum memory the entries may use
+    @param budget The size in bytes
+    */
+    void SpacescapeLayerCache::setMemoryBudget(size_t budget)
+    {
+        mMemoryBudget = budget;
+        evict(mMemoryBudget);
+    }
+}
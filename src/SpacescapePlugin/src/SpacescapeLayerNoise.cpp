@@ -28,6 +28,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
 #include "SpacescapeLayerNoise.h"
+#include "SpacescapeSoftwareRenderer.h"
 #include "OgreMaterialManager.h"
 #include "OgreMaterial.h"
 #include "OgreTechnique.h"
@@ -91,6 +92,7 @@ namespace Ogre
     SpacescapeLayerNoise::SpacescapeLayerNoise(const String& name, SpacescapePlugin* plugin) :
         SpacescapeLayer(name, plugin),
         mBuilt(false),
+        mCPUNoise(false),
         mDestBlendFactor(SBF_ONE),
         mDitherAmount(0.03),
         mGain(0.5),
@@ -133,6 +135,32 @@ namespace Ogre
         }
     }
 
+    /** Add the draw calls for this layer to a software renderer
+    @param renderer The renderer to add to
+    */
+    void SpacescapeLayerNoise::addToSoftwareRenderer(SpacescapeSoftwareRenderer& renderer)
+    {
+        SpacescapeNoiseParams params;
+        params.noiseType = mNoiseType;
+        params.innerColor = mInnerColor;
+        params.outerColor = mOuterColor;
+        params.octaves = mOctaves;
+        params.lacunarity = mLacunarity;
+        params.gain = mGain;
+        params.power = mPowerAmount;
+        params.threshold = mShelfAmount;
+        params.dither = mDitherAmount;
+        params.scale = mScale;
+        params.offset = mOffset;
+        params.hdrPower = mHDRPower;
+        params.hdrMultiplier = mHDRMultiplier;
+
+        // initialize permutations table
+        initNoise(mSeed);
+
+        renderer.addNoise(mPermutations, params, mSourceBlendFactor, mDestBlendFactor);
+    }
+
     /** Utility function for building a regular sphere based on class params
     */
     void SpacescapeLayerNoise::build(void) 
@@ -271,7 +299,7 @@ namespace Ogre
 			position(pos);
 			textureCoord(pos.normalisedCopy() * Vector3(1,1,-1));
 
-			uint16 base = i * 4;
+			uint32 base = i * 4;
 			quad(base, base+1, base+2, base+3);
         }
 
@@ -357,6 +385,7 @@ namespace Ogre
     /** Initialize this layer based on the given params
     @remarks Params for this layer type are:
     NAME -  VALUE TYPE
+    cpuNoise - bool (string i.e. "true") generate the noise cube on the CPU instead of the GPU
     destBlendFactor - string (i.e. one, dest_colour  etc.)
     ditherAmount - real (string i.e. "0.1") should be in range 0.0 to 1.0
     gain - real (string i.e. "2.0")
@@ -378,7 +407,11 @@ namespace Ogre
 
         NameValuePairList::iterator ii;
         for(ii = params.begin(); ii != params.end(); ii++) {
-            if(ii->first == "destBlendFactor") {
+            if(ii->first == "cpuNoise") {
+                shouldUpdate |= mCPUNoise != StringConverter::parseBool(ii->second);
+                mCPUNoise = StringConverter::parseBool(ii->second);
+            }
+            else if(ii->first == "destBlendFactor") {
                 shouldUpdate |= mDestBlendFactor != getBlendMode(ii->second);
                 mDestBlendFactor = getBlendMode(ii->second);
             }
@@ -463,6 +496,19 @@ namespace Ogre
         // update our saved params
         updateParams(params);
 
+        // the noise is rendered with the render system or generated in
+        // parallel already so there is nothing to prepare
+        if(mPreparing) {
+            return;
+        }
+
+        // nothing to build in software mode, the noise is generated when
+        // the layer is added to the software renderer
+        if(mPlugin->isSoftwareRenderingEnabled()) {
+            mBuilt = true;
+            return;
+        }
+
         // now build based on these settings
         if(shouldUpdate || !mBuilt) {
             if(!mBuilt) {
@@ -530,7 +576,7 @@ namespace Ogre
         mDisplayHighRes = displayHighRes;
     }
 
-    /** Utility function for updating the cubed texture material with GPU noise.
+    /** Utility function for updating the cubed texture material with GPU or CPU noise.
     */
     void SpacescapeLayerNoise::updateCubedMaterialParams(void)
     {
@@ -560,24 +606,46 @@ namespace Ogre
 
         }
 
-        // render the gpu noise to our cubic texture
-        renderNoiseToTexture(
-            t,
-            mSeed,
-            mNoiseType,
-            mInnerColor,
-            mOuterColor,
-            mOctaves,
-            mLacunarity,
-            mGain,
-            mPowerAmount,
-            mShelfAmount,
-            mDitherAmount,
-            mScale,
-            mOffset,
-            mHDRPower,
-            mHDRMultiplier
-        );
+        if(mCPUNoise || mPlugin->getDefaultCPUNoise()) {
+            // render the cpu noise to our cubic texture
+            renderNoiseToTextureCPU(
+                t,
+                mSeed,
+                mNoiseType,
+                mInnerColor,
+                mOuterColor,
+                mOctaves,
+                mLacunarity,
+                mGain,
+                mPowerAmount,
+                mShelfAmount,
+                mDitherAmount,
+                mScale,
+                mOffset,
+                mHDRPower,
+                mHDRMultiplier
+            );
+        }
+        else {
+            // render the gpu noise to our cubic texture
+            renderNoiseToTexture(
+                t,
+                mSeed,
+                mNoiseType,
+                mInnerColor,
+                mOuterColor,
+                mOctaves,
+                mLacunarity,
+                mGain,
+                mPowerAmount,
+                mShelfAmount,
+                mDitherAmount,
+                mScale,
+                mOffset,
+                mHDRPower,
+                mHDRMultiplier
+            );
+        }
 
         // build the skybox with our cubic texture
         if(!mBuilt) {
@@ -588,103 +656,6 @@ namespace Ogre
         mMaterial->getTechnique(0)->getPass(0)->setSceneBlending(mSourceBlendFactor,mDestBlendFactor);
     }
 
-    /** Old Utility function for updating the cubed texture material with CPU - doesn't match GPU
-    precisely and has seams at cube edges.
-    */
-    void SpacescapeLayerNoise::updateCubedMaterialParamsOld(void)
-    {
-        // initialize permutations table
-        initNoise(mSeed);
-
-        // set blending
-        mMaterial->getTechnique(0)->getPass(0)->setSceneBlending(mSourceBlendFactor,mDestBlendFactor);
-
-        TexturePtr t = mMaterial->getTechnique(0)->getPass(0)->getTextureUnitState(0)->_getTexturePtr();
-
-        // update the six faces of this texture
-        uchar* buf[6];
-        for(int f = 0; f < 6; ++f) {
-            buf[f] = OGRE_ALLOC_T( uchar, mPreviewTextureSize * mPreviewTextureSize * 4, MEMCATEGORY_GENERAL);
-        }
-
-        Real scale = 2.0 / (Real)mPreviewTextureSize;
-        float n;
-        float noiseScale = 1.0/(1.0-mShelfAmount);
-        float powerFactor = 1.0/mPowerAmount;
-        bool ridged = mNoiseType == "ridged";
-
-        for(unsigned int f = 0; f < 6; ++f) {
-            for(unsigned int y = 0; y < mPreviewTextureSize; ++y) {
-                int yOffset = y * mPreviewTextureSize * 4;
-                for(unsigned int x = 0; x < mPreviewTextureSize; ++x) {
-                    // get the 3d point on the top surface of the cube
-                    Vector3 p = Vector3(-1.0 + x*scale, 1.0, -1.0 + y*scale);
-                    
-                    // rotate to the cube face we want
-                    rotatePoint(p,f);
-
-                    // spherize the point from cube space to sphere space
-                    spherizePoint(p);
-
-                    // scale down to avoid noise irregularities at edges
-                    p.normalise();
-
-                    // get noise at this location
-                    if(ridged) {
-                        n = ridgedFbmNoise(p * mScale, mOctaves,mGain,mLacunarity,mOffset);
-                    }
-                    else {
-                        n = fbmNoise(p * mScale, mOctaves,mGain,mLacunarity);
-                    }
-
-                    // add a dithering noise if requested
-                    if(mDitherAmount > 0.0) {
-                        n += rand() / ((double) RAND_MAX) * mDitherAmount;
-                    }
-
-                    // scale noise value to between 0..1
-                    n += 1.0;
-                    n *= 0.5;
-
-                    // apply shelf
-                    if(mShelfAmount > 0.0) {
-                        n = std::max<float>(0.0,n - mShelfAmount);
-
-                        // scale remainder back to between 0..1
-                        n *= noiseScale;
-                    }
-
-                    // apply optional power function
-                    if(mPowerAmount) {
-                        n = pow(n,powerFactor);
-                    }
-
-                    int offset = yOffset + (x * 4);
-
-                    // clamp n to between 0 .. 1
-                    n = std::min<float>(1.0,n);
-                    n = std::max<float>(0.0,n);
-
-                    ColourValue c = mOuterColor + (n * (mInnerColor - mOuterColor));
-                    buf[f][offset] = c.r * 255.0;
-                    buf[f][offset + 1] = c.g * 255.0;
-                    buf[f][offset + 2] = c.b * 255.0;
-                    buf[f][offset + 3] = 1.0;//n * 255.0;
-                }
-            }
-        }
-        // write to the surface
-        for(int f = 0; f < 6; ++f) {
-            HardwarePixelBufferSharedPtr pb = t->getBuffer(f);
-            if(!pb->isLocked()) {
-                // blit from memory to the texture surface
-                pb->blitFromMemory(PixelBox(mPreviewTextureSize,mPreviewTextureSize,1,PF_BYTE_RGBA,buf[f]));
-            }
-
-            OGRE_FREE(buf[f], MEMCATEGORY_GENERAL);
-        }
-    }
-
     /** Utility function for updating material fragment program 
     parameters.
     @param mat The material to update
@@ -818,6 +789,7 @@ namespace Ogre
         SpacescapeLayer::updateParams(params);
 
         // update shared params
+        mParams["cpuNoise"] = StringConverter::toString(mCPUNoise);
         mParams["destBlendFactor"] = getBlendMode(mDestBlendFactor);
         mParams["ditherAmount"] = StringConverter::toString(mDitherAmount);
         mParams["gain"] = StringConverter::toString(mGain);
@@ -28,10 +28,15 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
 #include "SpacescapeLayerPoints.h"
+#include "SpacescapePreviewLOD.h"
+#include "SpacescapeRandom.h"
+#include "SpacescapeThreadPool.h"
 #include <OgreMaterialManager.h>
 #include <OgreTechnique.h>
 #include <OgrePass.h>
 #include "OgreHardwarePixelBuffer.h"
+#include "OgreHardwareBufferManager.h"
+#include "OgreSceneNode.h"
 #include "OgreTextureManager.h"
 #include "OgreHighLevelGpuProgram.h"
 
@@ -64,6 +69,7 @@ namespace Ogre
         mHDRMultiplier(1.0),
         mMaskNoiseType("fbm"),
         mNearColor(1.0,1.0,1.0),
+        mMaskCPUNoise(false),
         mMaskEnabled(false),
         mMaskGain(0.5),
         mMaskLacunarity(2.0),
@@ -72,9 +78,13 @@ namespace Ogre
         mMaskPower(1.0),
         mMaskScale(1.0),
         mMaskSeed(1),
+        mMaskSize(512),
         mMaskThreshold(0.0),
         mNumPoints(1000),
+        mNumFullVertices(0),
+        mNumImpostors(0),
         mPointSize(1),
+        mPreviewVertexStart(0),
         mSourceBlendFactor(SBF_ONE)
     {
     }
@@ -87,37 +97,74 @@ namespace Ogre
         clear();
     }
 
-    /** Utility function for building based on class params
+    /** Utility function to add a point to the point list
+    @remarks When software rendering the list holds the points the way the
+    software renderer draws them, otherwise it holds the points waiting for
+    createManualObject() to add them to the manual object
+    @param p The point position
+    @param c The point colour
+    */
+    void SpacescapeLayerPoints::addPoint(const Vector3& p, ColourValue c)
+    {
+        SpacescapeSoftwareRenderer::Point point;
+        point.position = p;
+        point.colour = c;
+
+        if(mHDREnabled && mPlugin->isSoftwareRenderingEnabled()) {
+            // the hdr shader outputs the hdr colour with full alpha
+            point.colour = c * mHDRMultiplier;
+            point.colour.a = 1.0;
+        }
+
+        mPoints.push_back(point);
+    }
+
+    /** Add the draw calls for this layer to a software renderer
+    @param renderer The renderer to add to
+    */
+    void SpacescapeLayerPoints::addToSoftwareRenderer(SpacescapeSoftwareRenderer& renderer)
+    {
+        renderer.addPoints(mPoints, mPointSize, mSourceBlendFactor, mDestBlendFactor);
+    }
+
+    /** Generate the point list from the loaded noise mask
+    */
+    void SpacescapeLayerPoints::buildData(void)
+    {
+        if(mMaskEnabled) {
+            buildMasked();
+        }
+        else {
+            build();
+        }
+    }
+
+    /** Utility function for building the point list based on class params
     */
     void SpacescapeLayerPoints::build(void) 
     {
         // clear the old list
-        clear();
-        
-        // create the material we'll need if not created already
-        createMaterial();
+        mPoints.clear();
 
-        begin(mMaterial->getName(), RenderOperation::OT_POINT_LIST);
-
-        // seed the random number generator
-        srand ( mSeed );
+        // seed the random number generator the scene was made with
+        SpacescapeRandom random(mSeed, mPlugin->getRandomGenerator());
 
         Vector3 v;
         ColourValue c;
         for(unsigned int i = 0; i < mNumPoints; ++i) {
             // nicer distribution
-            Real u = -1.0 + 2.0 * rand() / ((double) RAND_MAX);
-            Real a = Ogre::Math::TWO_PI * rand() / ((double) RAND_MAX);
+            Real u = -1.0 + 2.0 * random.nextUnit();
+            Real a = Ogre::Math::TWO_PI * random.nextUnit();
             Real s = sqrt(1 - u*u);
 
-            position(
+            v = Vector3(
                 s * cos(a),
                 s * sin(a),
                 u
             );
 
             // random distance
-            float dist = rand() / ((double) RAND_MAX);
+            float dist = random.nextUnit();
 
             if(mHDREnabled) {
                 dist = powf(dist, mHDRPower);
@@ -125,127 +172,51 @@ namespace Ogre
 
             // color is based on distance (linear interpolation here)
             c = mNearColor + (dist * (mFarColor - mNearColor));
-            colour(c);
-            
-            if(mHDREnabled) {
-                c *= mHDRMultiplier;
-                normal(c.r,c.g,c.b);
-            }
+            addPoint(v, c);
         }
-
-        end();
-
-        mBuilt = true;
     }
 
 
-    /** Utility function for building based on class params when masked
+    /** Utility function for building the point list based on class params 
+    when masked
+    @remarks The mask must be up to date, see updateMask()
     */
     void SpacescapeLayerPoints::buildMasked(void)
     {
         // clear the old list
-        clear();
-        
-        // create the material we'll need if not created already
-        createMaterial();
-
-        // should be a good approximation
-        uint maskSize = 512;
-
-        // create the noise texture (cubic)
-        TexturePtr t = TextureManager::getSingleton().createManual(
-            "SpacescapeNoiseTexture" + StringConverter::toString(mUniqueID),
-            ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME,
-            TEX_TYPE_CUBE_MAP,
-            maskSize, maskSize, 
-            1,
-            0, // no mip maps
-            mMaskFBOPixelFormat,
-            TU_RENDERTARGET
-        );
+        mPoints.clear();
 
-        // rtt a noise mask to a cubic texture then use this texture
-        // in place of the noise functions below
-        renderNoiseToTexture(
-            t,
-            mMaskSeed,
-            mMaskNoiseType,
-            ColourValue::White,
-            ColourValue::Black,
-            mMaskOctaves,
-            mMaskLacunarity,
-            mMaskGain,
-            mMaskPower,
-            mMaskThreshold,
-            0.0,
-            mMaskScale,
-            mMaskOffset
-        );
-
-        // face orientation is +X (0), -X (1), +Y (2), -Y (3), +Z (4), -Z (5)
-        // copy the texture into buffers
-        uchar* faceBuffers[6];
-        for(int i = 0 ; i < 6; ++i) {
-            faceBuffers[i] = OGRE_ALLOC_T( uchar, maskSize * maskSize * 4, MEMCATEGORY_GENERAL);
-            t->getBuffer(i)->blitToMemory(
-                PixelBox(t->getWidth(), t->getHeight(), 1, PF_BYTE_RGBA, faceBuffers[i])
-            );
+        if(mMaskSampler.isEmpty()) {
+            // nothing to place points on
+            return;
         }
-        
-        // instead of generating random points on a sphere, generate random points
-        // on a cube and then it should be easy to sample these points from the cubic
-        // map and use them if they're valid - unfortunately this method will cause
-        // bunching up at cube corners.  Using an even spherical sample would be better
-        // but then we need to translate from spherical to cube space to sample from
-        // the noise map (TODO?)
-        begin(mMaterial->getName(), RenderOperation::OT_POINT_LIST);
 
-        // seed the random number generator
-        srand ( mSeed );
-
-        unsigned int numPoints = std::min<unsigned int>(RAND_MAX,mNumPoints);
+        // instead of generating random points on a sphere, generate random points
+        // on a cube where the mask density is - the sampler weights them by the
+        // solid angle of the cube faces so they don't bunch up at cube corners
+        // seed the random number generator the scene was made with
+        SpacescapeRandom random(mSeed, mPlugin->getRandomGenerator());
+
+        // scenes made with rand() keep placing points the old way
+        bool rejection = random.getGenerator() == SpacescapeRandom::GENERATOR_RAND;
+        unsigned int numPoints = rejection ? std::min<unsigned int>(RAND_MAX, mNumPoints) : mNumPoints;
         unsigned int numPointsTested = 0;
-        unsigned int maxNumTestPoints = 99999;
 
-        Real n;
-        Real scale = 2.0 / (Real)maskSize;
-        Real noiseScale = 1.0 / 255.0;
         ColourValue c;
         while(numPoints) {
-            // pick random co-ords on the top face
-            Real rU = rand() / ((double) RAND_MAX);
-            Real rV = rand() / ((double) RAND_MAX);
-
-            // scale u,v to 0..maskSize
-            uint u = std::min<uint>(rU * maskSize,maskSize);
-            uint v = std::min<uint>(rV * maskSize,maskSize);
-
-            // pick a random face
-            uchar face = rand() % 6;
-
-            // use noise mask to discard positions
-            ++numPointsTested;
-
-            // get the noise value at this position 0..255
-            n = faceBuffers[face][((v * maskSize) + u) * 4];
-
-            // scale n to between 0..1
-            n *= noiseScale;
-
-            // get a random value between 0..1 to use for density test
-            double r = rand() / ((double) RAND_MAX);
-
-            // now see if the random value is less than the noise value
-            // should give us a greater density of points for higher noise values
-            if(r > (n * n)) {
-
-                // only test a certain number of points so we don't infinite loop
-                if(numPointsTested == maxNumTestPoints) {
-                    numPoints--;
-                }
+            // pick a random position weighted by the mask density
+            unsigned int face;
+            Real rU, rV;
+            if(!rejection) {
+                mMaskSampler.sample(random, face, rU, rV);
+            }
+            else if(!mMaskSampler.sampleRejection(random, numPointsTested, face, rU, rV)) {
+                // too many positions thrown away, drop this point
+                numPoints--;
                 continue;
             }
-            
+            numPoints--;
+
             // scale u and v to range -1 .. 1
             Vector3 p = Vector3( (rU * 2.0) - 1.0 , 1.0, (rV * 2.0) - 1.0);
 
@@ -253,37 +224,146 @@ namespace Ogre
             rotatePoint(p,face);
             p.z = -p.z;
 
-            // use this position
-            position(p);
-
-            numPoints--;
-            numPointsTested = 0;
-
             // random distance
-            float dist = rand() / ((double) RAND_MAX);
+            float dist = random.nextUnit();
             
             if(mHDREnabled) {
                 dist = powf(dist, mHDRPower);
             }
             // color is based on distance (linear interpolation here)
             c = mNearColor + (dist * (mFarColor - mNearColor));
-            colour(c);
-            
+
+            // use this position
+            addPoint(p, c);
+        }
+    }
+
+    /** Utility function to add the points in the point list to the manual
+    object
+    @remarks The points are written straight into one interleaved vertex 
+    buffer (position, packed colour and the hdr colour as a normal) in 
+    parallel chunks and uploaded at once, instead of going through the 
+    ManualObject::position() etc. temp buffers a vertex at a time.  The 
+    list is freed afterwards, the manual object keeps its own copy of the 
+    points in the hardware buffer.  Dense layers are ordered for the 
+    preview with their impostors appended, see SpacescapePreviewLOD
+    */
+    void SpacescapeLayerPoints::createManualObject(void)
+    {
+        // points per parallel task
+        static const size_t CHUNK_SIZE = 65536;
+
+        // clear the old geometry
+        clear();
+
+        // create the material we'll need if not created already
+        createMaterial();
+
+        if(mPoints.empty()) {
+            return;
+        }
+
+        // dense layers draw their brightest points and impostors for the
+        // rest in the preview
+        std::vector<uint32> order;
+        SpacescapeSoftwareRenderer::PointList impostors;
+        size_t omitted = SpacescapePreviewLOD::build(mPoints, order, impostors);
+
+        // the sections take the place of begin() / end(), impostors are 
+        // bigger points so they get their own section and material
+        mSectionList.push_back(OGRE_NEW ManualObjectSection(this, mMaterial->getName(), RenderOperation::OT_POINT_LIST));
+        if(!impostors.empty()) {
+            mSectionList.push_back(OGRE_NEW ManualObjectSection(this, mImpostorMaterial->getName(), RenderOperation::OT_POINT_LIST));
+        }
+
+        VertexElementType colourType = VertexElement::getBestColourVertexElementType();
+        size_t colourOffset = 0;
+        size_t hdrOffset = 0;
+        size_t vertexSize = 0;
+        for(size_t s = 0; s < mSectionList.size(); ++s) {
+            VertexDeclaration* decl = mSectionList[s]->getRenderOperation()->vertexData->vertexDeclaration;
+            size_t offset = 0;
+            offset += decl->addElement(0, offset, VET_FLOAT3, VES_POSITION).getSize();
+            colourOffset = offset;
+            offset += decl->addElement(0, offset, colourType, VES_DIFFUSE).getSize();
+            hdrOffset = offset;
             if(mHDREnabled) {
-                c *= mHDRMultiplier;
-                normal(c.r,c.g,c.b);
+                // the hdr shader reads the hdr colour from the normal
+                offset += decl->addElement(0, offset, VET_FLOAT3, VES_NORMAL).getSize();
             }
+            vertexSize = offset;
         }
-        
-        for(int i = 0 ; i < 6; ++i) {
-            OGRE_FREE(faceBuffers[i],MEMCATEGORY_GENERAL);
+
+        // fill the vertices in system memory then upload them once
+        size_t numPoints = mPoints.size();
+        size_t numVertices = numPoints + impostors.size();
+        size_t numChunks = (numVertices + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        uchar* vertices = OGRE_ALLOC_T(uchar, numVertices * vertexSize, MEMCATEGORY_GEOMETRY);
+        std::vector<AxisAlignedBox> chunkBounds(numChunks);
+        std::vector<Real> chunkRadius(numChunks, 0.0);
+
+        SpacescapeThreadPool::getSingleton().parallelFor(numChunks, [&](size_t chunk) {
+            size_t first = chunk * CHUNK_SIZE;
+            size_t last = std::min(first + CHUNK_SIZE, numVertices);
+            Real radiusSquared = 0.0;
+
+            for(size_t i = first; i < last; ++i) {
+                const SpacescapeSoftwareRenderer::Point& point = i >= numPoints ? impostors[i - numPoints] :
+                    mPoints[order.empty() ? i : order[i]];
+                uchar* vertex = vertices + i * vertexSize;
+
+                float* pos = reinterpret_cast<float*>(vertex);
+                pos[0] = point.position.x;
+                pos[1] = point.position.y;
+                pos[2] = point.position.z;
+
+                *reinterpret_cast<uint32*>(vertex + colourOffset) = 
+                    VertexElement::convertColourValue(point.colour, colourType);
+
+                if(mHDREnabled) {
+                    ColourValue c = point.colour * mHDRMultiplier;
+                    float* hdr = reinterpret_cast<float*>(vertex + hdrOffset);
+                    hdr[0] = c.r;
+                    hdr[1] = c.g;
+                    hdr[2] = c.b;
+                }
+
+                chunkBounds[chunk].merge(point.position);
+                radiusSquared = std::max(radiusSquared, point.position.squaredLength());
+            }
+
+            chunkRadius[chunk] = Math::Sqrt(radiusSquared);
+        });
+
+        HardwareVertexBufferSharedPtr vbuf = HardwareBufferManager::getSingleton().createVertexBuffer(
+            vertexSize, numPoints, HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+        vbuf->writeData(0, numPoints * vertexSize, vertices, true);
+        mSectionList[0]->getRenderOperation()->vertexData->vertexBufferBinding->setBinding(0, vbuf);
+
+        if(!impostors.empty()) {
+            vbuf = HardwareBufferManager::getSingleton().createVertexBuffer(
+                vertexSize, impostors.size(), HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+            vbuf->writeData(0, impostors.size() * vertexSize, vertices + numPoints * vertexSize, true);
+            mSectionList[1]->getRenderOperation()->vertexData->vertexBufferBinding->setBinding(0, vbuf);
         }
+        OGRE_FREE(vertices, MEMCATEGORY_GEOMETRY);
+
+        mNumFullVertices = numPoints;
+        mNumImpostors = impostors.size();
+        mPreviewVertexStart = omitted;
+        updateVertexRange();
 
-        end();
+        // update the bounds like end() does
+        for(size_t i = 0; i < numChunks; ++i) {
+            mAABB.merge(chunkBounds[i]);
+            mRadius = std::max(mRadius, chunkRadius[i]);
+        }
 
-        TextureManager::getSingleton().remove(t->getHandle());
+        if(mParentNode) {
+            mParentNode->needUpdate();
+        }
 
-        mBuilt = true;
+        SpacescapeSoftwareRenderer::PointList().swap(mPoints);
     }
 
     /** Create the material we'll need if not created already
@@ -352,6 +432,16 @@ namespace Ogre
 
         // make sure the material is loaded
         mMaterial->load();
+
+        // preview impostors are the same points drawn bigger
+        if(mImpostorMaterial.isNull()) {
+            mImpostorMaterial = (MaterialPtr)MaterialManager::getSingleton().create(
+                "SpacescapePointsImpostorMaterial" + StringConverter::toString(mUniqueID), 
+                ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+        }
+        mMaterial->copyDetailsTo(mImpostorMaterial);
+        mImpostorMaterial->getTechnique(0)->getPass(0)->setPointSize(mPointSize * SpacescapePreviewLOD::IMPOSTOR_SCALE);
+        mImpostorMaterial->load();
     }
 
     /** Initialize this layer based on the given params
@@ -378,6 +468,10 @@ namespace Ogre
                 shouldUpdate |= mFarColor != StringConverter::parseColourValue(ii->second);
                 mFarColor = StringConverter::parseColourValue(ii->second);
             }
+            else if(ii->first == "maskCPUNoise") {
+                shouldUpdate |= mMaskCPUNoise != StringConverter::parseBool(ii->second);
+                mMaskCPUNoise = StringConverter::parseBool(ii->second);
+            }
             else if(ii->first == "maskEnabled") {
                 shouldUpdate |= mMaskEnabled != StringConverter::parseBool(ii->second);
                 mMaskEnabled = StringConverter::parseBool(ii->second);
@@ -414,6 +508,11 @@ namespace Ogre
                 shouldUpdate |= mMaskSeed != StringConverter::parseInt(ii->second);
                 mMaskSeed = StringConverter::parseInt(ii->second);
             }
+            else if(ii->first == "maskSize") {
+                unsigned int maskSize = Math::Clamp<unsigned int>(StringConverter::parseUnsignedInt(ii->second), 1, MAX_MASK_SIZE);
+                shouldUpdate |= mMaskSize != maskSize;
+                mMaskSize = maskSize;
+            }
             else if(ii->first == "maskThreshold") {
                 shouldUpdate |= mMaskThreshold != std::min<Real>(1.0,std::max<Real>(0.0,StringConverter::parseReal(ii->second)));
                 mMaskThreshold = std::min<Real>(1.0,std::max<Real>(0.0,StringConverter::parseReal(ii->second)));
@@ -456,15 +555,51 @@ namespace Ogre
 
         // now build based on these settings
         if(shouldUpdate || !mBuilt) {
-            if(mMaskEnabled) {
-                buildMasked();
+            bool software = mPlugin->isSoftwareRenderingEnabled();
+
+            // generate the points unless prepareData() already has, the 
+            // mask is always loaded on this thread
+            if(!mPrepared || shouldUpdate) {
+                if(mMaskEnabled) {
+                    updateMask();
+                }
+
+                if(mPreparing) {
+                    mPreparePending = true;
+                }
+                else {
+                    buildData();
+                }
+            }
+
+            // prepareData() generates the points on a worker thread
+            if(mPreparing) {
+                return;
             }
-            else {
-                build();        
+
+            if(!software) {
+                createManualObject();
             }
+
+            mPreparePending = false;
+            mPrepared = false;
+            mBuilt = true;
         }
     }
 
+    /** Set whether to display the full detail points or the faster
+    preview version
+    @remarks Layers with more points than the preview budget draw their
+    brightest points and impostors for the rest in the preview, see
+    SpacescapePreviewLOD
+    @param displayHighRes Whether to display the full detail or not
+    */
+    void SpacescapeLayerPoints::setDisplayHighRes(bool displayHighRes)
+    {
+        mDisplayHighRes = displayHighRes;
+        updateVertexRange();
+    }
+
     /** Utility function for updating saved params list
     @param params The list of params
     */
@@ -475,6 +610,7 @@ namespace Ogre
         // update shared params
         mParams["destBlendFactor"] = getBlendMode(mDestBlendFactor);
         mParams["farColor"] = StringConverter::toString(mFarColor);
+        mParams["maskCPUNoise"] = StringConverter::toString(mMaskCPUNoise);
         mParams["maskEnabled"] = StringConverter::toString(mMaskEnabled);
         mParams["maskGain"] = StringConverter::toString(mMaskGain);
         mParams["maskLacunarity"] = StringConverter::toString(mMaskLacunarity);
@@ -484,6 +620,7 @@ namespace Ogre
         mParams["maskPower"] = StringConverter::toString(mMaskPower);
         mParams["maskScale"] = StringConverter::toString(mMaskScale);
         mParams["maskSeed"] = StringConverter::toString(mMaskSeed);
+        mParams["maskSize"] = StringConverter::toString(mMaskSize);
         mParams["maskThreshold"] = StringConverter::toString(mMaskThreshold);
         mParams["nearColor"] = StringConverter::toString(mNearColor);
         mParams["numPoints"] = StringConverter::toString(mNumPoints);
@@ -492,4 +629,48 @@ namespace Ogre
         mParams["hdrPower"] = StringConverter::toString(mHDRPower);
         mParams["hdrMultiplier"] = StringConverter::toString(mHDRMultiplier);
     }
+
+    /** Utility function to render the density mask into the mask sampler
+    unless only the number of points changed
+    @remarks Must be called on the render thread
+    */
+    void SpacescapeLayerPoints::updateMask(void)
+    {
+        updateMaskSampler(
+            mMaskSampler,
+            mMaskSize,
+            mMaskCPUNoise,
+            mMaskSeed,
+            mMaskNoiseType,
+            mMaskOctaves,
+            mMaskLacunarity,
+            mMaskGain,
+            mMaskPower,
+            mMaskThreshold,
+            mMaskScale,
+            mMaskOffset
+        );
+    }
+
+    /** Utility function to draw the full detail or the preview 
+    version of the points
+    */
+    void SpacescapeLayerPoints::updateVertexRange(void)
+    {
+        if(mSectionList.empty()) {
+            return;
+        }
+
+        // the points only the full detail version draws come first
+        VertexData* vertexData = mSectionList[0]->getRenderOperation()->vertexData;
+        vertexData->vertexStart = mDisplayHighRes ? 0 : mPreviewVertexStart;
+        vertexData->vertexCount = mNumFullVertices - vertexData->vertexStart;
+
+        // the impostors are only drawn in the preview
+        if(mSectionList.size() > 1) {
+            vertexData = mSectionList[1]->getRenderOperation()->vertexData;
+            vertexData->vertexStart = 0;
+            vertexData->vertexCount = mDisplayHighRes ? 0 : mNumImpostors;
+        }
+    }
 }
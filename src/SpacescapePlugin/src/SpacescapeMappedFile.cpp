@@ -0,0 +1,153 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include "SpacescapeMappedFile.h"
+#include <cstdio>
+
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+#   ifndef WIN32_LEAN_AND_MEAN
+#       define WIN32_LEAN_AND_MEAN
+#   endif
+#   ifndef NOMINMAX
+#       define NOMINMAX
+#   endif
+#   include <windows.h>
+#else
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+namespace Ogre
+{
+    /** Constructor
+    */
+    SpacescapeMappedFile::SpacescapeMappedFile(void) :
+        mData(0),
+        mSize(0)
+    {
+    }
+
+    /** Destructor
+    @remarks unmaps the file if it is still mapped
+    */
+    SpacescapeMappedFile::~SpacescapeMappedFile(void)
+    {
+        close();
+    }
+
+    /** Unmap the file
+    */
+    void SpacescapeMappedFile::close(void)
+    {
+        if(!mData) {
+            return;
+        }
+
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+        UnmapViewOfFile(mData);
+#else
+        munmap(mData, mSize);
+#endif
+        mData = 0;
+        mSize = 0;
+    }
+
+    /** Map a file, unmapping the current one first
+    @param filename The file to map
+    @return true on success, false if the file can't be opened or mapped
+    */
+    bool SpacescapeMappedFile::open(const String& filename)
+    {
+        close();
+
+        uchar* data = 0;
+        size_t fileSize = 0;
+
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+        HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+            NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if(file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+
+        LARGE_INTEGER length;
+        if(GetFileSizeEx(file, &length) && length.QuadPart > 0) {
+            fileSize = (size_t)length.QuadPart;
+            HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if(mapping) {
+                // the view keeps the file mapped after the handles are closed
+                data = (uchar*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                CloseHandle(mapping);
+            }
+        }
+        CloseHandle(file);
+#else
+        int file = ::open(filename.c_str(), O_RDONLY);
+        if(file < 0) {
+            return false;
+        }
+
+        struct stat info;
+        if(fstat(file, &info) == 0 && info.st_size > 0) {
+            fileSize = (size_t)info.st_size;
+            void* mapping = mmap(0, fileSize, PROT_READ, MAP_PRIVATE, file, 0);
+            if(mapping != MAP_FAILED) {
+                data = (uchar*)mapping;
+            }
+        }
+        ::close(file);
+#endif
+        if(!data) {
+            return false;
+        }
+
+        mData = data;
+        mSize = fileSize;
+        return true;
+    }
+
+    /** Move a file over another one in a single step, so readers see
+    either the old file or the new one and never a missing file
+    @param source The file to move
+    @param destination The file to replace
+    @return true on success, false if the source is left in place
+    */
+    bool SpacescapeMappedFile::replace(const String& source, const String& destination)
+    {
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+        // rename won't replace an existing file on Windows
+        return MoveFileExA(source.c_str(), destination.c_str(), 
+            MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+        return std::rename(source.c_str(), destination.c_str()) == 0;
+#endif
+    }
+}
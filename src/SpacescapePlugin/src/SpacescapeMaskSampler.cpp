@@ -0,0 +1,333 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include "SpacescapeMaskSampler.h"
+#include "SpacescapeThreadPool.h"
+
+namespace Ogre
+{
+    /** Constructor
+    */
+    SpacescapeMaskSampler::SpacescapeMaskSampler(void) :
+        mSize(0),
+        mTilesPerRow(0)
+    {
+    }
+
+    /** Build the table for the mask
+    @remarks Call once the mask faces are filled in (see getFace)
+    @param key The key of the mask settings (see getKey)
+    */
+    void SpacescapeMaskSampler::build(const String& key)
+    {
+        std::vector<uint32>().swap(mAlias);
+        std::vector<float>().swap(mProbability);
+        std::vector<float>().swap(mTileBound);
+        mKey = key;
+
+        size_t tilesPerFace = (size_t)mTilesPerRow * mTilesPerRow;
+        size_t numTiles = tilesPerFace * 6;
+        if(!numTiles) {
+            return;
+        }
+
+        // tile weights are their density bound times their area
+        std::vector<double> weights(numTiles);
+        mTileBound.resize(numTiles);
+        Real texelSize = 2.0 / (Real)mSize;
+
+        SpacescapeThreadPool::getSingleton().parallelFor(6 * mTilesPerRow, [&](size_t row) {
+            size_t face = row / mTilesPerRow;
+            unsigned int ty = (unsigned int)(row % mTilesPerRow);
+            const uchar* mask = &mMask[face * mSize * mSize];
+
+            unsigned int y0 = ty * TILE_SIZE;
+            unsigned int y1 = std::min(y0 + TILE_SIZE, mSize);
+
+            // bilinear samples in the tile use the texels one past its edges
+            unsigned int maskY0 = y0 > 0 ? y0 - 1 : 0;
+            unsigned int maskY1 = std::min(y1 + 1, mSize);
+
+            // the solid angle is largest at the point closest to the face center
+            Real ya = -1.0 + y0 * texelSize;
+            Real yb = -1.0 + y1 * texelSize;
+            Real yc = (ya <= 0.0 && yb >= 0.0) ? 0.0 : std::min(Math::Abs(ya), Math::Abs(yb));
+
+            for(unsigned int tx = 0; tx < mTilesPerRow; ++tx) {
+                unsigned int x0 = tx * TILE_SIZE;
+                unsigned int x1 = std::min(x0 + TILE_SIZE, mSize);
+                unsigned int maskX0 = x0 > 0 ? x0 - 1 : 0;
+                unsigned int maskX1 = std::min(x1 + 1, mSize);
+
+                uchar maxValue = 0;
+                for(unsigned int y = maskY0; y < maskY1; ++y) {
+                    for(unsigned int x = maskX0; x < maskX1; ++x) {
+                        maxValue = std::max(maxValue, mask[y * mSize + x]);
+                    }
+                }
+
+                Real xa = -1.0 + x0 * texelSize;
+                Real xb = -1.0 + x1 * texelSize;
+                Real xc = (xa <= 0.0 && xb >= 0.0) ? 0.0 : std::min(Math::Abs(xa), Math::Abs(xb));
+
+                Real n = maxValue * (1.0 / 255.0);
+                size_t tile = face * tilesPerFace + ty * mTilesPerRow + tx;
+                mTileBound[tile] = (float)(n * n * getSolidAngle(xc, yc));
+                weights[tile] = (double)mTileBound[tile] * (x1 - x0) * (y1 - y0);
+            }
+        });
+
+        double totalWeight = 0.0;
+        for(size_t i = 0; i < numTiles; ++i) {
+            totalWeight += weights[i];
+        }
+
+        if(totalWeight <= 0.0) {
+            // nothing to sample
+            std::vector<float>().swap(mTileBound);
+            return;
+        }
+
+        // scale weights so the average is 1 and split them into the tiles
+        // that are picked less than average and more than average
+        std::vector<uint32> small, large;
+        double scale = (double)numTiles / totalWeight;
+        for(size_t i = 0; i < numTiles; ++i) {
+            weights[i] *= scale;
+            if(weights[i] < 1.0) {
+                small.push_back((uint32)i);
+            }
+            else {
+                large.push_back((uint32)i);
+            }
+        }
+
+        mProbability.resize(numTiles);
+        mAlias.resize(numTiles);
+
+        // fill each small tile's slot up with part of a large tile
+        while(!small.empty() && !large.empty()) {
+            uint32 s = small.back();
+            small.pop_back();
+            uint32 l = large.back();
+
+            mProbability[s] = (float)weights[s];
+            mAlias[s] = l;
+
+            weights[l] = (weights[l] + weights[s]) - 1.0;
+            if(weights[l] < 1.0) {
+                large.pop_back();
+                small.push_back(l);
+            }
+        }
+
+        // whatever is left is full, up to rounding errors
+        for(size_t i = 0; i < large.size(); ++i) {
+            mProbability[large[i]] = 1.0f;
+            mAlias[large[i]] = large[i];
+        }
+        for(size_t i = 0; i < small.size(); ++i) {
+            mProbability[small[i]] = 1.0f;
+            mAlias[small[i]] = small[i];
+        }
+    }
+
+    /** Free the mask and the table
+    */
+    void SpacescapeMaskSampler::clear(void)
+    {
+        std::vector<uint32>().swap(mAlias);
+        std::vector<uchar>().swap(mMask);
+        std::vector<float>().swap(mProbability);
+        std::vector<float>().swap(mTileBound);
+        mKey.clear();
+        mSize = 0;
+        mTilesPerRow = 0;
+    }
+
+    /** Utility function to get the density at a position on the mask
+    @param face The cube face
+    @param u The horizontal position on the face in the range 0..1
+    @param v The vertical position on the face in the range 0..1
+    @return the bilinear mask value squared times the solid angle weight
+    */
+    Real SpacescapeMaskSampler::getDensity(unsigned int face, Real u, Real v) const
+    {
+        const uchar* mask = &mMask[(size_t)face * mSize * mSize];
+
+        // texel centers are at half texel offsets
+        Real s = u * mSize - 0.5;
+        Real t = v * mSize - 0.5;
+        Real sFloor = Math::Floor(s);
+        Real tFloor = Math::Floor(t);
+        Real fx = s - sFloor;
+        Real fy = t - tFloor;
+
+        // clamp to the face edges
+        int last = (int)mSize - 1;
+        int x0 = std::min(std::max((int)sFloor, 0), last);
+        int x1 = std::min(std::max((int)sFloor + 1, 0), last);
+        int y0 = std::min(std::max((int)tFloor, 0), last);
+        int y1 = std::min(std::max((int)tFloor + 1, 0), last);
+
+        Real top = mask[y0 * mSize + x0] + (mask[y0 * mSize + x1] - (Real)mask[y0 * mSize + x0]) * fx;
+        Real bottom = mask[y1 * mSize + x0] + (mask[y1 * mSize + x1] - (Real)mask[y1 * mSize + x0]) * fx;
+        Real n = (top + (bottom - top) * fy) * (1.0 / 255.0);
+
+        return n * n * getSolidAngle(u * 2.0 - 1.0, v * 2.0 - 1.0);
+    }
+
+    /** Get a mask face to fill in before calling build()
+    @param face The face, orientation is +X (0), -X (1), +Y (2), -Y (3), 
+    +Z (4), -Z (5)
+    @return the face in PF_L8
+    */
+    PixelBox SpacescapeMaskSampler::getFace(unsigned int face)
+    {
+        return PixelBox(mSize, mSize, 1, PF_L8, &mMask[(size_t)face * mSize * mSize]);
+    }
+
+    /** Pick a random position on the mask
+    @remarks The sampler must not be empty.  After MAX_SAMPLE_TRIES
+    positions are thrown away the densest one of them is used.
+    @param random The random number generator to use
+    @param face Set to the cube face
+    @param u Set to the horizontal position on the face in the range 0..1
+    @param v Set to the vertical position on the face in the range 0..1
+    */
+    void SpacescapeMaskSampler::sample(SpacescapeRandom& random, unsigned int& face, Real& u, Real& v) const
+    {
+        uint32 tilesPerFace = mTilesPerRow * mTilesPerRow;
+
+        // the candidate closest to being kept so far
+        Real bestRatio = -1.0;
+        unsigned int bestFace = 0;
+        Real bestU = 0.0, bestV = 0.0;
+
+        for(unsigned int tries = 0; tries < MAX_SAMPLE_TRIES; ++tries) {
+            // pick a tile from the table
+            uint32 i = random.nextBounded((uint32)mProbability.size());
+            if(random.nextUnit() >= mProbability[i]) {
+                i = mAlias[i];
+            }
+
+            uint32 tile = i % tilesPerFace;
+            face = i / tilesPerFace;
+
+            // pick a position in the tile, tiles on the far edges may be smaller
+            unsigned int x0 = (tile % mTilesPerRow) * TILE_SIZE;
+            unsigned int y0 = (tile / mTilesPerRow) * TILE_SIZE;
+            u = (x0 + random.nextUnit() * std::min(mSize - x0, (unsigned int)TILE_SIZE)) / (Real)mSize;
+            v = (y0 + random.nextUnit() * std::min(mSize - y0, (unsigned int)TILE_SIZE)) / (Real)mSize;
+
+            // keep it in proportion to the density under the tile bound
+            Real density = getDensity(face, u, v);
+            if(random.nextUnit() * mTileBound[i] < density) {
+                return;
+            }
+
+            Real ratio = mTileBound[i] > 0.0 ? density / mTileBound[i] : 0.0;
+            if(ratio > bestRatio) {
+                bestRatio = ratio;
+                bestFace = face;
+                bestU = u;
+                bestV = v;
+            }
+        }
+
+        // very unlikely, the tile bounds are tight for all but the 
+        // sparsest tiles
+        face = bestFace;
+        u = bestU;
+        v = bestV;
+    }
+
+    /** Pick a random position on the mask the way layers did before the
+    sampler, for scenes made with SpacescapeRandom::GENERATOR_RAND
+    @remarks Positions are picked evenly on the cube faces and kept 
+    against the square of the nearest mask texel, so they bunch up at
+    the cube corners.  The random numbers are used in the same order 
+    as before so those scenes keep their stars.
+    @param random The random number generator to use
+    @param numTested The number of positions thrown away in a row, set
+    to 0 before the first call
+    @param face Set to the cube face
+    @param u Set to the horizontal position on the face in the range 0..1
+    @param v Set to the vertical position on the face in the range 0..1
+    @return false when numTested reaches MAX_REJECTION_TESTS, the layers
+    drop a star then and keep going
+    */
+    bool SpacescapeMaskSampler::sampleRejection(SpacescapeRandom& random, unsigned int& numTested, unsigned int& face, Real& u, Real& v) const
+    {
+        for(;;) {
+            // pick random co-ords on the top face
+            u = random.nextUnit();
+            v = random.nextUnit();
+
+            // scale u,v to 0..size
+            unsigned int x = std::min<unsigned int>(u * mSize, mSize - 1);
+            unsigned int y = std::min<unsigned int>(v * mSize, mSize - 1);
+
+            // pick a random face
+            face = random.nextBounded(6);
+            ++numTested;
+
+            // get the mask value at this position scaled to 0..1
+            Real n = mMask[((size_t)face * mSize + y) * mSize + x];
+            n *= (Real)(1.0 / 255.0);
+
+            // get a random value between 0..1 to use for density test
+            double r = random.nextUnit();
+
+            // should give us a greater density of positions for higher mask values
+            if(r > (n * n)) {
+                // only test a certain number of positions so we don't loop forever
+                if(numTested == MAX_REJECTION_TESTS) {
+                    return false;
+                }
+                continue;
+            }
+
+            numTested = 0;
+            return true;
+        }
+    }
+
+    /** Allocate the mask faces, this frees the table
+    @param size The width/height of each mask face
+    */
+    void SpacescapeMaskSampler::setSize(unsigned int size)
+    {
+        clear();
+
+        mSize = size;
+        mTilesPerRow = (size + TILE_SIZE - 1) / TILE_SIZE;
+        mMask.resize((size_t)size * size * 6);
+    }
+}
@@ -0,0 +1,212 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include "SpacescapeMipmapGenerator.h"
+#include "SpacescapeSoftwareRenderer.h"
+#include "SpacescapeThreadPool.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Ogre
+{
+    // number of rows filtered by each thread pool task
+    static const unsigned int sRowsPerTask = 32;
+
+    // [1 3 3 1] tent kernel taps
+    static const float sKernel[4] = { 0.125f, 0.375f, 0.375f, 0.125f };
+
+    /** Utility function to get the solid angle weight of a texel - texels 
+    near the face corners cover less of the sphere
+    @param u Horizontal face position in the range -1..1
+    @param v Vertical face position in the range -1..1
+    @return the weight
+    */
+    static inline float getSolidAngleWeight(float u, float v)
+    {
+        float d = 1.0f + u * u + v * v;
+        return 1.0f / (d * sqrtf(d));
+    }
+
+    /** Constructor
+    @param orientation Orientation mode the faces were rendered with, 
+    used to find the neighbouring faces
+    */
+    SpacescapeMipmapGenerator::SpacescapeMipmapGenerator(SpacescapePlugin::SpacescapeRTTOrientation orientation)
+    {
+        // use the same face layout the faces were rendered with
+        for(unsigned int f = 0; f < 6; ++f) {
+            SpacescapeSoftwareRenderer::getFaceBasis(f, orientation, mFaceForward[f], mFaceRight[f], mFaceDown[f]);
+        }
+    }
+
+    /** Destructor
+    */
+    SpacescapeMipmapGenerator::~SpacescapeMipmapGenerator(void)
+    {
+    }
+
+    /** Utility function to filter rows of a face from the level above
+    @param src The six faces of the level above as RGB floats
+    @param srcSize The width/height of the level above
+    @param face The face to filter
+    @param rowStart The first row to filter
+    @param rowEnd One past the last row to filter
+    @param dest The RGB float face to write to
+    */
+    void SpacescapeMipmapGenerator::downsampleRows(const std::vector<float>* src, unsigned int srcSize, unsigned int face, unsigned int rowStart, unsigned int rowEnd, float* dest) const
+    {
+        unsigned int destSize = std::max<unsigned int>(1, srcSize / 2);
+        float texelSize = 2.0f / (float)srcSize;
+        const float* faceData = &src[face][0];
+
+        for(unsigned int y = rowStart; y < rowEnd; ++y) {
+            int sy = (int)y * 2 - 1;
+            bool interiorRow = sy >= 0 && sy + 3 < (int)srcSize;
+
+            for(unsigned int x = 0; x < destSize; ++x) {
+                int sx = (int)x * 2 - 1;
+                bool interior = interiorRow && sx >= 0 && sx + 3 < (int)srcSize;
+
+                float sum[3] = { 0.0f, 0.0f, 0.0f };
+                float weightSum = 0.0f;
+                for(int j = 0; j < 4; ++j) {
+                    float v = (sy + j + 0.5f) * texelSize - 1.0f;
+                    for(int i = 0; i < 4; ++i) {
+                        float u = (sx + i + 0.5f) * texelSize - 1.0f;
+                        float w = sKernel[i] * sKernel[j] * getSolidAngleWeight(u, v);
+
+                        const float* t = interior ? 
+                            faceData + ((size_t)(sy + j) * srcSize + (sx + i)) * 3 : 
+                            getTexel(src, srcSize, face, sx + i, sy + j);
+
+                        sum[0] += t[0] * w;
+                        sum[1] += t[1] * w;
+                        sum[2] += t[2] * w;
+                        weightSum += w;
+                    }
+                }
+
+                float* d = dest + ((size_t)y * destSize + x) * 3;
+                d[0] = sum[0] / weightSum;
+                d[1] = sum[1] / weightSum;
+                d[2] = sum[2] / weightSum;
+            }
+        }
+    }
+
+    /** Generate the mip levels of a cube map
+    @param faces Pixel boxes for every level of all six faces, face 
+    after face (faces[face * (numMipmaps + 1) + level]).  Level 0 of
+    every face must be filled in, the other levels are written.  Any 
+    pixel format can be used.
+    @param numMipmaps The number of levels below level 0 to generate
+    */
+    void SpacescapeMipmapGenerator::generate(const PixelBox* faces, unsigned int numMipmaps) const
+    {
+        if(numMipmaps == 0) {
+            return;
+        }
+
+        unsigned int numLevels = numMipmaps + 1;
+        unsigned int size = (unsigned int)faces[0].getWidth();
+
+        // work in floats so every level is filtered from full precision
+        std::vector<float> src[6];
+        std::vector<float> dest[6];
+        for(unsigned int f = 0; f < 6; ++f) {
+            src[f].resize((size_t)size * size * 3);
+            PixelUtil::bulkPixelConversion(faces[f * numLevels], 
+                PixelBox(size, size, 1, PF_FLOAT32_RGB, &src[f][0]));
+        }
+
+        for(unsigned int level = 1; level < numLevels; ++level) {
+            unsigned int destSize = std::max<unsigned int>(1, size / 2);
+            for(unsigned int f = 0; f < 6; ++f) {
+                dest[f].resize((size_t)destSize * destSize * 3);
+            }
+
+            unsigned int tasksPerFace = (destSize + sRowsPerTask - 1) / sRowsPerTask;
+            SpacescapeThreadPool::getSingleton().parallelFor(6 * tasksPerFace, [&](size_t i) {
+                unsigned int face = (unsigned int)(i / tasksPerFace);
+                unsigned int rowStart = (unsigned int)(i % tasksPerFace) * sRowsPerTask;
+                unsigned int rowEnd = std::min<unsigned int>(rowStart + sRowsPerTask, destSize);
+                downsampleRows(src, size, face, rowStart, rowEnd, &dest[face][0]);
+            });
+
+            for(unsigned int f = 0; f < 6; ++f) {
+                PixelUtil::bulkPixelConversion(
+                    PixelBox(destSize, destSize, 1, PF_FLOAT32_RGB, &dest[f][0]),
+                    faces[f * numLevels + level]);
+                src[f].swap(dest[f]);
+            }
+
+            size = destSize;
+        }
+    }
+
+    /** Utility function to get a texel, following the cube edges into 
+    the neighbouring faces for positions outside the face
+    @param src The six faces as RGB floats
+    @param size The width/height of the faces
+    @param face The face the position is relative to
+    @param x The texel column, may be outside the face
+    @param y The texel row, may be outside the face
+    @return the RGB texel
+    */
+    const float* SpacescapeMipmapGenerator::getTexel(const std::vector<float>* src, unsigned int size, unsigned int face, int x, int y) const
+    {
+        if(x >= 0 && y >= 0 && x < (int)size && y < (int)size) {
+            return &src[face][((size_t)y * size + x) * 3];
+        }
+
+        // direction through the texel centre on the plane of this face
+        Real u = (x + 0.5) * 2.0 / size - 1.0;
+        Real v = (y + 0.5) * 2.0 / size - 1.0;
+        Vector3 dir = mFaceForward[face] + mFaceRight[face] * u + mFaceDown[face] * v;
+
+        // the face it actually lands on
+        unsigned int f = 0;
+        Real best = dir.dotProduct(mFaceForward[0]);
+        for(unsigned int i = 1; i < 6; ++i) {
+            Real d = dir.dotProduct(mFaceForward[i]);
+            if(d > best) {
+                best = d;
+                f = i;
+            }
+        }
+
+        u = dir.dotProduct(mFaceRight[f]) / best;
+        v = dir.dotProduct(mFaceDown[f]) / best;
+
+        int fx = std::min<int>((int)size - 1, std::max<int>(0, (int)floor((u + 1.0) * 0.5 * size)));
+        int fy = std::min<int>((int)size - 1, std::max<int>(0, (int)floor((v + 1.0) * 0.5 * size)));
+
+        return &src[f][((size_t)fy * size + fx) * 3];
+    }
+}
@@ -0,0 +1,375 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include "SpacescapeNoiseCache.h"
+#include "OgreFileSystem.h"
+#include "OgreFileSystemLayer.h"
+#include "OgreLogManager.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <thread>
+
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+#   include <sys/utime.h>
+#else
+#   include <utime.h>
+#endif
+
+namespace Ogre
+{
+    // bump when the noise generation or the file layout changes so old
+    // cache files are no longer used (2 - permutations use SpacescapeRandom)
+    static const uint32 NOISE_CACHE_VERSION = 2;
+
+    // the face data starts on a multiple of this many bytes
+    static const uint32 NOISE_CACHE_ALIGNMENT = 16;
+
+    /** The header at the start of every cache file, followed by the key 
+    and then the six faces at dataOffset
+    */
+    struct NoiseCacheHeader
+    {
+        // "SSNC"
+        char magic[4];
+
+        // NOISE_CACHE_VERSION
+        uint32 version;
+
+        // width/height of each face
+        uint32 size;
+
+        // PixelFormat of the faces
+        uint32 format;
+
+        // length of the key that follows the header
+        uint32 keyLength;
+
+        // offset of the first face from the start of the file
+        uint32 dataOffset;
+    };
+
+    /** Constructor
+    */
+    SpacescapeNoiseCache::Cube::Cube(void)
+    {
+    }
+
+    /** Destructor
+    @remarks unmaps the file if it is still mapped
+    */
+    SpacescapeNoiseCache::Cube::~Cube(void)
+    {
+        close();
+    }
+
+    /** Unmap the file
+    */
+    void SpacescapeNoiseCache::Cube::close(void)
+    {
+        mFile.close();
+
+        for(int i = 0; i < 6; ++i) {
+            mFaces[i] = PixelBox();
+        }
+    }
+
+    /** Constructor
+    @param directory The directory the cache files are kept in, it is
+    created if it doesn't exist
+    */
+    SpacescapeNoiseCache::SpacescapeNoiseCache(const String& directory) :
+        mDirectory(directory),
+        mMaxSize(DEFAULT_MAX_SIZE)
+    {
+        if(!mDirectory.empty() && mDirectory[mDirectory.size() - 1] != '/' &&
+            mDirectory[mDirectory.size() - 1] != '\\') {
+            mDirectory += "/";
+        }
+
+        FileSystemLayer::createDirectory(mDirectory);
+    }
+
+    /** Destructor
+    */
+    SpacescapeNoiseCache::~SpacescapeNoiseCache(void)
+    {
+    }
+
+    /** Remove the least recently used cache files until the rest fit 
+    in mMaxSize
+    @remarks open() refreshes the modified time of every file it maps so
+    the modified time is the time the file was last used
+    @param keep A file that is never removed (the one just added)
+    */
+    void SpacescapeNoiseCache::evict(const String& keep)
+    {
+        FileSystemArchiveFactory factory;
+        Archive* archive = factory.createInstance(mDirectory, true);
+        archive->load();
+
+        FileInfoListPtr files = archive->findFileInfo("*.ssn", false);
+
+        uint64 totalSize = 0;
+        std::vector<std::pair<time_t, size_t> > ages;
+        for(size_t i = 0; i < files->size(); ++i) {
+            totalSize += (*files)[i].uncompressedSize;
+            ages.push_back(std::make_pair(archive->getModifiedTime((*files)[i].filename), i));
+        }
+
+        // least recently used first
+        std::sort(ages.begin(), ages.end());
+
+        for(size_t i = 0; i < ages.size() && totalSize > mMaxSize; ++i) {
+            const FileInfo& info = (*files)[ages[i].second];
+            String filename = mDirectory + info.filename;
+            if(filename == keep) {
+                continue;
+            }
+
+            // another process may have removed it already, or (on Windows)
+            // still have it mapped
+            if(std::remove(filename.c_str()) == 0) {
+                totalSize -= info.uncompressedSize;
+            }
+        }
+
+        archive->unload();
+        factory.destroyInstance(archive);
+    }
+
+    /** Get the file a key is stored in
+    @param key The cube key
+    @return the filename (with path)
+    */
+    String SpacescapeNoiseCache::getFilename(const String& key) const
+    {
+        // 64 bit FNV-1a
+        uint64 hash = 14695981039346656037ULL;
+        for(size_t i = 0; i < key.size(); ++i) {
+            hash ^= (uchar)key[i];
+            hash *= 1099511628211ULL;
+        }
+
+        StringStream name;
+        name << mDirectory << std::hex << std::setw(16) << std::setfill('0') << hash << ".ssn";
+        return name.str();
+    }
+
+    /** Build the key of a noise cube
+    @param source What rendered the cube, i.e. "gpu" or "cpu" - they
+    don't produce exactly the same pixels
+    @param seed The seed for the random noise
+    @param generator The generator the seed shuffles the permutation 
+    table with
+    @param params The noise settings
+    @param size The width/height of each face
+    @param format The pixel format of the faces
+    @return the key
+    */
+    String SpacescapeNoiseCache::getKey(const String& source, unsigned int seed, SpacescapeRandom::Generator generator,
+        const SpacescapeNoiseParams& params, unsigned int size, PixelFormat format)
+    {
+        // enough digits that every float value gets its own key
+        StringStream key;
+        key << std::setprecision(9);
+        key << "spacescape-noise " << NOISE_CACHE_VERSION << " " << source <<
+            " size " << size << 
+            " format " << PixelUtil::getFormatName(format) <<
+            " seed " << seed <<
+            " generator " << (int)generator <<
+            " type " << params.noiseType <<
+            " inner " << params.innerColor.r << " " << params.innerColor.g << " " << 
+                params.innerColor.b << " " << params.innerColor.a <<
+            " outer " << params.outerColor.r << " " << params.outerColor.g << " " << 
+                params.outerColor.b << " " << params.outerColor.a <<
+            " octaves " << params.octaves <<
+            " lacunarity " << params.lacunarity <<
+            " gain " << params.gain <<
+            " power " << params.power <<
+            " threshold " << params.threshold <<
+            " dither " << params.dither <<
+            " scale " << params.scale <<
+            " offset " << params.offset <<
+            " hdrPower " << params.hdrPower <<
+            " hdrMultiplier " << params.hdrMultiplier;
+        return key.str();
+    }
+
+    /** Map a cached cube into memory
+    @param key The cube key (see getKey)
+    @param size The width/height of each face
+    @param format The pixel format of the faces
+    @param cube The cube to map the file into
+    @return true if the cube is cached, false if not
+    */
+    bool SpacescapeNoiseCache::open(const String& key, unsigned int size, PixelFormat format, Cube& cube)
+    {
+        cube.close();
+
+        String filename = getFilename(key);
+        if(!cube.mFile.open(filename)) {
+            return false;
+        }
+
+        const uchar* data = cube.mFile.getData();
+        size_t fileSize = cube.mFile.getSize();
+
+        // make sure the file is the cube we're after and is complete
+        NoiseCacheHeader header;
+        size_t faceSize = PixelUtil::getMemorySize(size, size, 1, format);
+        if(fileSize < sizeof(header)) {
+            cube.close();
+            return false;
+        }
+
+        memcpy(&header, data, sizeof(header));
+        if(memcmp(header.magic, "SSNC", 4) != 0 ||
+            header.version != NOISE_CACHE_VERSION ||
+            header.size != size ||
+            header.format != (uint32)format ||
+            header.keyLength != key.size() ||
+            header.dataOffset < sizeof(header) + header.keyLength ||
+            header.dataOffset % NOISE_CACHE_ALIGNMENT != 0 ||
+            fileSize != header.dataOffset + faceSize * 6 ||
+            key.compare(0, key.size(), (const char*)data + sizeof(header), header.keyLength) != 0) {
+            cube.close();
+            return false;
+        }
+
+        for(int i = 0; i < 6; ++i) {
+            cube.mFaces[i] = PixelBox(size, size, 1, format, const_cast<uchar*>(data) + header.dataOffset + i * faceSize);
+        }
+
+        // mark the file as used so evict() keeps it over files that 
+        // haven't been read for longer, if this fails (read only cache
+        // directory) the file just ages from when it was written
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+        _utime(filename.c_str(), 0);
+#else
+        utime(filename.c_str(), 0);
+#endif
+
+        return true;
+    }
+
+    /** Copy a cached cube to six faces
+    @param key The cube key (see getKey)
+    @param faces Array of six pixel boxes to write to, all in the 
+    format and size the key was built with
+    @return true if the cube is cached, false if not
+    */
+    bool SpacescapeNoiseCache::read(const String& key, const PixelBox* faces)
+    {
+        Cube cube;
+        if(!open(key, faces[0].getWidth(), faces[0].format, cube)) {
+            return false;
+        }
+
+        for(int i = 0; i < 6; ++i) {
+            PixelUtil::bulkPixelConversion(cube.getFace(i), faces[i]);
+        }
+
+        return true;
+    }
+
+    /** Add a cube to the cache
+    @remarks The file is written under a temporary name and renamed
+    into place so other processes never map a partly written cube.
+    @param key The cube key (see getKey)
+    @param faces Array of six pixel boxes to store, all in the format 
+    and size the key was built with
+    @return true on success, false on error
+    */
+    bool SpacescapeNoiseCache::write(const String& key, const PixelBox* faces)
+    {
+        uint32 size = faces[0].getWidth();
+        PixelFormat format = faces[0].format;
+
+        NoiseCacheHeader header;
+        memcpy(header.magic, "SSNC", 4);
+        header.version = NOISE_CACHE_VERSION;
+        header.size = size;
+        header.format = (uint32)format;
+        header.keyLength = (uint32)key.size();
+        header.dataOffset = (uint32)(sizeof(header) + key.size() + NOISE_CACHE_ALIGNMENT - 1) / 
+            NOISE_CACHE_ALIGNMENT * NOISE_CACHE_ALIGNMENT;
+
+        // unique enough that two editors writing the same cube don't collide
+        String filename = getFilename(key);
+        StringStream tempName;
+        tempName << filename << "." << std::hex << 
+            std::hash<std::thread::id>()(std::this_thread::get_id()) << 
+            std::chrono::steady_clock::now().time_since_epoch().count() << ".tmp";
+
+        std::ofstream file(tempName.str().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        if(!file) {
+            Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
+                "Unable to write noise cache file " << tempName.str();
+            return false;
+        }
+
+        char padding[NOISE_CACHE_ALIGNMENT] = { 0 };
+        file.write((const char*)&header, sizeof(header));
+        file.write(key.data(), key.size());
+        file.write(padding, header.dataOffset - sizeof(header) - key.size());
+
+        // faces may have a row pitch so write them a row at a time
+        size_t rowSize = PixelUtil::getMemorySize(size, 1, 1, format);
+        for(int i = 0; i < 6; ++i) {
+            size_t pitch = PixelUtil::getMemorySize(faces[i].rowPitch, 1, 1, format);
+            const char* row = (const char*)faces[i].getTopLeftFrontPixelPtr();
+            for(uint32 y = 0; y < size; ++y, row += pitch) {
+                file.write(row, rowSize);
+            }
+        }
+
+        file.close();
+        if(file.fail()) {
+            std::remove(tempName.str().c_str());
+            Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
+                "Unable to write noise cache file " << tempName.str();
+            return false;
+        }
+
+        if(std::rename(tempName.str().c_str(), filename.c_str()) != 0) {
+            // another process may have added the same cube first
+            std::remove(tempName.str().c_str());
+            return false;
+        }
+
+        evict(filename);
+
+        return true;
+    }
+}
@@ -0,0 +1,460 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include "SpacescapeNoiseGenerator.h"
+#include "SpacescapeThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace Ogre
+{
+    // number of face rows each thread pool task renders
+    static const unsigned int sRowsPerTile = 16;
+
+    /** Constructor
+    */
+    SpacescapeNoiseParams::SpacescapeNoiseParams(void) :
+        noiseType("fbm"),
+        innerColor(1.0,1.0,1.0),
+        outerColor(0.0,0.0,0.0),
+        octaves(2),
+        lacunarity(2.0),
+        gain(0.5),
+        power(1.0),
+        threshold(0.0),
+        dither(0.0),
+        scale(1.0),
+        offset(1.0),
+        hdrPower(1.0),
+        hdrMultiplier(1.0)
+    {
+    }
+
+    /** Constructor
+    @param permutations The 512 entry permutation table (see SpacescapeLayer::initNoise)
+    @param params The noise settings
+    */
+    SpacescapeNoiseGenerator::SpacescapeNoiseGenerator(const uchar* permutations, const SpacescapeNoiseParams& params) :
+        mParams(params),
+        mRidged(params.noiseType == "ridged")
+    {
+        mTables.init(permutations, true);
+    }
+
+    /** Destructor
+    */
+    SpacescapeNoiseGenerator::~SpacescapeNoiseGenerator(void)
+    {
+    }
+
+    /** Utility noise function for fbm perlin noise
+    @param x
+    @param y
+    @param z
+    @param octaves Number of octaves
+    @return The noise value
+    */
+    float SpacescapeNoiseGenerator::fbmNoise(float x, float y, float z, unsigned int octaves) const
+    {
+        float noiseSum = 0.0;
+        float amplitude = 1.0;
+        float amplitudeSum = 0.0;
+        float gain = mParams.gain;
+        float lacunarity = mParams.lacunarity;
+
+        // make some fbm noise
+        for(unsigned int i = 0; i < octaves; i++) {
+            noiseSum += SpacescapeNoiseKernels::perlinNoise(mTables, x, y, z) * amplitude;
+            amplitudeSum += amplitude;
+            amplitude *= gain;
+            x *= lacunarity;
+            y *= lacunarity;
+            z *= lacunarity;
+        }
+
+        if(amplitudeSum == 0.0) {
+            return 0.0;
+        }
+
+        // get noiseSum in range -1..1
+        return noiseSum / amplitudeSum;
+    }
+
+    /** Utility noise function for fbm perlin noise on arrays of points
+    @remarks The coordinate arrays are used as scratch space
+    @param x Array of x coordinates
+    @param y Array of y coordinates
+    @param z Array of z coordinates
+    @param out Array the noise values are written to
+    @param noise Scratch array for the per octave noise
+    @param count Number of points
+    @param octaves Number of octaves
+    */
+    void SpacescapeNoiseGenerator::fbmNoise(float* x, float* y, float* z, float* out, float* noise, size_t count, unsigned int octaves) const
+    {
+        float amplitude = 1.0;
+        float amplitudeSum = 0.0;
+        float gain = mParams.gain;
+        float lacunarity = mParams.lacunarity;
+
+        std::fill(out, out + count, 0.0f);
+
+        // make some fbm noise - same operations per point as the scalar
+        // version so both give identical results
+        for(unsigned int i = 0; i < octaves; i++) {
+            SpacescapeNoiseKernels::perlinNoise(mTables, x, y, z, noise, count);
+
+            for(size_t j = 0; j < count; ++j) {
+                out[j] += noise[j] * amplitude;
+                x[j] *= lacunarity;
+                y[j] *= lacunarity;
+                z[j] *= lacunarity;
+            }
+
+            amplitudeSum += amplitude;
+            amplitude *= gain;
+        }
+
+        // get noiseSum in range -1..1
+        for(size_t j = 0; j < count; ++j) {
+            out[j] = amplitudeSum == 0.0 ? 0.0f : out[j] / amplitudeSum;
+        }
+    }
+
+    /** Get the final colour for a direction
+    @param dir The normalised direction
+    @return the colour (alpha holds the noise value)
+    */
+    ColourValue SpacescapeNoiseGenerator::getColour(const Vector3& dir) const
+    {
+        Real n = getNoise(dir);
+
+        ColourValue c = mParams.outerColor + (n * (mParams.innerColor - mParams.outerColor));
+        c *= mParams.hdrMultiplier;
+        c.a = n * mParams.hdrMultiplier;
+        return c;
+    }
+
+    /** Get the final colours for arrays of directions
+    @param dx Array of normalised direction x components
+    @param dy Array of normalised direction y components
+    @param dz Array of normalised direction z components
+    @param dest Array of count RGBA colours to write to (alpha holds the noise value)
+    @param count Number of directions
+    */
+    void SpacescapeNoiseGenerator::getColours(const float* dx, const float* dy, const float* dz, float* dest, size_t count) const
+    {
+        // structure of arrays scratch space so all the directions go
+        // through the batch noise kernels at once
+        std::vector<float> scratch(count * 6);
+        float* x = &scratch[0];
+        float* y = x + count;
+        float* z = y + count;
+        float* n = z + count;
+        float* dither = n + count;
+        float* noise = dither + count;
+
+        float noiseScale = mParams.scale;
+
+        for(size_t i = 0; i < count; ++i) {
+            x[i] = dx[i] * noiseScale;
+            y[i] = dy[i] * noiseScale;
+            z[i] = dz[i] * noiseScale;
+        }
+
+        if(mRidged) {
+            ridgedFbmNoise(x, y, z, n, noise, count, mParams.octaves);
+        }
+        else {
+            fbmNoise(x, y, z, n, noise, count, mParams.octaves);
+        }
+
+        // add a crazy amount of dithering noise
+        if(mParams.dither != 0.0) {
+            for(size_t i = 0; i < count; ++i) {
+                x[i] = dx[i] * 10000.0f;
+                y[i] = dy[i] * 10000.0f;
+                z[i] = dz[i] * 10000.0f;
+            }
+
+            if(mRidged) {
+                ridgedFbmNoise(x, y, z, dither, noise, count, mParams.octaves);
+            }
+            else {
+                fbmNoise(x, y, z, dither, noise, count, 2);
+            }
+
+            for(size_t i = 0; i < count; ++i) {
+                n[i] += dither[i] * mParams.dither;
+            }
+        }
+
+        for(size_t i = 0; i < count; ++i) {
+            Real value = shapeNoise(n[i]);
+
+            ColourValue c = mParams.outerColor + (value * (mParams.innerColor - mParams.outerColor));
+            c *= mParams.hdrMultiplier;
+            dest[i * 4 + 0] = c.r;
+            dest[i * 4 + 1] = c.g;
+            dest[i * 4 + 2] = c.b;
+            dest[i * 4 + 3] = value * mParams.hdrMultiplier;
+        }
+    }
+
+    /** Get the view direction through a cube face texel the same way
+    the RTT camera sees it
+    @param face The cube face (0 - 5)
+    @param u Horizontal position on the face in the range -1..1
+    @param v Vertical position on the face in the range -1..1 (top to bottom)
+    @return the direction (not normalised)
+    */
+    Vector3 SpacescapeNoiseGenerator::getFaceDirection(unsigned int face, Real u, Real v)
+    {
+        // these match the camera axes SpacescapePlugin::_rtt uses for each
+        // face in the default orientation
+        switch(face) {
+            case 0:
+                // right
+                return Vector3(1.0, -v, u);
+            case 1:
+                // left
+                return Vector3(-1.0, -v, -u);
+            case 2:
+                // top
+                return Vector3(u, 1.0, -v);
+            case 3:
+                // bottom
+                return Vector3(u, -1.0, v);
+            case 4:
+                // front
+                return Vector3(u, -v, -1.0);
+            default:
+                // back
+                return Vector3(-u, -v, 1.0);
+        }
+    }
+
+    /** Get the final noise value for a direction after the shelf and
+    power functions are applied
+    @param dir The normalised direction
+    @return the noise value
+    */
+    Real SpacescapeNoiseGenerator::getNoise(const Vector3& dir) const
+    {
+        float x = dir.x, y = dir.y, z = dir.z;
+        float scale = mParams.scale;
+        float n;
+
+        if(mRidged) {
+            n = ridgedFbmNoise(x * scale, y * scale, z * scale, mParams.octaves);
+
+            // add a crazy amount of dithering noise
+            if(mParams.dither != 0.0) {
+                n += ridgedFbmNoise(x * 10000.0f, y * 10000.0f, z * 10000.0f, mParams.octaves) * mParams.dither;
+            }
+        }
+        else {
+            n = fbmNoise(x * scale, y * scale, z * scale, mParams.octaves);
+
+            // add a crazy amount of dithering noise
+            if(mParams.dither != 0.0) {
+                n += fbmNoise(x * 10000.0f, y * 10000.0f, z * 10000.0f, 2) * mParams.dither;
+            }
+        }
+
+        return shapeNoise(n);
+    }
+
+    /** Render all six faces of a noise cube using the shared thread
+    pool.  Faces are split into row tiles so all the cores get used.
+    @param size The width/height of each face
+    @param faces Array of six pixel boxes to write to, in any pixel format
+    */
+    void SpacescapeNoiseGenerator::renderCube(unsigned int size, const PixelBox* faces) const
+    {
+        unsigned int tilesPerFace = (size + sRowsPerTile - 1) / sRowsPerTile;
+
+        SpacescapeThreadPool::getSingleton().parallelFor(6 * tilesPerFace, [&](size_t i) {
+            unsigned int face = (unsigned int)i / tilesPerFace;
+            unsigned int rowStart = ((unsigned int)i % tilesPerFace) * sRowsPerTile;
+            unsigned int rowEnd = std::min<unsigned int>(size, rowStart + sRowsPerTile);
+
+            renderFaceRows(face, size, rowStart, rowEnd, faces[face]);
+        });
+    }
+
+    /** Render a range of rows of a cube face
+    @param face The cube face (0 - 5)
+    @param size The width/height of the face
+    @param rowStart The first row to render
+    @param rowEnd One past the last row to render
+    @param dest The pixel box for the whole face to write to
+    */
+    void SpacescapeNoiseGenerator::renderFaceRows(unsigned int face, unsigned int size, unsigned int rowStart, unsigned int rowEnd, const PixelBox& dest) const
+    {
+        std::vector<float> dx(size);
+        std::vector<float> dy(size);
+        std::vector<float> dz(size);
+        std::vector<float> row(size * 4);
+        Real scale = 2.0 / (Real)size;
+
+        for(unsigned int j = rowStart; j < rowEnd; ++j) {
+            // sample at texel centres - sampling the corners is what
+            // caused the seams at the cube edges
+            Real v = -1.0 + (j + 0.5) * scale;
+
+            for(unsigned int i = 0; i < size; ++i) {
+                Real u = -1.0 + (i + 0.5) * scale;
+
+                Vector3 p = getFaceDirection(face, u, v);
+                p.normalise();
+
+                dx[i] = p.x;
+                dy[i] = p.y;
+                dz[i] = p.z;
+            }
+
+            getColours(&dx[0], &dy[0], &dz[0], &row[0], size);
+
+            // convert the row to the destination format
+            PixelUtil::bulkPixelConversion(
+                PixelBox(size, 1, 1, PF_FLOAT32_RGBA, &row[0]),
+                dest.getSubVolume(Box(0, j, size, j + 1))
+            );
+        }
+    }
+
+    /** Utility noise function for ridged fbm perlin noise
+    @param x
+    @param y
+    @param z
+    @param octaves Number of octaves
+    @return The noise value
+    */
+    float SpacescapeNoiseGenerator::ridgedFbmNoise(float x, float y, float z, unsigned int octaves) const
+    {
+        float noiseSum = 0.0;
+        float amplitude = 1.0;
+        float amplitudeSum = 0.0;
+        float prev = 1.0;
+        float gain = mParams.gain;
+        float lacunarity = mParams.lacunarity;
+        float offset = mParams.offset;
+        float n;
+
+        // make some ridged fbm noise
+        for(unsigned int i = 0; i < octaves; i++) {
+            n = offset - fabs(SpacescapeNoiseKernels::perlinNoise(mTables, x, y, z));
+            n *= n;
+            noiseSum += n * amplitude * prev;
+            prev = n;
+            amplitudeSum += amplitude;
+            amplitude *= gain;
+            x *= lacunarity;
+            y *= lacunarity;
+            z *= lacunarity;
+        }
+
+        if(amplitudeSum == 0.0) {
+            return 0.0;
+        }
+
+        // get noiseSum in range -1..1
+        return noiseSum / amplitudeSum;
+    }
+
+    /** Utility noise function for ridged fbm perlin noise on arrays of points
+    @remarks The coordinate arrays are used as scratch space
+    @param x Array of x coordinates
+    @param y Array of y coordinates
+    @param z Array of z coordinates
+    @param out Array the noise values are written to
+    @param noise Scratch array for the per octave noise
+    @param count Number of points
+    @param octaves Number of octaves
+    */
+    void SpacescapeNoiseGenerator::ridgedFbmNoise(float* x, float* y, float* z, float* out, float* noise, size_t count, unsigned int octaves) const
+    {
+        float amplitude = 1.0;
+        float amplitudeSum = 0.0;
+        float gain = mParams.gain;
+        float lacunarity = mParams.lacunarity;
+        float offset = mParams.offset;
+
+        // ridged noise weights each octave by the one before it
+        std::vector<float> prev(count, 1.0f);
+        std::fill(out, out + count, 0.0f);
+
+        // make some ridged fbm noise - same operations per point as the 
+        // scalar version so both give identical results
+        for(unsigned int i = 0; i < octaves; i++) {
+            SpacescapeNoiseKernels::perlinNoise(mTables, x, y, z, noise, count);
+
+            for(size_t j = 0; j < count; ++j) {
+                float n = offset - fabs(noise[j]);
+                n *= n;
+                out[j] += n * amplitude * prev[j];
+                prev[j] = n;
+                x[j] *= lacunarity;
+                y[j] *= lacunarity;
+                z[j] *= lacunarity;
+            }
+
+            amplitudeSum += amplitude;
+            amplitude *= gain;
+        }
+
+        // get noiseSum in range -1..1
+        for(size_t j = 0; j < count; ++j) {
+            out[j] = amplitudeSum == 0.0 ? 0.0f : out[j] / amplitudeSum;
+        }
+    }
+
+    /** Apply the shelf and power functions to a raw noise value
+    @param n The noise value in the range -1..1
+    @return the final noise value
+    */
+    float SpacescapeNoiseGenerator::shapeNoise(float n) const
+    {
+        // get noise in range 0..1
+        n = (n * 0.5f) + 0.5f;
+
+        // apply shelf
+        n = std::max<float>(0.0, n - mParams.threshold);
+
+        // scale whatever survives back into 0..1 range
+        n *= 1.0 / (1.0 - mParams.threshold);
+
+        // apply optional power function
+        n = pow(n, 1.0f / (float)mParams.power);
+
+        return pow(n, (float)mParams.hdrPower);
+    }
+}
@@ -0,0 +1,1056 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include "SpacescapeNoiseKernels.h"
+#include <atomic>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#   define SPACESCAPE_NOISE_X86
+#   include <immintrin.h>
+#   if defined(_MSC_VER)
+#       include <intrin.h>
+#       define SPACESCAPE_TARGET(x)
+#   else
+#       define SPACESCAPE_TARGET(x) __attribute__((target(x)))
+#   endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#   define SPACESCAPE_NOISE_NEON
+#   include <arm_neon.h>
+#endif
+
+namespace Ogre
+{
+    static char grad3[16][3] = {
+        {1,1,0},    {-1,1,0},    {1,-1,0},    {-1,-1,0},
+        {1,0,1},    {-1,0,1},    {1,0,-1},    {-1,0,-1},
+        {0,1,1},    {0,-1,1},    {0,1,-1},    {0,-1,-1},
+        {1,1,0},    {0,-1,1},    {-1,1,0},    {0,-1,-1}
+    };
+
+    // simple skewing factors for the 3D simplex noise case
+    static const float F3 = 0.333333333f;
+    static const float G3 = 0.166666667f;
+    static const float G3x2 = 2.0f * G3;
+    static const float G3x3 = 3.0f * G3;
+
+    // the instruction set in use, -1 until first used
+    static std::atomic<int> sInstructionSet(-1);
+
+    /** Build the tables from a permutation table
+    @param permutations The 512 entry permutation table (see SpacescapeLayer::initNoise)
+    @param gpuCompatible If true the gradients and hashes are built
+    the way the noise shaders see them through their 8 bit lookup
+    textures, otherwise they match SpacescapeLayer::grad
+    */
+    void SpacescapeNoiseKernels::Tables::init(const uchar* permutations, bool gpuCompatible)
+    {
+        for(int i = 0; i < 512; i++) {
+            perm[i] = permutations[i];
+
+            // the shaders add Z/256 to a permutation texture value that was
+            // normalised by 255 and look up the gradient texture with that,
+            // which lands one texel further along for the value 255
+            hash[i] = (gpuCompatible && permutations[i] == 255) ? 256 : permutations[i];
+        }
+
+        for(int i = 0; i < 256; i++) {
+            int h = permutations[i] & 15;
+            float gx = grad3[h][0], gy = grad3[h][1], gz = grad3[h][2];
+
+            if(gpuCompatible) {
+                // the gradient texture is PF_BYTE_RGB and holds normalised
+                // gradients so store them with the precision the shader 
+                // reads them back with
+                float l = sqrt(gx * gx + gy * gy + gz * gz);
+                gx = (floor((gx / l * 0.5 + 0.5) * 255.0) / 255.0) * 2.0 - 1.0;
+                gy = (floor((gy / l * 0.5 + 0.5) * 255.0) / 255.0) * 2.0 - 1.0;
+                gz = (floor((gz / l * 0.5 + 0.5) * 255.0) / 255.0) * 2.0 - 1.0;
+            }
+
+            gradX[i] = gx;
+            gradY[i] = gy;
+            gradZ[i] = gz;
+        }
+    }
+
+    /*
+     * Scalar reference
+     */
+    static inline float fade1(float t)
+    {
+        return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+    }
+
+    static inline float lerp1(float t, float a, float b)
+    {
+        return a + t * (b - a);
+    }
+
+    static inline float gradDot1(const SpacescapeNoiseKernels::Tables& tables, int i, float x, float y, float z)
+    {
+        i &= 255;
+        return tables.gradX[i] * x + tables.gradY[i] * y + tables.gradZ[i] * z;
+    }
+
+    /** Perlin improved noise (3d) scalar reference
+    @param tables The lookup tables
+    @param x
+    @param y
+    @param z
+    @return the noise value
+    */
+    float SpacescapeNoiseKernels::perlinNoise(const Tables& tables, float x, float y, float z)
+    {
+        float fx = floor(x), fy = floor(y), fz = floor(z);
+        int X = (int)fx & 255,                      /* FIND UNIT CUBE THAT */
+            Y = (int)fy & 255,                      /* CONTAINS POINT.     */
+            Z = (int)fz & 255;
+        x -= fx;                                    /* FIND RELATIVE X,Y,Z */
+        y -= fy;                                    /* OF POINT IN CUBE.   */
+        z -= fz;
+        float u = fade1(x),                         /* COMPUTE FADE CURVES */
+              v = fade1(y),                         /* FOR EACH OF X,Y,Z.  */
+              w = fade1(z);
+        int A = tables.perm[X] + Y,
+            B = tables.perm[X + 1] + Y;
+        int AA = tables.hash[A] + Z,
+            AB = tables.hash[A + 1] + Z,            /* HASH COORDINATES OF */
+            BA = tables.hash[B] + Z,
+            BB = tables.hash[B + 1] + Z;            /* THE 8 CUBE CORNERS, */
+        float x1 = x - 1.0f, y1 = y - 1.0f, z1 = z - 1.0f;
+
+        return lerp1(w, lerp1(v, lerp1(u, gradDot1(tables, AA, x, y, z),         /* AND ADD */
+                                          gradDot1(tables, BA, x1, y, z)),       /* BLENDED */
+                                 lerp1(u, gradDot1(tables, AB, x, y1, z),        /* RESULTS */
+                                          gradDot1(tables, BB, x1, y1, z))),     /* FROM  8 */
+                        lerp1(v, lerp1(u, gradDot1(tables, AA + 1, x, y, z1),    /* CORNERS */
+                                          gradDot1(tables, BA + 1, x1, y, z1)),  /* OF CUBE */
+                                 lerp1(u, gradDot1(tables, AB + 1, x, y1, z1),
+                                          gradDot1(tables, BB + 1, x1, y1, z1))));
+    }
+
+    /** Perlin simplex noise (3d) scalar reference
+    @param tables The lookup tables
+    @param x
+    @param y
+    @param z
+    @return the noise value
+    */
+    float SpacescapeNoiseKernels::simplexNoise(const Tables& tables, float x, float y, float z)
+    {
+        float n0, n1, n2, n3; // Noise contributions from the four corners
+
+        // Skew the input space to determine which simplex cell we're in
+        float s = (x + y + z) * F3;
+        int i = (int)floor(x + s);
+        int j = (int)floor(y + s);
+        int k = (int)floor(z + s);
+
+        float t = (float)(i + j + k) * G3;
+        float X0 = (float)i - t; // Unskew the cell origin back to (x,y,z) space
+        float Y0 = (float)j - t;
+        float Z0 = (float)k - t;
+        float x0 = x - X0; // The x,y,z distances from the cell origin
+        float y0 = y - Y0;
+        float z0 = z - Z0;
+
+        // Determine which simplex we are in - written as comparisons
+        // instead of branches so the vector versions can do the same
+        bool a = x0 >= y0, b = y0 >= z0, c = x0 >= z0;
+        int i1 = a && (b || c);
+        int j1 = !a && b;
+        int k1 = !b && !c;
+        int i2 = a || c;
+        int j2 = !a || b;
+        int k2 = !(b && c);
+
+        float x1 = x0 - (float)i1 + G3; // Offsets for second corner in (x,y,z) coords
+        float y1 = y0 - (float)j1 + G3;
+        float z1 = z0 - (float)k1 + G3;
+        float x2 = x0 - (float)i2 + G3x2; // Offsets for third corner in (x,y,z) coords
+        float y2 = y0 - (float)j2 + G3x2;
+        float z2 = z0 - (float)k2 + G3x2;
+        float x3 = x0 - 1.0f + G3x3; // Offsets for last corner in (x,y,z) coords
+        float y3 = y0 - 1.0f + G3x3;
+        float z3 = z0 - 1.0f + G3x3;
+
+        // Wrap the integer indices at 256, to avoid indexing perm[] out of bounds
+        int ii = i & 255;
+        int jj = j & 255;
+        int kk = k & 255;
+        const int* perm = tables.perm;
+
+        // Calculate the contribution from the four corners
+        float t0 = 0.6f - x0 * x0 - y0 * y0 - z0 * z0;
+        if(t0 < 0.0f) n0 = 0.0f;
+        else {
+            t0 *= t0;
+            n0 = t0 * t0 * gradDot1(tables, ii + perm[jj + perm[kk]], x0, y0, z0);
+        }
+
+        float t1 = 0.6f - x1 * x1 - y1 * y1 - z1 * z1;
+        if(t1 < 0.0f) n1 = 0.0f;
+        else {
+            t1 *= t1;
+            n1 = t1 * t1 * gradDot1(tables, ii + i1 + perm[jj + j1 + perm[kk + k1]], x1, y1, z1);
+        }
+
+        float t2 = 0.6f - x2 * x2 - y2 * y2 - z2 * z2;
+        if(t2 < 0.0f) n2 = 0.0f;
+        else {
+            t2 *= t2;
+            n2 = t2 * t2 * gradDot1(tables, ii + i2 + perm[jj + j2 + perm[kk + k2]], x2, y2, z2);
+        }
+
+        float t3 = 0.6f - x3 * x3 - y3 * y3 - z3 * z3;
+        if(t3 < 0.0f) n3 = 0.0f;
+        else {
+            t3 *= t3;
+            n3 = t3 * t3 * gradDot1(tables, ii + 1 + perm[jj + 1 + perm[kk + 1]], x3, y3, z3);
+        }
+
+        // Add contributions from each corner to get the final noise value.
+        // The result is scaled to stay just inside [-1,1]
+        return 32.0f * (n0 + n1 + n2 + n3);
+    }
+
+    static void perlinNoiseScalar(const SpacescapeNoiseKernels::Tables& tables, const float* x, const float* y, const float* z, float* out, size_t count)
+    {
+        for(size_t i = 0; i < count; ++i) {
+            out[i] = SpacescapeNoiseKernels::perlinNoise(tables, x[i], y[i], z[i]);
+        }
+    }
+
+    static void simplexNoiseScalar(const SpacescapeNoiseKernels::Tables& tables, const float* x, const float* y, const float* z, float* out, size_t count)
+    {
+        for(size_t i = 0; i < count; ++i) {
+            out[i] = SpacescapeNoiseKernels::simplexNoise(tables, x[i], y[i], z[i]);
+        }
+    }
+
+#if defined(SPACESCAPE_NOISE_X86)
+    /*
+     * SSE4.1 - 4 points at a time, gradient lookups are done per lane
+     */
+    SPACESCAPE_TARGET("sse4.1") static inline __m128 fade4(__m128 t)
+    {
+        __m128 t3 = _mm_mul_ps(_mm_mul_ps(t, t), t);
+        __m128 p = _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f));
+        return _mm_mul_ps(t3, _mm_add_ps(_mm_mul_ps(t, p), _mm_set1_ps(10.0f)));
+    }
+
+    SPACESCAPE_TARGET("sse4.1") static inline __m128 lerp4(__m128 t, __m128 a, __m128 b)
+    {
+        return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+    }
+
+    SPACESCAPE_TARGET("sse4.1") static inline __m128 gradDot4(const SpacescapeNoiseKernels::Tables& tables, const int* idx, __m128 x, __m128 y, __m128 z)
+    {
+        int i0 = idx[0] & 255, i1 = idx[1] & 255, i2 = idx[2] & 255, i3 = idx[3] & 255;
+        __m128 gx = _mm_setr_ps(tables.gradX[i0], tables.gradX[i1], tables.gradX[i2], tables.gradX[i3]);
+        __m128 gy = _mm_setr_ps(tables.gradY[i0], tables.gradY[i1], tables.gradY[i2], tables.gradY[i3]);
+        __m128 gz = _mm_setr_ps(tables.gradZ[i0], tables.gradZ[i1], tables.gradZ[i2], tables.gradZ[i3]);
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(gx, x), _mm_mul_ps(gy, y)), _mm_mul_ps(gz, z));
+    }
+
+    SPACESCAPE_TARGET("sse4.1") static void perlinNoiseSSE41(const SpacescapeNoiseKernels::Tables& tables, const float* px, const float* py, const float* pz, float* out, size_t count)
+    {
+        const __m128i mask = _mm_set1_epi32(255);
+        const __m128 one = _mm_set1_ps(1.0f);
+        alignas(16) int X[4], Y[4], Z[4];
+        alignas(16) int corner[8][4];
+
+        size_t i = 0;
+        for(; i + 4 <= count; i += 4) {
+            __m128 x = _mm_loadu_ps(px + i), y = _mm_loadu_ps(py + i), z = _mm_loadu_ps(pz + i);
+            __m128 fx = _mm_floor_ps(x), fy = _mm_floor_ps(y), fz = _mm_floor_ps(z);
+            _mm_store_si128((__m128i*)X, _mm_and_si128(_mm_cvttps_epi32(fx), mask));
+            _mm_store_si128((__m128i*)Y, _mm_and_si128(_mm_cvttps_epi32(fy), mask));
+            _mm_store_si128((__m128i*)Z, _mm_and_si128(_mm_cvttps_epi32(fz), mask));
+            x = _mm_sub_ps(x, fx);
+            y = _mm_sub_ps(y, fy);
+            z = _mm_sub_ps(z, fz);
+            __m128 u = fade4(x), v = fade4(y), w = fade4(z);
+
+            for(int l = 0; l < 4; ++l) {
+                int A = tables.perm[X[l]] + Y[l];
+                int B = tables.perm[X[l] + 1] + Y[l];
+                int AA = tables.hash[A] + Z[l], AB = tables.hash[A + 1] + Z[l];
+                int BA = tables.hash[B] + Z[l], BB = tables.hash[B + 1] + Z[l];
+                corner[0][l] = AA;      corner[1][l] = BA;
+                corner[2][l] = AB;      corner[3][l] = BB;
+                corner[4][l] = AA + 1;  corner[5][l] = BA + 1;
+                corner[6][l] = AB + 1;  corner[7][l] = BB + 1;
+            }
+
+            __m128 x1 = _mm_sub_ps(x, one), y1 = _mm_sub_ps(y, one), z1 = _mm_sub_ps(z, one);
+            __m128 r = lerp4(w, lerp4(v, lerp4(u, gradDot4(tables, corner[0], x, y, z),
+                                                  gradDot4(tables, corner[1], x1, y, z)),
+                                         lerp4(u, gradDot4(tables, corner[2], x, y1, z),
+                                                  gradDot4(tables, corner[3], x1, y1, z))),
+                                lerp4(v, lerp4(u, gradDot4(tables, corner[4], x, y, z1),
+                                                  gradDot4(tables, corner[5], x1, y, z1)),
+                                         lerp4(u, gradDot4(tables, corner[6], x, y1, z1),
+                                                  gradDot4(tables, corner[7], x1, y1, z1))));
+            _mm_storeu_ps(out + i, r);
+        }
+
+        perlinNoiseScalar(tables, px + i, py + i, pz + i, out + i, count - i);
+    }
+
+    SPACESCAPE_TARGET("sse4.1") static inline __m128 simplexCorner4(const SpacescapeNoiseKernels::Tables& tables, const int* idx, __m128 x, __m128 y, __m128 z)
+    {
+        // t = 0.6 - x*x - y*y - z*z, contribution is t^4 * (g . p) or 0 if t < 0
+        __m128 t = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(_mm_set1_ps(0.6f), _mm_mul_ps(x, x)), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+        __m128 inside = _mm_cmpnlt_ps(t, _mm_setzero_ps());
+        t = _mm_mul_ps(t, t);
+        __m128 n = _mm_mul_ps(_mm_mul_ps(t, t), gradDot4(tables, idx, x, y, z));
+        return _mm_and_ps(inside, n);
+    }
+
+    SPACESCAPE_TARGET("sse4.1") static void simplexNoiseSSE41(const SpacescapeNoiseKernels::Tables& tables, const float* px, const float* py, const float* pz, float* out, size_t count)
+    {
+        const __m128i mask = _mm_set1_epi32(255);
+        const __m128i ione = _mm_set1_epi32(1);
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 allBits = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        const int* perm = tables.perm;
+        alignas(16) int I[4], J[4], K[4];
+        alignas(16) int i1[4], j1[4], k1[4], i2[4], j2[4], k2[4];
+        alignas(16) int corner[4][4];
+
+        size_t n = 0;
+        for(; n + 4 <= count; n += 4) {
+            __m128 x = _mm_loadu_ps(px + n), y = _mm_loadu_ps(py + n), z = _mm_loadu_ps(pz + n);
+
+            // skew the input space to determine which simplex cell we're in
+            __m128 s = _mm_mul_ps(_mm_add_ps(_mm_add_ps(x, y), z), _mm_set1_ps(F3));
+            __m128i i = _mm_cvttps_epi32(_mm_floor_ps(_mm_add_ps(x, s)));
+            __m128i j = _mm_cvttps_epi32(_mm_floor_ps(_mm_add_ps(y, s)));
+            __m128i k = _mm_cvttps_epi32(_mm_floor_ps(_mm_add_ps(z, s)));
+
+            // unskew the cell origin back to (x,y,z) space
+            __m128 t = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_add_epi32(i, j), k)), _mm_set1_ps(G3));
+            __m128 x0 = _mm_sub_ps(x, _mm_sub_ps(_mm_cvtepi32_ps(i), t));
+            __m128 y0 = _mm_sub_ps(y, _mm_sub_ps(_mm_cvtepi32_ps(j), t));
+            __m128 z0 = _mm_sub_ps(z, _mm_sub_ps(_mm_cvtepi32_ps(k), t));
+
+            // determine which simplex we are in
+            __m128 a = _mm_cmpge_ps(x0, y0), b = _mm_cmpge_ps(y0, z0), c = _mm_cmpge_ps(x0, z0);
+            __m128 mi1 = _mm_and_ps(a, _mm_or_ps(b, c));
+            __m128 mj1 = _mm_andnot_ps(a, b);
+            __m128 mk1 = _mm_andnot_ps(_mm_or_ps(b, c), allBits);
+            __m128 mi2 = _mm_or_ps(a, c);
+            __m128 mj2 = _mm_or_ps(_mm_andnot_ps(a, allBits), b);
+            __m128 mk2 = _mm_andnot_ps(_mm_and_ps(b, c), allBits);
+
+            __m128 x1 = _mm_add_ps(_mm_sub_ps(x0, _mm_and_ps(mi1, one)), _mm_set1_ps(G3));
+            __m128 y1 = _mm_add_ps(_mm_sub_ps(y0, _mm_and_ps(mj1, one)), _mm_set1_ps(G3));
+            __m128 z1 = _mm_add_ps(_mm_sub_ps(z0, _mm_and_ps(mk1, one)), _mm_set1_ps(G3));
+            __m128 x2 = _mm_add_ps(_mm_sub_ps(x0, _mm_and_ps(mi2, one)), _mm_set1_ps(G3x2));
+            __m128 y2 = _mm_add_ps(_mm_sub_ps(y0, _mm_and_ps(mj2, one)), _mm_set1_ps(G3x2));
+            __m128 z2 = _mm_add_ps(_mm_sub_ps(z0, _mm_and_ps(mk2, one)), _mm_set1_ps(G3x2));
+            __m128 x3 = _mm_add_ps(_mm_sub_ps(x0, one), _mm_set1_ps(G3x3));
+            __m128 y3 = _mm_add_ps(_mm_sub_ps(y0, one), _mm_set1_ps(G3x3));
+            __m128 z3 = _mm_add_ps(_mm_sub_ps(z0, one), _mm_set1_ps(G3x3));
+
+            // hash the corners
+            _mm_store_si128((__m128i*)I, _mm_and_si128(i, mask));
+            _mm_store_si128((__m128i*)J, _mm_and_si128(j, mask));
+            _mm_store_si128((__m128i*)K, _mm_and_si128(k, mask));
+            _mm_store_si128((__m128i*)i1, _mm_and_si128(_mm_castps_si128(mi1), ione));
+            _mm_store_si128((__m128i*)j1, _mm_and_si128(_mm_castps_si128(mj1), ione));
+            _mm_store_si128((__m128i*)k1, _mm_and_si128(_mm_castps_si128(mk1), ione));
+            _mm_store_si128((__m128i*)i2, _mm_and_si128(_mm_castps_si128(mi2), ione));
+            _mm_store_si128((__m128i*)j2, _mm_and_si128(_mm_castps_si128(mj2), ione));
+            _mm_store_si128((__m128i*)k2, _mm_and_si128(_mm_castps_si128(mk2), ione));
+            for(int l = 0; l < 4; ++l) {
+                corner[0][l] = I[l] + perm[J[l] + perm[K[l]]];
+                corner[1][l] = I[l] + i1[l] + perm[J[l] + j1[l] + perm[K[l] + k1[l]]];
+                corner[2][l] = I[l] + i2[l] + perm[J[l] + j2[l] + perm[K[l] + k2[l]]];
+                corner[3][l] = I[l] + 1 + perm[J[l] + 1 + perm[K[l] + 1]];
+            }
+
+            // add contributions from each corner to get the final noise value
+            __m128 r = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+                simplexCorner4(tables, corner[0], x0, y0, z0),
+                simplexCorner4(tables, corner[1], x1, y1, z1)),
+                simplexCorner4(tables, corner[2], x2, y2, z2)),
+                simplexCorner4(tables, corner[3], x3, y3, z3));
+            _mm_storeu_ps(out + n, _mm_mul_ps(_mm_set1_ps(32.0f), r));
+        }
+
+        simplexNoiseScalar(tables, px + n, py + n, pz + n, out + n, count - n);
+    }
+
+    /*
+     * AVX2 - 8 points at a time, table lookups use gathers
+     */
+    SPACESCAPE_TARGET("avx2") static inline __m256 fade8(__m256 t)
+    {
+        __m256 t3 = _mm256_mul_ps(_mm256_mul_ps(t, t), t);
+        __m256 p = _mm256_sub_ps(_mm256_mul_ps(t, _mm256_set1_ps(6.0f)), _mm256_set1_ps(15.0f));
+        return _mm256_mul_ps(t3, _mm256_add_ps(_mm256_mul_ps(t, p), _mm256_set1_ps(10.0f)));
+    }
+
+    SPACESCAPE_TARGET("avx2") static inline __m256 lerp8(__m256 t, __m256 a, __m256 b)
+    {
+        return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+    }
+
+    SPACESCAPE_TARGET("avx2") static inline __m256 gradDot8(const SpacescapeNoiseKernels::Tables& tables, __m256i idx, __m256 x, __m256 y, __m256 z)
+    {
+        idx = _mm256_and_si256(idx, _mm256_set1_epi32(255));
+        __m256 gx = _mm256_i32gather_ps(tables.gradX, idx, 4);
+        __m256 gy = _mm256_i32gather_ps(tables.gradY, idx, 4);
+        __m256 gz = _mm256_i32gather_ps(tables.gradZ, idx, 4);
+        return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(gx, x), _mm256_mul_ps(gy, y)), _mm256_mul_ps(gz, z));
+    }
+
+    SPACESCAPE_TARGET("avx2") static void perlinNoiseAVX2(const SpacescapeNoiseKernels::Tables& tables, const float* px, const float* py, const float* pz, float* out, size_t count)
+    {
+        const __m256i mask = _mm256_set1_epi32(255);
+        const __m256i ione = _mm256_set1_epi32(1);
+        const __m256 one = _mm256_set1_ps(1.0f);
+
+        size_t i = 0;
+        for(; i + 8 <= count; i += 8) {
+            __m256 x = _mm256_loadu_ps(px + i), y = _mm256_loadu_ps(py + i), z = _mm256_loadu_ps(pz + i);
+            __m256 fx = _mm256_floor_ps(x), fy = _mm256_floor_ps(y), fz = _mm256_floor_ps(z);
+            __m256i X = _mm256_and_si256(_mm256_cvttps_epi32(fx), mask);
+            __m256i Y = _mm256_and_si256(_mm256_cvttps_epi32(fy), mask);
+            __m256i Z = _mm256_and_si256(_mm256_cvttps_epi32(fz), mask);
+            x = _mm256_sub_ps(x, fx);
+            y = _mm256_sub_ps(y, fy);
+            z = _mm256_sub_ps(z, fz);
+            __m256 u = fade8(x), v = fade8(y), w = fade8(z);
+
+            __m256i A = _mm256_add_epi32(_mm256_i32gather_epi32(tables.perm, X, 4), Y);
+            __m256i B = _mm256_add_epi32(_mm256_i32gather_epi32(tables.perm, _mm256_add_epi32(X, ione), 4), Y);
+            __m256i AA = _mm256_add_epi32(_mm256_i32gather_epi32(tables.hash, A, 4), Z);
+            __m256i AB = _mm256_add_epi32(_mm256_i32gather_epi32(tables.hash, _mm256_add_epi32(A, ione), 4), Z);
+            __m256i BA = _mm256_add_epi32(_mm256_i32gather_epi32(tables.hash, B, 4), Z);
+            __m256i BB = _mm256_add_epi32(_mm256_i32gather_epi32(tables.hash, _mm256_add_epi32(B, ione), 4), Z);
+
+            __m256 x1 = _mm256_sub_ps(x, one), y1 = _mm256_sub_ps(y, one), z1 = _mm256_sub_ps(z, one);
+            __m256 r = lerp8(w, lerp8(v, lerp8(u, gradDot8(tables, AA, x, y, z),
+                                                  gradDot8(tables, BA, x1, y, z)),
+                                         lerp8(u, gradDot8(tables, AB, x, y1, z),
+                                                  gradDot8(tables, BB, x1, y1, z))),
+                                lerp8(v, lerp8(u, gradDot8(tables, _mm256_add_epi32(AA, ione), x, y, z1),
+                                                  gradDot8(tables, _mm256_add_epi32(BA, ione), x1, y, z1)),
+                                         lerp8(u, gradDot8(tables, _mm256_add_epi32(AB, ione), x, y1, z1),
+                                                  gradDot8(tables, _mm256_add_epi32(BB, ione), x1, y1, z1))));
+            _mm256_storeu_ps(out + i, r);
+        }
+
+        perlinNoiseScalar(tables, px + i, py + i, pz + i, out + i, count - i);
+    }
+
+    SPACESCAPE_TARGET("avx2") static inline __m256 simplexCorner8(const SpacescapeNoiseKernels::Tables& tables, __m256i idx, __m256 x, __m256 y, __m256 z)
+    {
+        // t = 0.6 - x*x - y*y - z*z, contribution is t^4 * (g . p) or 0 if t < 0
+        __m256 t = _mm256_sub_ps(_mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(0.6f), _mm256_mul_ps(x, x)), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z));
+        __m256 inside = _mm256_cmp_ps(t, _mm256_setzero_ps(), _CMP_NLT_UQ);
+        t = _mm256_mul_ps(t, t);
+        __m256 n = _mm256_mul_ps(_mm256_mul_ps(t, t), gradDot8(tables, idx, x, y, z));
+        return _mm256_and_ps(inside, n);
+    }
+
+    SPACESCAPE_TARGET("avx2") static inline __m256i permLookup8(const SpacescapeNoiseKernels::Tables& tables, __m256i idx)
+    {
+        return _mm256_i32gather_epi32(tables.perm, idx, 4);
+    }
+
+    SPACESCAPE_TARGET("avx2") static void simplexNoiseAVX2(const SpacescapeNoiseKernels::Tables& tables, const float* px, const float* py, const float* pz, float* out, size_t count)
+    {
+        const __m256i mask = _mm256_set1_epi32(255);
+        const __m256i ione = _mm256_set1_epi32(1);
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 allBits = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+        size_t n = 0;
+        for(; n + 8 <= count; n += 8) {
+            __m256 x = _mm256_loadu_ps(px + n), y = _mm256_loadu_ps(py + n), z = _mm256_loadu_ps(pz + n);
+
+            // skew the input space to determine which simplex cell we're in
+            __m256 s = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(x, y), z), _mm256_set1_ps(F3));
+            __m256i i = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_add_ps(x, s)));
+            __m256i j = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_add_ps(y, s)));
+            __m256i k = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_add_ps(z, s)));
+
+            // unskew the cell origin back to (x,y,z) space
+            __m256 t = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_add_epi32(i, j), k)), _mm256_set1_ps(G3));
+            __m256 x0 = _mm256_sub_ps(x, _mm256_sub_ps(_mm256_cvtepi32_ps(i), t));
+            __m256 y0 = _mm256_sub_ps(y, _mm256_sub_ps(_mm256_cvtepi32_ps(j), t));
+            __m256 z0 = _mm256_sub_ps(z, _mm256_sub_ps(_mm256_cvtepi32_ps(k), t));
+
+            // determine which simplex we are in
+            __m256 a = _mm256_cmp_ps(x0, y0, _CMP_GE_OQ);
+            __m256 b = _mm256_cmp_ps(y0, z0, _CMP_GE_OQ);
+            __m256 c = _mm256_cmp_ps(x0, z0, _CMP_GE_OQ);
+            __m256 mi1 = _mm256_and_ps(a, _mm256_or_ps(b, c));
+            __m256 mj1 = _mm256_andnot_ps(a, b);
+            __m256 mk1 = _mm256_andnot_ps(_mm256_or_ps(b, c), allBits);
+            __m256 mi2 = _mm256_or_ps(a, c);
+            __m256 mj2 = _mm256_or_ps(_mm256_andnot_ps(a, allBits), b);
+            __m256 mk2 = _mm256_andnot_ps(_mm256_and_ps(b, c), allBits);
+
+            __m256 x1 = _mm256_add_ps(_mm256_sub_ps(x0, _mm256_and_ps(mi1, one)), _mm256_set1_ps(G3));
+            __m256 y1 = _mm256_add_ps(_mm256_sub_ps(y0, _mm256_and_ps(mj1, one)), _mm256_set1_ps(G3));
+            __m256 z1 = _mm256_add_ps(_mm256_sub_ps(z0, _mm256_and_ps(mk1, one)), _mm256_set1_ps(G3));
+            __m256 x2 = _mm256_add_ps(_mm256_sub_ps(x0, _mm256_and_ps(mi2, one)), _mm256_set1_ps(G3x2));
+            __m256 y2 = _mm256_add_ps(_mm256_sub_ps(y0, _mm256_and_ps(mj2, one)), _mm256_set1_ps(G3x2));
+            __m256 z2 = _mm256_add_ps(_mm256_sub_ps(z0, _mm256_and_ps(mk2, one)), _mm256_set1_ps(G3x2));
+            __m256 x3 = _mm256_add_ps(_mm256_sub_ps(x0, one), _mm256_set1_ps(G3x3));
+            __m256 y3 = _mm256_add_ps(_mm256_sub_ps(y0, one), _mm256_set1_ps(G3x3));
+            __m256 z3 = _mm256_add_ps(_mm256_sub_ps(z0, one), _mm256_set1_ps(G3x3));
+
+            // hash the corners
+            __m256i I = _mm256_and_si256(i, mask);
+            __m256i J = _mm256_and_si256(j, mask);
+            __m256i K = _mm256_and_si256(k, mask);
+            __m256i i1 = _mm256_and_si256(_mm256_castps_si256(mi1), ione);
+            __m256i j1 = _mm256_and_si256(_mm256_castps_si256(mj1), ione);
+            __m256i k1 = _mm256_and_si256(_mm256_castps_si256(mk1), ione);
+            __m256i i2 = _mm256_and_si256(_mm256_castps_si256(mi2), ione);
+            __m256i j2 = _mm256_and_si256(_mm256_castps_si256(mj2), ione);
+            __m256i k2 = _mm256_and_si256(_mm256_castps_si256(mk2), ione);
+
+            __m256i g0 = _mm256_add_epi32(I, permLookup8(tables, _mm256_add_epi32(J, permLookup8(tables, K))));
+            __m256i g1 = _mm256_add_epi32(_mm256_add_epi32(I, i1), permLookup8(tables, 
+                _mm256_add_epi32(_mm256_add_epi32(J, j1), permLookup8(tables, _mm256_add_epi32(K, k1)))));
+            __m256i g2 = _mm256_add_epi32(_mm256_add_epi32(I, i2), permLookup8(tables, 
+                _mm256_add_epi32(_mm256_add_epi32(J, j2), permLookup8(tables, _mm256_add_epi32(K, k2)))));
+            __m256i g3 = _mm256_add_epi32(_mm256_add_epi32(I, ione), permLookup8(tables, 
+                _mm256_add_epi32(_mm256_add_epi32(J, ione), permLookup8(tables, _mm256_add_epi32(K, ione)))));
+
+            // add contributions from each corner to get the final noise value
+            __m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+                simplexCorner8(tables, g0, x0, y0, z0),
+                simplexCorner8(tables, g1, x1, y1, z1)),
+                simplexCorner8(tables, g2, x2, y2, z2)),
+                simplexCorner8(tables, g3, x3, y3, z3));
+            _mm256_storeu_ps(out + n, _mm256_mul_ps(_mm256_set1_ps(32.0f), r));
+        }
+
+        simplexNoiseScalar(tables, px + n, py + n, pz + n, out + n, count - n);
+    }
+
+    /*
+     * AVX-512 - 16 points at a time, table lookups use gathers and the
+     * simplex corner selection uses mask registers
+     */
+#if defined(__GNUC__) && !defined(__clang__)
+    // gcc 12 wrongly warns about the undefined pass through registers
+    // inside its own avx512 intrinsics
+#   pragma GCC diagnostic push
+#   pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+    SPACESCAPE_TARGET("avx512f") static inline __m512 fade16(__m512 t)
+    {
+        __m512 t3 = _mm512_mul_ps(_mm512_mul_ps(t, t), t);
+        __m512 p = _mm512_sub_ps(_mm512_mul_ps(t, _mm512_set1_ps(6.0f)), _mm512_set1_ps(15.0f));
+        return _mm512_mul_ps(t3, _mm512_add_ps(_mm512_mul_ps(t, p), _mm512_set1_ps(10.0f)));
+    }
+
+    SPACESCAPE_TARGET("avx512f") static inline __m512 lerp16(__m512 t, __m512 a, __m512 b)
+    {
+        return _mm512_add_ps(a, _mm512_mul_ps(t, _mm512_sub_ps(b, a)));
+    }
+
+    SPACESCAPE_TARGET("avx512f") static inline __m512 floor16(__m512 x)
+    {
+        return _mm512_roundscale_ps(x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+    }
+
+    SPACESCAPE_TARGET("avx512f") static inline __m512 gradDot16(const SpacescapeNoiseKernels::Tables& tables, __m512i idx, __m512 x, __m512 y, __m512 z)
+    {
+        idx = _mm512_and_si512(idx, _mm512_set1_epi32(255));
+        __m512 gx = _mm512_i32gather_ps(idx, tables.gradX, 4);
+        __m512 gy = _mm512_i32gather_ps(idx, tables.gradY, 4);
+        __m512 gz = _mm512_i32gather_ps(idx, tables.gradZ, 4);
+        return _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(gx, x), _mm512_mul_ps(gy, y)), _mm512_mul_ps(gz, z));
+    }
+
+    SPACESCAPE_TARGET("avx512f") static void perlinNoiseAVX512(const SpacescapeNoiseKernels::Tables& tables, const float* px, const float* py, const float* pz, float* out, size_t count)
+    {
+        const __m512i mask = _mm512_set1_epi32(255);
+        const __m512i ione = _mm512_set1_epi32(1);
+        const __m512 one = _mm512_set1_ps(1.0f);
+
+        size_t i = 0;
+        for(; i + 16 <= count; i += 16) {
+            __m512 x = _mm512_loadu_ps(px + i), y = _mm512_loadu_ps(py + i), z = _mm512_loadu_ps(pz + i);
+            __m512 fx = floor16(x), fy = floor16(y), fz = floor16(z);
+            __m512i X = _mm512_and_si512(_mm512_cvttps_epi32(fx), mask);
+            __m512i Y = _mm512_and_si512(_mm512_cvttps_epi32(fy), mask);
+            __m512i Z = _mm512_and_si512(_mm512_cvttps_epi32(fz), mask);
+            x = _mm512_sub_ps(x, fx);
+            y = _mm512_sub_ps(y, fy);
+            z = _mm512_sub_ps(z, fz);
+            __m512 u = fade16(x), v = fade16(y), w = fade16(z);
+
+            __m512i A = _mm512_add_epi32(_mm512_i32gather_epi32(X, tables.perm, 4), Y);
+            __m512i B = _mm512_add_epi32(_mm512_i32gather_epi32(_mm512_add_epi32(X, ione), tables.perm, 4), Y);
+            __m512i AA = _mm512_add_epi32(_mm512_i32gather_epi32(A, tables.hash, 4), Z);
+            __m512i AB = _mm512_add_epi32(_mm512_i32gather_epi32(_mm512_add_epi32(A, ione), tables.hash, 4), Z);
+            __m512i BA = _mm512_add_epi32(_mm512_i32gather_epi32(B, tables.hash, 4), Z);
+            __m512i BB = _mm512_add_epi32(_mm512_i32gather_epi32(_mm512_add_epi32(B, ione), tables.hash, 4), Z);
+
+            __m512 x1 = _mm512_sub_ps(x, one), y1 = _mm512_sub_ps(y, one), z1 = _mm512_sub_ps(z, one);
+            __m512 r = lerp16(w, lerp16(v, lerp16(u, gradDot16(tables, AA, x, y, z),
+                                                     gradDot16(tables, BA, x1, y, z)),
+                                           lerp16(u, gradDot16(tables, AB, x, y1, z),
+                                                     gradDot16(tables, BB, x1, y1, z))),
+                                 lerp16(v, lerp16(u, gradDot16(tables, _mm512_add_epi32(AA, ione), x, y, z1),
+                                                     gradDot16(tables, _mm512_add_epi32(BA, ione), x1, y, z1)),
+                                           lerp16(u, gradDot16(tables, _mm512_add_epi32(AB, ione), x, y1, z1),
+                                                     gradDot16(tables, _mm512_add_epi32(BB, ione), x1, y1, z1))));
+            _mm512_storeu_ps(out + i, r);
+        }
+
+        perlinNoiseScalar(tables, px + i, py + i, pz + i, out + i, count - i);
+    }
+
+    SPACESCAPE_TARGET("avx512f") static inline __m512 simplexCorner16(const SpacescapeNoiseKernels::Tables& tables, __m512i idx, __m512 x, __m512 y, __m512 z)
+    {
+        // t = 0.6 - x*x - y*y - z*z, contribution is t^4 * (g . p) or 0 if t < 0
+        __m512 t = _mm512_sub_ps(_mm512_sub_ps(_mm512_sub_ps(_mm512_set1_ps(0.6f), _mm512_mul_ps(x, x)), _mm512_mul_ps(y, y)), _mm512_mul_ps(z, z));
+        __mmask16 inside = _mm512_cmp_ps_mask(t, _mm512_setzero_ps(), _CMP_NLT_UQ);
+        t = _mm512_mul_ps(t, t);
+        return _mm512_maskz_mul_ps(inside, _mm512_mul_ps(t, t), gradDot16(tables, idx, x, y, z));
+    }
+
+    SPACESCAPE_TARGET("avx512f") static inline __m512i permLookup16(const SpacescapeNoiseKernels::Tables& tables, __m512i idx)
+    {
+        return _mm512_i32gather_epi32(idx, tables.perm, 4);
+    }
+
+    SPACESCAPE_TARGET("avx512f") static void simplexNoiseAVX512(const SpacescapeNoiseKernels::Tables& tables, const float* px, const float* py, const float* pz, float* out, size_t count)
+    {
+        const __m512i mask = _mm512_set1_epi32(255);
+        const __m512i ione = _mm512_set1_epi32(1);
+        const __m512 one = _mm512_set1_ps(1.0f);
+
+        size_t n = 0;
+        for(; n + 16 <= count; n += 16) {
+            __m512 x = _mm512_loadu_ps(px + n), y = _mm512_loadu_ps(py + n), z = _mm512_loadu_ps(pz + n);
+
+            // skew the input space to determine which simplex cell we're in
+            __m512 s = _mm512_mul_ps(_mm512_add_ps(_mm512_add_ps(x, y), z), _mm512_set1_ps(F3));
+            __m512i i = _mm512_cvttps_epi32(floor16(_mm512_add_ps(x, s)));
+            __m512i j = _mm512_cvttps_epi32(floor16(_mm512_add_ps(y, s)));
+            __m512i k = _mm512_cvttps_epi32(floor16(_mm512_add_ps(z, s)));
+
+            // unskew the cell origin back to (x,y,z) space
+            __m512 t = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_add_epi32(_mm512_add_epi32(i, j), k)), _mm512_set1_ps(G3));
+            __m512 x0 = _mm512_sub_ps(x, _mm512_sub_ps(_mm512_cvtepi32_ps(i), t));
+            __m512 y0 = _mm512_sub_ps(y, _mm512_sub_ps(_mm512_cvtepi32_ps(j), t));
+            __m512 z0 = _mm512_sub_ps(z, _mm512_sub_ps(_mm512_cvtepi32_ps(k), t));
+
+            // determine which simplex we are in
+            __mmask16 a = _mm512_cmp_ps_mask(x0, y0, _CMP_GE_OQ);
+            __mmask16 b = _mm512_cmp_ps_mask(y0, z0, _CMP_GE_OQ);
+            __mmask16 c = _mm512_cmp_ps_mask(x0, z0, _CMP_GE_OQ);
+            __mmask16 mi1 = a & (b | c);
+            __mmask16 mj1 = ~a & b;
+            __mmask16 mk1 = ~(b | c);
+            __mmask16 mi2 = a | c;
+            __mmask16 mj2 = ~a | b;
+            __mmask16 mk2 = ~(b & c);
+
+            // subtracting 1 only in the lanes that step along an axis is
+            // the same as the scalar subtracting 0 or 1
+            __m512 x1 = _mm512_add_ps(_mm512_mask_sub_ps(x0, mi1, x0, one), _mm512_set1_ps(G3));
+            __m512 y1 = _mm512_add_ps(_mm512_mask_sub_ps(y0, mj1, y0, one), _mm512_set1_ps(G3));
+            __m512 z1 = _mm512_add_ps(_mm512_mask_sub_ps(z0, mk1, z0, one), _mm512_set1_ps(G3));
+            __m512 x2 = _mm512_add_ps(_mm512_mask_sub_ps(x0, mi2, x0, one), _mm512_set1_ps(G3x2));
+            __m512 y2 = _mm512_add_ps(_mm512_mask_sub_ps(y0, mj2, y0, one), _mm512_set1_ps(G3x2));
+            __m512 z2 = _mm512_add_ps(_mm512_mask_sub_ps(z0, mk2, z0, one), _mm512_set1_ps(G3x2));
+            __m512 x3 = _mm512_add_ps(_mm512_sub_ps(x0, one), _mm512_set1_ps(G3x3));
+            __m512 y3 = _mm512_add_ps(_mm512_sub_ps(y0, one), _mm512_set1_ps(G3x3));
+            __m512 z3 = _mm512_add_ps(_mm512_sub_ps(z0, one), _mm512_set1_ps(G3x3));
+
+            // hash the corners
+            __m512i I = _mm512_and_si512(i, mask);
+            __m512i J = _mm512_and_si512(j, mask);
+            __m512i K = _mm512_and_si512(k, mask);
+
+            __m512i g0 = _mm512_add_epi32(I, permLookup16(tables, _mm512_add_epi32(J, permLookup16(tables, K))));
+            __m512i g1 = _mm512_mask_add_epi32(I, mi1, I, ione);
+            g1 = _mm512_add_epi32(g1, permLookup16(tables, _mm512_add_epi32(_mm512_mask_add_epi32(J, mj1, J, ione),
+                permLookup16(tables, _mm512_mask_add_epi32(K, mk1, K, ione)))));
+            __m512i g2 = _mm512_mask_add_epi32(I, mi2, I, ione);
+            g2 = _mm512_add_epi32(g2, permLookup16(tables, _mm512_add_epi32(_mm512_mask_add_epi32(J, mj2, J, ione),
+                permLookup16(tables, _mm512_mask_add_epi32(K, mk2, K, ione)))));
+            __m512i g3 = _mm512_add_epi32(_mm512_add_epi32(I, ione), permLookup16(tables, 
+                _mm512_add_epi32(_mm512_add_epi32(J, ione), permLookup16(tables, _mm512_add_epi32(K, ione)))));
+
+            // add contributions from each corner to get the final noise value
+            __m512 r = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(
+                simplexCorner16(tables, g0, x0, y0, z0),
+                simplexCorner16(tables, g1, x1, y1, z1)),
+                simplexCorner16(tables, g2, x2, y2, z2)),
+                simplexCorner16(tables, g3, x3, y3, z3));
+            _mm512_storeu_ps(out + n, _mm512_mul_ps(_mm512_set1_ps(32.0f), r));
+        }
+
+        simplexNoiseScalar(tables, px + n, py + n, pz + n, out + n, count - n);
+    }
+#if defined(__GNUC__) && !defined(__clang__)
+#   pragma GCC diagnostic pop
+#endif
+#endif
+
+#if defined(SPACESCAPE_NOISE_NEON)
+    /*
+     * NEON - 4 points at a time, gradient lookups are done per lane
+     */
+    static inline float32x4_t fadeNEON(float32x4_t t)
+    {
+        float32x4_t t3 = vmulq_f32(vmulq_f32(t, t), t);
+        float32x4_t p = vsubq_f32(vmulq_f32(t, vdupq_n_f32(6.0f)), vdupq_n_f32(15.0f));
+        return vmulq_f32(t3, vaddq_f32(vmulq_f32(t, p), vdupq_n_f32(10.0f)));
+    }
+
+    static inline float32x4_t lerpNEON(float32x4_t t, float32x4_t a, float32x4_t b)
+    {
+        return vaddq_f32(a, vmulq_f32(t, vsubq_f32(b, a)));
+    }
+
+    static inline float32x4_t gradDotNEON(const SpacescapeNoiseKernels::Tables& tables, const int* idx, float32x4_t x, float32x4_t y, float32x4_t z)
+    {
+        int i0 = idx[0] & 255, i1 = idx[1] & 255, i2 = idx[2] & 255, i3 = idx[3] & 255;
+        float gx[4] = { tables.gradX[i0], tables.gradX[i1], tables.gradX[i2], tables.gradX[i3] };
+        float gy[4] = { tables.gradY[i0], tables.gradY[i1], tables.gradY[i2], tables.gradY[i3] };
+        float gz[4] = { tables.gradZ[i0], tables.gradZ[i1], tables.gradZ[i2], tables.gradZ[i3] };
+        return vaddq_f32(vaddq_f32(vmulq_f32(vld1q_f32(gx), x), vmulq_f32(vld1q_f32(gy), y)), vmulq_f32(vld1q_f32(gz), z));
+    }
+
+    static void perlinNoiseNEON(const SpacescapeNoiseKernels::Tables& tables, const float* px, const float* py, const float* pz, float* out, size_t count)
+    {
+        const int32x4_t mask = vdupq_n_s32(255);
+        const float32x4_t one = vdupq_n_f32(1.0f);
+        int X[4], Y[4], Z[4];
+        int corner[8][4];
+
+        size_t i = 0;
+        for(; i + 4 <= count; i += 4) {
+            float32x4_t x = vld1q_f32(px + i), y = vld1q_f32(py + i), z = vld1q_f32(pz + i);
+            float32x4_t fx = vrndmq_f32(x), fy = vrndmq_f32(y), fz = vrndmq_f32(z);
+            vst1q_s32(X, vandq_s32(vcvtq_s32_f32(fx), mask));
+            vst1q_s32(Y, vandq_s32(vcvtq_s32_f32(fy), mask));
+            vst1q_s32(Z, vandq_s32(vcvtq_s32_f32(fz), mask));
+            x = vsubq_f32(x, fx);
+            y = vsubq_f32(y, fy);
+            z = vsubq_f32(z, fz);
+            float32x4_t u = fadeNEON(x), v = fadeNEON(y), w = fadeNEON(z);
+
+            for(int l = 0; l < 4; ++l) {
+                int A = tables.perm[X[l]] + Y[l];
+                int B = tables.perm[X[l] + 1] + Y[l];
+                int AA = tables.hash[A] + Z[l], AB = tables.hash[A + 1] + Z[l];
+                int BA = tables.hash[B] + Z[l], BB = tables.hash[B + 1] + Z[l];
+                corner[0][l] = AA;      corner[1][l] = BA;
+                corner[2][l] = AB;      corner[3][l] = BB;
+                corner[4][l] = AA + 1;  corner[5][l] = BA + 1;
+                corner[6][l] = AB + 1;  corner[7][l] = BB + 1;
+            }
+
+            float32x4_t x1 = vsubq_f32(x, one), y1 = vsubq_f32(y, one), z1 = vsubq_f32(z, one);
+            float32x4_t r = lerpNEON(w, lerpNEON(v, lerpNEON(u, gradDotNEON(tables, corner[0], x, y, z),
+                                                                gradDotNEON(tables, corner[1], x1, y, z)),
+                                                    lerpNEON(u, gradDotNEON(tables, corner[2], x, y1, z),
+                                                                gradDotNEON(tables, corner[3], x1, y1, z))),
+                                        lerpNEON(v, lerpNEON(u, gradDotNEON(tables, corner[4], x, y, z1),
+                                                                gradDotNEON(tables, corner[5], x1, y, z1)),
+                                                    lerpNEON(u, gradDotNEON(tables, corner[6], x, y1, z1),
+                                                                gradDotNEON(tables, corner[7], x1, y1, z1))));
+            vst1q_f32(out + i, r);
+        }
+
+        perlinNoiseScalar(tables, px + i, py + i, pz + i, out + i, count - i);
+    }
+
+    static inline float32x4_t simplexCornerNEON(const SpacescapeNoiseKernels::Tables& tables, const int* idx, float32x4_t x, float32x4_t y, float32x4_t z)
+    {
+        // t = 0.6 - x*x - y*y - z*z, contribution is t^4 * (g . p) or 0 if t < 0
+        float32x4_t t = vsubq_f32(vsubq_f32(vsubq_f32(vdupq_n_f32(0.6f), vmulq_f32(x, x)), vmulq_f32(y, y)), vmulq_f32(z, z));
+        uint32x4_t inside = vmvnq_u32(vcltq_f32(t, vdupq_n_f32(0.0f)));
+        t = vmulq_f32(t, t);
+        float32x4_t n = vmulq_f32(vmulq_f32(t, t), gradDotNEON(tables, idx, x, y, z));
+        return vreinterpretq_f32_u32(vandq_u32(inside, vreinterpretq_u32_f32(n)));
+    }
+
+    static void simplexNoiseNEON(const SpacescapeNoiseKernels::Tables& tables, const float* px, const float* py, const float* pz, float* out, size_t count)
+    {
+        const int32x4_t mask = vdupq_n_s32(255);
+        const uint32x4_t ione = vdupq_n_u32(1);
+        const float32x4_t one = vdupq_n_f32(1.0f);
+        const uint32x4_t oneBits = vreinterpretq_u32_f32(one);
+        const int* perm = tables.perm;
+        int I[4], J[4], K[4];
+        uint32_t i1[4], j1[4], k1[4], i2[4], j2[4], k2[4];
+        int corner[4][4];
+
+        size_t n = 0;
+        for(; n + 4 <= count; n += 4) {
+            float32x4_t x = vld1q_f32(px + n), y = vld1q_f32(py + n), z = vld1q_f32(pz + n);
+
+            // skew the input space to determine which simplex cell we're in
+            float32x4_t s = vmulq_f32(vaddq_f32(vaddq_f32(x, y), z), vdupq_n_f32(F3));
+            int32x4_t i = vcvtq_s32_f32(vrndmq_f32(vaddq_f32(x, s)));
+            int32x4_t j = vcvtq_s32_f32(vrndmq_f32(vaddq_f32(y, s)));
+            int32x4_t k = vcvtq_s32_f32(vrndmq_f32(vaddq_f32(z, s)));
+
+            // unskew the cell origin back to (x,y,z) space
+            float32x4_t t = vmulq_f32(vcvtq_f32_s32(vaddq_s32(vaddq_s32(i, j), k)), vdupq_n_f32(G3));
+            float32x4_t x0 = vsubq_f32(x, vsubq_f32(vcvtq_f32_s32(i), t));
+            float32x4_t y0 = vsubq_f32(y, vsubq_f32(vcvtq_f32_s32(j), t));
+            float32x4_t z0 = vsubq_f32(z, vsubq_f32(vcvtq_f32_s32(k), t));
+
+            // determine which simplex we are in
+            uint32x4_t a = vcgeq_f32(x0, y0), b = vcgeq_f32(y0, z0), c = vcgeq_f32(x0, z0);
+            uint32x4_t mi1 = vandq_u32(a, vorrq_u32(b, c));
+            uint32x4_t mj1 = vbicq_u32(b, a);
+            uint32x4_t mk1 = vmvnq_u32(vorrq_u32(b, c));
+            uint32x4_t mi2 = vorrq_u32(a, c);
+            uint32x4_t mj2 = vorrq_u32(vmvnq_u32(a), b);
+            uint32x4_t mk2 = vmvnq_u32(vandq_u32(b, c));
+
+            #define SPACESCAPE_MASK_ONE(m) vreinterpretq_f32_u32(vandq_u32(m, oneBits))
+            float32x4_t x1 = vaddq_f32(vsubq_f32(x0, SPACESCAPE_MASK_ONE(mi1)), vdupq_n_f32(G3));
+            float32x4_t y1 = vaddq_f32(vsubq_f32(y0, SPACESCAPE_MASK_ONE(mj1)), vdupq_n_f32(G3));
+            float32x4_t z1 = vaddq_f32(vsubq_f32(z0, SPACESCAPE_MASK_ONE(mk1)), vdupq_n_f32(G3));
+            float32x4_t x2 = vaddq_f32(vsubq_f32(x0, SPACESCAPE_MASK_ONE(mi2)), vdupq_n_f32(G3x2));
+            float32x4_t y2 = vaddq_f32(vsubq_f32(y0, SPACESCAPE_MASK_ONE(mj2)), vdupq_n_f32(G3x2));
+            float32x4_t z2 = vaddq_f32(vsubq_f32(z0, SPACESCAPE_MASK_ONE(mk2)), vdupq_n_f32(G3x2));
+            #undef SPACESCAPE_MASK_ONE
+            float32x4_t x3 = vaddq_f32(vsubq_f32(x0, one), vdupq_n_f32(G3x3));
+            float32x4_t y3 = vaddq_f32(vsubq_f32(y0, one), vdupq_n_f32(G3x3));
+            float32x4_t z3 = vaddq_f32(vsubq_f32(z0, one), vdupq_n_f32(G3x3));
+
+            // hash the corners
+            vst1q_s32(I, vandq_s32(i, mask));
+            vst1q_s32(J, vandq_s32(j, mask));
+            vst1q_s32(K, vandq_s32(k, mask));
+            vst1q_u32(i1, vandq_u32(mi1, ione));
+            vst1q_u32(j1, vandq_u32(mj1, ione));
+            vst1q_u32(k1, vandq_u32(mk1, ione));
+            vst1q_u32(i2, vandq_u32(mi2, ione));
+            vst1q_u32(j2, vandq_u32(mj2, ione));
+            vst1q_u32(k2, vandq_u32(mk2, ione));
+            for(int l = 0; l < 4; ++l) {
+                corner[0][l] = I[l] + perm[J[l] + perm[K[l]]];
+                corner[1][l] = I[l] + i1[l] + perm[J[l] + j1[l] + perm[K[l] + k1[l]]];
+                corner[2][l] = I[l] + i2[l] + perm[J[l] + j2[l] + perm[K[l] + k2[l]]];
+                corner[3][l] = I[l] + 1 + perm[J[l] + 1 + perm[K[l] + 1]];
+            }
+
+            // add contributions from each corner to get the final noise value
+            float32x4_t r = vaddq_f32(vaddq_f32(vaddq_f32(
+                simplexCornerNEON(tables, corner[0], x0, y0, z0),
+                simplexCornerNEON(tables, corner[1], x1, y1, z1)),
+                simplexCornerNEON(tables, corner[2], x2, y2, z2)),
+                simplexCornerNEON(tables, corner[3], x3, y3, z3));
+            vst1q_f32(out + n, vmulq_f32(vdupq_n_f32(32.0f), r));
+        }
+
+        simplexNoiseScalar(tables, px + n, py + n, pz + n, out + n, count - n);
+    }
+#endif
+
+    /** Get the fastest instruction set this CPU supports
+    @return the instruction set
+    */
+    SpacescapeNoiseKernels::InstructionSet SpacescapeNoiseKernels::getBestInstructionSet(void)
+    {
+#if defined(SPACESCAPE_NOISE_X86)
+#   if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        int maxId = info[0];
+
+        __cpuid(info, 1);
+        bool sse41 = (info[2] & (1 << 19)) != 0;
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        bool avx2 = false;
+        bool avx512 = false;
+
+        // avx2 also needs the OS to save the ymm registers
+        if(maxId >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6) {
+            __cpuidex(info, 7, 0);
+            avx2 = (info[1] & (1 << 5)) != 0;
+
+            // and avx512 the opmask and zmm registers
+            avx512 = (info[1] & (1 << 16)) != 0 && (_xgetbv(0) & 0xe6) == 0xe6;
+        }
+#   else
+        __builtin_cpu_init();
+        bool sse41 = __builtin_cpu_supports("sse4.1") != 0;
+        bool avx2 = __builtin_cpu_supports("avx2") != 0;
+        bool avx512 = __builtin_cpu_supports("avx512f") != 0;
+#   endif
+        if(avx512) {
+            return SIS_AVX512;
+        }
+        if(avx2) {
+            return SIS_AVX2;
+        }
+        if(sse41) {
+            return SIS_SSE41;
+        }
+#elif defined(SPACESCAPE_NOISE_NEON)
+        // neon is always there on 64 bit arm
+        return SIS_NEON;
+#endif
+        return SIS_SCALAR;
+    }
+
+    /** Get the instruction set the batch functions currently use
+    @return the instruction set
+    */
+    SpacescapeNoiseKernels::InstructionSet SpacescapeNoiseKernels::getInstructionSet(void)
+    {
+        int set = sInstructionSet;
+        if(set < 0) {
+            set = getBestInstructionSet();
+            sInstructionSet = set;
+        }
+        return (InstructionSet)set;
+    }
+
+    /** Get a printable name for an instruction set
+    @param set The instruction set
+    @return the name
+    */
+    const char* SpacescapeNoiseKernels::getInstructionSetName(InstructionSet set)
+    {
+        switch(set) {
+            case SIS_SSE41:
+                return "SSE4.1";
+            case SIS_AVX2:
+                return "AVX2";
+            case SIS_AVX512:
+                return "AVX-512";
+            case SIS_NEON:
+                return "NEON";
+            default:
+                return "scalar";
+        }
+    }
+
+    /** Perlin improved noise (3d) for an array of points
+    @param tables The lookup tables
+    @param x Array of x coordinates
+    @param y Array of y coordinates
+    @param z Array of z coordinates
+    @param out Array the noise values are written to
+    @param count Number of points
+    */
+    void SpacescapeNoiseKernels::perlinNoise(const Tables& tables, const float* x, const float* y, const float* z, float* out, size_t count)
+    {
+        switch(getInstructionSet()) {
+#if defined(SPACESCAPE_NOISE_X86)
+            case SIS_AVX512:
+                perlinNoiseAVX512(tables, x, y, z, out, count);
+                break;
+            case SIS_AVX2:
+                perlinNoiseAVX2(tables, x, y, z, out, count);
+                break;
+            case SIS_SSE41:
+                perlinNoiseSSE41(tables, x, y, z, out, count);
+                break;
+#endif
+#if defined(SPACESCAPE_NOISE_NEON)
+            case SIS_NEON:
+                perlinNoiseNEON(tables, x, y, z, out, count);
+                break;
+#endif
+            default:
+                perlinNoiseScalar(tables, x, y, z, out, count);
+                break;
+        }
+    }
+
+    /** Force the batch functions to use a particular instruction set
+    @remarks Mainly for comparing results and timings.  Falls back to
+    the best supported instruction set if the one requested isn't supported.
+    @param set The instruction set
+    */
+    void SpacescapeNoiseKernels::setInstructionSet(InstructionSet set)
+    {
+        InstructionSet best = getBestInstructionSet();
+
+        bool supported = set == SIS_SCALAR || set == best;
+#if defined(SPACESCAPE_NOISE_X86)
+        // avx512 machines can run the avx2 and sse4.1 kernels too and
+        // avx2 machines the sse4.1 ones
+        supported |= set == SIS_AVX2 && best == SIS_AVX512;
+        supported |= set == SIS_SSE41 && (best == SIS_AVX2 || best == SIS_AVX512);
+#endif
+        sInstructionSet = supported ? set : best;
+    }
+
+    /** Perlin simplex noise (3d) for an array of points
+    @param tables The lookup tables
+    @param x Array of x coordinates
+    @param y Array of y coordinates
+    @param z Array of z coordinates
+    @param out Array the noise values are written to
+    @param count Number of points
+    */
+    void SpacescapeNoiseKernels::simplexNoise(const Tables& tables, const float* x, const float* y, const float* z, float* out, size_t count)
+    {
+        switch(getInstructionSet()) {
+#if defined(SPACESCAPE_NOISE_X86)
+            case SIS_AVX512:
+                simplexNoiseAVX512(tables, x, y, z, out, count);
+                break;
+            case SIS_AVX2:
+                simplexNoiseAVX2(tables, x, y, z, out, count);
+                break;
+            case SIS_SSE41:
+                simplexNoiseSSE41(tables, x, y, z, out, count);
+                break;
+#endif
+#if defined(SPACESCAPE_NOISE_NEON)
+            case SIS_NEON:
+                simplexNoiseNEON(tables, x, y, z, out, count);
+                break;
+#endif
+            default:
+                simplexNoiseScalar(tables, x, y, z, out, count);
+                break;
+        }
+    }
+}
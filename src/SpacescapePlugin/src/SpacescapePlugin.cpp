@@ -29,8 +29,14 @@ THE SOFTWARE.
 */
 #include "SpacescapePlugin.h"
 #include "SpacescapeLayerBillboards.h"
+#include "SpacescapeLayerCache.h"
 #include "SpacescapeLayerNoise.h"
 #include "SpacescapeLayerPoints.h"
+#include "SpacescapeMipmapGenerator.h"
+#include "SpacescapeNoiseCache.h"
+#include "SpacescapeSoftwareRenderer.h"
+#include "SpacescapeStripWriter.h"
+#include "SpacescapeThreadPool.h"
 #include "OgreRoot.h"
 #include "OgreMaterialManager.h"
 #include "OgreTextureManager.h"
@@ -39,6 +45,7 @@ THE SOFTWARE.
 #include "OgreRenderTexture.h"
 #include "OgreSceneNode.h"
 #include <iostream>
+#include <mutex>
 #include "ticpp.h"
 //#include "half.h"
 #include "OgreLogManager.h"
@@ -50,10 +57,23 @@ namespace Ogre
 {
 	const String sPluginName = "Spacescape";
 
+    // Ogre's image codecs aren't documented to be reentrant, so faces 
+    // encoded on the thread pool take turns in Image::save
+    static std::mutex sCodecMutex;
+
     SpacescapePlugin::SpacescapePlugin() :
         mDebugBox(0),
+        mDefaultCPUNoise(false),
+        mExportCompression(PF_UNKNOWN),
+        mExportCompressionQuality(SpacescapeBlockCompressor::BCQ_NORMAL),
+        mExportMipmaps(false),
+        mExportStripHeight(0),
         mHDREnabled(false),
+        mLayerCache(0),
+        mNoiseCache(0),
+        mRandomGenerator(SpacescapeRandom::GENERATOR_CURRENT),
         mSceneNode(0),
+        mSoftwareRendering(false),
         mUniqueId(0)
 	{
         mProgressListeners.clear();
@@ -65,10 +85,25 @@ namespace Ogre
     @return the layer id of the created layer or -1 on error
     */
     int SpacescapePlugin::addLayer(int type, const NameValuePairList& params)
+    {
+        // create the layer
+        SpacescapeLayer* layer = createLayer(type, "SpacescapeLayer" + StringConverter::toString(mLayers.size()));
+        if(!layer) {
+            return -1;
+        }
+
+        return addLayer(layer, params);
+    }
+
+    /** Utility function to add a created layer to the scene
+    @param layer The layer to add, prepared or not
+    @param params The list of name & value pairs that are parameters for the layer type
+    @return the layer id of the added layer
+    */
+    int SpacescapePlugin::addLayer(SpacescapeLayer* layer, const NameValuePairList& params)
     {
         // get the next layer id
         unsigned int layerId = (unsigned int)mLayers.size();
-        String layerName = "SpacescapeLayer" + StringConverter::toString(layerId);
 
         // create the scene node if it doesn't already exist
         if(!mSceneNode) {
@@ -81,34 +116,7 @@ namespace Ogre
             mSceneNode = sceneMgr->getRootSceneNode()->createChildSceneNode("SpacescapeNode");
         }
 
-        if(type == SLT_BILLBOARDS) {
-            Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
-                "Creating Billboards SpacescapeLayer";
-
-            // create the layer
-            mLayers.push_back(OGRE_NEW SpacescapeLayerBillboards(layerName,this));
-        }
-        else if(type == SLT_NOISE) {
-            Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
-                "Creating Noise SpacescapeLayer";
-            
-            // create the layer
-            mLayers.push_back(OGRE_NEW SpacescapeLayerNoise(layerName,this));
-        }
-
-        else if(type == SLT_POINTS) {
-            Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
-                "Creating Points SpacescapeLayer";
-
-            // create the layer
-            mLayers.push_back(OGRE_NEW SpacescapeLayerPoints(layerName,this));
-        }
-        else {
-            // unknown type
-            Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
-                "Unkown SpacescapeLayerType: " << type;
-            return -1;
-        }
+        mLayers.push_back(layer);
 
         // set layer id and render queue
         mLayers[layerId]->setLayerID(layerId);
@@ -118,7 +126,7 @@ namespace Ogre
         mLayers[layerId]->getMovableObject()->setRenderQueueGroup(RENDER_QUEUE_SKIES_EARLY + layerId);
 
         // attach the layer to the scene so it can be displayed
-        mSceneNode->createChildSceneNode(layerName)->attachObject(mLayers[layerId]->getMovableObject());
+        mSceneNode->createChildSceneNode(layer->getName())->attachObject(mLayers[layerId]->getMovableObject());
 
         //#ifdef DEBUG
         // setDebugBoxVisible(true);
@@ -145,6 +153,64 @@ namespace Ogre
         mProgressListeners.push_back(listener);
     }
 
+    /** Utility function to create a layer of the given type
+    @param type The layer type (see the SpacescapeLayerType enum)
+    @param name The layer name
+    @return the created layer or NULL if the type is unknown
+    */
+    SpacescapeLayer* SpacescapePlugin::createLayer(int type, const String& name)
+    {
+        if(type == SLT_BILLBOARDS) {
+            Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
+                "Creating Billboards SpacescapeLayer";
+
+            return OGRE_NEW SpacescapeLayerBillboards(name,this);
+        }
+        else if(type == SLT_NOISE) {
+            Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
+                "Creating Noise SpacescapeLayer";
+            
+            return OGRE_NEW SpacescapeLayerNoise(name,this);
+        }
+        else if(type == SLT_POINTS) {
+            Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
+                "Creating Points SpacescapeLayer";
+
+            return OGRE_NEW SpacescapeLayerPoints(name,this);
+        }
+
+        // unknown type
+        Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
+            "Unkown SpacescapeLayerType: " << type;
+        return 0;
+    }
+
+    /** Utility function to add the draw calls for all the visible 
+    layers to a software renderer
+    @param renderer The renderer to add to
+    */
+    void SpacescapePlugin::addLayersToSoftwareRenderer(SpacescapeSoftwareRenderer& renderer)
+    {
+        // layers draw in layer order just like their render queues
+        for(unsigned int i = 0; i < mLayers.size(); i++) {
+            if(mLayers[i]->getMovableObject()->getVisible()) {
+                // a layer's pixels only depend on its params and the hdr 
+                // mode, the name doesn't change anything
+                String key = mHDREnabled ? "hdr" : "ldr";
+                key += "|randomGenerator=" + StringConverter::toString((int)mRandomGenerator);
+                NameValuePairList params = mLayers[i]->getParams();
+                for(NameValuePairList::iterator ii = params.begin(); ii != params.end(); ++ii) {
+                    if(ii->first != "name") {
+                        key += "|" + ii->first + "=" + ii->second;
+                    }
+                }
+
+                renderer.beginLayer(key);
+                mLayers[i]->addToSoftwareRenderer(renderer);
+            }
+        }
+    }
+
     void SpacescapePlugin::buildDebugBox(SceneNode *sceneNode)
     {
 		if (!sceneNode) return;
@@ -480,6 +546,9 @@ namespace Ogre
     */
     bool SpacescapePlugin::clear()
     {
+        // new scenes use the current generator
+        mRandomGenerator = SpacescapeRandom::GENERATOR_CURRENT;
+
         // check if the scene manager still exists
         if(!Ogre::Root::getSingleton().getSceneManagerIterator().hasMoreElements()) {
             Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
@@ -577,6 +646,14 @@ namespace Ogre
 		return sPluginName;
 	}
 
+    /** Get the directory baked noise cubes are cached in
+    @return the directory, empty when the noise cache is disabled
+    */
+    String SpacescapePlugin::getNoiseCacheDirectory()
+    {
+        return mNoiseCache ? mNoiseCache->getDirectory() : StringUtil::BLANK;
+    }
+
     void SpacescapePlugin::install()
 	{
 	}
@@ -585,10 +662,25 @@ namespace Ogre
 	{
 	}
     
+    bool SpacescapePlugin::isExportMipmapsEnabled()
+    {
+        return mExportMipmaps;
+    }
+
     bool SpacescapePlugin::isHDREnabled()
     {
         return mHDREnabled;
     }
+
+    bool SpacescapePlugin::isLayerCacheEnabled()
+    {
+        return mLayerCache != 0;
+    }
+
+    bool SpacescapePlugin::isSoftwareRenderingEnabled()
+    {
+        return mSoftwareRendering;
+    }
     
 
     /** Load a config file
@@ -620,17 +712,19 @@ namespace Ogre
         // clear the current scene first
         clear();
 
-        // get number of layers to add
-        for(child = child.begin(config.FirstChildElement()); child != child.end(); child++) {
-            std::string key;
-
-            // top level items should be layers
-            child->GetValue(&key);
-
-            if(key == "layer") {
-                numLayers++;
-            }
+        // scenes saved before the generator was recorded were built with rand()
+        int generator = SpacescapeRandom::GENERATOR_RAND;
+        config.FirstChildElement()->GetAttributeOrDefault("randomGenerator", &generator, (int)SpacescapeRandom::GENERATOR_RAND);
+        if(generator < SpacescapeRandom::GENERATOR_RAND || generator > SpacescapeRandom::GENERATOR_CURRENT) {
+            LogManager::getSingleton().getDefaultLog()->logMessage("Unknown random generator " + 
+                StringConverter::toString(generator) + ", using the current one");
+            generator = SpacescapeRandom::GENERATOR_CURRENT;
         }
+        mRandomGenerator = (SpacescapeRandom::Generator)generator;
+
+        // the layer types and params in file order
+        std::vector<int> layerTypes;
+        std::vector<NameValuePairList> layerParams;
 
         for(child = child.begin(config.FirstChildElement()); child != child.end(); child++) {
             std::string key, value;
@@ -669,26 +763,48 @@ namespace Ogre
                     }
                 }
 
-                // update progress
-                if(params["name"].empty()) {
-                    updateProgress(progressAmount, "Creating layer " + 
-                        StringConverter::toString(currentLayer) + " of " +
-                        StringConverter::toString(numLayers));
-                }
-                else {
-                    updateProgress(progressAmount, "Creating layer " + params["name"] + " (" + 
-                        StringConverter::toString(currentLayer) + " of " +
-                        StringConverter::toString(numLayers) + ")");
-                }
+                layerTypes.push_back(layerType);
+                layerParams.push_back(params);
+            }
+        }
+
+        numLayers = (unsigned int)layerTypes.size();
 
-                // add the layer
-                addLayer(layerType, params);
+        // create all the layers and generate their stars in parallel first, 
+        // the layers are added to the scene in order afterwards
+        SpacescapeLayerList layers;
+        for(unsigned int i = 0; i < numLayers; ++i) {
+            layers.push_back(createLayer(layerTypes[i], "SpacescapeLayer" + StringConverter::toString(i)));
+            layers[i]->setLayerID(i);
+        }
+
+        // update progress
+        updateProgress(progressAmount, "Generating layers");
 
-                // update progress amount
-                progressAmount += (unsigned int)(90.0 / (Real)numLayers);
-                progressAmount = std::min<unsigned int>(progressAmount, 100);
-                currentLayer++;
+        prepareLayers(layers, layerParams);
+
+        for(unsigned int i = 0; i < numLayers; ++i) {
+            NameValuePairList& params = layerParams[i];
+
+            // update progress
+            if(params["name"].empty()) {
+                updateProgress(progressAmount, "Creating layer " + 
+                    StringConverter::toString(currentLayer) + " of " +
+                    StringConverter::toString(numLayers));
+            }
+            else {
+                updateProgress(progressAmount, "Creating layer " + params["name"] + " (" + 
+                    StringConverter::toString(currentLayer) + " of " +
+                    StringConverter::toString(numLayers) + ")");
             }
+
+            // add the layer
+            addLayer(layers[i], params);
+
+            // update progress amount
+            progressAmount += (unsigned int)(90.0 / (Real)numLayers);
+            progressAmount = std::min<unsigned int>(progressAmount, 100);
+            currentLayer++;
         }
 
         // update progress
@@ -790,6 +906,79 @@ namespace Ogre
         }
     }
 
+    /** For internal use only - get the orientation of the camera _rtt 
+    renders a cube face with
+    @param face The cube face (0 - 5)
+    @param orientation Orientation mode for non-Ogre skybox orientations
+    @return the camera scene node orientation
+    */
+    Quaternion SpacescapePlugin::_getRTTFaceOrientation(int face, SpacescapeRTTOrientation orientation)
+    {
+        Vector3 forward,up,right;
+        Quaternion alterOrientation = Quaternion::IDENTITY;
+
+        switch (face)
+        {
+        case 0:
+            if (orientation == SRO_UNREAL_ORIENTATION) {
+                alterOrientation = Quaternion(Radian(Degree(-90)), Vector3::UNIT_Z);
+            }
+
+            // right
+            forward = Vector3::NEGATIVE_UNIT_X;
+            up = Vector3::UNIT_Y;
+            right = Vector3::UNIT_Z;
+            break;
+        case 1:
+            // left
+            if (orientation == SRO_UNREAL_ORIENTATION) {
+                alterOrientation = Quaternion(Radian(Degree(90)), Vector3::UNIT_Z);
+            }
+            forward = Vector3::UNIT_X;
+            up = Vector3::UNIT_Y;
+            right = Vector3::NEGATIVE_UNIT_Z;
+            break;
+        case 2:
+            // top
+            if (orientation == SRO_UNREAL_ORIENTATION) {
+                alterOrientation = Quaternion(Radian(Degree(180)), Vector3::UNIT_Z);
+            }
+            forward = Vector3::NEGATIVE_UNIT_Y;
+            up = Vector3::UNIT_Z;
+            right = Vector3::UNIT_X;
+            break;
+        case 3:
+            // down
+            forward = Vector3::UNIT_Y;
+            up = Vector3::NEGATIVE_UNIT_Z;
+            right = Vector3::UNIT_X;
+            break;
+        case 4:
+            // correct (forward)
+            forward = Vector3::UNIT_Y;
+            up = Vector3::UNIT_Z;
+            right = Vector3::UNIT_X;
+            break;
+        default:
+            // correct (opposite of 4) back
+            forward = Vector3::NEGATIVE_UNIT_Z;
+            up = Vector3::UNIT_Y;
+            right = Vector3::NEGATIVE_UNIT_X;
+            break;
+        }
+
+        Quaternion q;
+        q.FromAxes(right,up,forward);
+
+        // the front face axes are left handed, so FromAxes gives a scaled
+        // identity for them rather than a rotation.  The scene node 
+        // normalises whatever it is given, so do the same here and the
+        // front camera ends up looking down -z
+        q = q * alterOrientation;
+        q.normalise();
+        return q;
+    }
+
     /** For internal use only - layers use this render to texture function
     to render to texture
     @param texture The texture to rtt to - must be cubic
@@ -829,63 +1018,8 @@ namespace Ogre
         // be sure to not go negative
         numMips = std::max<int>(0,numMips);
 		// point the camera in six different directions and rtt
-        Vector3 forward,up,right;
         for(int i = 0; i < 6; i++) {
-			Quaternion alterOrientation = Quaternion::IDENTITY;
-
-			switch (i)
-			{
-			case 0:
-				if (orientation == SRO_UNREAL_ORIENTATION) {
-					alterOrientation = Quaternion(Radian(Degree(-90)), Vector3::UNIT_Z);
-				}
-
-				// right
-				forward = Vector3::NEGATIVE_UNIT_X;
-				up = Vector3::UNIT_Y;
-				right = Vector3::UNIT_Z;
-				break;
-			case 1:
-				// left
-				if (orientation == SRO_UNREAL_ORIENTATION) {
-					alterOrientation = Quaternion(Radian(Degree(90)), Vector3::UNIT_Z);
-				}
-				forward = Vector3::UNIT_X;
-			    up = Vector3::UNIT_Y ;
-			    right = Vector3::NEGATIVE_UNIT_Z;
-			    break;
-		    case 2:
-                // top
-				if (orientation == SRO_UNREAL_ORIENTATION) {
-					alterOrientation = Quaternion(Radian(Degree(180)), Vector3::UNIT_Z);
-				}
-                forward = Vector3::NEGATIVE_UNIT_Y ;
-			    up = Vector3::UNIT_Z ;
-			    right = Vector3::UNIT_X;
-			    break;
-		    case 3:
-                // down
-                forward = Vector3::UNIT_Y ;
-			    up = Vector3::NEGATIVE_UNIT_Z ;
-			    right = Vector3::UNIT_X;
-			    break;
-		    case 4:
-                // correct (forward)
-                forward = Vector3::UNIT_Y;
-			    up = Vector3::UNIT_Z;
-			    right = Vector3::UNIT_X;
-			    break;
-		    case 5:
-                // correct (opposite of 4) back
-                forward = Vector3::NEGATIVE_UNIT_Z;
-			    up = Vector3::UNIT_Y ;
-			    right = Vector3::NEGATIVE_UNIT_X ;
-			    break;
-		    }
-
-            Quaternion q;
-            q.FromAxes(right,up,forward);
-            CamSceneNode->setOrientation(q * alterOrientation);
+            CamSceneNode->setOrientation(_getRTTFaceOrientation(i, orientation));
 
             for(int j = 0; j <= numMips; ++j) {
                 // get render target for mipmap
@@ -933,6 +1067,9 @@ namespace Ogre
 
             ticpp::Element elem("spacescapelayers");
             ticpp::Element *n = config.InsertEndChild(elem)->ToElement();
+
+            // record the generator so the layers build the same way on load
+            n->SetAttribute("randomGenerator", (int)mRandomGenerator);
             for(unsigned int i = 0; i < mLayers.size(); i++) {
                 // create the layer node
 				ticpp::Element temp_element = ticpp::Element("layer");
@@ -963,6 +1100,63 @@ namespace Ogre
         return true;
     }
 
+    /** Utility function to save an image and its mip maps
+    @remarks Can be called from several threads at once.  Mip level 
+    conversion and block compression run in parallel, saves that go 
+    through Ogre's codecs are serialized.
+    @param img The image to save
+    @param basename The filename (and path) to save to without the extension
+    @param ext The file extension including the "."
+    */
+    void SpacescapePlugin::saveImage(Image& img, const String& basename, const String& ext)
+    {
+        size_t numMips = img.getNumMipmaps();
+        if((numMips || mExportCompression != PF_UNKNOWN) && StringUtil::endsWith(ext, ".dds")) {
+            // write the mip chain and compress ourselves, converting 
+            // each level to the format the writer wants
+            SpacescapeStripWriter writer;
+            writer.setCompression(mExportCompression, mExportCompressionQuality);
+            if(!writer.open(basename + ext, img.getWidth(), img.getNumFaces(), mHDREnabled, numMips)) {
+                Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
+                    "Failed to write " << basename << ext;
+            }
+            else {
+                std::vector<uchar> level;
+                for(size_t i = 0; i < img.getNumFaces(); ++i) {
+                    for(size_t j = 0; j <= numMips; ++j) {
+                        PixelBox src = img.getPixelBox(i,j);
+                        level.resize(PixelUtil::getMemorySize(src.getWidth(), src.getHeight(), 1, writer.getFormat()));
+                        PixelBox dst(src.getWidth(), src.getHeight(), 1, writer.getFormat(), &level[0]);
+                        PixelUtil::bulkPixelConversion(src, dst);
+                        writer.writeRows(dst);
+                    }
+                }
+
+                if(!writer.close()) {
+                    Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
+                        "Failed to write " << basename << ext;
+                }
+            }
+        }
+        else if(numMips && img.getNumFaces() == 1) {
+            // write each level to its own file
+            for(size_t j = 0; j <= numMips; ++j) {
+                PixelBox src = img.getPixelBox(0,j);
+                Image level;
+                level.loadDynamicImage((uchar*)src.data, src.getWidth(), src.getHeight(), 1, src.format);
+
+                std::lock_guard<std::mutex> lock(sCodecMutex);
+                level.save(j ? basename + "_mip" + StringConverter::toString(j) + ext : basename + ext);
+            }
+        }
+        else {
+            // tell the image to save out in the requested format
+            // this internal Ogre function will handle format issues
+            std::lock_guard<std::mutex> lock(sCodecMutex);
+            img.save(basename + ext);
+        }
+    }
+
     void SpacescapePlugin::setDebugBoxVisible(bool visible)
     {
 		if (!mSceneNode) {
@@ -986,7 +1180,50 @@ namespace Ogre
         
         buildDebugBox(n);
     }
+
+    /** Make noise layers generate their noise on the CPU by default
+    @remarks Layers that are already built pick it up the next time they
+    are updated
+    @param enabled true to use the CPU noise generator, false to use the 
+    cpuNoise param of each layer
+    */
+    void SpacescapePlugin::setDefaultCPUNoise(bool enabled)
+    {
+        mDefaultCPUNoise = enabled;
+    }
     
+    /** Set the block compression used for .dds exports
+    @param format The compressed pixel format, PF_UNKNOWN to disable
+    @param quality The compression quality
+    */
+    void SpacescapePlugin::setExportCompression(PixelFormat format, SpacescapeBlockCompressor::Quality quality)
+    {
+        if(format != PF_UNKNOWN && !SpacescapeBlockCompressor::isSupported(format)) {
+            Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
+                "Unsupported export compression format " << PixelUtil::getFormatName(format);
+            format = PF_UNKNOWN;
+        }
+
+        mExportCompression = format;
+        mExportCompressionQuality = quality;
+    }
+
+    /** Enable/Disable generating mip maps for exports
+    @param enabled true to enable, false to disable
+    */
+    void SpacescapePlugin::setExportMipmapsEnabled(bool enabled)
+    {
+        mExportMipmaps = enabled;
+    }
+
+    /** Set the number of rows streaming exports render and write at a time
+    @param rows The number of rows in a strip, 0 to write whole faces
+    */
+    void SpacescapePlugin::setExportStripHeight(unsigned int rows)
+    {
+        mExportStripHeight = rows;
+    }
+
     void SpacescapePlugin::setHDREnabled(bool enabled)
     {
         if(mHDREnabled == enabled) return;
@@ -994,10 +1231,20 @@ namespace Ogre
         mHDREnabled = enabled;
         
         // re-create all layers
+        recreateLayers();
+    }
+    
+    /** Utility function to destroy and re-create all layers with their
+    current params, used when a setting the layers are built with has changed
+    */
+    void SpacescapePlugin::recreateLayers()
+    {
+        std::vector<NameValuePairList> layerParams;
+
         for(unsigned int i = 0; i < mLayers.size(); i++) {
             String layerName = mLayers[i]->getName();
             int layerType = mLayers[i]->getLayerType();
-            NameValuePairList params = mLayers[i]->getParams();
+            layerParams.push_back(mLayers[i]->getParams());
             
             // detach old object from the layer scene node
             SceneNode* n =(SceneNode*)mSceneNode->getChild("SpacescapeLayer" + StringConverter::toString(i));
@@ -1007,28 +1254,61 @@ namespace Ogre
             OGRE_DELETE mLayers[i];
             
             // create the new layer
-            if(layerType == SpacescapePlugin::SLT_BILLBOARDS) {
-                mLayers[i] = OGRE_NEW SpacescapeLayerBillboards(layerName,this);
-            }
-            else if(layerType == SpacescapePlugin::SLT_NOISE) {
-                mLayers[i] = OGRE_NEW SpacescapeLayerNoise(layerName,this);
-            }
-            else {
-                mLayers[i] = OGRE_NEW SpacescapeLayerPoints(layerName,this);
-            }
+            mLayers[i] = createLayer(layerType, layerName);
             
             mLayers[i]->setLayerID(i);
             // set hdr enabled before calling init
-            mLayers[i]->setHDREnabled(enabled);
-            mLayers[i]->init(params);
+            mLayers[i]->setHDREnabled(mHDREnabled);
+        }
+
+        // generate the stars of all layers in parallel
+        prepareLayers(mLayers, layerParams);
+
+        for(unsigned int i = 0; i < mLayers.size(); i++) {
+            SceneNode* n =(SceneNode*)mSceneNode->getChild("SpacescapeLayer" + StringConverter::toString(i));
+
+            mLayers[i]->init(layerParams[i]);
             mLayers[i]->getMovableObject()->setRenderQueueGroup(RENDER_QUEUE_SKIES_EARLY + i);
             
             // attach the layer to the scene so it can be displayed
             n->attachObject(mLayers[i]->getMovableObject());
         }
     }
+
+    /** Utility function to prepare layers in parallel on the thread pool
+    @remarks see SpacescapeLayer::prepare() and prepareData()
+    @param layers The layers to prepare
+    @param params The params for each layer
+    */
+    void SpacescapePlugin::prepareLayers(const SpacescapeLayerList& layers, const std::vector<NameValuePairList>& params)
+    {
+        // star catalogs, noise masks and the noise cache are only touched 
+        // on this thread, the thread pool just generates the stars
+        for(size_t i = 0; i < layers.size(); ++i) {
+            layers[i]->prepare(params[i]);
+        }
+
+        SpacescapeThreadPool::getSingleton().parallelFor(layers.size(), [&](size_t i) {
+            layers[i]->prepareData();
+        });
+    }
     
     
+    /** Enable/Disable the software render layer cache
+    @remarks Only software rendered exports use the cache
+    @param enabled true to enable, false to disable
+    */
+    void SpacescapePlugin::setLayerCacheEnabled(bool enabled)
+    {
+        if(enabled && !mLayerCache) {
+            mLayerCache = OGRE_NEW_T(SpacescapeLayerCache, MEMCATEGORY_GENERAL);
+        }
+        else if(!enabled && mLayerCache) {
+            OGRE_DELETE_T(mLayerCache, SpacescapeLayerCache, MEMCATEGORY_GENERAL);
+            mLayerCache = 0;
+        }
+    }
+
     /** Show or hide a layer
     @param layerId the layer to hide/show
     @param visible true to show, false to hide
@@ -1047,6 +1327,35 @@ namespace Ogre
         }
     }
 
+    /** Set the directory baked noise cubes are cached in
+    @param directory The directory (it is created if needed), or an 
+    empty string to disable the noise cache
+    */
+    void SpacescapePlugin::setNoiseCacheDirectory(const String& directory)
+    {
+        if(mNoiseCache) {
+            OGRE_DELETE_T(mNoiseCache, SpacescapeNoiseCache, MEMCATEGORY_GENERAL);
+            mNoiseCache = 0;
+        }
+
+        if(!directory.empty()) {
+            mNoiseCache = OGRE_NEW_T(SpacescapeNoiseCache, MEMCATEGORY_GENERAL)(directory);
+        }
+    }
+
+    /** Enable/Disable software rendering
+     @param enable true to enable, false to disable
+     */
+    void SpacescapePlugin::setSoftwareRenderingEnabled(bool enabled)
+    {
+        if(mSoftwareRendering == enabled) return;
+
+        mSoftwareRendering = enabled;
+
+        // layers only build gpu resources when not in software mode
+        recreateLayers();
+    }
+
     void SpacescapePlugin::shutdown()
 	{
         clear();
@@ -1072,6 +1381,11 @@ namespace Ogre
     void SpacescapePlugin::uninstall()
 	{
         clear();
+        setLayerCacheEnabled(false);
+        setNoiseCacheDirectory(StringUtil::BLANK);
+
+        // join the worker threads before the plugin is unloaded
+        SpacescapeThreadPool::destroySingleton();
 	}
 
     /** Update a layer with new params
@@ -1219,6 +1533,52 @@ namespace Ogre
         return result;
     }
 
+    /** Utility function to write faces to a file a strip of rows at a time
+    @param filename The filename (and path) of the file to write
+    @param firstFace The first face to write
+    @param numFaces The number of faces to write - 6 for a cube map
+    @param size The size / resolution of the skybox image
+    @param renderer The software renderer to render strips with in software mode
+    @param rtt The render to texture to copy strips from otherwise
+    @return true on success
+    */
+    bool SpacescapePlugin::writeFaceStrips(const String& filename, unsigned int firstFace, unsigned int numFaces, unsigned int size, const SpacescapeSoftwareRenderer& renderer, TexturePtr& rtt)
+    {
+        SpacescapeStripWriter writer;
+        if(StringUtil::endsWith(filename, ".dds")) {
+            writer.setCompression(mExportCompression, mExportCompressionQuality);
+        }
+        if(!writer.open(filename, size, numFaces, mHDREnabled)) {
+            return false;
+        }
+
+        // only a single strip is ever held in memory
+        unsigned int stripHeight = std::min<unsigned int>(mExportStripHeight, size);
+        PixelFormat pixelFormat = writer.getFormat();
+        uchar* data = OGRE_ALLOC_T(uchar, PixelUtil::getMemorySize(size, stripHeight, 1, pixelFormat), MEMCATEGORY_GENERAL);
+
+        bool result = true;
+        for(unsigned int i = firstFace; i < firstFace + numFaces && result; ++i) {
+            for(unsigned int row = 0; row < size && result; row += stripHeight) {
+                unsigned int rowEnd = std::min<unsigned int>(row + stripHeight, size);
+                PixelBox strip(size, rowEnd - row, 1, pixelFormat, data);
+
+                if(mSoftwareRendering) {
+                    renderer.renderFaceRows(i, row, rowEnd, strip);
+                }
+                else {
+                    rtt->getBuffer(i,0)->blitToMemory(Box(0, row, size, rowEnd), strip);
+                }
+
+                result = writer.writeRows(strip);
+            }
+        }
+
+        OGRE_FREE(data, MEMCATEGORY_GENERAL);
+
+        return writer.close() && result;
+    }
+
     /** Write the skybox to a file
     @param filename The filename (and path) of the file to write
     @param type The filetype.  TEX_TYPE_2D will be written as 6 
@@ -1268,25 +1628,52 @@ namespace Ogre
         Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
             "Writing to file " << filename << " size: " << StringConverter::toString(size);
 
-        // update progress
-        updateProgress(progressAmount,"Updating RTT");
+        // in software mode the faces are rendered on the cpu as they're 
+        // written instead of being copied from the rtt texture
+        SpacescapeSoftwareRenderer renderer(orientation, !mHDREnabled);
+        TexturePtr rtt;
 
-        Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
-            "Updating RTT";
+        if(mSoftwareRendering) {
+            // update progress
+            updateProgress(progressAmount,"Preparing software render");
+
+            Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
+                "Preparing software render";
 
-        // first update the rtt texture
-        updateRTT(size, orientation);
+            // streaming exports keep memory use down so they skip the cache
+            if(!mExportStripHeight) {
+                renderer.setLayerCache(mLayerCache);
+            }
+
+            addLayersToSoftwareRenderer(renderer);
+            renderer.prepare(size);
+        }
+        else {
+            // update progress
+            updateProgress(progressAmount,"Updating RTT");
+
+            Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
+                "Updating RTT";
+
+            // first update the rtt texture
+            updateRTT(size, orientation);
+
+            // get the render to texture object
+            rtt = TextureManager::getSingleton().getByName("SpacescapeRTT");
+        }
 
         // update progress
         progressAmount+= 40;
 
-        // get number of mip maps - disabled for now because ATI x1950 pro draws them funny
-        // and it doesn't look like we need them
-        //int numMips = SpacescapePlugin::_log2(size);
-        int numMips = 0;
+        // mip maps are generated on the cpu instead of by the render system
+        // because ATI x1950 pro draws them funny
+        unsigned int numMips = mExportMipmaps ? SpacescapePlugin::_log2(size) : 0;
+        SpacescapeMipmapGenerator mipmapGenerator(orientation);
 
-        // get the render to texture object
-        TexturePtr rtt = TextureManager::getSingleton().getByName("SpacescapeRTT");
+        if(mHDREnabled && mExportCompression != PF_UNKNOWN && mExportCompression != PF_BC6H_UF16) {
+            Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
+                PixelUtil::getFormatName(mExportCompression) << " can't hold HDR colours, use PF_BC6H_UF16";
+        }
 
         if(type == TEX_TYPE_2D) {
             String suffixes[6] = {
@@ -1328,71 +1715,154 @@ namespace Ogre
             if(mHDREnabled && (ext == ".exr" || ext == ".dds")) {
                 pixelFormat = PF_FLOAT32_RGB;
             }
+
+            bool streaming = mExportStripHeight && !numMips && SpacescapeStripWriter::isSupported(ext);
+            if(mExportStripHeight && !streaming) {
+                Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
+                    "Can't stream " << ext << " files or mip maps, writing whole faces";
+            }
+
+            // mip maps are filtered across the face edges so faces with 
+            // mip maps are only saved once all six have been read back
+            std::vector<Image> images(6);
+
+            // faces are encoded and saved on the thread pool, declared after
+            // the images so a throw waits for the tasks before freeing them
+            SpacescapeThreadPool::TaskGroup encodes(SpacescapeThreadPool::getSingleton());
             
             // write out six textures
             for(int i = 0; i < 6; ++i) {
-                Image* img = OGRE_NEW Image();
-
                 Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
                     "Saving image " << basename  << suffixes[i] << ext;
 
                 // update progress
                 updateProgress(progressAmount,"Exporting " + suffixes[i]);
 
+                if(streaming) {
+                    if(!writeFaceStrips(basename + suffixes[i] + ext, i, 1, size, renderer, rtt)) {
+                        Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
+                            "Failed to write " << basename << suffixes[i] << ext;
+                    }
+
+                    // update progress
+                    progressAmount += 10;
+                    continue;
+                }
+
+                Image* img = &images[i];
+
                 // allocate room for this image and its mip maps
                 size_t numBytes = img->calculateSize(numMips,1,size,size,1,pixelFormat);
                 uchar* data = OGRE_ALLOC_T(uchar,numBytes,MEMCATEGORY_GENERAL);
 
-                // load all the data into the image
-                img->loadDynamicImage(data,size,size,1,pixelFormat,false,1,numMips);
-                for(int j = 0; j <= numMips; ++j) {
-                    rtt->getBuffer(i,j)->getRenderTarget()->copyContentsToMemory(
-                        img->getPixelBox(0,j),
+                // load all the data into the image, the image frees it
+                img->loadDynamicImage(data,size,size,1,pixelFormat,true,1,numMips);
+                if(mSoftwareRendering) {
+                    renderer.renderFace(i, img->getPixelBox(0,0));
+                }
+                else {
+                    rtt->getBuffer(i,0)->getRenderTarget()->copyContentsToMemory(
+                        img->getPixelBox(0,0),
                         RenderTarget::FB_FRONT
                     );
                 }
 
-                // tell the image to save out in the requested format
-                // this internal Ogre function will handle format issues
-                // filename is basename with our suffix and the original extension
-                img->save(basename + suffixes[i] + ext);
-
-                OGRE_FREE(data,MEMCATEGORY_GENERAL);
-                OGRE_DELETE img;
+                if(!numMips) {
+                    // encode and save on the thread pool while the next face
+                    // is read back
+                    // filename is basename with our suffix and the original extension
+                    String faceBasename = basename + suffixes[i];
+                    encodes.run([this, img, faceBasename, ext]() {
+                        saveImage(*img, faceBasename, ext);
+                    });
+                }
 
                 // update progress
                 progressAmount += 10;
             }
+
+            if(numMips) {
+                updateProgress(progressAmount,"Generating mip maps");
+
+                std::vector<PixelBox> levels;
+                for(int i = 0; i < 6; ++i) {
+                    for(unsigned int j = 0; j <= numMips; ++j) {
+                        levels.push_back(images[i].getPixelBox(0,j));
+                    }
+                }
+                mipmapGenerator.generate(&levels[0], numMips);
+
+                for(int i = 0; i < 6; ++i) {
+                    Image* img = &images[i];
+                    String faceBasename = basename + suffixes[i];
+                    encodes.run([this, img, faceBasename, ext]() {
+                        saveImage(*img, faceBasename, ext);
+                    });
+                }
+            }
+
+            // wait for the last faces to be written
+            updateProgress(progressAmount,"Saving images");
+            encodes.wait();
+        }
+        else if(mExportStripHeight && !numMips && filename.length() > 4 &&
+            SpacescapeStripWriter::isSupported(filename.substr(filename.length() - 4, 4), 6)) {
+            // update progress
+            updateProgress(progressAmount,"Exporting cube map");
+
+            if(!writeFaceStrips(filename, 0, 6, size, renderer, rtt)) {
+                Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
+                    "Failed to write " << filename;
+            }
         }
         else {
             // assume cubic/3d .dds texture
-            Image* img = OGRE_NEW Image();
+            Image img;
 
             Ogre::PixelFormat pixelFormat = mHDREnabled ? PF_FLOAT32_RGBA : PF_R8G8B8;
-			size_t numBytes = img->calculateSize(numMips, 6, size, size, 1, pixelFormat);
+			size_t numBytes = img.calculateSize(numMips, 6, size, size, 1, pixelFormat);
 
             // allocate room for this image and its mip maps
             uchar* data = OGRE_ALLOC_T(uchar,numBytes,MEMCATEGORY_GENERAL);
 
-            // load all the data into the image
-			img->loadDynamicImage(data, size, size, 1, pixelFormat, false, 6, numMips);
+            // load all the data into the image, the image frees it
+			img.loadDynamicImage(data, size, size, 1, pixelFormat, true, 6, numMips);
 
             // combine the six textures into one image with 6 faces
             for(int i = 0; i < 6; ++i) {
-                for(int j = 0; j <= numMips; ++j) {
-                    rtt->getBuffer(i,j)->getRenderTarget()->copyContentsToMemory(
-                        img->getPixelBox(i,j),
+                if(mSoftwareRendering) {
+                    renderer.renderFace(i, img.getPixelBox(i,0));
+                }
+                else {
+                    rtt->getBuffer(i,0)->getRenderTarget()->copyContentsToMemory(
+                        img.getPixelBox(i,0),
                         RenderTarget::FB_FRONT
                     );
                 }
             }
 
-            // tell the image to save out in the requested format
-            // this internal Ogre function will handle format issues
-            img->save(filename);
+            if(numMips) {
+                updateProgress(progressAmount,"Generating mip maps");
 
-            OGRE_FREE(data,MEMCATEGORY_GENERAL);
-            OGRE_DELETE img;
+                std::vector<PixelBox> levels;
+                for(int i = 0; i < 6; ++i) {
+                    for(unsigned int j = 0; j <= numMips; ++j) {
+                        levels.push_back(img.getPixelBox(i,j));
+                    }
+                }
+                mipmapGenerator.generate(&levels[0], numMips);
+            }
+
+            // default extension/type is dds
+            String ext = ".dds";
+            String basename = filename;
+            if(filename.length() > 4) {
+                ext = filename.substr(filename.length() - 4, 4);
+                basename = filename.substr(0,filename.length() - 4);
+            }
+
+            updateProgress(progressAmount,"Saving image");
+            saveImage(img, basename, ext);
         }
 
         updateProgress(100, "Export complete");
@@ -1428,6 +1898,12 @@ namespace Ogre
             return;
         }
 
+        if(mSoftwareRendering) {
+            Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
+                "Can't write to a material with software rendering enabled";
+            return;
+        }
+
         // update the rtt
         updateRTT(size);
 
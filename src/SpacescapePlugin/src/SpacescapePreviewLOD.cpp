@@ -0,0 +1,241 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include "SpacescapePreviewLOD.h"
+#include "OgreMath.h"
+#include <cmath>
+
+namespace Ogre
+{
+    // number of importance tiers, each one half as bright as the one before
+    static const int NUM_TIERS = 16;
+
+    // area of an impostor relative to the stars it stands for
+    static const Real IMPOSTOR_AREA = Real(SpacescapePreviewLOD::IMPOSTOR_SCALE * SpacescapePreviewLOD::IMPOSTOR_SCALE);
+
+    // a group of stars drawn as one impostor
+    struct PreviewGroup
+    {
+        // star the impostor is drawn in place of
+        uint32 representative;
+
+        // area of the impostor
+        Real area;
+
+        // summed light of the group
+        ColourValue colour;
+        ColourValue hdrColour;
+    };
+
+    /** Utility function to sort stars into importance tiers and group the
+    ones the preview leaves out
+    @param count Number of stars
+    @param colourOf Returns the colour of a star
+    @param hdrColourOf Returns the HDR colour of a star
+    @param areaOf Returns the area of a star
+    @param order Filled with the star indices in draw order
+    @param groups Filled with the groups the impostors are made from
+    @return The number of stars only the full detail version draws
+    */
+    template<typename ColourFunc, typename HDRColourFunc, typename AreaFunc>
+    static size_t buildGroups(size_t count, ColourFunc colourOf, HDRColourFunc hdrColourOf, AreaFunc areaOf,
+        std::vector<uint32>& order, std::vector<PreviewGroup>& groups)
+    {
+        order.clear();
+        groups.clear();
+
+        if(count <= SpacescapePreviewLOD::PREVIEW_BUDGET) {
+            return 0;
+        }
+
+        // importance is the brightest channel times the area
+        std::vector<Real> importance(count);
+        Real maxImportance = 0.0;
+        for(size_t i = 0; i < count; ++i) {
+            const ColourValue& c = colourOf(i);
+            importance[i] = std::max(c.r, std::max(c.g, c.b)) * areaOf(i);
+            maxImportance = std::max(maxImportance, importance[i]);
+        }
+
+        // tier 0 holds the stars at least half as important as the most 
+        // important one, tier 1 at least a quarter and so on
+        std::vector<uchar> tiers(count);
+        size_t tierCounts[NUM_TIERS] = { 0 };
+        for(size_t i = 0; i < count; ++i) {
+            int tier = NUM_TIERS - 1;
+            if(importance[i] > 0.0) {
+                int exponent;
+                std::frexp(importance[i] / maxImportance, &exponent);
+                tier = std::min(std::max(-exponent, 0), NUM_TIERS - 1);
+            }
+            tiers[i] = static_cast<uchar>(tier);
+            ++tierCounts[tier];
+        }
+        std::vector<Real>().swap(importance);
+
+        // keep whole tiers from the brightest while they fill no more than
+        // half the budget, the impostors get the rest
+        size_t kept = 0;
+        int keptTiers = 0;
+        while(keptTiers < NUM_TIERS && kept + tierCounts[keptTiers] <= SpacescapePreviewLOD::PREVIEW_BUDGET / 2) {
+            kept += tierCounts[keptTiers++];
+        }
+        size_t omitted = count - kept;
+
+        // counting sort, dimmest tier first and generation order within a tier
+        size_t tierStart[NUM_TIERS];
+        size_t start = 0;
+        for(int tier = NUM_TIERS - 1; tier >= 0; --tier) {
+            tierStart[tier] = start;
+            start += tierCounts[tier];
+        }
+        order.resize(count);
+        for(size_t i = 0; i < count; ++i) {
+            order[tierStart[tiers[i]]++] = static_cast<uint32>(i);
+        }
+
+        // group the omitted stars of each tier, growing groups up to the 
+        // size that fits the budget while their colour stays in range
+        size_t impostorBudget = SpacescapePreviewLOD::PREVIEW_BUDGET - kept;
+        size_t groupSize = (omitted + impostorBudget - 1) / impostorBudget;
+        size_t members = 0;
+        Real area = 0.0;
+        ColourValue colour = ColourValue::ZERO;
+        ColourValue hdrColour = ColourValue::ZERO;
+        for(size_t i = 0; i <= omitted; ++i) {
+            bool close = members > 0;
+            if(i < omitted && members > 0) {
+                uint32 star = order[i];
+                uint32 representative = order[i - members];
+                Real a = areaOf(star);
+                ColourValue c = (colour + colourOf(star) * a) * (Real(members + 1) / ((area + a) * IMPOSTOR_AREA));
+                close = members == groupSize || tiers[star] != tiers[representative] ||
+                    c.r > 1.0 || c.g > 1.0 || c.b > 1.0;
+            }
+
+            if(close) {
+                // the impostor covers a bigger area than the average star
+                // of the group with the light of all of it
+                PreviewGroup group;
+                group.representative = order[i - members];
+                group.area = area / members * IMPOSTOR_AREA;
+                group.colour = colour / group.area;
+                group.colour.a = colourOf(group.representative).a;
+                group.hdrColour = hdrColour / group.area;
+                group.hdrColour.a = hdrColourOf(group.representative).a;
+                groups.push_back(group);
+
+                members = 0;
+                area = 0.0;
+                colour = ColourValue::ZERO;
+                hdrColour = ColourValue::ZERO;
+            }
+
+            if(i < omitted) {
+                uint32 star = order[i];
+                Real a = areaOf(star);
+                colour += colourOf(star) * a;
+                hdrColour += hdrColourOf(star) * a;
+                area += a;
+                ++members;
+            }
+        }
+
+        // nothing to gain when the stars are too bright to group
+        if(kept + groups.size() >= count) {
+            order.clear();
+            groups.clear();
+            return 0;
+        }
+
+        return omitted;
+    }
+
+    /** Order a point list for previewing and build its impostors
+    @param points The points
+    @param order Filled with the point indices in draw order
+    @param impostors Filled with the impostors to draw after the points
+    @return The number of points at the start of order only the full 
+    detail version draws, or 0 with order and impostors left empty when
+    the preview can draw the points as they are
+    */
+    size_t SpacescapePreviewLOD::build(const SpacescapeSoftwareRenderer::PointList& points, 
+        std::vector<uint32>& order, SpacescapeSoftwareRenderer::PointList& impostors)
+    {
+        std::vector<PreviewGroup> groups;
+        size_t omitted = buildGroups(points.size(),
+            [&](size_t i) -> const ColourValue& { return points[i].colour; },
+            [&](size_t i) -> const ColourValue& { return points[i].colour; },
+            [](size_t) { return Real(1.0); },
+            order, groups);
+
+        impostors.resize(groups.size());
+        for(size_t i = 0; i < groups.size(); ++i) {
+            impostors[i].position = points[groups[i].representative].position;
+            impostors[i].colour = groups[i].colour;
+        }
+
+        return omitted;
+    }
+
+    /** Order a sprite list for previewing and build its impostors
+    @param sprites The sprites
+    @param hdrColours The HDR colour of each sprite
+    @param order Filled with the sprite indices in draw order
+    @param impostors Filled with the impostors to draw after the sprites
+    @param impostorHDRColours Filled with the HDR colour of each impostor
+    @return The number of sprites at the start of order only the full 
+    detail version draws, or 0 with order and impostors left empty when
+    the preview can draw the sprites as they are
+    */
+    size_t SpacescapePreviewLOD::build(const SpacescapeSoftwareRenderer::SpriteList& sprites, 
+        const std::vector<ColourValue>& hdrColours, std::vector<uint32>& order, 
+        SpacescapeSoftwareRenderer::SpriteList& impostors, std::vector<ColourValue>& impostorHDRColours)
+    {
+        std::vector<PreviewGroup> groups;
+        size_t omitted = buildGroups(sprites.size(),
+            [&](size_t i) -> const ColourValue& { return sprites[i].colour; },
+            [&](size_t i) -> const ColourValue& { return hdrColours[i]; },
+            [&](size_t i) { return sprites[i].width * sprites[i].height; },
+            order, groups);
+
+        impostors.resize(groups.size());
+        impostorHDRColours.resize(groups.size());
+        for(size_t i = 0; i < groups.size(); ++i) {
+            Real size = Math::Sqrt(groups[i].area);
+            impostors[i].position = sprites[groups[i].representative].position;
+            impostors[i].width = size;
+            impostors[i].height = size;
+            impostors[i].colour = groups[i].colour;
+            impostorHDRColours[i] = groups[i].hdrColour;
+        }
+
+        return omitted;
+    }
+}
@@ -0,0 +1,73 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include "SpacescapeRandom.h"
+
+namespace Ogre
+{
+    // the lock GENERATOR_RAND generators hold on the global rand() state
+    static std::recursive_mutex sRandMutex;
+
+    /** Constructor
+    @param seed The seed
+    @param generator The generator to use
+    @param stream Selects one of 2^63 independent sequences for the seed
+    (PCG32 only)
+    */
+    SpacescapeRandom::SpacescapeRandom(uint64 seed, Generator generator, uint64 stream) :
+        mGenerator(generator),
+        mIncrement(0),
+        mState(0)
+    {
+        if(mGenerator == GENERATOR_RAND) {
+            mRandLock = std::unique_lock<std::recursive_mutex>(sRandMutex);
+        }
+
+        setSeed(seed, stream);
+    }
+
+    /** Restart the sequence
+    @param seed The seed
+    @param stream Selects one of 2^63 independent sequences for the seed
+    (PCG32 only)
+    */
+    void SpacescapeRandom::setSeed(uint64 seed, uint64 stream)
+    {
+        if(mGenerator == GENERATOR_RAND) {
+            srand((unsigned int)seed);
+            return;
+        }
+
+        mState = 0;
+        mIncrement = (stream << 1) | 1;
+        next();
+        mState += seed;
+        next();
+    }
+}
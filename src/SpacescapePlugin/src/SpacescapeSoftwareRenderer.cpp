@@ -0,0 +1,968 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include "SpacescapeSoftwareRenderer.h"
+#include "SpacescapeThreadPool.h"
+#include "OgreLogManager.h"
+#include "OgreStringConverter.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Ogre
+{
+    // width/height in pixels of the tiles faces are binned and rendered in
+    static const unsigned int sTileSize = 64;
+
+    // floats per pixel in the tile buffers, RGBA like the RTT
+    static const unsigned int sPixelSize = 4;
+
+    /** Utility function to get the value of a blend factor for a single
+    channel.  For the alpha channel pass the alphas as the channel values
+    too, the render system blends alpha with the same factors.
+    @param factor The blend factor
+    @param src The source channel value
+    @param srcAlpha The source alpha
+    @param dest The destination channel value
+    @param destAlpha The destination alpha
+    @return the factor value
+    */
+    static inline float getBlendFactor(SceneBlendFactor factor, float src, float srcAlpha, float dest, float destAlpha)
+    {
+        switch(factor) {
+            case SBF_ONE:
+                return 1.0f;
+            case SBF_ZERO:
+                return 0.0f;
+            case SBF_DEST_COLOUR:
+                return dest;
+            case SBF_SOURCE_COLOUR:
+                return src;
+            case SBF_ONE_MINUS_DEST_COLOUR:
+                return 1.0f - dest;
+            case SBF_ONE_MINUS_SOURCE_COLOUR:
+                return 1.0f - src;
+            case SBF_DEST_ALPHA:
+                return destAlpha;
+            case SBF_SOURCE_ALPHA:
+                return srcAlpha;
+            case SBF_ONE_MINUS_DEST_ALPHA:
+                return 1.0f - destAlpha;
+            case SBF_ONE_MINUS_SOURCE_ALPHA:
+                return 1.0f - srcAlpha;
+            default:
+                return 1.0f;
+        }
+    }
+
+    /** Constructor
+    @param orientation Orientation mode for non-Ogre skybox orientations
+    @param clamp Clamp colours to 0..1 after every draw like an 8 bit 
+    render target does - turn off for HDR
+    */
+    SpacescapeSoftwareRenderer::SpacescapeSoftwareRenderer(SpacescapePlugin::SpacescapeRTTOrientation orientation, bool clamp) :
+        mClamp(clamp),
+        mLayerCache(0),
+        mOrientation(orientation),
+        mSize(0),
+        mTilesPerSide(0)
+    {
+        for(unsigned int f = 0; f < 6; ++f) {
+            getFaceBasis(f, orientation, mFaceForward[f], mFaceRight[f], mFaceDown[f]);
+        }
+    }
+
+    /** Destructor
+    */
+    SpacescapeSoftwareRenderer::~SpacescapeSoftwareRenderer(void)
+    {
+        for(unsigned int i = 0; i < mDrawCalls.size(); ++i) {
+            if(mDrawCalls[i]->generator) {
+                OGRE_DELETE_T(mDrawCalls[i]->generator, SpacescapeNoiseGenerator, MEMCATEGORY_GENERAL);
+            }
+            OGRE_DELETE_T(mDrawCalls[i], DrawCall, MEMCATEGORY_GENERAL);
+        }
+        mDrawCalls.clear();
+    }
+
+    /** Add a draw call that covers every pixel with noise
+    @param permutations The 512 entry permutation table (see SpacescapeLayer::initNoise)
+    @param params The noise settings
+    @param sourceFactor Source blend factor
+    @param destFactor Destination blend factor
+    */
+    void SpacescapeSoftwareRenderer::addNoise(const uchar* permutations, const SpacescapeNoiseParams& params, SceneBlendFactor sourceFactor, SceneBlendFactor destFactor)
+    {
+        DrawCall* call = OGRE_NEW_T(DrawCall, MEMCATEGORY_GENERAL);
+        call->type = DT_NOISE;
+        call->sourceFactor = sourceFactor;
+        call->destFactor = destFactor;
+        call->generator = OGRE_NEW_T(SpacescapeNoiseGenerator, MEMCATEGORY_GENERAL)(permutations, params);
+        call->pointSize = 0;
+
+        mDrawCalls.push_back(call);
+    }
+
+    /** Add a draw call for a list of points
+    @param points The points to draw
+    @param pointSize The point size in pixels
+    @param sourceFactor Source blend factor
+    @param destFactor Destination blend factor
+    */
+    void SpacescapeSoftwareRenderer::addPoints(const PointList& points, unsigned int pointSize, SceneBlendFactor sourceFactor, SceneBlendFactor destFactor)
+    {
+        DrawCall* call = OGRE_NEW_T(DrawCall, MEMCATEGORY_GENERAL);
+        call->type = DT_POINTS;
+        call->sourceFactor = sourceFactor;
+        call->destFactor = destFactor;
+        call->generator = 0;
+        call->points = points;
+        call->pointSize = std::max<unsigned int>(1, pointSize);
+
+        mDrawCalls.push_back(call);
+    }
+
+    /** Add a draw call for a list of billboard sprites
+    @param sprites The sprites to draw
+    @param texture The sprite texture or NULL to draw untextured sprites
+    @param mipmaps Sample from a mipmap chain like a texture loaded 
+    with mipmaps does, otherwise only the full size image is used
+    @param sourceFactor Source blend factor
+    @param destFactor Destination blend factor
+    */
+    void SpacescapeSoftwareRenderer::addSprites(const SpriteList& sprites, const Image* texture, bool mipmaps, SceneBlendFactor sourceFactor, SceneBlendFactor destFactor)
+    {
+        DrawCall* call = OGRE_NEW_T(DrawCall, MEMCATEGORY_GENERAL);
+        call->type = DT_SPRITES;
+        call->sourceFactor = sourceFactor;
+        call->destFactor = destFactor;
+        call->generator = 0;
+        call->pointSize = 0;
+        call->sprites = sprites;
+
+        if(texture && PixelUtil::isCompressed(texture->getFormat())) {
+            Ogre::LogManager::getSingleton().getDefaultLog()->stream() <<
+                "Software renderer can't sample compressed textures, drawing sprites untextured";
+        }
+        else if(texture && texture->getWidth() && texture->getHeight()) {
+            // convert the full size image to float RGBA
+            TextureLevel level;
+            level.width = (unsigned int)texture->getWidth();
+            level.height = (unsigned int)texture->getHeight();
+            level.data.resize(level.width * level.height * 4);
+            PixelUtil::bulkPixelConversion(
+                texture->getPixelBox(0, 0),
+                PixelBox(level.width, level.height, 1, PF_FLOAT32_RGBA, &level.data[0])
+            );
+            call->texture.push_back(level);
+
+            // box filter each level down to 1x1
+            while(mipmaps && (level.width > 1 || level.height > 1)) {
+                const TextureLevel& prev = call->texture.back();
+
+                level.width = std::max<unsigned int>(1, prev.width / 2);
+                level.height = std::max<unsigned int>(1, prev.height / 2);
+                level.data.assign(level.width * level.height * 4, 0.0f);
+
+                for(unsigned int y = 0; y < level.height; ++y) {
+                    unsigned int y0 = std::min(y * 2, prev.height - 1);
+                    unsigned int y1 = std::min(y * 2 + 1, prev.height - 1);
+                    for(unsigned int x = 0; x < level.width; ++x) {
+                        unsigned int x0 = std::min(x * 2, prev.width - 1);
+                        unsigned int x1 = std::min(x * 2 + 1, prev.width - 1);
+                        for(unsigned int c = 0; c < 4; ++c) {
+                            level.data[(y * level.width + x) * 4 + c] = 0.25f * (
+                                prev.data[(y0 * prev.width + x0) * 4 + c] +
+                                prev.data[(y0 * prev.width + x1) * 4 + c] +
+                                prev.data[(y1 * prev.width + x0) * 4 + c] +
+                                prev.data[(y1 * prev.width + x1) * 4 + c]);
+                        }
+                    }
+                }
+
+                call->texture.push_back(level);
+            }
+        }
+
+        mDrawCalls.push_back(call);
+    }
+
+    /** Sort the primitives of a draw call into the tiles of a face
+    @param call The draw call
+    @param face The cube face (0 - 5)
+    */
+    void SpacescapeSoftwareRenderer::binPrimitives(DrawCall* call, unsigned int face)
+    {
+        std::vector<uint32>& offsets = call->binOffsets[face];
+        std::vector<uint32>& indices = call->binIndices[face];
+        offsets.assign(mTilesPerSide * mTilesPerSide + 1, 0);
+        indices.clear();
+
+        if(call->type == DT_NOISE) {
+            // noise covers every pixel, nothing to sort
+            return;
+        }
+
+        // get the covered pixels of every primitive
+        size_t count = call->type == DT_POINTS ? call->points.size() : call->sprites.size();
+        std::vector<Box> bounds(count);
+        std::vector<bool> visible(count, false);
+        Vector3 axisX, axisY;
+        for(size_t i = 0; i < count; ++i) {
+            if(call->type == DT_POINTS) {
+                visible[i] = getPointBounds(call->points[i], call->pointSize, face, bounds[i]);
+            }
+            else {
+                visible[i] = getSpriteBounds(call->sprites[i], face, axisX, axisY, bounds[i]);
+            }
+        }
+
+        // count the primitives in each tile, then turn the counts into 
+        // offsets and fill in the indices in draw order
+        for(int pass = 0; pass < 2; ++pass) {
+            std::vector<uint32> next;
+            if(pass == 1) {
+                for(size_t t = 1; t < offsets.size(); ++t) {
+                    offsets[t] += offsets[t - 1];
+                }
+                indices.resize(offsets.back());
+                next.assign(offsets.begin(), offsets.end() - 1);
+            }
+
+            for(size_t i = 0; i < count; ++i) {
+                if(!visible[i]) {
+                    continue;
+                }
+
+                uint32 tx0 = bounds[i].left / sTileSize;
+                uint32 tx1 = (bounds[i].right - 1) / sTileSize;
+                uint32 ty0 = bounds[i].top / sTileSize;
+                uint32 ty1 = (bounds[i].bottom - 1) / sTileSize;
+                for(uint32 ty = ty0; ty <= ty1; ++ty) {
+                    for(uint32 tx = tx0; tx <= tx1; ++tx) {
+                        uint32 tile = ty * mTilesPerSide + tx;
+                        if(pass == 0) {
+                            offsets[tile + 1]++;
+                        }
+                        else {
+                            indices[next[tile]++] = (uint32)i;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /** Start a new layer - the draw calls added after this belong to it
+    @param key Everything the layer's pixels depend on (i.e. its params)
+    */
+    void SpacescapeSoftwareRenderer::beginLayer(const String& key)
+    {
+        Layer layer;
+        layer.key = key;
+        layer.firstCall = mDrawCalls.size();
+        layer.cached = 0;
+        mLayers.push_back(layer);
+    }
+
+    /** Blend a colour into a pixel
+    @param dest The RGBA pixel to blend into, or the RGBA offset followed
+    by the RGBA scale of an affine pixel
+    @param src The colour to blend
+    @param call The draw call with the blend factors
+    @param affine Blend into an affine pixel
+    */
+    void SpacescapeSoftwareRenderer::blend(float* dest, const ColourValue& src, const DrawCall* call, bool affine) const
+    {
+        float colour[4] = { src.r, src.g, src.b, src.a };
+
+        if(mClamp) {
+            // 8 bit textures and vertex colours can't go outside 0..1
+            for(int c = 0; c < 4; ++c) {
+                colour[c] = std::min(1.0f, std::max(0.0f, colour[c]));
+            }
+        }
+
+        float alpha = colour[3];
+
+        if(affine) {
+            // the pixel holds the offset and scale it maps the channel below
+            // it with - the destination factor doesn't depend on that channel
+            // and the source factor is linear in it (see isLayerAffine)
+            for(int c = 0; c < 4; ++c) {
+                float source = getBlendFactor(call->sourceFactor, colour[c], alpha, 0.0f, 0.0f);
+                float sourceSlope = getBlendFactor(call->sourceFactor, colour[c], alpha, 1.0f, 1.0f) - source;
+                float scale = colour[c] * sourceSlope + getBlendFactor(call->destFactor, colour[c], alpha, 0.0f, 0.0f);
+
+                dest[c] = colour[c] * source + dest[c] * scale;
+                dest[c + 4] *= scale;
+            }
+            return;
+        }
+
+        // the colour channels see the destination alpha from before the draw
+        float destAlpha = dest[3];
+        for(int c = 0; c < 4; ++c) {
+            float value = colour[c] * getBlendFactor(call->sourceFactor, colour[c], alpha, dest[c], destAlpha) +
+                dest[c] * getBlendFactor(call->destFactor, colour[c], alpha, dest[c], destAlpha);
+
+            dest[c] = mClamp ? std::min(1.0f, std::max(0.0f, value)) : value;
+        }
+    }
+
+    /** Blend a cached layer into a tile
+    @param entry The cached layer
+    @param face The cube face (0 - 5)
+    @param tile The pixels to draw
+    @param buffer The RGBA tile buffer
+    */
+    void SpacescapeSoftwareRenderer::blendCachedLayer(const SpacescapeLayerCache::Entry* entry, unsigned int face, const Box& tile, float* buffer) const
+    {
+        const float* offsets = &entry->offset[face][0];
+        const float* scales = entry->scale[face].empty() ? 0 : &entry->scale[face][0];
+
+        for(uint32 y = tile.top; y < tile.bottom; ++y) {
+            float* row = buffer + (y - tile.top) * tile.getWidth() * sPixelSize;
+            size_t index = ((size_t)y * mSize + tile.left) * sPixelSize;
+            for(uint32 i = 0; i < tile.getWidth() * sPixelSize; ++i, ++index) {
+                float value = offsets[index] + (scales ? scales[index] : 1.0f) * row[i];
+                row[i] = mClamp ? std::min(1.0f, std::max(0.0f, value)) : value;
+            }
+        }
+    }
+
+    /** Draw a range of draw calls into a tile
+    @param firstCall The first draw call
+    @param lastCall One past the last draw call
+    @param face The cube face (0 - 5)
+    @param tile The pixels to draw
+    @param buffer The tile buffer
+    @param affine The buffer holds affine pixels (see blend)
+    */
+    void SpacescapeSoftwareRenderer::drawCalls(size_t firstCall, size_t lastCall, unsigned int face, const Box& tile, float* buffer, bool affine) const
+    {
+        for(size_t i = firstCall; i < lastCall; ++i) {
+            const DrawCall* call = mDrawCalls[i];
+            if(call->type == DT_NOISE) {
+                drawNoise(call, face, tile, buffer, affine);
+            }
+            else if(call->type == DT_POINTS) {
+                drawPoints(call, face, tile, buffer, affine);
+            }
+            else {
+                drawSprites(call, face, tile, buffer, affine);
+            }
+        }
+    }
+
+    /** Draw the noise of a draw call into a tile
+    @param call The draw call
+    @param face The cube face (0 - 5)
+    @param tile The pixels to draw
+    @param buffer The tile buffer
+    @param affine The buffer holds affine pixels (see blend)
+    */
+    void SpacescapeSoftwareRenderer::drawNoise(const DrawCall* call, unsigned int face, const Box& tile, float* buffer, bool affine) const
+    {
+        unsigned int width = tile.getWidth();
+        unsigned int stride = affine ? sPixelSize * 2 : sPixelSize;
+        std::vector<float> dx(width);
+        std::vector<float> dy(width);
+        std::vector<float> dz(width);
+        std::vector<float> colours(width * 4);
+        Real scale = 2.0 / (Real)mSize;
+
+        for(uint32 y = tile.top; y < tile.bottom; ++y) {
+            // same texel centres the noise generator uses
+            Real v = -1.0 + (y + 0.5) * scale;
+
+            for(unsigned int i = 0; i < width; ++i) {
+                Real u = -1.0 + (tile.left + i + 0.5) * scale;
+
+                Vector3 p = mFaceForward[face] + mFaceRight[face] * u + mFaceDown[face] * v;
+                p.normalise();
+
+                dx[i] = p.x;
+                dy[i] = p.y;
+                dz[i] = p.z;
+            }
+
+            call->generator->getColours(&dx[0], &dy[0], &dz[0], &colours[0], width);
+
+            float* row = buffer + (y - tile.top) * width * stride;
+            for(unsigned int i = 0; i < width; ++i) {
+                blend(row + i * stride, ColourValue(colours[i * 4], colours[i * 4 + 1], colours[i * 4 + 2], colours[i * 4 + 3]), call, affine);
+            }
+        }
+    }
+
+    /** Draw the points of a draw call into a tile
+    @param call The draw call
+    @param face The cube face (0 - 5)
+    @param tile The pixels to draw
+    @param buffer The tile buffer
+    @param affine The buffer holds affine pixels (see blend)
+    */
+    void SpacescapeSoftwareRenderer::drawPoints(const DrawCall* call, unsigned int face, const Box& tile, float* buffer, bool affine) const
+    {
+        unsigned int width = tile.getWidth();
+        unsigned int stride = affine ? sPixelSize * 2 : sPixelSize;
+        uint32 bin = (tile.top / sTileSize) * mTilesPerSide + tile.left / sTileSize;
+        const std::vector<uint32>& offsets = call->binOffsets[face];
+        const std::vector<uint32>& indices = call->binIndices[face];
+
+        Box bounds;
+        for(uint32 i = offsets[bin]; i < offsets[bin + 1]; ++i) {
+            const Point& point = call->points[indices[i]];
+            getPointBounds(point, call->pointSize, face, bounds);
+
+            // clip to the tile
+            uint32 left = std::max(bounds.left, tile.left);
+            uint32 right = std::min(bounds.right, tile.right);
+            uint32 top = std::max(bounds.top, tile.top);
+            uint32 bottom = std::min(bounds.bottom, tile.bottom);
+
+            for(uint32 y = top; y < bottom; ++y) {
+                float* row = buffer + (y - tile.top) * width * stride;
+                for(uint32 x = left; x < right; ++x) {
+                    blend(row + (x - tile.left) * stride, point.colour, call, affine);
+                }
+            }
+        }
+    }
+
+    /** Draw the sprites of a draw call into a tile
+    @param call The draw call
+    @param face The cube face (0 - 5)
+    @param tile The pixels to draw
+    @param buffer The tile buffer
+    @param affine The buffer holds affine pixels (see blend)
+    */
+    void SpacescapeSoftwareRenderer::drawSprites(const DrawCall* call, unsigned int face, const Box& tile, float* buffer, bool affine) const
+    {
+        unsigned int width = tile.getWidth();
+        unsigned int stride = affine ? sPixelSize * 2 : sPixelSize;
+        uint32 bin = (tile.top / sTileSize) * mTilesPerSide + tile.left / sTileSize;
+        const std::vector<uint32>& offsets = call->binOffsets[face];
+        const std::vector<uint32>& indices = call->binIndices[face];
+        Real scale = 2.0 / (Real)mSize;
+
+        Box bounds;
+        Vector3 axisX, axisY;
+        for(uint32 i = offsets[bin]; i < offsets[bin + 1]; ++i) {
+            const Sprite& sprite = call->sprites[indices[i]];
+            getSpriteBounds(sprite, face, axisX, axisY, bounds);
+
+            // the sprite lies in the plane facing the camera through its centre
+            Vector3 normal = sprite.position.normalisedCopy();
+            Real distance = sprite.position.dotProduct(normal);
+            Real halfWidth = sprite.width * 0.5;
+            Real halfHeight = sprite.height * 0.5;
+
+            // pick the mipmap level from the size on screen
+            const TextureLevel* level = 0;
+            if(!call->texture.empty()) {
+                size_t levelIndex = 0;
+                Real depth = sprite.position.dotProduct(mFaceForward[face]);
+                if(call->texture.size() > 1 && depth > 0.0 && sprite.width > 0.0) {
+                    Real pixels = sprite.width / depth * mSize * 0.5;
+                    Real texelsPerPixel = call->texture[0].width / std::max<Real>(pixels, 1e-6);
+                    if(texelsPerPixel > 1.0) {
+                        levelIndex = std::min<size_t>(call->texture.size() - 1,
+                            (size_t)std::floor(std::log(texelsPerPixel) / std::log(2.0) + 0.5));
+                    }
+                }
+                level = &call->texture[levelIndex];
+            }
+
+            // clip to the tile
+            uint32 left = std::max(bounds.left, tile.left);
+            uint32 right = std::min(bounds.right, tile.right);
+            uint32 top = std::max(bounds.top, tile.top);
+            uint32 bottom = std::min(bounds.bottom, tile.bottom);
+
+            for(uint32 y = top; y < bottom; ++y) {
+                Real v = -1.0 + (y + 0.5) * scale;
+                float* row = buffer + (y - tile.top) * width * stride;
+
+                for(uint32 x = left; x < right; ++x) {
+                    Real u = -1.0 + (x + 0.5) * scale;
+
+                    // intersect the pixel ray with the sprite plane - the
+                    // plane goes through the centre so the offsets along
+                    // the axes are just the ray position along them
+                    Vector3 ray = mFaceForward[face] + mFaceRight[face] * u + mFaceDown[face] * v;
+                    Real denom = ray.dotProduct(normal);
+                    if(denom <= 0.0) {
+                        continue;
+                    }
+                    Real t = distance / denom;
+                    Real s = t * ray.dotProduct(axisX) / halfWidth;
+                    Real r = t * ray.dotProduct(axisY) / halfHeight;
+                    if(s < -1.0 || s > 1.0 || r < -1.0 || r > 1.0) {
+                        continue;
+                    }
+
+                    ColourValue c = sprite.colour;
+                    if(level) {
+                        // texture v runs top to bottom
+                        c = c * sampleTexture(*level, (s + 1.0) * 0.5, (1.0 - r) * 0.5);
+                    }
+
+                    blend(row + (x - tile.left) * stride, c, call, affine);
+                }
+            }
+        }
+    }
+
+    /** Get the axes of a cube face the same way the RTT camera sees it
+    @param face The cube face (0 - 5)
+    @param orientation Orientation mode for non-Ogre skybox orientations
+    @param forward Set to the direction through the face center
+    @param right Set to the step in direction for u going from 0 to 1
+    @param down Set to the step in direction for v going from 0 to 1
+    */
+    void SpacescapeSoftwareRenderer::getFaceBasis(unsigned int face, SpacescapePlugin::SpacescapeRTTOrientation orientation,
+        Vector3& forward, Vector3& right, Vector3& down)
+    {
+        // the face directions are linear in u and v so three directions 
+        // describe the whole face
+        forward = getFaceDirection(face, 0.0, 0.0, orientation);
+        right = getFaceDirection(face, 1.0, 0.0, orientation) - forward;
+        down = getFaceDirection(face, 0.0, 1.0, orientation) - forward;
+    }
+
+    /** Get the view direction through a cube face position the same
+    way the RTT camera sees it for the given orientation
+    @param face The cube face (0 - 5)
+    @param u Horizontal position on the face in the range -1..1
+    @param v Vertical position on the face in the range -1..1 (top to bottom)
+    @param orientation Orientation mode for non-Ogre skybox orientations
+    @return the direction (not normalised)
+    */
+    Vector3 SpacescapeSoftwareRenderer::getFaceDirection(unsigned int face, Real u, Real v, SpacescapePlugin::SpacescapeRTTOrientation orientation)
+    {
+        if(orientation == SpacescapePlugin::SRO_UNREAL_ORIENTATION) {
+            // _rtt rolls these cameras about their view axis, which
+            // rotates the face u,v coordinates the same amount
+            Real tmp = u;
+            if(face == 0) {
+                // -90 degrees
+                u = -v;
+                v = tmp;
+            }
+            else if(face == 1) {
+                // 90 degrees
+                u = v;
+                v = -tmp;
+            }
+            else if(face == 2) {
+                // 180 degrees
+                u = -u;
+                v = -v;
+            }
+        }
+
+        return SpacescapeNoiseGenerator::getFaceDirection(face, u, v);
+    }
+
+    /** Get the pixels a point covers on a face
+    @param point The point
+    @param pointSize The point size in pixels
+    @param face The cube face (0 - 5)
+    @param bounds Return param
+    @return false if the point isn't drawn on this face
+    */
+    bool SpacescapeSoftwareRenderer::getPointBounds(const Point& point, unsigned int pointSize, unsigned int face, Box& bounds) const
+    {
+        Real depth = point.position.dotProduct(mFaceForward[face]);
+        if(depth <= 0.0) {
+            return false;
+        }
+
+        // points are clipped by their centre so a point is only drawn on 
+        // one face even if it is big enough to overlap the next face
+        Real u = point.position.dotProduct(mFaceRight[face]) / depth;
+        Real v = point.position.dotProduct(mFaceDown[face]) / depth;
+        if(u < -1.0 || u > 1.0 || v < -1.0 || v > 1.0) {
+            return false;
+        }
+
+        // cover the pixels whose centres are inside the point square
+        Real halfSize = mSize * 0.5;
+        Real radius = pointSize * 0.5;
+        Real x = (u + 1.0) * halfSize;
+        Real y = (v + 1.0) * halfSize;
+
+        bounds.left = (uint32)std::max<Real>(0.0, std::ceil(x - radius - 0.5));
+        bounds.right = (uint32)std::min<Real>(mSize, std::max<Real>(0.0, std::ceil(x + radius - 0.5)));
+        bounds.top = (uint32)std::max<Real>(0.0, std::ceil(y - radius - 0.5));
+        bounds.bottom = (uint32)std::min<Real>(mSize, std::max<Real>(0.0, std::ceil(y + radius - 0.5)));
+
+        return bounds.left < bounds.right && bounds.top < bounds.bottom;
+    }
+
+    /** Get the billboard axes and the pixels a sprite covers on a face
+    @param sprite The sprite
+    @param face The cube face (0 - 5)
+    @param axisX Return param - the billboard x axis
+    @param axisY Return param - the billboard y axis
+    @param bounds Return param
+    @return false if the sprite isn't drawn on this face
+    */
+    bool SpacescapeSoftwareRenderer::getSpriteBounds(const Sprite& sprite, unsigned int face, Vector3& axisX, Vector3& axisY, Box& bounds) const
+    {
+        // same axes as SpacescapeBillboardSet::genBillboardAxes with 
+        // accurate facing - the camera sits at the origin and its up 
+        // vector is the top of the face
+        Vector3 dir = sprite.position.normalisedCopy();
+        axisX = dir.crossProduct(-mFaceDown[face]);
+        if(axisX.squaredLength() < 1e-12) {
+            return false;
+        }
+        axisX.normalise();
+        axisY = axisX.crossProduct(dir);
+
+        Real halfWidth = sprite.width * 0.5;
+        Real halfHeight = sprite.height * 0.5;
+        Real halfSize = mSize * 0.5;
+
+        Real minX = mSize, maxX = 0.0, minY = mSize, maxY = 0.0;
+        bool behind = false;
+        for(int i = 0; i < 4; ++i) {
+            Vector3 corner = sprite.position +
+                axisX * ((i & 1) ? halfWidth : -halfWidth) +
+                axisY * ((i & 2) ? halfHeight : -halfHeight);
+
+            Real depth = corner.dotProduct(mFaceForward[face]);
+            if(depth <= 1e-6) {
+                behind = true;
+                break;
+            }
+
+            Real x = (corner.dotProduct(mFaceRight[face]) / depth + 1.0) * halfSize;
+            Real y = (corner.dotProduct(mFaceDown[face]) / depth + 1.0) * halfSize;
+            minX = std::min(minX, x);
+            maxX = std::max(maxX, x);
+            minY = std::min(minY, y);
+            maxY = std::max(maxY, y);
+        }
+
+        if(behind) {
+            // a corner is behind the camera so the projected corners can't
+            // be trusted - test the whole face unless it's all behind
+            if(sprite.position.dotProduct(mFaceForward[face]) + halfWidth + halfHeight <= 0.0) {
+                return false;
+            }
+            minX = minY = 0.0;
+            maxX = maxY = mSize;
+        }
+
+        // cover the pixels whose centres are inside the projected corners
+        bounds.left = (uint32)std::max<Real>(0.0, std::ceil(minX - 0.5));
+        bounds.right = (uint32)std::min<Real>(mSize, std::max<Real>(0.0, std::floor(maxX - 0.5) + 1.0));
+        bounds.top = (uint32)std::max<Real>(0.0, std::ceil(minY - 0.5));
+        bounds.bottom = (uint32)std::min<Real>(mSize, std::max<Real>(0.0, std::floor(maxY - 0.5) + 1.0));
+
+        return bounds.left < bounds.right && bounds.top < bounds.bottom;
+    }
+
+    /** Get the index one past the last draw call of a layer
+    @param layer The layer index
+    @return the draw call index
+    */
+    size_t SpacescapeSoftwareRenderer::getLayerEnd(size_t layer) const
+    {
+        return layer + 1 < mLayers.size() ? mLayers[layer + 1].firstCall : mDrawCalls.size();
+    }
+
+    /** Split a range of rows into tiles that each sit inside a single
+    bin so every primitive is drawn once per pixel
+    @param rowStart The first row
+    @param rowEnd One past the last row
+    @param tiles The list to add the tiles to
+    */
+    void SpacescapeSoftwareRenderer::getTiles(unsigned int rowStart, unsigned int rowEnd, std::vector<Box>& tiles) const
+    {
+        unsigned int y = rowStart;
+        while(y < rowEnd) {
+            unsigned int bottom = std::min(rowEnd, (y / sTileSize + 1) * sTileSize);
+            for(unsigned int x = 0; x < mSize; x += sTileSize) {
+                tiles.push_back(Box(x, y, std::min(mSize, x + sTileSize), bottom));
+            }
+            y = bottom;
+        }
+    }
+
+    /** Check whether a layer blends as offset + scale * colour
+    @param layer The layer index
+    @return true if the layer can be cached
+    */
+    bool SpacescapeSoftwareRenderer::isLayerAffine(size_t layer) const
+    {
+        for(size_t i = mLayers[layer].firstCall; i < getLayerEnd(layer); ++i) {
+            SceneBlendFactor source = mDrawCalls[i]->sourceFactor;
+            SceneBlendFactor dest = mDrawCalls[i]->destFactor;
+
+            // a destination factor that depends on the destination makes
+            // the result quadratic in it, and a source factor depending on
+            // the destination alpha mixes the alpha into the colour channels
+            if(dest == SBF_DEST_COLOUR || dest == SBF_ONE_MINUS_DEST_COLOUR ||
+                dest == SBF_DEST_ALPHA || dest == SBF_ONE_MINUS_DEST_ALPHA ||
+                source == SBF_DEST_ALPHA || source == SBF_ONE_MINUS_DEST_ALPHA) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /** Project and sort all the draw calls into face tiles
+    @remarks must be called after the last draw call is added and 
+    before rendering
+    @param size The width/height of each face
+    */
+    void SpacescapeSoftwareRenderer::prepare(unsigned int size)
+    {
+        mSize = size;
+        mTilesPerSide = (size + sTileSize - 1) / sTileSize;
+
+        // the cache key also needs everything the renderer adds
+        String suffix = "|size=" + StringConverter::toString(size) + 
+            "|orientation=" + StringConverter::toString((int)mOrientation) +
+            "|clamp=" + StringConverter::toString(mClamp);
+
+        std::vector<bool> binned(mDrawCalls.size(), false);
+        for(size_t i = 0; i < mLayers.size(); ++i) {
+            mLayers[i].cached = mLayerCache ? mLayerCache->find(mLayers[i].key + suffix) : 0;
+            if(mLayers[i].cached) {
+                // nothing to project for cached layers
+                for(size_t j = mLayers[i].firstCall; j < getLayerEnd(i); ++j) {
+                    binned[j] = true;
+                }
+            }
+        }
+
+        SpacescapeThreadPool::getSingleton().parallelFor(mDrawCalls.size() * 6, [&](size_t i) {
+            if(!binned[i / 6]) {
+                binPrimitives(mDrawCalls[i / 6], (unsigned int)(i % 6));
+            }
+        });
+
+        if(!mLayerCache) {
+            return;
+        }
+
+        // an offset and a scale cube of RGBA floats, the scale cube is 
+        // dropped again for additive layers
+        size_t entrySize = (size_t)size * size * 6 * sPixelSize * 2 * sizeof(float);
+
+        // render the layers that changed since the last render, layers 
+        // that don't fit in the cache budget are drawn instead
+        for(size_t i = 0; i < mLayers.size(); ++i) {
+            if(!mLayers[i].cached && isLayerAffine(i)) {
+                // an identical layer may have been rendered already
+                mLayers[i].cached = mLayerCache->find(mLayers[i].key + suffix);
+                if(!mLayers[i].cached && mLayerCache->reserve(entrySize)) {
+                    SpacescapeLayerCache::Entry* entry = renderLayer(i);
+                    mLayerCache->insert(mLayers[i].key + suffix, entry);
+                    mLayers[i].cached = entry;
+                }
+            }
+        }
+        mLayerCache->release();
+    }
+
+    /** Prepare and render all six faces using the shared thread pool
+    @param size The width/height of each face
+    @param faces Array of six pixel boxes to write to, in any pixel format
+    */
+    void SpacescapeSoftwareRenderer::renderCube(unsigned int size, const PixelBox* faces)
+    {
+        prepare(size);
+
+        std::vector<Box> tiles;
+        getTiles(0, size, tiles);
+
+        // one task per tile of every face so small faces still use all the cores
+        SpacescapeThreadPool::getSingleton().parallelFor(tiles.size() * 6, [&](size_t i) {
+            unsigned int face = (unsigned int)(i / tiles.size());
+            renderTile(face, tiles[i % tiles.size()], 0, faces[face]);
+        });
+    }
+
+    /** Render a whole face using the shared thread pool
+    @param face The cube face (0 - 5)
+    @param dest The pixel box to write to, in any pixel format
+    */
+    void SpacescapeSoftwareRenderer::renderFace(unsigned int face, const PixelBox& dest) const
+    {
+        renderFaceRows(face, 0, mSize, dest);
+    }
+
+    /** Render a range of rows of a face using the shared thread pool
+    @param face The cube face (0 - 5)
+    @param rowStart The first row to render
+    @param rowEnd One past the last row to render
+    @param dest The pixel box for just these rows to write to, in any pixel format
+    */
+    void SpacescapeSoftwareRenderer::renderFaceRows(unsigned int face, unsigned int rowStart, unsigned int rowEnd, const PixelBox& dest) const
+    {
+        std::vector<Box> tiles;
+        getTiles(rowStart, std::min(rowEnd, mSize), tiles);
+
+        SpacescapeThreadPool::getSingleton().parallelFor(tiles.size(), [&](size_t i) {
+            renderTile(face, tiles[i], rowStart, dest);
+        });
+    }
+
+    /** Render a tile and write it to the destination
+    @param face The cube face (0 - 5)
+    @param tile The pixels to render
+    @param rowStart The face row the first row of dest holds
+    @param dest The pixel box to write to
+    */
+    void SpacescapeSoftwareRenderer::renderTile(unsigned int face, const Box& tile, unsigned int rowStart, const PixelBox& dest) const
+    {
+        // start from the opaque black background _rtt clears to
+        std::vector<float> buffer(tile.getWidth() * tile.getHeight() * sPixelSize, 0.0f);
+        for(size_t j = 3; j < buffer.size(); j += sPixelSize) {
+            buffer[j] = 1.0f;
+        }
+
+        // draw calls added before the first layer
+        drawCalls(0, mLayers.empty() ? mDrawCalls.size() : mLayers[0].firstCall, face, tile, &buffer[0], false);
+
+        for(size_t i = 0; i < mLayers.size(); ++i) {
+            if(mLayers[i].cached) {
+                blendCachedLayer(mLayers[i].cached, face, tile, &buffer[0]);
+            }
+            else {
+                drawCalls(mLayers[i].firstCall, getLayerEnd(i), face, tile, &buffer[0], false);
+            }
+        }
+
+        // convert the tile to the destination format
+        PixelUtil::bulkPixelConversion(
+            PixelBox(tile.getWidth(), tile.getHeight(), 1, PF_FLOAT32_RGBA, &buffer[0]),
+            dest.getSubVolume(Box(
+                dest.left + tile.left, dest.top + tile.top - rowStart,
+                dest.left + tile.right, dest.top + tile.bottom - rowStart))
+        );
+    }
+
+    /** Render the contribution of a layer to all six faces
+    @param layer The layer index
+    @return the new cache entry
+    */
+    SpacescapeLayerCache::Entry* SpacescapeSoftwareRenderer::renderLayer(size_t layer) const
+    {
+        SpacescapeLayerCache::Entry* entry = OGRE_NEW_T(SpacescapeLayerCache::Entry, MEMCATEGORY_GENERAL);
+        for(unsigned int face = 0; face < 6; ++face) {
+            entry->offset[face].resize((size_t)mSize * mSize * sPixelSize);
+            entry->scale[face].resize((size_t)mSize * mSize * sPixelSize);
+        }
+
+        std::vector<Box> tiles;
+        getTiles(0, mSize, tiles);
+
+        SpacescapeThreadPool::getSingleton().parallelFor(tiles.size() * 6, [&](size_t i) {
+            unsigned int face = (unsigned int)(i / tiles.size());
+            const Box& tile = tiles[i % tiles.size()];
+
+            // every pixel starts out passing the colour below it through
+            std::vector<float> buffer(tile.getWidth() * tile.getHeight() * sPixelSize * 2, 0.0f);
+            for(size_t j = 0; j < buffer.size(); j += sPixelSize * 2) {
+                std::fill(&buffer[j + sPixelSize], &buffer[j + sPixelSize * 2], 1.0f);
+            }
+
+            drawCalls(mLayers[layer].firstCall, getLayerEnd(layer), face, tile, &buffer[0], true);
+
+            const float* pixel = &buffer[0];
+            for(uint32 y = tile.top; y < tile.bottom; ++y) {
+                size_t index = ((size_t)y * mSize + tile.left) * sPixelSize;
+                for(uint32 x = tile.left; x < tile.right; ++x, pixel += sPixelSize * 2, index += sPixelSize) {
+                    for(unsigned int c = 0; c < sPixelSize; ++c) {
+                        entry->offset[face][index + c] = pixel[c];
+                        entry->scale[face][index + c] = pixel[c + sPixelSize];
+                    }
+                }
+            }
+        });
+
+        // additive layers leave the colour below at full scale, which 
+        // doesn't need to be stored
+        bool unitScale = true;
+        for(unsigned int face = 0; face < 6 && unitScale; ++face) {
+            unitScale = std::find_if(entry->scale[face].begin(), entry->scale[face].end(), 
+                [](float v) { return v != 1.0f; }) == entry->scale[face].end();
+        }
+        if(unitScale) {
+            for(unsigned int face = 0; face < 6; ++face) {
+                std::vector<float>().swap(entry->scale[face]);
+            }
+        }
+
+        return entry;
+    }
+
+    /** Sample a sprite texture with bilinear filtering and wrapping
+    @param level The mipmap level to sample
+    @param u Horizontal texture coordinate
+    @param v Vertical texture coordinate
+    @return the texture colour
+    */
+    ColourValue SpacescapeSoftwareRenderer::sampleTexture(const TextureLevel& level, Real u, Real v)
+    {
+        Real x = u * level.width - 0.5;
+        Real y = v * level.height - 0.5;
+        Real fx = x - std::floor(x);
+        Real fy = y - std::floor(y);
+
+        // wrap like the default texture addressing mode
+        int w = (int)level.width;
+        int h = (int)level.height;
+        int x0 = (((int)std::floor(x) % w) + w) % w;
+        int y0 = (((int)std::floor(y) % h) + h) % h;
+        int x1 = (x0 + 1) % w;
+        int y1 = (y0 + 1) % h;
+
+        const float* p00 = &level.data[(y0 * w + x0) * 4];
+        const float* p10 = &level.data[(y0 * w + x1) * 4];
+        const float* p01 = &level.data[(y1 * w + x0) * 4];
+        const float* p11 = &level.data[(y1 * w + x1) * 4];
+
+        float c[4];
+        for(int i = 0; i < 4; ++i) {
+            float top = p00[i] + (p10[i] - p00[i]) * fx;
+            float bottom = p01[i] + (p11[i] - p01[i]) * fx;
+            c[i] = top + (bottom - top) * fy;
+        }
+
+        return ColourValue(c[0], c[1], c[2], c[3]);
+    }
+}
@@ -0,0 +1,784 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include "SpacescapeStarCatalog.h"
+#include "SpacescapeThreadPool.h"
+#include "OgreLogManager.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <locale>
+#include <sstream>
+
+namespace Ogre
+{
+    // bump when the binary catalog layout changes
+    static const uint32 STAR_CATALOG_VERSION = 2;
+
+    // columns start on a multiple of this many bytes
+    static const uint64 STAR_CATALOG_ALIGNMENT = 16;
+
+    // the index aims for this many stars in each cell
+    static const double STAR_CATALOG_STARS_PER_CELL = 256.0;
+
+    // the most cells along each cube face edge of the index
+    static const uint32 STAR_CATALOG_MAX_GRID_SIZE = 256;
+
+    /** The header at the start of every binary catalog, followed by the 
+    columns and the index cells
+    */
+    struct StarCatalogHeader
+    {
+        // "SSSC"
+        char magic[4];
+
+        // STAR_CATALOG_VERSION
+        uint32 version;
+
+        // number of stars
+        uint64 numStars;
+
+        // offset of each column from the start of the file or 0 if the 
+        // catalog doesn't have it
+        uint64 columnOffsets[SpacescapeStarCatalog::SC_NUM_COLUMNS];
+
+        // number of index cells along each cube face edge
+        uint32 gridSize;
+
+        // unused, keeps the cell offset aligned
+        uint32 reserved;
+
+        // offset of the first star of each index cell followed by the 
+        // number of stars, 6 * gridSize * gridSize + 1 uint64s
+        uint64 cellsOffset;
+    };
+
+    /** Constructor
+    */
+    SpacescapeStarCatalog::SpacescapeStarCatalog(void) :
+        mCells(0),
+        mGridSize(0),
+        mNumStars(0)
+    {
+        for(int i = 0; i < SC_NUM_COLUMNS; ++i) {
+            mColumns[i] = 0;
+        }
+    }
+
+    /** Free the stars
+    */
+    void SpacescapeStarCatalog::clear(void)
+    {
+        for(int i = 0; i < SC_NUM_COLUMNS; ++i) {
+            mColumns[i] = 0;
+            std::vector<float>().swap(mData[i]);
+        }
+
+        mCells = 0;
+        mFile.close();
+        mGridSize = 0;
+        mNumStars = 0;
+    }
+
+    /** Get the apparent magnitude of a star
+    @param star The star
+    @return the apparent magnitude, minus infinity for stars closer 
+    than 0.1 parsecs
+    */
+    Real SpacescapeStarCatalog::getApparentMagnitude(size_t star) const
+    {
+        Real dist = mColumns[SC_DISTANCE][star];
+        if(dist < 0.1) {
+            return -std::numeric_limits<Real>::infinity();
+        }
+
+        return mColumns[SC_ABSMAG][star] - 5*log10(10.0/dist);
+    }
+
+    /** Get the index cell a direction falls in
+    @param direction The direction
+    @param gridSize The number of cells along each cube face edge
+    @return the cell
+    */
+    uint32 SpacescapeStarCatalog::getCell(const Vector3& direction, uint32 gridSize)
+    {
+        // the face is the major axis and its sign
+        int axis = 0;
+        if(Math::Abs(direction.y) > Math::Abs(direction[axis])) {
+            axis = 1;
+        }
+        if(Math::Abs(direction.z) > Math::Abs(direction[axis])) {
+            axis = 2;
+        }
+
+        Real major = Math::Abs(direction[axis]);
+        Real u = major > 0 ? direction[(axis + 1) % 3] / major : 0;
+        Real v = major > 0 ? direction[(axis + 2) % 3] / major : 0;
+
+        uint32 face = axis * 2 + (direction[axis] < 0 ? 1 : 0);
+        uint32 x = std::min<uint32>((uint32)((u + 1) * 0.5 * gridSize), gridSize - 1);
+        uint32 y = std::min<uint32>((uint32)((v + 1) * 0.5 * gridSize), gridSize - 1);
+        return (face * gridSize + y) * gridSize + x;
+    }
+
+    /** Get the direction through a point on a cube face
+    @param face The cube face
+    @param u The horizontal face position, -1 to 1
+    @param v The vertical face position, -1 to 1
+    @return the normalised direction
+    */
+    Vector3 SpacescapeStarCatalog::getFaceDirection(uint32 face, Real u, Real v)
+    {
+        int axis = face / 2;
+
+        Vector3 direction;
+        direction[axis] = face % 2 ? -1.0 : 1.0;
+        direction[(axis + 1) % 3] = u;
+        direction[(axis + 2) % 3] = v;
+        direction.normalise();
+        return direction;
+    }
+
+    /** Get the stars at least as bright as a magnitude within a region
+    of the sky
+    @remarks Indexed catalogs only visit the cells that overlap the 
+    region and stop each cell at the first star that's too faint, 
+    otherwise every star is tested.
+    @param magnitudeLimit The faintest apparent magnitude to include
+    @param direction The centre of the region
+    @param radius The angular radius of the region, PI or more for the 
+    whole sky
+    @param stars Filled with the matching stars
+    */
+    void SpacescapeStarCatalog::getStars(Real magnitudeLimit, const Vector3& direction, 
+        const Radian& radius, std::vector<uint32>& stars) const
+    {
+        stars.clear();
+
+        const float* xs = mColumns[SC_X];
+        const float* ys = mColumns[SC_Y];
+        const float* zs = mColumns[SC_Z];
+
+        bool wholeSky = radius.valueRadians() >= Math::PI;
+        Vector3 centre = direction.normalisedCopy();
+        Real cosRadius = cos(radius.valueRadians());
+
+        if(!mCells) {
+            for(size_t i = 0; i < mNumStars; ++i) {
+                if(getApparentMagnitude(i) > magnitudeLimit) {
+                    continue;
+                }
+
+                if(wholeSky || Vector3(xs[i], ys[i], zs[i]).normalisedCopy().dotProduct(centre) >= cosRadius) {
+                    stars.push_back((uint32)i);
+                }
+            }
+            return;
+        }
+
+        uint32 numCells = 6 * mGridSize * mGridSize;
+        Real cellSize = 2.0 / mGridSize;
+        for(uint32 cell = 0; cell < numCells; ++cell) {
+            if(mCells[cell] == mCells[cell + 1]) {
+                continue;
+            }
+
+            // cells entirely inside the region don't need each star tested
+            bool testStars = false;
+            if(!wholeSky) {
+                uint32 face = cell / (mGridSize * mGridSize);
+                Real u = (cell % mGridSize) * cellSize - 1;
+                Real v = ((cell / mGridSize) % mGridSize) * cellSize - 1;
+
+                // the farthest point of a cell from its centre is a corner
+                Vector3 cellCentre = getFaceDirection(face, u + cellSize * 0.5, v + cellSize * 0.5);
+                Real cellRadius = 0;
+                for(int corner = 0; corner < 4; ++corner) {
+                    Vector3 cornerDirection = getFaceDirection(face, 
+                        u + (corner & 1) * cellSize, v + (corner >> 1) * cellSize);
+                    cellRadius = std::max<Real>(cellRadius, 
+                        acos(Math::Clamp<Real>(cellCentre.dotProduct(cornerDirection), -1, 1)));
+                }
+
+                Real angle = acos(Math::Clamp<Real>(cellCentre.dotProduct(centre), -1, 1));
+                if(angle > radius.valueRadians() + cellRadius) {
+                    continue;
+                }
+                testStars = angle + cellRadius > radius.valueRadians();
+            }
+
+            // stars in a cell are sorted brightest first
+            for(uint64 i = mCells[cell]; i < mCells[cell + 1]; ++i) {
+                if(getApparentMagnitude((size_t)i) > magnitudeLimit) {
+                    break;
+                }
+
+                if(!testStars || Vector3(xs[i], ys[i], zs[i]).normalisedCopy().dotProduct(centre) >= cosRadius) {
+                    stars.push_back((uint32)i);
+                }
+            }
+        }
+    }
+
+    /** Load a catalog, binary or CSV
+    @param filename The catalog file
+    @return true on success, false on error
+    */
+    bool SpacescapeStarCatalog::load(const String& filename)
+    {
+        // binary catalogs start with their magic
+        char magic[4] = { 0 };
+        std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+        file.read(magic, 4);
+        file.close();
+
+        if(memcmp(magic, "SSSC", 4) == 0) {
+            return loadBinary(filename);
+        }
+
+        return loadCSV(filename);
+    }
+
+    /** Load a binary catalog
+    @param filename The catalog file
+    @return true on success, false on error
+    */
+    bool SpacescapeStarCatalog::loadBinary(const String& filename)
+    {
+        clear();
+
+        if(!mFile.open(filename)) {
+            Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
+                "Unable to open star catalog " << filename;
+            return false;
+        }
+
+        // make sure the file is a catalog and is complete
+        StarCatalogHeader header;
+        bool valid = mFile.getSize() >= sizeof(header);
+        if(valid) {
+            memcpy(&header, mFile.getData(), sizeof(header));
+            valid = memcmp(header.magic, "SSSC", 4) == 0 && 
+                header.version == STAR_CATALOG_VERSION &&
+                header.numStars <= mFile.getSize() / sizeof(float);
+        }
+
+        for(int i = 0; valid && i < SC_NUM_COLUMNS; ++i) {
+            uint64 offset = header.columnOffsets[i];
+            if(offset == 0) {
+                // only the colour index is optional
+                valid = i == SC_BV;
+                continue;
+            }
+
+            valid = offset >= sizeof(header) && 
+                offset % STAR_CATALOG_ALIGNMENT == 0 &&
+                offset + header.numStars * sizeof(float) <= mFile.getSize();
+            if(valid) {
+                mColumns[i] = (const float*)(mFile.getData() + offset);
+            }
+        }
+
+        // the index cells must cover every star in order
+        if(valid && header.gridSize) {
+            uint64 numCells = 6 * (uint64)header.gridSize * header.gridSize;
+            valid = header.gridSize <= STAR_CATALOG_MAX_GRID_SIZE &&
+                header.cellsOffset >= sizeof(header) &&
+                header.cellsOffset % STAR_CATALOG_ALIGNMENT == 0 &&
+                header.cellsOffset + (numCells + 1) * sizeof(uint64) <= mFile.getSize();
+            if(valid) {
+                mCells = (const uint64*)(mFile.getData() + header.cellsOffset);
+                valid = mCells[0] == 0 && mCells[numCells] == header.numStars;
+                for(uint64 i = 0; valid && i < numCells; ++i) {
+                    valid = mCells[i] <= mCells[i + 1];
+                }
+            }
+        }
+
+        if(!valid) {
+            clear();
+            Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
+                "Invalid star catalog " << filename;
+            return false;
+        }
+
+        mGridSize = header.gridSize;
+        mNumStars = (size_t)header.numStars;
+        return true;
+    }
+
+    /** Load a CSV catalog
+    @remarks The first line names the columns, x, y, z, absmag and 
+    distance are required and bv (or colorIndex) is optional.  Quotes
+    aren't handled.  The file is mapped and split into chunks of whole
+    lines that are parsed on the thread pool straight into the columns.
+    @param filename The catalog file
+    @return true on success, false on error
+    */
+    bool SpacescapeStarCatalog::loadCSV(const String& filename)
+    {
+        clear();
+
+        SpacescapeMappedFile file;
+        if(!file.open(filename)) {
+            Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
+                "Unable to open star catalog " << filename;
+            return false;
+        }
+
+        const char* data = (const char*)file.getData();
+        const char* end = data + file.getSize();
+        const char* headerEnd = (const char*)memchr(data, '\n', end - data);
+        if(!headerEnd) {
+            headerEnd = end;
+        }
+
+        // the catalog column of each CSV field or -1
+        std::vector<int> fieldColumns;
+        int offsets[SC_NUM_COLUMNS];
+        for(int i = 0; i < SC_NUM_COLUMNS; ++i) {
+            offsets[i] = -1;
+        }
+
+        std::string header(data, headerEnd);
+        if(!header.empty() && header[header.size() - 1] == '\r') {
+            header.erase(header.size() - 1);
+        }
+
+        std::stringstream ss(header);
+        std::string item;
+        int offset = 0;
+        while(std::getline(ss, item, ',')) {
+            int column = -1;
+            if(item == "x" || item == "X") {
+                column = SC_X;
+            }
+            else if(item == "y" || item == "Y") {
+                column = SC_Y;
+            }
+            else if(item == "z" || item == "Z") {
+                column = SC_Z;
+            }
+            else if(item == "colorIndex" || item == "ColorIndex" || item == "bv" || item == "BV") {
+                column = SC_BV;
+            }
+            else if(item == "AbsMag" || item == "absmag") {
+                column = SC_ABSMAG;
+            }
+            else if(item == "distance" || item == "Distance") {
+                column = SC_DISTANCE;
+            }
+
+            if(column != -1) {
+                offsets[column] = offset;
+            }
+            fieldColumns.push_back(column);
+            offset++;
+        }
+
+        // rows need at least 6 fields and every column we use
+        size_t minFields = 6;
+        for(int i = 0; i < SC_NUM_COLUMNS; ++i) {
+            if(offsets[i] == -1 && i != SC_BV) {
+                Ogre::LogManager::getSingleton().getDefaultLog()->stream() <<
+                    "CSV file first line must have x,y,z,absmag,distance";
+                return false;
+            }
+            minFields = std::max<size_t>(minFields, offsets[i] + 1);
+        }
+
+        // split the rows into chunks of whole lines, big enough to be 
+        // worth a task
+        const char* body = headerEnd < end ? headerEnd + 1 : end;
+        size_t bodySize = end - body;
+        size_t numChunks = std::min<size_t>(SpacescapeThreadPool::getSingleton().getNumThreads() * 4, 
+            bodySize / 65536);
+        numChunks = std::max<size_t>(numChunks, 1);
+
+        std::vector<const char*> chunks(numChunks + 1, end);
+        chunks[0] = body;
+        for(size_t i = 1; i < numChunks; ++i) {
+            const char* start = body + bodySize * i / numChunks - 1;
+            const char* lineEnd = (const char*)memchr(start, '\n', end - start);
+            chunks[i] = lineEnd ? lineEnd + 1 : end;
+        }
+
+        // every line may be a star so size the columns by line count
+        std::vector<size_t> chunkRows(numChunks);
+        SpacescapeThreadPool::getSingleton().parallelFor(numChunks, [&](size_t i) {
+            const char* begin = chunks[i];
+            const char* chunkEnd = chunks[i + 1];
+            size_t lines = std::count(begin, chunkEnd, '\n');
+            if(chunkEnd > begin && chunkEnd[-1] != '\n') {
+                ++lines;
+            }
+            chunkRows[i] = lines;
+        });
+
+        std::vector<size_t> chunkOffsets(numChunks);
+        size_t maxRows = 0;
+        for(size_t i = 0; i < numChunks; ++i) {
+            chunkOffsets[i] = maxRows;
+            maxRows += chunkRows[i];
+        }
+
+        float* columns[SC_NUM_COLUMNS];
+        for(int i = 0; i < SC_NUM_COLUMNS; ++i) {
+            columns[i] = 0;
+            if(offsets[i] != -1 && maxRows) {
+                mData[i].resize(maxRows);
+                columns[i] = &mData[i][0];
+            }
+        }
+
+        SpacescapeThreadPool::getSingleton().parallelFor(numChunks, [&](size_t i) {
+            float* chunkColumns[SC_NUM_COLUMNS];
+            for(int c = 0; c < SC_NUM_COLUMNS; ++c) {
+                chunkColumns[c] = columns[c] ? columns[c] + chunkOffsets[i] : 0;
+            }
+
+            chunkRows[i] = parseCSVRows(chunks[i], chunks[i + 1], 
+                &fieldColumns[0], fieldColumns.size(), minFields, chunkColumns);
+        });
+
+        // close the gaps left by skipped rows
+        size_t numStars = 0;
+        for(size_t i = 0; i < numChunks; ++i) {
+            for(int c = 0; c < SC_NUM_COLUMNS; ++c) {
+                if(columns[c] && numStars != chunkOffsets[i]) {
+                    memmove(columns[c] + numStars, columns[c] + chunkOffsets[i], 
+                        chunkRows[i] * sizeof(float));
+                }
+            }
+            numStars += chunkRows[i];
+        }
+
+        for(int i = 0; i < SC_NUM_COLUMNS; ++i) {
+            if(offsets[i] != -1) {
+                mData[i].resize(numStars);
+                mColumns[i] = mData[i].empty() ? 0 : &mData[i][0];
+            }
+        }
+
+        mNumStars = numStars;
+        return true;
+    }
+
+    /** Parse the rows of a CSV catalog
+    @remarks Rows with fewer than minFields fields are skipped.
+    @param begin The start of the first row
+    @param end The end of the last row
+    @param fieldColumns The catalog column of each CSV field or -1
+    @param numFields The number of entries in fieldColumns
+    @param minFields The number of fields a row needs
+    @param columns Where to write each column or NULL to skip it
+    @return the number of rows written
+    */
+    size_t SpacescapeStarCatalog::parseCSVRows(const char* begin, const char* end, 
+        const int* fieldColumns, size_t numFields, size_t minFields, float* const* columns)
+    {
+        float row[SC_NUM_COLUMNS] = { 0 };
+        size_t numRows = 0;
+
+        const char* line = begin;
+        while(line < end) {
+            const char* lineEnd = (const char*)memchr(line, '\n', end - line);
+            if(!lineEnd) {
+                lineEnd = end;
+            }
+
+            size_t field = 0;
+            const char* item = line;
+            for(;;) {
+                const char* itemEnd = (const char*)memchr(item, ',', lineEnd - item);
+                if(!itemEnd) {
+                    itemEnd = lineEnd;
+                }
+
+                if(field < numFields && fieldColumns[field] != -1) {
+                    row[fieldColumns[field]] = parseFloat(item, itemEnd);
+                }
+                ++field;
+
+                if(itemEnd == lineEnd) {
+                    // like getline a trailing empty field doesn't count
+                    if(item == lineEnd) {
+                        --field;
+                    }
+                    break;
+                }
+                item = itemEnd + 1;
+            }
+
+            if(field >= minFields) {
+                for(int c = 0; c < SC_NUM_COLUMNS; ++c) {
+                    if(columns[c]) {
+                        columns[c][numRows] = row[c];
+                    }
+                }
+                ++numRows;
+            }
+
+            line = lineEnd + 1;
+        }
+
+        return numRows;
+    }
+
+    /** Parse a number from a CSV field
+    @remarks Handles an optional sign, digits, a fraction and an exponent
+    without the locale lookups and allocations of StringConverter.  Like
+    StringConverter::parseReal anything that isn't a number is 0.  Numbers
+    with more significant digits or a bigger exponent than a double can 
+    scale exactly fall back to a stream in the classic locale, so the 
+    result always matches strtod.
+    @param begin The start of the field
+    @param end The end of the field
+    @return the number
+    */
+    float SpacescapeStarCatalog::parseFloat(const char* begin, const char* end)
+    {
+        // the powers of ten a double holds exactly
+        static const double powers[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+
+        // the largest mantissa a double holds exactly
+        static const uint64 maxExactMantissa = (uint64)1 << 53;
+
+        const char* p = begin;
+        while(p < end && (*p == ' ' || *p == '\t')) {
+            ++p;
+        }
+
+        const char* numberBegin = p;
+        bool negative = false;
+        if(p < end && (*p == '-' || *p == '+')) {
+            negative = *p == '-';
+            ++p;
+        }
+
+        // keep 19 significant digits and note any non zero digit dropped
+        uint64 mantissa = 0;
+        int digits = 0;
+        int exponent = 0;
+        bool truncated = false;
+        for(; p < end && *p >= '0' && *p <= '9'; ++p) {
+            if(digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += mantissa != 0;
+            }
+            else {
+                truncated |= *p != '0';
+                ++exponent;
+            }
+        }
+
+        if(p < end && *p == '.') {
+            for(++p; p < end && *p >= '0' && *p <= '9'; ++p) {
+                if(digits < 19) {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    digits += mantissa != 0;
+                    --exponent;
+                }
+                else {
+                    truncated |= *p != '0';
+                }
+            }
+        }
+
+        // an exponent without digits isn't part of the number
+        const char* numberEnd = p;
+        if(p < end && (*p == 'e' || *p == 'E')) {
+            ++p;
+            bool negativeExponent = false;
+            if(p < end && (*p == '-' || *p == '+')) {
+                negativeExponent = *p == '-';
+                ++p;
+            }
+
+            int value = 0;
+            for(; p < end && *p >= '0' && *p <= '9'; ++p) {
+                if(value < 10000) {
+                    value = value * 10 + (*p - '0');
+                }
+                numberEnd = p + 1;
+            }
+            exponent += negativeExponent ? -value : value;
+        }
+
+        if(mantissa == 0) {
+            return negative ? -0.0f : 0.0f;
+        }
+
+        if(truncated || mantissa > maxExactMantissa || exponent < -22 || exponent > 22) {
+            // one rounding of an exact mantissa and power is only 
+            // guaranteed to be correct inside the fast path's limits
+            std::istringstream stream(std::string(numberBegin, numberEnd));
+            stream.imbue(std::locale::classic());
+            double result = 0.0;
+            stream >> result;
+            return (float)result;
+        }
+
+        double result = (double)mantissa;
+        if(exponent < 0) {
+            result /= powers[-exponent];
+        }
+        else {
+            result *= powers[exponent];
+        }
+
+        return (float)(negative ? -result : result);
+    }
+
+    /** Save the catalog in the binary format
+    @remarks The saved catalog is indexed, so its stars are in a 
+    different order than this catalog's.  The file is written under a 
+    temporary name and renamed into place so a catalog that is mapped 
+    elsewhere is never truncated.
+    @param filename The file to write
+    @return true on success, false on error
+    */
+    bool SpacescapeStarCatalog::save(const String& filename) const
+    {
+        StarCatalogHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "SSSC", 4);
+        header.version = STAR_CATALOG_VERSION;
+        header.numStars = mNumStars;
+
+        // enough cells that each holds a few hundred stars
+        uint32 gridSize = 0;
+        if(mNumStars) {
+            gridSize = (uint32)ceil(sqrt(mNumStars / (6.0 * STAR_CATALOG_STARS_PER_CELL)));
+            gridSize = Math::Clamp<uint32>(gridSize, 1, STAR_CATALOG_MAX_GRID_SIZE);
+        }
+        uint32 numCells = 6 * gridSize * gridSize;
+        header.gridSize = gridSize;
+
+        // group the stars by cell, brightest first in each cell
+        std::vector<uint32> cells(mNumStars);
+        std::vector<Real> magnitudes(mNumStars);
+        std::vector<uint32> order(mNumStars);
+        for(size_t i = 0; i < mNumStars; ++i) {
+            cells[i] = getCell(Vector3(mColumns[SC_X][i], mColumns[SC_Y][i], mColumns[SC_Z][i]), gridSize);
+            magnitudes[i] = getApparentMagnitude(i);
+            if(magnitudes[i] != magnitudes[i]) {
+                magnitudes[i] = std::numeric_limits<Real>::infinity();
+            }
+            order[i] = (uint32)i;
+        }
+
+        std::sort(order.begin(), order.end(), [&](uint32 a, uint32 b) {
+            if(cells[a] != cells[b]) {
+                return cells[a] < cells[b];
+            }
+            if(magnitudes[a] != magnitudes[b]) {
+                return magnitudes[a] < magnitudes[b];
+            }
+            return a < b;
+        });
+
+        std::vector<uint64> cellStarts(mNumStars ? numCells + 1 : 0, 0);
+        for(size_t i = 0; i < mNumStars; ++i) {
+            cellStarts[cells[i] + 1]++;
+        }
+        for(uint32 i = 0; i < numCells; ++i) {
+            cellStarts[i + 1] += cellStarts[i];
+        }
+
+        uint64 columnSize = (mNumStars * sizeof(float) + STAR_CATALOG_ALIGNMENT - 1) / 
+            STAR_CATALOG_ALIGNMENT * STAR_CATALOG_ALIGNMENT;
+        uint64 offset = (sizeof(header) + STAR_CATALOG_ALIGNMENT - 1) / 
+            STAR_CATALOG_ALIGNMENT * STAR_CATALOG_ALIGNMENT;
+        for(int i = 0; i < SC_NUM_COLUMNS; ++i) {
+            if(mColumns[i] || (mNumStars == 0 && i != SC_BV)) {
+                header.columnOffsets[i] = offset;
+                offset += columnSize;
+            }
+        }
+        header.cellsOffset = gridSize ? offset : 0;
+
+        String tempName = filename + ".tmp";
+        std::ofstream file(tempName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        if(!file) {
+            Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
+                "Unable to write star catalog " << tempName;
+            return false;
+        }
+
+        char padding[STAR_CATALOG_ALIGNMENT] = { 0 };
+        file.write((const char*)&header, sizeof(header));
+        file.write(padding, header.columnOffsets[SC_X] - sizeof(header));
+
+        // write each column in index order a block at a time
+        std::vector<float> block(std::min<size_t>(mNumStars, 65536));
+        for(int i = 0; i < SC_NUM_COLUMNS; ++i) {
+            if(!header.columnOffsets[i]) {
+                continue;
+            }
+
+            for(size_t first = 0; first < mNumStars; first += block.size()) {
+                size_t count = std::min(block.size(), mNumStars - first);
+                for(size_t j = 0; j < count; ++j) {
+                    block[j] = mColumns[i][order[first + j]];
+                }
+                file.write((const char*)&block[0], count * sizeof(float));
+            }
+            file.write(padding, columnSize - mNumStars * sizeof(float));
+        }
+
+        if(gridSize) {
+            file.write((const char*)&cellStarts[0], cellStarts.size() * sizeof(uint64));
+        }
+
+        file.close();
+        if(file.fail()) {
+            std::remove(tempName.c_str());
+            Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
+                "Unable to write star catalog " << tempName;
+            return false;
+        }
+
+        // the old catalog stays in place until the new one replaces it
+        if(!SpacescapeMappedFile::replace(tempName, filename)) {
+            std::remove(tempName.c_str());
+            Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
+                "Unable to write star catalog " << filename;
+            return false;
+        }
+
+        return true;
+    }
+}
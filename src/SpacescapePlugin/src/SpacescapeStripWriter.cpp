@@ -0,0 +1,509 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include "SpacescapeStripWriter.h"
+#include "OgreLogManager.h"
+#include "OgreStringConverter.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Ogre
+{
+    // dds header flags (see the DirectX DDS_HEADER docs)
+    static const uint32 DDSD_CAPS = 0x1;
+    static const uint32 DDSD_HEIGHT = 0x2;
+    static const uint32 DDSD_WIDTH = 0x4;
+    static const uint32 DDSD_PITCH = 0x8;
+    static const uint32 DDSD_PIXELFORMAT = 0x1000;
+    static const uint32 DDSD_MIPMAPCOUNT = 0x20000;
+    static const uint32 DDSD_LINEARSIZE = 0x80000;
+    static const uint32 DDPF_FOURCC = 0x4;
+    static const uint32 DDPF_RGB = 0x40;
+    static const uint32 DDSCAPS_COMPLEX = 0x8;
+    static const uint32 DDSCAPS_TEXTURE = 0x1000;
+    static const uint32 DDSCAPS_MIPMAP = 0x400000;
+    static const uint32 DDSCAPS2_CUBEMAP_ALLFACES = 0xFE00;
+    static const uint32 D3DFMT_A32B32G32R32F = 116;
+    static const uint32 D3D10_RESOURCE_DIMENSION_TEXTURE2D = 3;
+    static const uint32 D3D10_RESOURCE_MISC_TEXTURECUBE = 0x4;
+    static const uint32 DXGI_FORMAT_BC6H_UF16 = 95;
+    static const uint32 DXGI_FORMAT_BC7_UNORM = 98;
+
+    /** Constructor
+    */
+    SpacescapeStripWriter::SpacescapeStripWriter(void) :
+        mCompression(PF_UNKNOWN),
+        mCompressionQuality(SpacescapeBlockCompressor::BCQ_NORMAL),
+        mFileType(FT_DDS),
+        mFormat(PF_UNKNOWN),
+        mNumFaces(0),
+        mNumMipmaps(0),
+        mNumPendingRows(0),
+        mRowsWritten(0),
+        mSize(0)
+    {
+    }
+
+    /** Destructor
+    @remarks closes the file if it is still open
+    */
+    SpacescapeStripWriter::~SpacescapeStripWriter(void)
+    {
+        close();
+    }
+
+    /** Finish writing and close the file
+    @return true if all the rows were written
+    */
+    bool SpacescapeStripWriter::close(void)
+    {
+        if(!mFile.is_open()) {
+            return false;
+        }
+
+        bool complete = mRowsWritten == getRowsPerFace() * mNumFaces;
+        mFile.close();
+
+        if(!complete) {
+            Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
+                "SpacescapeStripWriter closed after " << mRowsWritten << " of " <<
+                getRowsPerFace() * mNumFaces << " rows";
+        }
+
+        return complete && !mFile.fail();
+    }
+
+    /** Utility function to get the mip level the next row belongs to
+    @param rowsLeft Return param - rows left in that level
+    @return the width/height of the level
+    */
+    unsigned int SpacescapeStripWriter::getCurrentLevelSize(size_t& rowsLeft) const
+    {
+        size_t row = mRowsWritten % getRowsPerFace();
+        for(unsigned int level = 0; level <= mNumMipmaps; ++level) {
+            unsigned int levelSize = std::max<unsigned int>(1, mSize >> level);
+            if(row < levelSize) {
+                rowsLeft = levelSize - row;
+                return levelSize;
+            }
+            row -= levelSize;
+        }
+
+        rowsLeft = 0;
+        return 0;
+    }
+
+    /** Utility function to get the file type for an extension
+    @param extension The file extension including the dot
+    @param type Return param
+    @return false if the extension isn't supported
+    */
+    bool SpacescapeStripWriter::getFileType(const String& extension, FileType& type)
+    {
+        String ext = extension;
+        StringUtil::toLowerCase(ext);
+
+        if(ext == ".dds") {
+            type = FT_DDS;
+        }
+        else if(ext == ".hdr") {
+            type = FT_HDR;
+        }
+        else if(ext == ".pfm") {
+            type = FT_PFM;
+        }
+        else if(ext == ".tga") {
+            type = FT_TGA;
+        }
+        else {
+            return false;
+        }
+
+        return true;
+    }
+
+    /** Utility function to get the number of rows in a face including
+    its mipmaps
+    @return the number of rows
+    */
+    size_t SpacescapeStripWriter::getRowsPerFace(void) const
+    {
+        size_t rows = 0;
+        for(unsigned int level = 0; level <= mNumMipmaps; ++level) {
+            rows += std::max<unsigned int>(1, mSize >> level);
+        }
+        return rows;
+    }
+
+    /** Check whether a file type can be written a strip at a time
+    @param extension The file extension including the dot (i.e. ".dds")
+    @param numFaces The number of faces the file will hold
+    @return true if supported
+    */
+    bool SpacescapeStripWriter::isSupported(const String& extension, unsigned int numFaces)
+    {
+        FileType type;
+        if(!getFileType(extension, type)) {
+            return false;
+        }
+
+        // only dds files hold more than one face
+        return numFaces == 1 || (numFaces == 6 && type == FT_DDS);
+    }
+
+    /** Create the file and write its header
+    @param filename The filename (and path) of the file to write
+    @param size The width/height of each face
+    @param numFaces The number of faces - 6 for a .dds cube map, otherwise 1
+    @param hdr Write floating point colours when the file type supports it
+    @param numMipmaps The number of mip levels after level 0 (.dds only)
+    @return true on success
+    */
+    bool SpacescapeStripWriter::open(const String& filename, unsigned int size, unsigned int numFaces, bool hdr, unsigned int numMipmaps)
+    {
+        close();
+
+        String::size_type index_of_extension = filename.find_last_of('.');
+        if(index_of_extension == String::npos || 
+            !getFileType(filename.substr(index_of_extension), mFileType) ||
+            !isSupported(filename.substr(index_of_extension), numFaces) ||
+            ((numMipmaps || mCompression != PF_UNKNOWN) && mFileType != FT_DDS)) {
+            Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
+                "SpacescapeStripWriter can't write " << filename;
+            return false;
+        }
+
+        mFile.open(filename.c_str(), std::ios::binary | std::ios::out | std::ios::trunc);
+        if(!mFile.is_open()) {
+            Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
+                "SpacescapeStripWriter couldn't create " << filename;
+            return false;
+        }
+
+        mNumFaces = numFaces;
+        mNumMipmaps = numMipmaps;
+        mNumPendingRows = 0;
+        mPendingRows.clear();
+        mRowsWritten = 0;
+        mSize = size;
+
+        switch(mFileType) {
+            case FT_DDS:
+                {
+                    // byte order B,G,R matches the legacy 24 bit RGB masks
+                    mFormat = hdr ? PF_FLOAT32_RGBA : PF_BYTE_BGR;
+                    if(mCompression != PF_UNKNOWN) {
+                        mFormat = mCompression == PF_BC6H_UF16 ? PF_FLOAT32_RGBA : PF_BYTE_RGBA;
+                    }
+
+                    mFile.write("DDS ", 4);
+                    writeUInt32(124);
+                    writeUInt32(DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT |
+                        (mCompression != PF_UNKNOWN ? DDSD_LINEARSIZE : DDSD_PITCH) |
+                        (numMipmaps ? DDSD_MIPMAPCOUNT : 0));
+                    writeUInt32(size);
+                    writeUInt32(size);
+                    if(mCompression != PF_UNKNOWN) {
+                        writeUInt32((uint32)SpacescapeBlockCompressor::getCompressedSize(mCompression, size, size));
+                    }
+                    else {
+                        writeUInt32((uint32)(size * PixelUtil::getNumElemBytes(mFormat)));
+                    }
+                    writeUInt32(0); // depth
+                    writeUInt32(numMipmaps ? numMipmaps + 1 : 0);
+                    for(int i = 0; i < 11; ++i) {
+                        writeUInt32(0);
+                    }
+
+                    // pixel format
+                    writeUInt32(32);
+                    if(mCompression != PF_UNKNOWN) {
+                        // BC6H and BC7 are only defined in the DX10 header
+                        writeUInt32(DDPF_FOURCC);
+                        if(mCompression == PF_DXT1) {
+                            mFile.write("DXT1", 4);
+                        }
+                        else if(mCompression == PF_DXT5) {
+                            mFile.write("DXT5", 4);
+                        }
+                        else {
+                            mFile.write("DX10", 4);
+                        }
+                        for(int i = 0; i < 5; ++i) {
+                            writeUInt32(0);
+                        }
+                    }
+                    else if(hdr) {
+                        writeUInt32(DDPF_FOURCC);
+                        writeUInt32(D3DFMT_A32B32G32R32F);
+                        for(int i = 0; i < 5; ++i) {
+                            writeUInt32(0);
+                        }
+                    }
+                    else {
+                        writeUInt32(DDPF_RGB);
+                        writeUInt32(0);
+                        writeUInt32(24);
+                        writeUInt32(0x00FF0000);
+                        writeUInt32(0x0000FF00);
+                        writeUInt32(0x000000FF);
+                        writeUInt32(0);
+                    }
+
+                    // caps
+                    writeUInt32(DDSCAPS_TEXTURE | 
+                        (numFaces == 6 || numMipmaps ? DDSCAPS_COMPLEX : 0) |
+                        (numMipmaps ? DDSCAPS_MIPMAP : 0));
+                    writeUInt32(numFaces == 6 ? DDSCAPS2_CUBEMAP_ALLFACES : 0);
+                    writeUInt32(0);
+                    writeUInt32(0);
+                    writeUInt32(0);
+
+                    if(mCompression == PF_BC6H_UF16 || mCompression == PF_BC7_UNORM) {
+                        writeUInt32(mCompression == PF_BC6H_UF16 ? DXGI_FORMAT_BC6H_UF16 : DXGI_FORMAT_BC7_UNORM);
+                        writeUInt32(D3D10_RESOURCE_DIMENSION_TEXTURE2D);
+                        writeUInt32(numFaces == 6 ? D3D10_RESOURCE_MISC_TEXTURECUBE : 0);
+                        writeUInt32(1); // array size
+                        writeUInt32(0);
+                    }
+                }
+                break;
+
+            case FT_HDR:
+                {
+                    mFormat = PF_FLOAT32_RGB;
+                    mScanline.resize(size * 4);
+
+                    String header = "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y " + 
+                        StringConverter::toString(size) + " +X " + StringConverter::toString(size) + "\n";
+                    mFile.write(header.c_str(), header.length());
+                }
+                break;
+
+            case FT_PFM:
+                {
+                    // negative scale means little endian
+                    mFormat = PF_FLOAT32_RGB;
+
+                    String header = "PF\n" + StringConverter::toString(size) + " " + 
+                        StringConverter::toString(size) + "\n-1.0\n";
+                    mFile.write(header.c_str(), header.length());
+                }
+                break;
+
+            case FT_TGA:
+                {
+                    mFormat = PF_BYTE_BGR;
+
+                    uchar header[18] = { 0 };
+                    header[2] = 2; // uncompressed true colour
+                    header[12] = size & 0xFF;
+                    header[13] = (size >> 8) & 0xFF;
+                    header[14] = size & 0xFF;
+                    header[15] = (size >> 8) & 0xFF;
+                    header[16] = 24;
+                    header[17] = 0x20; // top to bottom
+                    mFile.write((const char*)header, 18);
+                }
+                break;
+        }
+
+        return !mFile.fail();
+    }
+
+    /** Set the block compression for .dds files
+    @param format The compressed pixel format or PF_UNKNOWN to write 
+    uncompressed files
+    @param quality The compression quality
+    */
+    void SpacescapeStripWriter::setCompression(PixelFormat format, SpacescapeBlockCompressor::Quality quality)
+    {
+        mCompression = SpacescapeBlockCompressor::isSupported(format) ? format : PF_UNKNOWN;
+        mCompressionQuality = quality;
+    }
+
+    /** Utility function to write a Radiance RGBE scanline, run length
+    encoded when the width allows it
+    @param row The RGB float row
+    @remarks the run length encoding is the one from Greg Ward's rgbe.c
+    */
+    void SpacescapeStripWriter::writeRGBERow(const float* row)
+    {
+        // convert to rgbe, one channel after the other for the rle version
+        bool rle = mSize >= 8 && mSize < 0x8000;
+        for(unsigned int x = 0; x < mSize; ++x) {
+            const float* p = row + x * 3;
+            float v = std::max<float>(p[0], std::max<float>(p[1], p[2]));
+            uchar rgbe[4] = { 0, 0, 0, 0 };
+            if(v >= 1e-32f) {
+                int e;
+                float scale = frexpf(v, &e) * 256.0f / v;
+                rgbe[0] = (uchar)(std::max<float>(p[0], 0.0f) * scale);
+                rgbe[1] = (uchar)(std::max<float>(p[1], 0.0f) * scale);
+                rgbe[2] = (uchar)(std::max<float>(p[2], 0.0f) * scale);
+                rgbe[3] = (uchar)(e + 128);
+            }
+
+            for(int c = 0; c < 4; ++c) {
+                if(rle) {
+                    mScanline[c * mSize + x] = rgbe[c];
+                }
+                else {
+                    mScanline[x * 4 + c] = rgbe[c];
+                }
+            }
+        }
+
+        if(!rle) {
+            mFile.write((const char*)&mScanline[0], mSize * 4);
+            return;
+        }
+
+        uchar header[4] = { 2, 2, (uchar)(mSize >> 8), (uchar)(mSize & 0xFF) };
+        mFile.write((const char*)header, 4);
+
+        for(int c = 0; c < 4; ++c) {
+            const uchar* data = &mScanline[c * mSize];
+            unsigned int cur = 0;
+            while(cur < mSize) {
+                // find the next run of at least 4 equal values
+                unsigned int begRun = cur;
+                unsigned int runCount = 0;
+                unsigned int oldRunCount = 0;
+                while(runCount < 4 && begRun < mSize) {
+                    begRun += runCount;
+                    oldRunCount = runCount;
+                    runCount = 1;
+                    while(begRun + runCount < mSize && runCount < 127 && 
+                        data[begRun] == data[begRun + runCount]) {
+                        runCount++;
+                    }
+                }
+
+                // a short run right before the long run
+                if(oldRunCount > 1 && oldRunCount == begRun - cur) {
+                    uchar run[2] = { (uchar)(128 + oldRunCount), data[cur] };
+                    mFile.write((const char*)run, 2);
+                    cur = begRun;
+                }
+
+                // everything up to the run is written as is
+                while(cur < begRun) {
+                    uchar count = (uchar)std::min<unsigned int>(128, begRun - cur);
+                    mFile.write((const char*)&count, 1);
+                    mFile.write((const char*)(data + cur), count);
+                    cur += count;
+                }
+
+                if(runCount >= 4) {
+                    uchar run[2] = { (uchar)(128 + runCount), data[begRun] };
+                    mFile.write((const char*)run, 2);
+                    cur += runCount;
+                }
+            }
+        }
+    }
+
+    /** Write the next rows of the image
+    @param rows The rows to write - must be in getFormat() with no 
+    padding between rows
+    @return true on success
+    */
+    bool SpacescapeStripWriter::writeRows(const PixelBox& rows)
+    {
+        size_t numRows = rows.getHeight();
+        size_t rowsLeft = 0;
+        unsigned int levelSize = mFile.is_open() ? getCurrentLevelSize(rowsLeft) : 0;
+        if(!mFile.is_open() || rows.format != mFormat || rows.getWidth() != levelSize ||
+            !rows.isConsecutive() || numRows > rowsLeft ||
+            mRowsWritten + numRows > getRowsPerFace() * mNumFaces) {
+            Ogre::LogManager::getSingleton().getDefaultLog()->stream() << 
+                "SpacescapeStripWriter can't write the rows given";
+            return false;
+        }
+
+        const uchar* data = (const uchar*)rows.data;
+        size_t rowBytes = levelSize * PixelUtil::getNumElemBytes(mFormat);
+
+        if(mCompression != PF_UNKNOWN) {
+            // rows are compressed a row of blocks at a time so up to 3 rows
+            // wait for the rest of their blocks, unless the level ends
+            mPendingRows.insert(mPendingRows.end(), data, data + numRows * rowBytes);
+            mNumPendingRows += numRows;
+
+            size_t numCompressedRows = numRows == rowsLeft ? mNumPendingRows : mNumPendingRows / 4 * 4;
+            if(numCompressedRows) {
+                SpacescapeBlockCompressor compressor(mCompression, mCompressionQuality);
+                std::vector<uchar> blocks(SpacescapeBlockCompressor::getCompressedSize(
+                    mCompression, levelSize, (unsigned int)numCompressedRows));
+                compressor.compress(PixelBox(levelSize, (uint32)numCompressedRows, 1, mFormat, &mPendingRows[0]), &blocks[0]);
+                mFile.write((const char*)&blocks[0], blocks.size());
+
+                mPendingRows.erase(mPendingRows.begin(), mPendingRows.begin() + numCompressedRows * rowBytes);
+                mNumPendingRows -= numCompressedRows;
+            }
+        }
+        else if(mFileType == FT_HDR) {
+            for(size_t y = 0; y < numRows; ++y) {
+                writeRGBERow((const float*)(data + y * rowBytes));
+            }
+        }
+        else if(mFileType == FT_PFM) {
+            // pfm rows go from bottom to top so each row is written in place
+            std::streamoff start = (std::streamoff)mFile.tellp() - (std::streamoff)(mRowsWritten * rowBytes);
+            for(size_t y = 0; y < numRows; ++y) {
+                size_t row = mSize - 1 - (mRowsWritten + y);
+                mFile.seekp(start + (std::streamoff)(row * rowBytes));
+                mFile.write((const char*)(data + y * rowBytes), rowBytes);
+            }
+            mFile.seekp(start + (std::streamoff)((mRowsWritten + numRows) * rowBytes));
+        }
+        else {
+            mFile.write((const char*)data, numRows * rowBytes);
+        }
+
+        mRowsWritten += numRows;
+
+        return !mFile.fail();
+    }
+
+    /** Utility function to write a little endian 32 bit value
+    @param value The value to write
+    */
+    void SpacescapeStripWriter::writeUInt32(uint32 value)
+    {
+        uchar bytes[4] = { 
+            (uchar)(value & 0xFF), 
+            (uchar)((value >> 8) & 0xFF),
+            (uchar)((value >> 16) & 0xFF),
+            (uchar)((value >> 24) & 0xFF)
+        };
+        mFile.write((const char*)bytes, 4);
+    }
+}
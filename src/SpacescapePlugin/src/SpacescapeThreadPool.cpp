@@ -0,0 +1,317 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include "SpacescapeThreadPool.h"
+#include <exception>
+#include <memory>
+
+namespace Ogre
+{
+    // the shared thread pool
+    static SpacescapeThreadPool* sSharedThreadPool = 0;
+
+    // guards creation/destruction of the shared thread pool
+    static std::mutex sSharedThreadPoolMutex;
+
+    /** Constructor
+    @param numThreads The number of worker threads to create, use 0
+    to create one worker per hardware thread
+    */
+    SpacescapeThreadPool::SpacescapeThreadPool(unsigned int numThreads) :
+        mNextQueue(0),
+        mNumQueuedTasks(0),
+        mShutdown(false)
+    {
+        if(numThreads == 0) {
+            numThreads = std::thread::hardware_concurrency();
+
+            // hardware_concurrency is allowed to return 0 if unknown
+            if(numThreads == 0) {
+                numThreads = 2;
+            }
+        }
+
+        for(unsigned int i = 0; i < numThreads; ++i) {
+            mQueues.push_back(new WorkQueue());
+        }
+
+        for(unsigned int i = 0; i < numThreads; ++i) {
+            mThreads.push_back(std::thread(&SpacescapeThreadPool::workerThread, this, i));
+        }
+    }
+
+    /** Destructor
+    @remarks waits for all queued tasks to finish
+    */
+    SpacescapeThreadPool::~SpacescapeThreadPool(void)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mWakeMutex);
+            mShutdown = true;
+        }
+        mWakeCondition.notify_all();
+
+        for(size_t i = 0; i < mThreads.size(); ++i) {
+            mThreads[i].join();
+        }
+
+        for(size_t i = 0; i < mQueues.size(); ++i) {
+            delete mQueues[i];
+        }
+    }
+
+    /** Destroy the shared thread pool if it was created
+    @remarks called when the plugin is uninstalled so the worker threads
+    are joined before the library is unloaded
+    */
+    void SpacescapeThreadPool::destroySingleton(void)
+    {
+        std::lock_guard<std::mutex> lock(sSharedThreadPoolMutex);
+        delete sSharedThreadPool;
+        sSharedThreadPool = 0;
+    }
+
+    /** Get the shared thread pool (created on first use)
+    @return the shared thread pool
+    */
+    SpacescapeThreadPool& SpacescapeThreadPool::getSingleton(void)
+    {
+        std::lock_guard<std::mutex> lock(sSharedThreadPoolMutex);
+        if(!sSharedThreadPool) {
+            sSharedThreadPool = new SpacescapeThreadPool();
+        }
+        return *sSharedThreadPool;
+    }
+
+    /** Run a function for every index in the range 0..count-1 and wait
+    for all of them to complete
+    @remarks The calling thread helps out with the work so it is safe to
+    call this from inside another task.  If any of the calls throw, the
+    first exception is rethrown here once all the calls are done.
+    @param count The number of indices
+    @param func The function to call for every index
+    */
+    void SpacescapeThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& func)
+    {
+        if(count == 0) {
+            return;
+        }
+
+        // nothing to gain from queueing a single call
+        if(count == 1 || mThreads.empty()) {
+            for(size_t i = 0; i < count; ++i) {
+                func(i);
+            }
+            return;
+        }
+
+        TaskGroup group(*this);
+
+        const std::function<void(size_t)>* f = &func;
+        for(size_t i = 0; i < count; ++i) {
+            group.add([f, i]() { (*f)(i); });
+        }
+        wakeWorkers();
+
+        group.wait();
+    }
+
+    /** Utility function to get a task to run, first from the given
+    queue then by stealing from the other queues
+    @param index The index of the queue to check first
+    @param task Return param
+    @return true if a task was found
+    */
+    bool SpacescapeThreadPool::popTask(unsigned int index, Task& task)
+    {
+        if(mNumQueuedTasks == 0) {
+            return false;
+        }
+
+        // our own queue - oldest task first
+        {
+            WorkQueue* q = mQueues[index];
+            std::lock_guard<std::mutex> lock(q->mutex);
+            if(!q->tasks.empty()) {
+                task = q->tasks.front();
+                q->tasks.pop_front();
+                --mNumQueuedTasks;
+                return true;
+            }
+        }
+
+        // steal from the back of the other queues
+        unsigned int numQueues = (unsigned int)mQueues.size();
+        for(unsigned int i = 1; i < numQueues; ++i) {
+            WorkQueue* q = mQueues[(index + i) % numQueues];
+            std::lock_guard<std::mutex> lock(q->mutex);
+            if(!q->tasks.empty()) {
+                task = q->tasks.back();
+                q->tasks.pop_back();
+                --mNumQueuedTasks;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /** Utility function to add a task to the next queue
+    @param task The task to add
+    */
+    void SpacescapeThreadPool::pushTask(const Task& task)
+    {
+        WorkQueue* q = mQueues[mNextQueue++ % (unsigned int)mQueues.size()];
+        {
+            std::lock_guard<std::mutex> lock(q->mutex);
+            q->tasks.push_back(task);
+            ++mNumQueuedTasks;
+        }
+    }
+
+    /** Utility function to wake up the idle workers after tasks were added
+    */
+    void SpacescapeThreadPool::wakeWorkers(void)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mWakeMutex);
+        }
+        mWakeCondition.notify_all();
+    }
+
+    /** Worker thread main loop
+    @param index The index of this worker's queue
+    */
+    void SpacescapeThreadPool::workerThread(unsigned int index)
+    {
+        while(true) {
+            Task task;
+            if(popTask(index, task)) {
+                task();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mWakeMutex);
+            mWakeCondition.wait(lock, [this]() { return mShutdown || mNumQueuedTasks > 0; });
+            if(mShutdown && mNumQueuedTasks == 0) {
+                return;
+            }
+        }
+    }
+
+    /** Constructor
+    @param pool The thread pool to run the tasks on
+    */
+    SpacescapeThreadPool::TaskGroup::TaskGroup(SpacescapeThreadPool& pool) :
+        mPool(pool),
+        mState(std::make_shared<State>())
+    {
+        mState->remaining = 0;
+    }
+
+    /** Destructor
+    @remarks waits for any tasks still running, exceptions they 
+    throw are dropped
+    */
+    SpacescapeThreadPool::TaskGroup::~TaskGroup(void)
+    {
+        try {
+            wait();
+        }
+        catch(...) {
+        }
+    }
+
+    /** Utility function to queue a task without waking the workers
+    @param task The task to run
+    */
+    void SpacescapeThreadPool::TaskGroup::add(const Task& task)
+    {
+        std::shared_ptr<State> state = mState;
+        ++state->remaining;
+
+        mPool.pushTask([state, task]() {
+            try {
+                task();
+            }
+            catch(...) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if(!state->error) {
+                    state->error = std::current_exception();
+                }
+            }
+
+            if(--state->remaining == 0) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->done.notify_all();
+            }
+        });
+    }
+
+    /** Queue a task
+    @param task The task to run
+    */
+    void SpacescapeThreadPool::TaskGroup::run(const Task& task)
+    {
+        add(task);
+        mPool.wakeWorkers();
+    }
+
+    /** Wait for all the queued tasks to complete
+    @remarks The calling thread helps out with the work.  If any of 
+    the tasks throw, the first exception is rethrown here once all 
+    the tasks are done.
+    */
+    void SpacescapeThreadPool::TaskGroup::wait(void)
+    {
+        // help out until every task in this group is done
+        unsigned int queueIndex = mPool.mNextQueue % (unsigned int)mPool.mQueues.size();
+        while(mState->remaining > 0) {
+            Task task;
+            if(mPool.popTask(queueIndex, task)) {
+                task();
+            }
+            else {
+                // the remaining tasks are running on other threads
+                std::unique_lock<std::mutex> lock(mState->mutex);
+                mState->done.wait(lock, [this]() { return mState->remaining == 0; });
+            }
+        }
+
+        std::exception_ptr error;
+        {
+            std::lock_guard<std::mutex> lock(mState->mutex);
+            std::swap(error, mState->error);
+        }
+
+        if(error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
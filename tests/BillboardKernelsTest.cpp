@@ -0,0 +1,190 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include "SpacescapeBillboardKernels.h"
+#include "SpacescapeNoiseKernels.h"
+#include "SpacescapeRandom.h"
+#include "OgreMath.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace Ogre;
+
+/** Builds the quad of an accurate facing point billboard the way
+SpacescapeBillboardSet::genBillboardAxes, genVertOffsets and genVertices
+do it with Ogre's vector maths
+@param params The camera and origin settings
+@param position The billboard position
+@param width The billboard width
+@param height The billboard height
+@param corners The 4 corner positions
+*/
+static void genReferenceQuad(const SpacescapeBillboardKernels::FacingParams& params, const Vector3& position, 
+    Real width, Real height, Vector3* corners)
+{
+    // genBillboardAxes
+    Vector3 camDir = position - params.camPos;
+    camDir.normalise();
+
+    Vector3 y = params.camUp;
+    if(params.fixedUp && Math::Abs(camDir.dotProduct(y)) > 0.99f) {
+        y = Vector3::UNIT_Z;
+    }
+
+    Vector3 x = camDir.crossProduct(y);
+    x.normalise();
+    y = x.crossProduct(camDir);
+
+    // genVertOffsets
+    Vector3 leftOff = x * (params.left * width);
+    Vector3 rightOff = x * (params.right * width);
+    Vector3 topOff = y * (params.top * height);
+    Vector3 bottomOff = y * (params.bottom * height);
+
+    // genVertices
+    corners[0] = (leftOff + topOff) + position;
+    corners[1] = (rightOff + topOff) + position;
+    corners[2] = (leftOff + bottomOff) + position;
+    corners[3] = (rightOff + bottomOff) + position;
+}
+
+/** Checks the billboard kernels build the same quads as the per 
+billboard Ogre path on every instruction set this CPU supports, with and
+without the static geometry fixed up vector.
+*/
+int main(int argc, char** argv)
+{
+    SpacescapeRandom random(1234);
+
+    // billboards on a sphere around the origin like a star layer,
+    // every 97th one straight above or below the camera
+    const size_t numBillboards = 4096 + 7;
+    std::vector<float> x(numBillboards), y(numBillboards), z(numBillboards);
+    std::vector<float> width(numBillboards), height(numBillboards);
+    for(size_t i = 0; i < numBillboards; i++) {
+        Vector3 position(random.nextUnit() - 0.5f, random.nextUnit() - 0.5f, random.nextUnit() - 0.5f);
+        if(i % 97 == 0) {
+            position = Vector3(0.0f, i % 2 ? 1.0f : -1.0f, 0.001f * (random.nextUnit() - 0.5f));
+        }
+        position.normalise();
+        position = position * 1000.0f;
+
+        x[i] = position.x;
+        y[i] = position.y;
+        z[i] = position.z;
+        width[i] = random.nextUnit() * 10.0f + 1.0f;
+        height[i] = i % 3 ? width[i] : random.nextUnit() * 10.0f + 1.0f;
+    }
+
+    SpacescapeBillboardKernels::FacingParams params;
+    params.camPos = Vector3(1.0f, 2.0f, 3.0f);
+    params.camUp = Vector3(0.0f, 1.0f, 0.0f);
+    params.left = -0.5f;
+    params.right = 0.5f;
+    params.top = 0.5f;
+    params.bottom = -0.5f;
+
+    const SpacescapeNoiseKernels::InstructionSet sets[] = {
+        SpacescapeNoiseKernels::SIS_SCALAR,
+        SpacescapeNoiseKernels::SIS_SSE41,
+        SpacescapeNoiseKernels::SIS_AVX2,
+        SpacescapeNoiseKernels::SIS_AVX512,
+        SpacescapeNoiseKernels::SIS_NEON
+    };
+
+    int failures = 0;
+    std::vector<float> reference(12 * numBillboards), corners(12 * numBillboards);
+
+    for(int fixedUp = 0; fixedUp < 2; fixedUp++) {
+        params.fixedUp = fixedUp != 0;
+
+        // the fixed up vector only kicks in when the camera up lines up
+        // with the billboard, which static geometry gets from the origin
+        if(params.fixedUp) {
+            params.camPos = Vector3::ZERO;
+        }
+
+        for(size_t s = 0; s < sizeof(sets) / sizeof(sets[0]); s++) {
+            const char* name = SpacescapeNoiseKernels::getInstructionSetName(sets[s]);
+
+            SpacescapeNoiseKernels::setInstructionSet(sets[s]);
+            if(SpacescapeNoiseKernels::getInstructionSet() != sets[s]) {
+                printf("%-8s not supported, skipped\n", name);
+                continue;
+            }
+
+            // every offset and tail length a 4 or 8 wide kernel can see
+            for(size_t start = 0; start < 8; start++) {
+                size_t count = numBillboards - start;
+
+                for(size_t i = 0; i < count; i++) {
+                    Vector3 quad[4];
+                    genReferenceQuad(params, Vector3(x[start + i], y[start + i], z[start + i]), 
+                        width[start + i], height[start + i], quad);
+                    for(size_t c = 0; c < 4; c++) {
+                        for(size_t a = 0; a < 3; a++) {
+                            reference[(c * 3 + a) * count + i] = quad[c][a];
+                        }
+                    }
+                }
+
+                memset(&corners[0], 0, corners.size() * sizeof(float));
+                SpacescapeBillboardKernels::genFacingQuads(params, &x[start], &y[start], &z[start],
+                    &width[start], &height[start], &corners[0], count);
+
+                size_t mismatches = 0;
+                for(size_t i = 0; i < 12 * count; i++) {
+                    if(memcmp(&corners[i], &reference[i], sizeof(float)) != 0) {
+                        if(mismatches == 0) {
+                            size_t index = start + i % count;
+                            printf("%-8s billboard %u (%g, %g, %g) corner %u axis %u: %.9g != %.9g\n", name,
+                                (unsigned int)index, x[index], y[index], z[index], 
+                                (unsigned int)(i / count / 3), (unsigned int)(i / count % 3), 
+                                corners[i], reference[i]);
+                        }
+                        mismatches++;
+                    }
+                }
+
+                if(mismatches) {
+                    printf("%-8s offset %u fixed up %d: %u of %u values differ from genBillboardAxes\n", name,
+                        (unsigned int)start, fixedUp, (unsigned int)mismatches, (unsigned int)(12 * count));
+                    failures++;
+                }
+            }
+
+            printf("%-8s checked%s\n", name, params.fixedUp ? " with fixed up" : "");
+        }
+    }
+
+    SpacescapeNoiseKernels::setInstructionSet(SpacescapeNoiseKernels::getBestInstructionSet());
+
+    return failures ? 1 : 0;
+}
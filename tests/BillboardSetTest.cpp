@@ -0,0 +1,251 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include "SpacescapeBillboardSet.h"
+#include "SpacescapeRandom.h"
+#include "OgreCamera.h"
+#include "OgreHardwareBufferManager.h"
+#include "OgreLogManager.h"
+#include "OgreMath.h"
+#include "OgreRenderOperation.h"
+#include "OgreRenderQueue.h"
+#include "OgreRoot.h"
+#include "OgreSceneManager.h"
+#include "OgreSceneNode.h"
+#include <cstdio>
+#include <vector>
+
+using namespace Ogre;
+
+// ctest reports tests that return this as skipped, see CMakeLists.txt
+static const int SKIPPED = 77;
+
+/** Updates a billboard set the way drawing a frame does and reads back
+one element of every vertex in the buffer holding it
+@param set The billboard set, attached to a scene node
+@param camera The camera to draw with
+@param semantic The semantic of the element to read
+@param index The index of the element to read
+@param values Set to the floats of the element of every vertex
+*/
+static void readVertices(SpacescapeBillboardSet& set, Camera* camera, 
+    VertexElementSemantic semantic, unsigned short index, std::vector<float>& values)
+{
+    RenderQueue queue;
+    set._notifyCurrentCamera(camera);
+    set._updateRenderQueue(&queue);
+
+    RenderOperation op;
+    set.getRenderOperation(op);
+    const VertexElement* element = op.vertexData->vertexDeclaration->findElementBySemantic(semantic, index);
+    HardwareVertexBufferSharedPtr buffer = op.vertexData->vertexBufferBinding->getBuffer(element->getSource());
+
+    std::vector<uchar> data(buffer->getSizeInBytes());
+    buffer->readData(0, data.size(), &data[0]);
+
+    size_t numFloats = element->getSize() / sizeof(float);
+    values.clear();
+    for(size_t i = 0; i < buffer->getNumVertices(); ++i) {
+        const float* v = (const float*)(&data[i * buffer->getVertexSize() + element->getOffset()]);
+        values.insert(values.end(), v, v + numFloats);
+    }
+}
+
+/** Utility function to get a vertex position read by readVertices
+@param values The positions
+@param vertex The vertex index
+@return the position
+*/
+static Vector3 getPosition(const std::vector<float>& values, size_t vertex)
+{
+    return Vector3(values[vertex * 3], values[vertex * 3 + 1], values[vertex * 3 + 2]);
+}
+
+/** Checks the quads of a static billboard set are built again at the new
+size when its default dimensions change
+@param sceneMgr The scene manager to attach the set to
+@param camera The camera to draw with
+@return the number of failures
+*/
+static int checkStaticDimensions(SceneManager* sceneMgr, Camera* camera)
+{
+    const unsigned int numBillboards = 64;
+
+    SpacescapeBillboardSet set("BillboardSetTestStatic", numBillboards);
+    set.setUseAccurateFacing(true);
+    set.setStaticGeometry(true);
+    set.setDefaultDimensions(1.0, 1.0);
+
+    SpacescapeRandom random(1234);
+    for(unsigned int i = 0; i < numBillboards; ++i) {
+        Vector3 position(random.nextUnit() - 0.5, random.nextUnit() - 0.5, random.nextUnit() - 0.5);
+        set.createBillboard(position.normalisedCopy() * 100.0, ColourValue::White);
+    }
+    sceneMgr->getRootSceneNode()->attachObject(&set);
+
+    std::vector<float> before, after;
+    readVertices(set, camera, VES_POSITION, 0, before);
+    set.setDefaultDimensions(2.0, 2.0);
+    readVertices(set, camera, VES_POSITION, 0, after);
+
+    sceneMgr->getRootSceneNode()->detachObject(&set);
+
+    // each quad keeps its centre and facing so the corners move twice as
+    // far out
+    int failures = 0;
+    for(size_t q = 0; q < numBillboards; ++q) {
+        Vector3 centre = Vector3::ZERO;
+        for(int c = 0; c < 4; ++c) {
+            centre += getPosition(before, q * 4 + c) * 0.25;
+        }
+
+        for(int c = 0; c < 4; ++c) {
+            Real oldDistance = (getPosition(before, q * 4 + c) - centre).length();
+            Real newDistance = (getPosition(after, q * 4 + c) - centre).length();
+            if(Math::Abs(newDistance - oldDistance * 2.0) > 1e-3) {
+                if(failures == 0) {
+                    printf("static quad %u corner %d: %g from the centre at 1x1, %g at 2x2\n",
+                        (unsigned int)q, c, oldDistance, newDistance);
+                }
+                failures++;
+            }
+        }
+    }
+
+    printf("%-8s checked\n", "static");
+    return failures;
+}
+
+/** Checks the per instance buffer of an instanced billboard set is 
+written again with the new size when its default dimensions change
+@param sceneMgr The scene manager to attach the set to
+@param camera The camera to draw with
+@return the number of failures
+*/
+static int checkInstancedDimensions(SceneManager* sceneMgr, Camera* camera)
+{
+    if(!SpacescapeBillboardSet::isInstancingSupported()) {
+        printf("%-8s skipped, the render system has no instance data\n", "instanced");
+        return 0;
+    }
+
+    const unsigned int numBillboards = 64;
+
+    SpacescapeBillboardSet set("BillboardSetTestInstanced", numBillboards);
+    set.setUseAccurateFacing(true);
+    set.setStaticGeometry(true);
+    set.setInstancingEnabled(true);
+    set.setDefaultDimensions(1.0, 1.0);
+
+    SpacescapeRandom random(1234);
+    for(unsigned int i = 0; i < numBillboards; ++i) {
+        Vector3 position(random.nextUnit() - 0.5, random.nextUnit() - 0.5, random.nextUnit() - 0.5);
+        set.createBillboard(position.normalisedCopy() * 100.0, ColourValue::White);
+    }
+    sceneMgr->getRootSceneNode()->attachObject(&set);
+
+    // uv1 holds the width and height of each instance
+    std::vector<float> sizes;
+    readVertices(set, camera, VES_TEXTURE_COORDINATES, 1, sizes);
+    set.setDefaultDimensions(2.0, 3.0);
+    readVertices(set, camera, VES_TEXTURE_COORDINATES, 1, sizes);
+
+    sceneMgr->getRootSceneNode()->detachObject(&set);
+
+    int failures = 0;
+    for(size_t i = 0; i < numBillboards; ++i) {
+        if(sizes[i * 2] != 2.0f || sizes[i * 2 + 1] != 3.0f) {
+            if(failures == 0) {
+                printf("instance %u is %gx%g instead of 2x3\n", (unsigned int)i, sizes[i * 2], sizes[i * 2 + 1]);
+            }
+            failures++;
+        }
+    }
+
+    printf("%-8s checked\n", "instanced");
+    return failures;
+}
+
+/** Checks the vertices billboard sets write to their buffers follow the 
+set wide settings changed after they were first drawn.  This needs a 
+render system for the vertex buffers, the test is skipped when there is
+none (pass a plugins file as the first argument, or run it where 
+plugins.cfg is).
+*/
+int main(int argc, char** argv)
+{
+    String pluginsFile = argc > 1 ? argv[1] : "plugins.cfg";
+
+    // keep the Ogre log out of the console
+    LogManager* logManager = OGRE_NEW LogManager();
+    logManager->createLog("BillboardSetTest.log", true, false, false);
+
+    Root* root = OGRE_NEW Root(pluginsFile, "", "");
+
+    RenderSystem* renderSystem = root->getRenderSystemByName("OpenGL Rendering Subsystem");
+    if(!renderSystem && !root->getAvailableRenderers().empty()) {
+        renderSystem = root->getAvailableRenderers().front();
+    }
+
+    // the render system needs a context, i.e. a display or xvfb
+    bool initialised = false;
+    if(renderSystem) {
+        try {
+            root->setRenderSystem(renderSystem);
+            root->initialise(false);
+
+            NameValuePairList windowParams;
+            windowParams["hidden"] = "true";
+            root->createRenderWindow("BillboardSetTest", 1, 1, false, &windowParams);
+            initialised = true;
+        }
+        catch(Exception& e) {
+            printf("%s\n", e.getDescription().c_str());
+        }
+    }
+
+    if(!initialised) {
+        printf("skipped, no render system found in %s\n", pluginsFile.c_str());
+        OGRE_DELETE root;
+        OGRE_DELETE logManager;
+        return SKIPPED;
+    }
+
+    SceneManager* sceneMgr = root->createSceneManager();
+    Camera* camera = sceneMgr->createCamera("BillboardSetTest");
+
+    int failures = 0;
+    failures += checkStaticDimensions(sceneMgr, camera);
+    failures += checkInstancedDimensions(sceneMgr, camera);
+
+    OGRE_DELETE root;
+    OGRE_DELETE logManager;
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,330 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include "SpacescapeBlockCompressor.h"
+#include "SpacescapeRandom.h"
+#include "OgreBitwise.h"
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace Ogre;
+
+// BC7 and BC6H interpolation weights for 4 bit indices
+static const int WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+/** Utility class to read the little endian bit fields of a block
+*/
+class BitReader
+{
+public:
+    BitReader(const uchar* data) : mData(data), mPos(0) {}
+
+    unsigned int read(unsigned int numBits)
+    {
+        unsigned int value = 0;
+        for(unsigned int i = 0; i < numBits; i++, mPos++) {
+            value |= ((mData[mPos >> 3] >> (mPos & 7)) & 1) << i;
+        }
+        return value;
+    }
+
+private:
+    const uchar* mData;
+    unsigned int mPos;
+};
+
+/** Utility function to decode a BC1 colour block
+@param block The 8 byte block
+@param pixels Return param - the 16 RGBA pixels in the 0 - 255 range,
+alpha is left alone
+@param fourColours Always use the 4 colour palette like BC3 does
+*/
+static void decodeBC1(const uchar* block, float* pixels, bool fourColours)
+{
+    BitReader reader(block);
+    unsigned int endPoints[2] = { reader.read(16), reader.read(16) };
+
+    int palette[4][3];
+    for(int i = 0; i < 2; i++) {
+        int r = (endPoints[i] >> 11) & 31, g = (endPoints[i] >> 5) & 63, b = endPoints[i] & 31;
+        palette[i][0] = (r << 3) | (r >> 2);
+        palette[i][1] = (g << 2) | (g >> 4);
+        palette[i][2] = (b << 3) | (b >> 2);
+    }
+
+    for(int c = 0; c < 3; c++) {
+        if(fourColours || endPoints[0] > endPoints[1]) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        else {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+    }
+
+    for(int i = 0; i < 16; i++) {
+        unsigned int index = reader.read(2);
+        for(int c = 0; c < 3; c++) {
+            pixels[i * 4 + c] = (float)palette[index][c];
+        }
+    }
+}
+
+/** Utility function to decode a BC3 alpha block
+@param block The 8 byte block
+@param pixels Return param - the 16 RGBA pixels, only alpha is written
+*/
+static void decodeBC3Alpha(const uchar* block, float* pixels)
+{
+    BitReader reader(block);
+    int palette[8];
+    palette[0] = reader.read(8);
+    palette[1] = reader.read(8);
+
+    if(palette[0] > palette[1]) {
+        for(int i = 2; i < 8; i++) {
+            palette[i] = ((8 - i) * palette[0] + (i - 1) * palette[1]) / 7;
+        }
+    }
+    else {
+        for(int i = 2; i < 6; i++) {
+            palette[i] = ((6 - i) * palette[0] + (i - 1) * palette[1]) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    for(int i = 0; i < 16; i++) {
+        pixels[i * 4 + 3] = (float)palette[reader.read(3)];
+    }
+}
+
+/** Utility function to decode a BC7 mode 6 block
+@param block The 16 byte block
+@param pixels Return param - the 16 RGBA pixels in the 0 - 255 range
+@return false if the block isn't mode 6
+*/
+static bool decodeBC7(const uchar* block, float* pixels)
+{
+    BitReader reader(block);
+    if(reader.read(7) != 0x40) {
+        return false;
+    }
+
+    int endPoints[2][4];
+    for(int c = 0; c < 4; c++) {
+        endPoints[0][c] = reader.read(7) << 1;
+        endPoints[1][c] = reader.read(7) << 1;
+    }
+
+    // shared p bits
+    unsigned int p0 = reader.read(1), p1 = reader.read(1);
+    for(int c = 0; c < 4; c++) {
+        endPoints[0][c] |= p0;
+        endPoints[1][c] |= p1;
+    }
+
+    for(int i = 0; i < 16; i++) {
+        // the first index drops its top bit
+        unsigned int index = reader.read(i ? 4 : 3);
+        for(int c = 0; c < 4; c++) {
+            pixels[i * 4 + c] = (float)(((64 - WEIGHTS4[index]) * endPoints[0][c] + WEIGHTS4[index] * endPoints[1][c] + 32) >> 6);
+        }
+    }
+
+    return true;
+}
+
+/** Utility function to decode a BC6H mode 11 block
+@param block The 16 byte block
+@param pixels Return param - the 16 RGBA pixels, alpha is 1
+@return false if the block isn't mode 11
+*/
+static bool decodeBC6H(const uchar* block, float* pixels)
+{
+    BitReader reader(block);
+    if(reader.read(5) != 3) {
+        return false;
+    }
+
+    int endPoints[2][3];
+    for(int i = 0; i < 2; i++) {
+        for(int c = 0; c < 3; c++) {
+            // unquantize the 10 bit unsigned end points
+            int q = reader.read(10);
+            endPoints[i][c] = q == 0 ? 0 : (q == 1023 ? 0xFFFF : ((q << 16) + 0x8000) >> 10);
+        }
+    }
+
+    for(int i = 0; i < 16; i++) {
+        unsigned int index = reader.read(i ? 4 : 3);
+        for(int c = 0; c < 3; c++) {
+            int value = ((64 - WEIGHTS4[index]) * endPoints[0][c] + WEIGHTS4[index] * endPoints[1][c] + 32) >> 6;
+            pixels[i * 4 + c] = Bitwise::halfToFloat((uint16)((value * 31) >> 6));
+        }
+        pixels[i * 4 + 3] = 1.0f;
+    }
+
+    return true;
+}
+
+/** Compresses a smooth image with every supported block format and 
+quality, decodes it again and checks the error stays within what the 
+format should manage.  Images that aren't a multiple of 4 pixels are
+used so the padded edge blocks are covered too.
+*/
+int main(int argc, char** argv)
+{
+    const unsigned int width = 67, height = 37;
+
+    // a colour ramp over smooth noise like a nebula layer, with a
+    // little per channel noise
+    SpacescapeRandom random(1234);
+    std::vector<float> image(width * height * 4);
+    for(unsigned int y = 0; y < height; y++) {
+        for(unsigned int x = 0; x < width; x++) {
+            float intensity = 0.5f + 0.4f * std::sin(x * 0.1f) * std::cos(y * 0.13f);
+            float* p = &image[(y * width + x) * 4];
+            p[0] = 0.9f * intensity + 0.004f * (random.nextUnit() - 0.5f);
+            p[1] = 0.6f * intensity + 0.1f + 0.004f * (random.nextUnit() - 0.5f);
+            p[2] = 0.5f * intensity + 0.3f + 0.004f * (random.nextUnit() - 0.5f);
+            p[3] = intensity;
+        }
+    }
+
+    struct TestCase
+    {
+        const char* name;
+        PixelFormat format;
+
+        // the lowest PSNR in dB for LDR formats or the highest RMS
+        // error in stops for BC6H
+        double limit;
+    };
+
+    const TestCase cases[] = {
+        { "BC1", PF_DXT1, 38.0 },
+        { "BC3", PF_DXT5, 38.0 },
+        { "BC6H", PF_BC6H_UF16, 0.02 },
+        { "BC7", PF_BC7_UNORM, 48.0 }
+    };
+
+    const char* qualityNames[] = { "fast", "normal", "high" };
+
+    int failures = 0;
+    for(size_t t = 0; t < sizeof(cases) / sizeof(cases[0]); t++) {
+        const TestCase& test = cases[t];
+        bool hdr = test.format == PF_BC6H_UF16;
+        int numChannels = test.format == PF_DXT1 || hdr ? 3 : 4;
+
+        // BC6H gets colours well above 1
+        std::vector<float> src(image);
+        if(hdr) {
+            for(size_t i = 0; i < src.size(); i++) {
+                src[i] *= 40.0f;
+            }
+        }
+
+        for(int q = SpacescapeBlockCompressor::BCQ_FAST; q <= SpacescapeBlockCompressor::BCQ_HIGH; q++) {
+            SpacescapeBlockCompressor compressor(test.format, (SpacescapeBlockCompressor::Quality)q);
+            std::vector<uchar> blocks(SpacescapeBlockCompressor::getCompressedSize(test.format, width, height));
+            compressor.compress(PixelBox(width, height, 1, PF_FLOAT32_RGBA, &src[0]), &blocks[0]);
+
+            size_t blockSize = SpacescapeBlockCompressor::getBlockSize(test.format);
+            unsigned int blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+            double squaredError = 0.0;
+            size_t numValues = 0, badBlocks = 0;
+
+            for(unsigned int by = 0; by < blocksHigh; by++) {
+                for(unsigned int bx = 0; bx < blocksWide; bx++) {
+                    const uchar* block = &blocks[(by * blocksWide + bx) * blockSize];
+                    float pixels[16 * 4];
+                    bool valid = true;
+                    switch(test.format) {
+                        case PF_DXT1:
+                            decodeBC1(block, pixels, false);
+                            break;
+                        case PF_DXT5:
+                            decodeBC3Alpha(block, pixels);
+                            decodeBC1(block + 8, pixels, true);
+                            break;
+                        case PF_BC7_UNORM:
+                            valid = decodeBC7(block, pixels);
+                            break;
+                        default:
+                            valid = decodeBC6H(block, pixels);
+                            break;
+                    }
+
+                    if(!valid) {
+                        badBlocks++;
+                        continue;
+                    }
+
+                    for(unsigned int y = 0; y < 4; y++) {
+                        for(unsigned int x = 0; x < 4; x++) {
+                            unsigned int px = bx * 4 + x, py = by * 4 + y;
+                            if(px >= width || py >= height) {
+                                continue;
+                            }
+
+                            const float* expected = &src[(py * width + px) * 4];
+                            const float* decoded = &pixels[(y * 4 + x) * 4];
+                            for(int c = 0; c < numChannels; c++) {
+                                // HDR error is measured in stops
+                                double error = hdr ? 
+                                    std::log((decoded[c] + 1e-3) / (expected[c] + 1e-3)) / std::log(2.0) :
+                                    decoded[c] - std::min(1.0f, std::max(0.0f, expected[c])) * 255.0f;
+                                squaredError += error * error;
+                                numValues++;
+                            }
+                        }
+                    }
+                }
+            }
+
+            double meanSquaredError = squaredError / std::max<size_t>(numValues, 1);
+            double score = hdr ? std::sqrt(meanSquaredError) : 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+            bool passed = badBlocks == 0 && (hdr ? score <= test.limit : score >= test.limit);
+
+            printf("%-8s %-6s %s %.4f%s\n", test.name, qualityNames[q], hdr ? "rms stops" : "psnr", score, 
+                passed ? "" : " FAILED");
+            if(badBlocks) {
+                printf("%-8s %-6s %u blocks in an unexpected mode\n", test.name, qualityNames[q], (unsigned int)badBlocks);
+            }
+            if(!passed) {
+                failures++;
+            }
+        }
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,88 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include "SpacescapePlugin.h"
+#include "SpacescapeSoftwareRenderer.h"
+#include "OgreQuaternion.h"
+#include <cstdio>
+
+using namespace Ogre;
+
+/** Checks the CPU renderers see every cube face the same way the
+camera SpacescapePlugin::_rtt renders it with does, in both orientations.
+*/
+int main(int argc, char** argv)
+{
+    const SpacescapePlugin::SpacescapeRTTOrientation orientations[] = {
+        SpacescapePlugin::SRO_DEFAULT_ORIENTATION,
+        SpacescapePlugin::SRO_UNREAL_ORIENTATION
+    };
+    const char* orientationNames[] = { "default", "unreal" };
+    const Real positions[] = { -1.0, -0.75, -0.25, 0.0, 0.5, 1.0 };
+    const unsigned int numPositions = sizeof(positions) / sizeof(positions[0]);
+
+    int failures = 0;
+    for(int o = 0; o < 2; o++) {
+        for(unsigned int face = 0; face < 6; face++) {
+            Quaternion camera = SpacescapePlugin::_getRTTFaceOrientation(face, orientations[o]);
+
+            unsigned int mismatches = 0;
+            for(unsigned int i = 0; i < numPositions; i++) {
+                for(unsigned int j = 0; j < numPositions; j++) {
+                    Real u = positions[i];
+                    Real v = positions[j];
+
+                    // the camera looks down its -z axis with +y up and a 
+                    // 90 degree fov, and v runs from the top of the face down
+                    Vector3 expected = camera * Vector3(u, -v, -1.0);
+                    Vector3 actual = SpacescapeSoftwareRenderer::getFaceDirection(face, u, v, orientations[o]);
+
+                    expected.normalise();
+                    actual.normalise();
+                    if(!expected.positionEquals(actual, 1e-5)) {
+                        if(mismatches == 0) {
+                            printf("%-7s face %u at (%g, %g): camera sees (%g, %g, %g), CPU sees (%g, %g, %g)\n",
+                                orientationNames[o], face, u, v, expected.x, expected.y, expected.z,
+                                actual.x, actual.y, actual.z);
+                        }
+                        mismatches++;
+                    }
+                }
+            }
+
+            if(mismatches) {
+                failures++;
+            }
+        }
+
+        printf("%-7s checked\n", orientationNames[o]);
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,148 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include "SpacescapeNoiseKernels.h"
+#include "SpacescapeRandom.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace Ogre;
+
+typedef float (*ScalarNoise)(const SpacescapeNoiseKernels::Tables&, float, float, float);
+typedef void (*BatchNoise)(const SpacescapeNoiseKernels::Tables&, const float*, const float*, const float*, float*, size_t);
+
+/** Checks the vector Perlin and simplex noise kernels are bit identical to the scalar 
+reference on every instruction set this CPU supports, including the
+partial batches at the end of an array.
+*/
+int main(int argc, char** argv)
+{
+    // build a shuffled permutation table the way SpacescapeLayer::initNoise does
+    uchar permutations[512];
+    for(int i = 0; i < 256; i++) {
+        permutations[i] = i;
+    }
+
+    SpacescapeRandom random(1234);
+    for(int i = 0; i < 256; i++) {
+        uchar swapIndex = random.nextBounded(256);
+        uchar oldVal = permutations[i];
+        permutations[i] = permutations[swapIndex];
+        permutations[swapIndex] = oldVal;
+    }
+
+    for(int i = 0; i < 256; i++) {
+        permutations[i + 256] = permutations[i];
+    }
+
+    // the tables the noise shaders see and the ones SpacescapeLayer uses
+    SpacescapeNoiseKernels::Tables tables[2];
+    tables[0].init(permutations, true);
+    tables[1].init(permutations, false);
+
+    // points on both sides of zero, including exact lattice points
+    const size_t numPoints = 65536 + 7;
+    std::vector<float> x(numPoints), y(numPoints), z(numPoints);
+    for(size_t i = 0; i < numPoints; i++) {
+        x[i] = (random.nextUnit() - 0.5f) * 600.0f;
+        y[i] = (random.nextUnit() - 0.5f) * 600.0f;
+        z[i] = (random.nextUnit() - 0.5f) * 600.0f;
+
+        if(i % 101 == 0) {
+            x[i] = (float)(int)x[i];
+            y[i] = (float)(int)y[i];
+            z[i] = (float)(int)z[i];
+        }
+    }
+
+    const SpacescapeNoiseKernels::InstructionSet sets[] = {
+        SpacescapeNoiseKernels::SIS_SCALAR,
+        SpacescapeNoiseKernels::SIS_SSE41,
+        SpacescapeNoiseKernels::SIS_AVX2,
+        SpacescapeNoiseKernels::SIS_AVX512,
+        SpacescapeNoiseKernels::SIS_NEON
+    };
+
+    const char* noiseNames[] = { "perlin", "simplex" };
+    const ScalarNoise scalarNoise[] = { SpacescapeNoiseKernels::perlinNoise, SpacescapeNoiseKernels::simplexNoise };
+    const BatchNoise batchNoise[] = { SpacescapeNoiseKernels::perlinNoise, SpacescapeNoiseKernels::simplexNoise };
+
+    int failures = 0;
+    std::vector<float> out(numPoints);
+    std::vector<float> reference(numPoints);
+
+    for(size_t s = 0; s < sizeof(sets) / sizeof(sets[0]); s++) {
+        const char* name = SpacescapeNoiseKernels::getInstructionSetName(sets[s]);
+
+        SpacescapeNoiseKernels::setInstructionSet(sets[s]);
+        if(SpacescapeNoiseKernels::getInstructionSet() != sets[s]) {
+            printf("%-8s not supported, skipped\n", name);
+            continue;
+        }
+
+        for(size_t n = 0; n < 2; n++) {
+            for(size_t t = 0; t < 2; t++) {
+                for(size_t i = 0; i < numPoints; i++) {
+                    reference[i] = scalarNoise[n](tables[t], x[i], y[i], z[i]);
+                }
+
+                // every offset and tail length a 4, 8 or 16 wide kernel can see
+                for(size_t start = 0; start < 16; start++) {
+                    size_t count = numPoints - start;
+                    memset(&out[0], 0, out.size() * sizeof(float));
+                    batchNoise[n](tables[t], &x[start], &y[start], &z[start], &out[start], count);
+
+                    size_t mismatches = 0;
+                    for(size_t i = start; i < numPoints; i++) {
+                        if(memcmp(&out[i], &reference[i], sizeof(float)) != 0) {
+                            if(mismatches == 0) {
+                                printf("%-8s %s point %u (%g, %g, %g): %.9g != %.9g\n", name, noiseNames[n],
+                                    (unsigned int)i, x[i], y[i], z[i], out[i], reference[i]);
+                            }
+                            mismatches++;
+                        }
+                    }
+
+                    if(mismatches) {
+                        printf("%-8s %s offset %u: %u of %u values differ from the scalar reference\n", name, 
+                            noiseNames[n], (unsigned int)start, (unsigned int)mismatches, (unsigned int)count);
+                        failures++;
+                    }
+                }
+            }
+        }
+
+        printf("%-8s checked\n", name);
+    }
+
+    SpacescapeNoiseKernels::setInstructionSet(SpacescapeNoiseKernels::getBestInstructionSet());
+
+    return failures ? 1 : 0;
+}
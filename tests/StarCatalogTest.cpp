@@ -0,0 +1,144 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include "SpacescapeStarCatalog.h"
+#include "SpacescapeRandom.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+
+using namespace Ogre;
+
+/** Utility function to make a random CSV number field in one of the 
+ways catalogs write them
+@param random The random number generator
+@return the field
+*/
+static String makeField(SpacescapeRandom& random)
+{
+    char field[64];
+    double value = (random.nextUnit() - 0.5) * std::pow(10.0, (int)random.nextBounded(61) - 30);
+
+    switch(random.nextBounded(10)) {
+        case 0:
+            snprintf(field, sizeof(field), "%d", (int)random.nextBounded(2000000) - 1000000);
+            break;
+        case 1:
+            snprintf(field, sizeof(field), "%.*f", (int)random.nextBounded(9), value * 1e-20);
+            break;
+        case 2:
+            snprintf(field, sizeof(field), "%.*e", (int)random.nextBounded(10), value);
+            break;
+        case 3:
+            snprintf(field, sizeof(field), "%.*E", (int)random.nextBounded(10), value);
+            break;
+        case 4:
+            // more significant digits than the parser keeps
+            snprintf(field, sizeof(field), "%.17g", value);
+            break;
+        case 5:
+            snprintf(field, sizeof(field), "%.30f", value * 1e-25);
+            break;
+        case 6:
+            snprintf(field, sizeof(field), " +%g", std::fabs(value));
+            break;
+        case 7:
+            snprintf(field, sizeof(field), "%s.%u", random.nextBounded(2) ? "-" : "", random.nextBounded(100000));
+            break;
+        case 8:
+            snprintf(field, sizeof(field), "%u.", random.nextBounded(100000));
+            break;
+        default:
+            // not a number
+            snprintf(field, sizeof(field), "%s", random.nextBounded(2) ? "" : "abc");
+            break;
+    }
+
+    return field;
+}
+
+/** Writes a HYG style CSV catalog of numbers in many formats and checks
+loading it parses every field to the same float as strtod.  The catalog
+is big enough to be split into several chunks.
+*/
+int main(int argc, char** argv)
+{
+    static const char* filename = "StarCatalogTest.csv";
+    const size_t numStars = 100000;
+
+    // the field each catalog column is read from
+    const size_t columnFields[SpacescapeStarCatalog::SC_NUM_COLUMNS] = { 2, 3, 4, 5, 6, 7 };
+
+    SpacescapeRandom random(1234);
+    std::vector<String> fields(numStars * SpacescapeStarCatalog::SC_NUM_COLUMNS);
+    {
+        std::ofstream file(filename, std::ios::binary);
+        file << "id,proper,x,y,z,bv,absmag,distance,spect\n";
+        for(size_t i = 0; i < numStars; i++) {
+            file << i << (i % 7 ? "," : ",Sol");
+            for(int c = 0; c < SpacescapeStarCatalog::SC_NUM_COLUMNS; c++) {
+                fields[i * SpacescapeStarCatalog::SC_NUM_COLUMNS + c] = makeField(random);
+                file << "," << fields[i * SpacescapeStarCatalog::SC_NUM_COLUMNS + c];
+            }
+            file << ",G2V" << (i % 3 ? "\n" : "\r\n");
+        }
+    }
+
+    SpacescapeStarCatalog catalog;
+    bool loaded = catalog.loadCSV(filename);
+    std::remove(filename);
+
+    if(!loaded || catalog.getNumStars() != numStars) {
+        printf("loaded %u of %u stars\n", (unsigned int)catalog.getNumStars(), (unsigned int)numStars);
+        return 1;
+    }
+
+    size_t mismatches = 0;
+    for(int c = 0; c < SpacescapeStarCatalog::SC_NUM_COLUMNS; c++) {
+        const float* column = catalog.getColumn((SpacescapeStarCatalog::Column)c);
+        for(size_t i = 0; i < numStars; i++) {
+            const String& field = fields[i * SpacescapeStarCatalog::SC_NUM_COLUMNS + c];
+            float expected = (float)strtod(field.c_str(), 0);
+            if(column[i] != expected) {
+                if(mismatches == 0) {
+                    printf("star %u field %u \"%s\": %.9g != %.9g\n", (unsigned int)i, 
+                        (unsigned int)columnFields[c], field.c_str(), column[i], expected);
+                }
+                mismatches++;
+            }
+        }
+    }
+
+    printf("%u of %u fields differ from strtod\n", (unsigned int)mismatches, 
+        (unsigned int)(numStars * SpacescapeStarCatalog::SC_NUM_COLUMNS));
+
+    return mismatches ? 1 : 0;
+}
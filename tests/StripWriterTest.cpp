@@ -0,0 +1,256 @@
+/* 
+This source file is part of Spacescape
+For the latest info, see http://alexcpeterson.com/spacescape
+
+"He determines the number of the stars and calls them each by name. "
+Psalm 147:4
+
+The MIT License
+
+Copyright (c) 2010 Alex Peterson
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include "SpacescapeStripWriter.h"
+#include "SpacescapeRandom.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+using namespace Ogre;
+
+// a face and mip level worth of RGB float colours
+typedef std::vector<float> Level;
+
+/** Utility function to read a whole file
+@param filename The file to read
+@return the file contents, empty if it couldn't be read
+*/
+static std::vector<uchar> readFile(const String& filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    return std::vector<uchar>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+/** Utility function to write an image with a strip writer
+@param filename The file to write
+@param size The width/height of each face
+@param numFaces The number of faces
+@param hdr Write floating point colours when the file type supports it
+@param numMipmaps The number of mip levels after level 0
+@param compression The .dds block compression or PF_UNKNOWN
+@param stripHeight Rows per writeRows call or 0 to write whole levels
+@param levels The levels to write, face after face, converted to the
+writer's pixel format like SpacescapePlugin::saveImage does
+@return true on success
+*/
+static bool writeFile(const String& filename, unsigned int size, unsigned int numFaces, bool hdr, 
+    unsigned int numMipmaps, PixelFormat compression, unsigned int stripHeight, const std::vector<Level>& levels)
+{
+    SpacescapeStripWriter writer;
+    writer.setCompression(compression);
+    if(!writer.open(filename, size, numFaces, hdr, numMipmaps)) {
+        return false;
+    }
+
+    size_t rowSize = PixelUtil::getNumElemBytes(writer.getFormat());
+    std::vector<uchar> level;
+    bool success = true;
+    for(size_t i = 0; i < levels.size(); i++) {
+        unsigned int levelSize = std::max(1u, size >> (i % (numMipmaps + 1)));
+        PixelBox src(levelSize, levelSize, 1, PF_FLOAT32_RGB, const_cast<float*>(&levels[i][0]));
+        level.resize(PixelUtil::getMemorySize(levelSize, levelSize, 1, writer.getFormat()));
+        PixelUtil::bulkPixelConversion(src, PixelBox(levelSize, levelSize, 1, writer.getFormat(), &level[0]));
+
+        unsigned int height = stripHeight ? stripHeight : levelSize;
+        for(unsigned int row = 0; row < levelSize; row += height) {
+            unsigned int rows = std::min(height, levelSize - row);
+            PixelBox strip(levelSize, rows, 1, writer.getFormat(), &level[row * levelSize * rowSize]);
+            success &= writer.writeRows(strip);
+        }
+    }
+
+    return writer.close() && success;
+}
+
+/** Utility function to check a Radiance .hdr file decodes to the colours
+it was written from, within the precision of the shared exponent
+@param file The file contents
+@param size The width/height of the image
+@param colours The RGB float colours that were written
+@return true if the file matches
+*/
+static bool checkRGBE(const std::vector<uchar>& file, unsigned int size, const float* colours)
+{
+    String contents(file.begin(), file.end());
+    size_t pos = contents.find("+X ");
+    if(pos == String::npos) {
+        return false;
+    }
+    pos = contents.find('\n', pos) + 1;
+
+    std::vector<uchar> scanline(size * 4);
+    for(unsigned int y = 0; y < size; y++) {
+        if(size >= 8) {
+            // run length encoded, one channel after the other
+            if(pos + 4 > file.size() || file[pos] != 2 || file[pos + 1] != 2) {
+                return false;
+            }
+            pos += 4;
+
+            for(int c = 0; c < 4; c++) {
+                unsigned int x = 0;
+                while(x < size && pos < file.size()) {
+                    uchar count = file[pos++];
+                    bool run = count > 128;
+                    if(run) {
+                        count -= 128;
+                    }
+                    if(x + count > size) {
+                        return false;
+                    }
+                    for(uchar i = 0; i < count; i++, x++) {
+                        scanline[x * 4 + c] = run ? file[pos] : file[pos++];
+                    }
+                    if(run) {
+                        pos++;
+                    }
+                }
+            }
+        }
+        else {
+            if(pos + size * 4 > file.size()) {
+                return false;
+            }
+            memcpy(&scanline[0], &file[pos], size * 4);
+            pos += size * 4;
+        }
+
+        for(unsigned int x = 0; x < size; x++) {
+            const float* p = colours + (y * size + x) * 3;
+            const uchar* rgbe = &scanline[x * 4];
+            float v = std::max(p[0], std::max(p[1], p[2]));
+            for(int c = 0; c < 3; c++) {
+                float f = rgbe[3] ? ldexpf(rgbe[c], rgbe[3] - (128 + 8)) : 0.0f;
+                if(std::fabs(f - p[c]) > v / 128.0f + 1e-30f) {
+                    printf("hdr      pixel (%u, %u) channel %d: %g != %g\n", x, y, c, f, p[c]);
+                    return false;
+                }
+            }
+        }
+    }
+
+    return pos == file.size();
+}
+
+/** Checks writing images a few rows at a time gives exactly the same
+files as writing each face and mip level in one go, for every file type
+the strip writer supports, and that .hdr files decode to the colours that
+were written.
+*/
+int main(int argc, char** argv)
+{
+    struct TestCase
+    {
+        const char* extension;
+        unsigned int size;
+        unsigned int numFaces;
+        bool hdr;
+        unsigned int numMipmaps;
+        PixelFormat compression;
+    };
+
+    const TestCase cases[] = {
+        { ".dds", 37, 6, false, 0, PF_UNKNOWN },
+        { ".dds", 37, 6, true, 5, PF_UNKNOWN },
+        { ".dds", 32, 1, false, 3, PF_UNKNOWN },
+        { ".dds", 37, 6, false, 5, PF_DXT1 },
+        { ".dds", 37, 1, true, 3, PF_BC6H_UF16 },
+        { ".hdr", 37, 1, true, 0, PF_UNKNOWN },
+        { ".hdr", 5, 1, true, 0, PF_UNKNOWN },
+        { ".pfm", 37, 1, true, 0, PF_UNKNOWN },
+        { ".tga", 37, 1, false, 0, PF_UNKNOWN }
+    };
+
+    const unsigned int stripHeights[] = { 1, 3, 16 };
+
+    SpacescapeRandom random(1234);
+    int failures = 0;
+
+    for(size_t t = 0; t < sizeof(cases) / sizeof(cases[0]); t++) {
+        const TestCase& test = cases[t];
+        char name[64];
+        snprintf(name, sizeof(name), "%u x %u%s %u mips%s%s", test.size, test.numFaces, 
+            test.hdr ? " hdr" : "", test.numMipmaps, test.compression != PF_UNKNOWN ? " " : "",
+            test.compression != PF_UNKNOWN ? PixelUtil::getFormatName(test.compression).c_str() : "");
+
+        // random colours with flat rows and black pixels so the
+        // .hdr run length encoding sees runs and literals
+        std::vector<Level> levels;
+        for(unsigned int face = 0; face < test.numFaces; face++) {
+            for(unsigned int mip = 0; mip <= test.numMipmaps; mip++) {
+                unsigned int levelSize = std::max(1u, test.size >> mip);
+                Level level(levelSize * levelSize * 3);
+                for(size_t i = 0; i < level.size(); i++) {
+                    size_t row = i / (levelSize * 3);
+                    level[i] = row % 5 == 0 ? 0.5f : (i % 11 == 0 ? 0.0f : random.nextUnit() * (test.hdr ? 8.0f : 1.0f));
+                }
+                levels.push_back(level);
+            }
+        }
+
+        String filename = String("StripWriterTest") + test.extension;
+
+        if(!writeFile(filename, test.size, test.numFaces, test.hdr, test.numMipmaps, test.compression, 0, levels)) {
+            printf("%-8s %s: whole image write failed\n", test.extension, name);
+            failures++;
+            continue;
+        }
+        std::vector<uchar> whole = readFile(filename);
+
+        for(size_t s = 0; s < sizeof(stripHeights) / sizeof(stripHeights[0]); s++) {
+            if(!writeFile(filename, test.size, test.numFaces, test.hdr, test.numMipmaps, test.compression, 
+                stripHeights[s], levels)) {
+                printf("%-8s %s: strip write failed\n", test.extension, name);
+                failures++;
+                continue;
+            }
+
+            std::vector<uchar> strips = readFile(filename);
+            if(strips != whole) {
+                printf("%-8s %s: %u row strips differ from the whole image (%u vs %u bytes)\n", test.extension, 
+                    name, stripHeights[s], (unsigned int)strips.size(), (unsigned int)whole.size());
+                failures++;
+            }
+        }
+
+        if(String(test.extension) == ".hdr" && !checkRGBE(whole, test.size, &levels[0][0])) {
+            printf("%-8s %s: decoded colours differ\n", test.extension, name);
+            failures++;
+        }
+
+        std::remove(filename.c_str());
+        printf("%-8s %s checked\n", test.extension, name);
+    }
+
+    return failures ? 1 : 0;
+}